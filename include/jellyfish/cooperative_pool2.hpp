@@ -44,6 +44,11 @@
 /// is in [0, max_producers) and it is guaranteed that at any given
 /// time, no two producers have the same `i`.
 ///
+/// The derived class may also implement `void prepare(T& e)`. It is
+/// called by the consumer thread which takes the element, before it
+/// is used. The part of the work done there instead of in `produce`
+/// is done in parallel by the consumers.
+///
 /// The following example will produce the integers `[0, 1000 * max)`,
 /// with max producers.
 ///
@@ -138,6 +143,8 @@ public:
 
   uint32_t size() const { return size_; }
 
+  void prepare(element_type&) { } // Default: nothing to do
+
   element_type* element_begin() { return elts_; }
   element_type* element_end() { return elts_ + size_; }
 
@@ -147,7 +154,7 @@ public:
     cooperative_pool2& cp_;
     uint32_t          i_;       // Index of element
   public:
-    job(cooperative_pool2& cp) : cp_(cp), i_(cp_.get_element()) { }
+    job(cooperative_pool2& cp) : cp_(cp), i_(cp_.get_element()) { prepare(); }
     ~job() { release(); }
 
     void release() {
@@ -159,12 +166,18 @@ public:
     void next() {
       release();
       i_ = cp_.get_element();
+      prepare();
     }
 
     element_type& operator*() { return cp_.elts_[i_]; }
     element_type* operator->() { return &cp_.elts_[i_]; }
 
   private:
+    void prepare() {
+      if(!is_empty())
+        static_cast<D&>(cp_).prepare(cp_.elts_[i_]);
+    }
+
     // Disable copy of job
     job(const job& rhs) { }
     job& operator=(const job& rhs) { }
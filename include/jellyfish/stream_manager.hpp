@@ -24,17 +24,20 @@
 #include <mutex>
 
 namespace jellyfish {
-template<typename PathIterator>
+/// The files are opened as FileStream, which must be constructible
+/// from a path. For example, a stream decompressing the files on the
+/// fly.
+template<typename PathIterator, typename FileStream = std::ifstream>
 class stream_manager {
-  /// A wrapper around an ifstream for a standard file. Standard in
+  /// A wrapper around a FileStream for a standard file. Standard in
   /// opposition to a pipe_stream below, but the file may be a regular
   /// file or a pipe. The file is opened once and notifies the manager
   /// that it is closed upon destruction.
-  class file_stream : public std::ifstream {
+  class file_stream : public FileStream {
     stream_manager& manager_;
   public:
     file_stream(const char* path, stream_manager& manager) :
-      std::ifstream(path),
+      FileStream(path),
       manager_(manager)
     {
       manager_.take_file();
@@ -3,6 +3,12 @@
 
 #include <string>
 #include <memory>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <mutex>
 
 #include <jellyfish/cooperative_pool2.hpp>
 #include <jellyfish/cpp_array.hpp>
@@ -16,25 +22,35 @@ struct header_sequence_qual {
 struct sequence_list {
   size_t nb_filled;
   std::vector<header_sequence_qual> data;
+  std::string raw; // records not yet parsed into data
 };
 
+/// The producer, holding the producer token, only finds the
+/// boundaries of the records in large blocks read from the stream and
+/// copies them in the element. The records are parsed by the consumer
+/// thread which takes the element (see prepare()), hence in parallel.
 template<typename StreamIterator>
 class whole_sequence_parser : public jellyfish::cooperative_pool2<whole_sequence_parser<StreamIterator>, sequence_list> {
   typedef jellyfish::cooperative_pool2<whole_sequence_parser<StreamIterator>, sequence_list> super;
   typedef std::unique_ptr<std::istream> stream_type;
   enum file_type { DONE_TYPE, FASTA_TYPE, FASTQ_TYPE };
+  static const size_t read_size = 1 << 20; // bytes read from a stream at once
 
   struct stream_status {
     file_type   type;
-    std::string buffer;
+    std::string buffer; // data read from the stream
+    size_t      pos;    // start of the records not yet handed over in buffer
+    bool        eof;
     stream_type stream;
-    stream_status() : type(DONE_TYPE) { }
+    stream_status() : type(DONE_TYPE), pos(0), eof(false) { }
   };
   cpp_array<stream_status> streams_;
   StreamIterator&          streams_iterator_;
   const size_t             max_sequence_;
   size_t                   files_read_; // nb of files read
   size_t                   reads_read_; // nb of reads read
+  std::exception_ptr       error_;      // first error reading a stream
+  std::mutex               error_mutex_;
 
 
 public:
@@ -82,7 +98,7 @@ public:
       return true;
     }
 
-    if(st.stream->good())
+    if(peek(st, 0) != EOF)
       return false;
 
     // Reach the end of file, close current and try to open the next one
@@ -90,22 +106,61 @@ public:
     return false;
   }
 
+  /// Parse the records of the element, in the consumer thread
+  void prepare(sequence_list& buff) {
+    if(buff.raw.empty()) return;
+    const char*       p   = buff.raw.data();
+    const char* const end = p + buff.raw.size();
+    for(size_t i = 0; i < buff.nb_filled; ++i) {
+      header_sequence_qual& fill_buff = buff.data[i];
+      const char            type      = *p;
+      fill_buff.header.clear();
+      p = append_line(p + 1, end, fill_buff.header); // Skip '>' or '@'
+      fill_buff.seq.clear();
+      while(p < end && *p != (type == '>' ? '>' : '+'))
+        p = append_line(p, end, fill_buff.seq);
+      if(type == '@') {
+        const char* nl = (const char*)memchr(p, '\n', end - p);
+        p = nl ? nl + 1 : end; // Skip '+' line
+        fill_buff.qual.clear();
+        while(fill_buff.qual.size() < fill_buff.seq.size() && p < end)
+          p = append_line(p, end, fill_buff.qual);
+      }
+    }
+    // Don't hold on to the memory of a long sequence
+    if(buff.raw.capacity() > 2 * read_size)
+      std::string().swap(buff.raw);
+    else
+      buff.raw.clear();
+  }
+
   size_t nb_files() const { return files_read_; }
   size_t nb_reads() const { return reads_read_; }
+  /// The first error reading a stream (e.g., a truncated compressed
+  /// file), null if none. The stream is then treated as ended, so check
+  /// it once the parsing is over.
+  std::exception_ptr error() const { return error_; }
 
 protected:
   void open_next_file(stream_status& st) {
     st.stream.reset();
-    st.stream = streams_iterator_.next();
+    st.buffer.clear();
+    st.pos = 0;
+    st.eof = false;
+    try {
+      st.stream = streams_iterator_.next();
+    } catch(...) { // Failed to open the next file
+      record_error();
+      st.stream.reset();
+    }
     if(!st.stream) {
       st.type = DONE_TYPE;
       return;
     }
 
     ++files_read_;
-    // Update the type of the current file and move past first header
-    // to beginning of sequence.
-    switch(st.stream->peek()) {
+    // Update the type of the current file
+    switch(peek(st, 0)) {
     case EOF: return open_next_file(st);
     case '>':
       st.type = FASTA_TYPE;
@@ -118,54 +173,125 @@ protected:
     }
   }
 
+  void record_error() {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if(!error_) error_ = std::current_exception();
+  }
+
+  // Append the next block of the stream to the buffer. False at end of
+  // file.
+  bool fill(stream_status& st) {
+    if(st.eof) return false;
+    if(st.pos >= read_size) { // Drop the data handed over
+      st.buffer.erase(0, st.pos);
+      st.pos = 0;
+    }
+    const size_t size = st.buffer.size();
+    st.buffer.resize(size + read_size);
+    std::streamsize got;
+    try { // The stream buffer is read directly, its errors are not caught by the stream
+      got = st.stream->rdbuf()->sgetn(&st.buffer[size], read_size);
+    } catch(...) {
+      record_error();
+      got = 0;
+    }
+    st.buffer.resize(size + std::max(got, (std::streamsize)0));
+    st.eof = got <= 0;
+    return !st.eof;
+  }
+
+  // Character at position pos in the buffer, EOF past the end of the
+  // file. Positions are relative to st.pos, which fill() may change.
+  int peek(stream_status& st, size_t pos) {
+    while(st.pos + pos >= st.buffer.size())
+      if(!fill(st)) return EOF;
+    return (unsigned char)st.buffer[st.pos + pos];
+  }
+
+  // Length of the line at pos, without the '\n'. Set pos to the start
+  // of the next line.
+  size_t next_line(stream_status& st, size_t& pos) {
+    size_t scanned = pos;
+    while(true) {
+      const char* const start = st.buffer.data() + st.pos;
+      const size_t      size  = st.buffer.size() - st.pos;
+      const char* const nl    = (const char*)memchr(start + scanned, '\n', size - scanned);
+      if(nl) {
+        const size_t len = nl - start - pos;
+        pos = nl - start + 1;
+        return len;
+      }
+      scanned = size;
+      if(!fill(st)) {
+        const size_t len = size - pos;
+        pos = size;
+        return len;
+      }
+    }
+  }
+
+  // Hand over the first len bytes of the records to the element
+  void hand_over(stream_status& st, size_t len, sequence_list& buff) {
+    if(st.pos == 0 && 2 * len >= st.buffer.size()) {
+      // Mostly one long sequence: give away the buffer, keep the rest
+      buff.raw.swap(st.buffer);
+      st.buffer.assign(buff.raw, len, std::string::npos);
+      buff.raw.resize(len);
+    } else {
+      buff.raw.assign(st.buffer, st.pos, len);
+      st.pos += len;
+    }
+  }
+
   void read_fasta(stream_status& st, sequence_list& buff) {
     size_t&      nb_filled     = buff.nb_filled;
     size_t       sequence_read = 0;
     const size_t data_size     = buff.data.size();
+    size_t       pos           = 0;
 
-    for(nb_filled = 0; nb_filled < data_size && sequence_read < max_sequence_ && st.stream->peek() != EOF; ++nb_filled) {
+    for(nb_filled = 0; nb_filled < data_size && sequence_read < max_sequence_ && peek(st, pos) != EOF; ++nb_filled) {
       ++reads_read_;
-      header_sequence_qual& fill_buff = buff.data[nb_filled];
-      st.stream->get(); // Skip '>'
-      std::getline(*st.stream, fill_buff.header);
-      fill_buff.seq.clear();
-      for(int c = st.stream->peek(); c != '>' && c != EOF; c = st.stream->peek()) {
-        std::getline(*st.stream, st.buffer); // Wish there was an easy way to combine the
-        fill_buff.seq.append(st.buffer);             // two lines avoiding copying
-      }
-      sequence_read += fill_buff.seq.size();
+      next_line(st, pos); // Header
+      for(int c = peek(st, pos); c != '>' && c != EOF; c = peek(st, pos))
+        sequence_read += next_line(st, pos);
     }
+    hand_over(st, pos, buff);
   }
 
   void read_fastq(stream_status& st, sequence_list& buff) {
     size_t&      nb_filled     = buff.nb_filled;
     size_t       sequence_read = 0;
     const size_t data_size     = buff.data.size();
+    size_t       pos           = 0;
 
-    for(nb_filled = 0; nb_filled < data_size && sequence_read < max_sequence_ && st.stream->peek() != EOF; ++nb_filled) {
+    for(nb_filled = 0; nb_filled < data_size && sequence_read < max_sequence_ && peek(st, pos) != EOF; ++nb_filled) {
       ++reads_read_;
-      header_sequence_qual& fill_buff = buff.data[nb_filled];
-      st.stream->get(); // Skip '@'
-      std::getline(*st.stream, fill_buff.header);
-      fill_buff.seq.clear();
-      while(st.stream->peek() != '+' && st.stream->peek() != EOF) {
-        std::getline(*st.stream, st.buffer); // Wish there was an easy way to combine the
-        fill_buff.seq.append(st.buffer);             // two lines avoiding copying
-      }
-      if(!st.stream->good())
+      next_line(st, pos); // Header
+      size_t seq_len = 0;
+      for(int c = peek(st, pos); c != '+' && c != EOF; c = peek(st, pos))
+        seq_len += next_line(st, pos);
+      if(peek(st, pos) == EOF)
         throw std::runtime_error("Truncated fastq file");
-      sequence_read += fill_buff.seq.size();
-      st.stream->ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-      fill_buff.qual.clear();
-      while(fill_buff.qual.size() < fill_buff.seq.size() && st.stream->good()) {
-        std::getline(*st.stream, st.buffer);
-        fill_buff.qual.append(st.buffer);
-      }
-      if(fill_buff.qual.size() != fill_buff.seq.size())
+      sequence_read += seq_len;
+      next_line(st, pos); // '+' line
+      size_t qual_len = 0;
+      while(qual_len < seq_len && peek(st, pos) != EOF)
+        qual_len += next_line(st, pos);
+      if(qual_len != seq_len)
         throw std::runtime_error("Invalid fastq file: wrong number of quals");
-      if(st.stream->peek() != EOF && st.stream->peek() != '@')
+      if(peek(st, pos) != EOF && peek(st, pos) != '@')
         throw std::runtime_error("Invalid fastq file: header missing");
     }
+    hand_over(st, pos, buff);
+  }
+
+  // Append to str the line at p, without the '\n'. Return the start of
+  // the next line.
+  static const char* append_line(const char* p, const char* end, std::string& str) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    if(!nl) nl = end;
+    str.append(p, nl);
+    return nl < end ? nl + 1 : end;
   }
 };
 } // namespace jellyfish
@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Encoding of BAM header and records
+//!
+//! Follows the SAM/BAM specification (v1.6): all integers are little
+//! endian, the CIGAR is binary (length << 4 | op), the sequence is packed
+//! 2 bases per byte and the tags are typed. The encoded data is then
+//! compressed with bgzf.hh.
+//!
+//! \see bam.cc, bgzf.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __BAM_HH
+#define __BAM_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace mummer {
+namespace bam {
+
+//! Bin of the region [beg, end) (0-based, end exclusive) in the BAI index
+int reg2bin(int64_t beg, int64_t end);
+
+//! Length on the reference of the CIGAR operations
+int64_t reference_span(const std::vector<uint32_t>& cigar);
+
+//! Append to out the BAM header: magic, SAM header text and references
+//! (name, length)
+void append_header(std::string& out, const std::string& text,
+                   const std::vector<std::pair<std::string, long>>& references);
+
+//! Append to out a record, with no mate and no quality values.
+//!
+//! \param pos 0-based position on the reference
+//! \param seq query bases, with seq_len 0 for no sequence
+//! \param md MD tag, omitted if empty
+void append_record(std::string& out, const char* qname, uint16_t flag,
+                   int32_t ref_id, int32_t pos, uint8_t mapq,
+                   const std::vector<uint32_t>& cigar,
+                   const char* seq, size_t seq_len,
+                   int32_t nm, const std::string& md);
+
+} // namespace bam
+} // namespace mummer
+
+#endif // __BAM_HH
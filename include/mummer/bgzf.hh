@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief BGZF block compression (the compression of BAM files)
+//!
+//! A BGZF file is a series of gzip members, each holding at most
+//! BLOCK_SIZE bytes of uncompressed data, with the compressed size of the
+//! member in an extra field. The blocks are independent: they are
+//! compressed in parallel, and the blocks of different threads can be
+//! concatenated in any order, as long as each thread hands out whole
+//! records. A file ends with an empty block (EOF_BLOCK).
+//!
+//! Requires zlib. Without it, available() is false and compressing
+//! throws.
+//!
+//! \see bgzf.cc
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __BGZF_HH
+#define __BGZF_HH
+
+#include <cstddef>
+#include <string>
+#include <ostream>
+
+namespace mummer {
+namespace bgzf {
+
+const size_t BLOCK_SIZE    = 0xff00; //!< maximum uncompressed size of a block
+const size_t EOF_BLOCK_LEN = 28;
+extern const char EOF_BLOCK[EOF_BLOCK_LEN]; //!< empty block ending a file
+
+//! Whether compiled with zlib
+bool available();
+
+//! Compress data into BGZF blocks appended to out. level is the zlib
+//! compression level (-1 for the default).
+void compress(const char* data, size_t len, std::string& out, int level = -1);
+inline void compress(const std::string& data, std::string& out, int level = -1) {
+  compress(data.data(), data.size(), out, level);
+}
+
+//! Buffer data written to an ostream and compress it in BGZF blocks,
+//! many blocks at a time in parallel.
+class writer {
+  std::ostream&      os_m;
+  const unsigned int threads_m;
+  const int          level_m;
+  std::string        buffer_m;
+
+  void compress_buffer();
+public:
+  writer(std::ostream& os, unsigned int threads = 1, int level = -1);
+  writer(const writer&) = delete;
+  writer& operator=(const writer&) = delete;
+
+  void write(const char* data, size_t len);
+  void write(const std::string& data) { write(data.data(), data.size()); }
+  //! Compress and write the data buffered. The next write starts a new
+  //! block.
+  void flush();
+  //! Flush and write the end of file block
+  void close();
+};
+
+} // namespace bgzf
+} // namespace mummer
+
+#endif // __BGZF_HH
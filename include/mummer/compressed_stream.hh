@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Input streams reading gzip compressed files transparently
+//!
+//! A file starting with the gzip magic number is decompressed on the fly,
+//! other files are read as is. A file may hold many gzip members (as
+//! written by concatenating gzip files, or by parallel writers). BGZF
+//! files (see bgzf.hh) are made of small independent blocks, which are
+//! decompressed many at a time in parallel, with the number of threads
+//! given to the stream (1 by default). The decompression runs in its own
+//! thread, a few large chunks ahead of the reader.
+//!
+//! Opening a stream throws std::runtime_error if the gzip header is
+//! truncated or zlib is not available. Later errors set the badbit.
+//!
+//! The decompressed streams are not seekable (tellg() returns -1), so
+//! readers fall back to sequential reading.
+//!
+//! \see compressed_stream.cc, bgzf.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __COMPRESSED_STREAM_HH
+#define __COMPRESSED_STREAM_HH
+
+#include <istream>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace mummer {
+namespace compressed {
+
+//! Whether the next bytes of the stream buffer are the gzip magic
+//! number. Does not consume any byte.
+bool is_gzip(std::streambuf* sb);
+
+//! Decompress the gzip data read from another stream buffer
+class inflate_streambuf : public std::streambuf {
+  struct state;
+  std::streambuf*        source_m;
+  const unsigned int     threads_m; //!< threads to decompress BGZF blocks
+  std::unique_ptr<state> state_m;
+  std::string            buffer_m; //!< decompressed data
+
+  bool fill_bgzf(std::string& out);
+  bool fill_gzip(std::string& out);
+  void read_ahead();
+protected:
+  int_type underflow() override;
+public:
+  explicit inflate_streambuf(std::streambuf* source, unsigned int threads = 1);
+  ~inflate_streambuf();
+};
+
+//! Input file stream, decompressing gzip files
+class ifstream : public std::istream {
+  std::filebuf                       file_m;
+  std::unique_ptr<inflate_streambuf> inflate_m;
+public:
+  ifstream() : std::istream(&file_m) { }
+  explicit ifstream(const char* path, std::ios::openmode mode = std::ios::in, unsigned int threads = 1)
+    : std::istream(&file_m)
+  { open(path, mode, threads); }
+  explicit ifstream(const std::string& path, std::ios::openmode mode = std::ios::in, unsigned int threads = 1)
+    : ifstream(path.c_str(), mode, threads)
+  { }
+
+  void open(const char* path, std::ios::openmode mode = std::ios::in, unsigned int threads = 1);
+  void open(const std::string& path, std::ios::openmode mode = std::ios::in, unsigned int threads = 1) {
+    open(path.c_str(), mode, threads);
+  }
+  void close();
+  bool is_open() const { return file_m.is_open(); }
+  //! Whether the file is decompressed
+  bool is_compressed() const { return (bool)inflate_m; }
+};
+
+} // namespace compressed
+} // namespace mummer
+
+#endif // __COMPRESSED_STREAM_HH
@@ -12,12 +12,15 @@
 #define __DELTA_HH
 
 #include "tigrinc.hh"
+#include "delta_binary.hh"
+#include "compressed_stream.hh"
 #include <cassert>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <cstdlib>
 #include <iostream>
+#include <functional>
 #include <map>
 
 
@@ -130,13 +133,23 @@ class DeltaReader_t {
 private:
 
   std::string delta_path_m;      //!< the name of the delta input file
-  std::ifstream delta_stream_m;  //!< the delta file input stream
+  mummer::compressed::ifstream delta_stream_m; //!< the delta file input stream, decompressed if gzipped
   std::string data_type_m;       //!< the type of alignment data
   std::string reference_path_m;  //!< the name of the reference file
   std::string query_path_m;      //!< the name of the query file
   DeltaRecord_t record_m;        //!< the current delta information record
   bool is_record_m;              //!< there is a valid record in record_m
   bool is_open_m;                //!< delta stream is open
+  bool is_binary_m;              //!< delta file is in the binary format
+  bool is_indexed_m;             //!< binary delta file has a record index
+  std::streamoff records_begin_m; //!< offset of the first binary record
+  std::streamoff records_end_m;  //!< end of the binary records
+  std::streamoff position_m;     //!< offset of the next binary record
+  mummer::delta_binary::index_t index_m; //!< index of the binary records
+  std::string buffer_m;          //!< payload of the current binary record
+  const char * map_m;            //!< text delta file mapped in memory
+  size_t map_size_m;             //!< size of the mapping
+  const char * map_pos_m;        //!< next text record in the mapping
 
 
   //--------------------------------------------------- readNextAlignment ------
@@ -160,6 +173,50 @@ private:
   bool readNextRecord (const bool read_deltas);
 
 
+  //--------------------------------------------------- readNextBinaryRecord ---
+  //! \brief Reads in the next record from a binary delta file
+  //!
+  //! \param read_deltas read delta information yes/no
+  //! \pre delta file must be open and binary
+  //! \return true on success, false on EOF
+  //!
+  bool readNextBinaryRecord (const bool read_deltas);
+
+
+  //--------------------------------------------------- openBinary -------------
+  //! \brief Reads the header and index of a binary delta file
+  //!
+  //! \pre delta_stream is positioned after the magic number
+  //! \return void
+  //!
+  void openBinary ( );
+
+
+  //--------------------------------------------------- mapText ----------------
+  //! \brief Maps a text delta file in memory, if possible
+  //!
+  //! \pre delta_stream is positioned at the first record
+  //! \return void
+  //!
+  void mapText ( );
+
+
+  //--------------------------------------------------- unmap ------------------
+  //! \brief Releases the memory mapping, if any
+  //!
+  //! \return void
+  //!
+  void unmap ( );
+
+
+  //--------------------------------------------------- parseError -------------
+  //! \brief Abort program on a parse error in the mapped file
+  //!
+  //! \return void
+  //!
+  void parseError ( );
+
+
   //--------------------------------------------------- checkStream ------------
   //! \brief Check stream status and abort program if an error has occured
   //!
@@ -193,6 +250,10 @@ public:
   {
     is_record_m = false;
     is_open_m = false;
+    is_binary_m = false;
+    is_indexed_m = false;
+    map_m = map_pos_m = NULL;
+    map_size_m = 0;
   }
 
 
@@ -223,6 +284,7 @@ public:
   //!
   void close ( )
   {
+    unmap ( );
     delta_path_m.erase ( );
     delta_stream_m.close ( );
     data_type_m.erase ( );
@@ -231,6 +293,9 @@ public:
     record_m.clear ( );
     is_record_m = false;
     is_open_m = false;
+    is_binary_m = false;
+    is_indexed_m = false;
+    index_m.clear ( );
   }
 
 
@@ -263,6 +328,55 @@ public:
   }
 
 
+  //--------------------------------------------------- readNextBatch --------
+  //! \brief Reads in the next delta records from the delta file
+  //!
+  //! Text delta files mapped in memory are split into records, which are
+  //! parsed in parallel. The records vector is reused between calls to
+  //! avoid memory allocations, only the first records are valid.
+  //!
+  //! \param records read the records into this vector
+  //! \param max maximum number of records to read
+  //! \param read_deltas read delta information yes/no
+  //! \param threads number of threads parsing the records
+  //! \pre delta file must be open
+  //! \return the number of records read, 0 on EOF
+  //!
+  size_t readNextBatch (std::vector<DeltaRecord_t> & records, size_t max,
+                        bool read_deltas = true, unsigned int threads = 1);
+
+
+  //--------------------------------------------------- readRecord ------------
+  //! \brief Reads in the first record between two sequences
+  //!
+  //! Seeks directly to the record if the delta file is binary and
+  //! indexed, otherwise rereads the file from the beginning until the
+  //! record is found. Subsequent calls to readNext( ) continue after
+  //! the record.
+  //!
+  //! \param idR the reference sequence ID
+  //! \param idQ the query sequence ID
+  //! \param read_deltas read delta information yes/no
+  //! \pre delta file must be open
+  //! \return true on success, false if there is no such record
+  //!
+  bool readRecord (const std::string & idR, const std::string & idQ,
+                   bool read_deltas = true);
+
+
+  //--------------------------------------------------- isBinary --------------
+  //! \brief Is the current delta file in the binary format
+  //!
+  //! \pre delta file is open
+  //! \return true if the delta file is binary
+  //!
+  bool isBinary ( ) const
+  {
+    assert (is_open_m);
+    return is_binary_m;
+  }
+
+
   //--------------------------------------------------- getRecord --------------
   //! \brief Returns a reference to the current delta record
   //!
@@ -457,6 +571,108 @@ struct DeltaNode_t
 };
 
 
+//===================================================== SNP sorting ============
+const char  INDEL_CHAR = '.';   //!< SNP character of an indel
+const char SEQEND_CHAR = '-';   //!< SNP context past the end of a sequence
+
+struct SNP_R_Sort
+//!< Sorts SNPs by reference ID and position, then query ID and position
+{
+  bool operator() (const SNP_t * a, const SNP_t * b) const
+  {
+    int i = a->ep->refnode->id->compare (*(b->ep->refnode->id));
+
+    if ( i < 0 )
+      return true;
+    else if ( i > 0 )
+      return false;
+    else
+      {
+        if ( a -> pR < b -> pR )
+          return true;
+        else if ( a -> pR > b -> pR )
+          return false;
+        else
+          {
+            int j = a->ep->qrynode->id->compare (*(b->ep->qrynode->id));
+
+            if ( j < 0 )
+              return true;
+            else if ( j > 0 )
+              return false;
+            else
+              {
+                if ( a -> pQ < b -> pQ )
+                  return true;
+                else
+                  return false;
+              }
+          }
+      }
+  }
+};
+
+
+struct SNP_Q_Sort
+//!< Sorts SNPs by query ID and position, then reference ID and position
+{
+  bool operator() (const SNP_t * a, const SNP_t * b) const
+  {
+    int i = a->ep->qrynode->id->compare (*(b->ep->qrynode->id));
+
+    if ( i < 0 )
+      return true;
+    else if ( i > 0 )
+      return false;
+    else
+      {
+        if ( a -> pQ < b -> pQ )
+          return true;
+        else if ( a -> pQ > b -> pQ )
+          return false;
+        else
+          {
+            int j = a->ep->refnode->id->compare (*(b->ep->refnode->id));
+
+            if ( j < 0 )
+              return true;
+            else if ( j > 0 )
+              return false;
+            else
+              {
+                if ( a -> pR < b -> pR )
+                  return true;
+                else
+                  return false;
+              }
+          }
+      }
+  }
+};
+
+
+//===================================================== DeltaDiff_t ============
+enum DiffType_t
+//!< Classification of a breakpoint between two alignments, see show-diff
+  {
+    DIFF_GAP,                   //!< gap between two colinear alignments
+    DIFF_DUP,                   //!< duplicated sequence
+    DIFF_BRK,                   //!< other inserted sequence
+    DIFF_JMP,                   //!< rearrangement
+    DIFF_INV,                   //!< rearrangement with inversion
+    DIFF_SEQ                    //!< rearrangement with another sequence
+  };
+
+struct DeltaDiff_t
+//!< A breakpoint on a sequence
+{
+  DiffType_t type;
+  long s, e;                    //!< breakpoint coordinates, 1-based
+  long gap1, gap2;              //!< DIFF_GAP: gap length in this and the other sequence
+  const std::string * prev;     //!< DIFF_SEQ: previous aligned sequence
+  const std::string * next;     //!< DIFF_SEQ: next aligned sequence
+};
+
 
 //===================================================== DeltaGraph_t ===========
 //! \brief A graph of sequences (nodes) and their alignments (edges)
@@ -483,9 +699,10 @@ public:
   std::string refpath;         //!< path of the reference FastA file
   std::string qrypath;         //!< path of the query FastA file
   AlignmentType_t datatype;    //!< alignment data type
+  unsigned int threads;        //!< number of threads of the parallel passes
 
   DeltaGraph_t()
-  { datatype = NULL_DATA; }
+  { datatype = NULL_DATA; threads = 1; }
 
   ~DeltaGraph_t ( )
   { clear(); }
@@ -511,6 +728,11 @@ public:
   void flagUNIQ(float minuniq);
 
   void loadSequences();
+  void findSNPs(bool sortbyref = true, int context = 0,
+                const std::function<bool (const DeltaEdgelet_t &)> & select = nullptr);
+  void checkSNPs();
+  void findDiffs(bool ref,
+                 const std::function<void (const DeltaNode_t &, const DeltaDiff_t &)> & report);
   std::ostream & outputDelta(std::ostream & out);
 };
 
@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Binary encoding of delta alignment files
+//!
+//! A binary delta file holds the same information as a text delta file,
+//! with every number varint encoded:
+//!
+//!   file    := MAGIC header record* [footer trailer]
+//!   header  := str(reference path) str(query path) str(data type)
+//!   record  := varint(size of payload) payload
+//!   payload := str(idR) str(idQ) varint(lenR) varint(lenQ)
+//!              varint(#alignments) alignment*
+//!   alignment := varint(sR eR sQ eQ idyc simc stpc) varint(#deltas)
+//!                zigzag(delta)*       (without the terminating 0)
+//!   footer  := varint(0) varint(#ids) str(id)*
+//!              varint(#records) (varint(offset) varint(idR) varint(idQ))*
+//!   trailer := footer offset (8 bytes, little endian) INDEX_MAGIC
+//!
+//! where str(s) is varint(length of s) followed by the characters of
+//! s. The records are self contained, so they can be written in any
+//! order by parallel writers. The footer is a string table of the
+//! sequence ids and an index of the records (offsets are relative to the
+//! previous record, ids are indices in the string table), used to seek
+//! to the alignments between a pair of sequences. It starts with an
+//! empty record, so a sequential reader stops there. A file without
+//! footer is valid and read sequentially.
+//!
+//! \see delta.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __DELTA_BINARY_HH
+#define __DELTA_BINARY_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <istream>
+#include <ostream>
+
+namespace mummer {
+namespace delta_binary {
+
+const char     MAGIC[]       = "MUMBDLT1"; //!< start of a binary delta file
+const char     INDEX_MAGIC[] = "MUMBIDX1"; //!< end of an indexed binary delta file
+const size_t   MAGIC_LEN     = 8;
+const size_t   TRAILER_LEN   = 8 + MAGIC_LEN;
+
+//-- Encoding
+inline void put_varint(std::string& buf, uint64_t x) {
+  while(x >= 0x80) {
+    buf += (char)(x | 0x80);
+    x >>= 7;
+  }
+  buf += (char)x;
+}
+inline size_t varint_size(uint64_t x) {
+  size_t res = 1;
+  for( ; x >= 0x80; x >>= 7) ++res;
+  return res;
+}
+inline void put_signed(std::string& buf, long x) {
+  put_varint(buf, ((uint64_t)x << 1) ^ (uint64_t)(x >> (8 * sizeof(long) - 1)));
+}
+inline void put_string(std::string& buf, const std::string& s) {
+  put_varint(buf, s.size());
+  buf += s;
+}
+
+//-- Decoding from memory. good is false after reading past the end.
+struct cursor {
+  const char* p;
+  const char* end;
+  bool        good;
+
+  cursor(const char* b, const char* e) : p(b), end(e), good(true) { }
+
+  uint64_t varint() {
+    if(p < end && !(*p & 0x80)) // Most numbers fit on one byte
+      return (unsigned char)*p++;
+    uint64_t res = 0;
+    for(int shift = 0; p < end && shift < 64; shift += 7) {
+      const unsigned char c = *p++;
+      res |= (uint64_t)(c & 0x7f) << shift;
+      if(!(c & 0x80)) return res;
+    }
+    good = false;
+    return 0;
+  }
+  long signed_varint() {
+    const uint64_t x = varint();
+    return (long)(x >> 1) ^ -(long)(x & 1);
+  }
+  std::string string() {
+    const uint64_t len = varint();
+    if(!good || (uint64_t)(end - p) < len) {
+      good = false;
+      return std::string();
+    }
+    std::string res(p, len);
+    p += len;
+    return res;
+  }
+};
+
+//-- Decoding from a stream. Return false at the end of the stream.
+bool read_varint(std::istream& is, uint64_t& x);
+bool read_string(std::istream& is, std::string& s);
+
+//! Header of a delta alignment
+struct alignment_header {
+  long sR, eR, sQ, eQ;
+  long idyc, simc, stpc;
+};
+
+//! \brief Encode one record, i.e. the alignments between two sequences.
+//!
+//! Call begin(), then alignment() for each alignment and finish() to
+//! append the length prefixed record to a buffer.
+class record_encoder {
+  std::string payload_m;
+
+public:
+  void begin(const std::string& idR, const std::string& idQ, long lenR, long lenQ, uint64_t nb_aligns) {
+    payload_m.clear();
+    put_string(payload_m, idR);
+    put_string(payload_m, idQ);
+    put_varint(payload_m, lenR);
+    put_varint(payload_m, lenQ);
+    put_varint(payload_m, nb_aligns);
+  }
+  //! Add an alignment. The deltas may be terminated by a 0, which is
+  //! not stored.
+  template<typename Iterator>
+  void alignment(const alignment_header& h, Iterator first, Iterator last) {
+    put_varint(payload_m, h.sR);
+    put_varint(payload_m, h.eR);
+    put_varint(payload_m, h.sQ);
+    put_varint(payload_m, h.eQ);
+    put_varint(payload_m, h.idyc);
+    put_varint(payload_m, h.simc);
+    put_varint(payload_m, h.stpc);
+    uint64_t nb = 0;
+    for(Iterator it = first; it != last && *it != 0; ++it) ++nb;
+    put_varint(payload_m, nb);
+    for(Iterator it = first; it != last && *it != 0; ++it)
+      put_signed(payload_m, *it);
+  }
+  void finish(std::string& buf) const {
+    put_varint(buf, payload_m.size());
+    buf += payload_m;
+  }
+};
+
+//! Index of the records of a binary delta file
+struct index_t {
+  struct entry {
+    uint64_t offset;            //!< offset of the record in the file
+    uint64_t idR, idQ;          //!< indices in ids
+  };
+  std::vector<std::string> ids;     //!< string table of sequence ids
+  std::vector<entry>       records;
+
+  void clear() { ids.clear(); records.clear(); }
+};
+
+//! Write the file header and return its size
+uint64_t write_header(std::ostream& os, const std::string& reference_path,
+                      const std::string& query_path, const std::string& data_type);
+
+//! \brief Build the index of the records from offset to the end of the
+//! stream, reading only the record ids.
+//!
+//! \return false if the stream is not a valid sequence of records
+bool scan_records(std::istream& is, uint64_t offset, index_t& index);
+
+//! \brief Write the footer and trailer of index at the current position
+//! of the stream
+void write_index(std::ostream& os, const index_t& index);
+
+//! \brief Read the trailer of the file, if any.
+//!
+//! \return false if the file has no footer. In this case, records_end
+//! is the end of the file. Otherwise it is the offset of the footer.
+bool read_trailer(std::istream& is, uint64_t& records_end);
+
+//! \brief Read the index from the footer of the file, if any.
+//!
+//! \return false if the file has no valid footer. records_end is set as
+//! by read_trailer.
+bool read_index(std::istream& is, index_t& index, uint64_t& records_end);
+
+//! \brief Append the index to a binary delta file written without it.
+//!
+//! \return false if the file could not be read or written
+bool append_index(const std::string& path);
+
+//! \brief Write a binary delta file sequentially, indexing the records
+//! on the fly.
+class writer {
+  std::ostream&                             os_m;
+  uint64_t                                  offset_m;
+  index_t                                   index_m;
+  std::unordered_map<std::string, uint64_t> id_map_m;
+  record_encoder                            encoder_m;
+  index_t::entry                            entry_m;
+  std::string                               buf_m;
+
+  uint64_t id_index(const std::string& id);
+
+public:
+  writer(std::ostream& os, const std::string& reference_path,
+         const std::string& query_path, const std::string& data_type);
+
+  record_encoder& begin(const std::string& idR, const std::string& idQ, long lenR, long lenQ, uint64_t nb_aligns);
+  void end();
+  //! Write the footer. The writer must not be used afterward.
+  void close();
+};
+
+} // namespace delta_binary
+} // namespace mummer
+
+#endif // __DELTA_BINARY_HH
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief External sort of output records, under a memory limit
+//!
+//! Records are a 64 bit key and a payload of bytes (e.g. a SAM line).
+//! Each thread adds its records to its own buffer. A full buffer is
+//! sorted and spilled to a temporary file as a sorted run. The runs, and
+//! the records left in the buffers, are then merged k-way.
+//!
+//! Records are sorted by key, then by payload, so the output does not
+//! depend on the order in which the threads add the records.
+//!
+//! A run is a sequence of records encoded as: key (8 bytes), length of
+//! the payload (4 bytes), payload, in native byte order. Temporary files
+//! are created in $TMPDIR (or /tmp) and unlinked right away.
+//!
+//! \see external_sort.cc
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __EXTERNAL_SORT_HH
+#define __EXTERNAL_SORT_HH
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+
+namespace mummer {
+namespace external_sort {
+
+class sorter;
+
+//! Records added by one thread
+class buffer {
+  sorter&             sorter_m;
+  std::string         data_m;     //!< encoded records, in order added
+  std::vector<size_t> offsets_m;  //!< start of each record in data_m
+
+  void sort();
+public:
+  explicit buffer(sorter& s) : sorter_m(s) { }
+  ~buffer() { done(); }
+  buffer(const buffer&) = delete;
+  buffer& operator=(const buffer&) = delete;
+
+  void add(uint64_t key, const char* payload, size_t len);
+  void add(uint64_t key, const std::string& payload) { add(key, payload.data(), payload.size()); }
+
+  //! Hand the records left to the sorter. The buffer may be used
+  //! again afterwards.
+  void done();
+};
+
+class sorter {
+  friend class buffer;
+
+  const size_t             memory_m;      //!< memory limit of all the buffers
+  const size_t             buffer_size_m; //!< memory limit of a buffer
+  std::mutex               mutex_m;
+  std::vector<FILE*>       runs_m;        //!< runs spilled to disk
+  std::vector<std::string> memory_runs_m; //!< last runs of the buffers
+  size_t                   memory_used_m; //!< size of the memory runs
+
+  void spill(const std::string& run);
+  void keep(std::string&& run);
+  void merge(FILE* const* first, FILE* const* last, bool with_memory_runs,
+             const std::function<void(uint64_t, const char*, size_t)>& out);
+
+public:
+  //! \param memory memory used by the buffers, altogether
+  //! \param nb_buffers number of buffers (threads) adding records
+  sorter(size_t memory, unsigned int nb_buffers);
+  ~sorter();
+  sorter(const sorter&) = delete;
+  sorter& operator=(const sorter&) = delete;
+
+  //! Number of runs spilled to disk so far
+  size_t nb_spilled() const { return runs_m.size(); }
+
+  //! \brief Call out(key, payload, len) on every record, in order.
+  //!
+  //! Must be called once all the buffers are done. The records are
+  //! released as they are merged.
+  void merge(const std::function<void(uint64_t, const char*, size_t)>& out);
+};
+
+} // namespace external_sort
+} // namespace mummer
+
+#endif // __EXTERNAL_SORT_HH
@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Random access to the sequences of a FASTA file
+//!
+//! The FASTA file is mapped in memory and indexed with a samtools
+//! compatible .fai index, read from PATH.fai if up to date, or built
+//! and saved there on first use. Only the requested sequences, or
+//! regions of sequences, are read from the file.
+//!
+//! A record whose lines are not all of the same length (except the
+//! last one) cannot be described in a .fai index. It is still indexed
+//! in memory and read sequentially from its start, and the index is
+//! not saved.
+//!
+//! \see fasta_index.cc
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __FASTA_INDEX_HH
+#define __FASTA_INDEX_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace mummer {
+namespace fasta_index {
+
+//! A line of a .fai index
+struct entry {
+  std::string name;             //!< sequence name, up to the first space
+  uint64_t    length;           //!< number of bases
+  uint64_t    offset;           //!< offset of the first base in the file
+  uint64_t    line_bases;       //!< bases per line, 0 if irregular lines
+  uint64_t    line_width;       //!< bytes per line, including the newline
+};
+
+class indexed_fasta {
+  std::string                             path_m;
+  const char*                             data_m;
+  uint64_t                                size_m;
+  std::vector<entry>                      entries_m;
+  std::unordered_map<std::string, size_t> names_m;
+
+  bool load_index(const std::string& fai_path);
+  void build_index();
+  bool save_index(const std::string& fai_path) const;
+  void add_entry(entry&& e);
+
+public:
+  indexed_fasta() : data_m(nullptr), size_m(0) { }
+  ~indexed_fasta() { close(); }
+  indexed_fasta(const indexed_fasta&) = delete;
+  indexed_fasta& operator=(const indexed_fasta&) = delete;
+
+  //! \brief Map the file in memory and load or build its index.
+  //!
+  //! \return false if the file is not a regular file, cannot be
+  //! mapped (e.g. a pipe) or is not a plain FASTA file starting with
+  //! '>' (e.g. compressed). The caller must then read it sequentially.
+  bool open(const std::string& path);
+  void close();
+  bool is_open() const { return data_m != nullptr; }
+
+  const std::vector<entry>& entries() const { return entries_m; }
+
+  //! The sequence named name, nullptr if none. The first one wins if
+  //! the name is duplicated.
+  const entry* find(const std::string& name) const;
+
+  //! \brief Copy len bases of e, starting at 0 based position start, to
+  //! out, in lower case.
+  //!
+  //! \return the number of bases copied
+  uint64_t fetch(const entry& e, uint64_t start, uint64_t len, char* out) const;
+
+  //! \brief Get a whole sequence in lower case, 1 based: seq[0] is
+  //! '\0'.
+  //!
+  //! \return false if there is no sequence named name
+  bool fetch(const std::string& name, std::string& seq) const;
+};
+
+} // namespace fasta_index
+} // namespace mummer
+
+#endif // __FASTA_INDEX_HH
@@ -11,6 +11,7 @@
 #include <mummer/sparseSA.hpp>
 #include <mummer/mgaps.hh>
 #include <mummer/postnuc.hh>
+#include <mummer/compressed_stream.hh>
 #include <jellyfish/stream_manager.hpp>
 #include <jellyfish/whole_sequence_parser.hpp>
 #include <mt_skip_list/set.hpp>
@@ -57,6 +58,8 @@ struct Options {
     , do_shadows(false)
     , break_len(200)
     , banding(0)
+    , engine(sw_align::DP_ENGINE)
+    , extend_threads(1)
   { }
 
   // Setters corresponding to nucmer.pl switches
@@ -67,6 +70,10 @@ struct Options {
   Options& breaklen(long l) { break_len = l; return *this; }
   Options& banded() { banding = 1; return *this; }
   Options& nobanded() { banding = 0; return *this; }
+  Options& wavefront() { engine |= sw_align::WAVEFRONT_ENGINE; return *this; }
+  Options& nowavefront() { engine &= ~sw_align::WAVEFRONT_ENGINE; return *this; }
+  Options& bitsearch() { engine |= sw_align::BITVECTOR_SEARCH; return *this; }
+  Options& nobitsearch() { engine &= ~sw_align::BITVECTOR_SEARCH; return *this; }
   Options& mincluster(long m) { min_output_score = m; return *this; }
   Options& diagdiff(long d) { fixed_separation = d; return *this; }
   Options& diagfactor(double f) { separation_factor = f; return *this; }
@@ -80,6 +87,7 @@ struct Options {
   Options& reverse() { orientation = REVERSE; return *this; }
   Options& simplify() { do_shadows = false; return *this; }
   Options& nosimplify() { do_shadows = true; return *this; }
+  Options& extendthreads(int n) { extend_threads = n; return *this; }
 
   // Options for mummer
   match_type match;
@@ -100,6 +108,8 @@ struct Options {
   bool do_shadows;
   int  break_len;
   int  banding;
+  int  engine;
+  int  extend_threads; // threads to extend a synteny, in align_long_sequences only
 };
 
 // FastaRecord information, pointing to an existing string. Meant to
@@ -153,7 +163,7 @@ public:
                 opts.min_output_score, opts.separation_factor,
                 opts.use_extent)
     , merger(opts.do_delta, opts.do_extend, opts.to_seqend, opts.do_shadows,
-             opts.break_len, opts.banding, sw_align::NUCLEOTIDE)
+             opts.break_len, opts.banding, sw_align::NUCLEOTIDE, opts.engine)
     , Ref(reference)
     , options(opts)
   { }
@@ -195,12 +205,12 @@ struct sequence_info {
   std::string         sequence;
   std::string         headers;
 
-  static std::unique_ptr<std::ifstream> open_path(const char* path);
+  static std::unique_ptr<std::istream> open_path(const char* path);
 
   // Load from a file
   sequence_info(std::istream& is, size_t chunk_size);
   explicit sequence_info(std::istream& is) : sequence_info(is, std::numeric_limits<size_t>::max()) { }
-  sequence_info(std::unique_ptr<std::ifstream>&& is, size_t chunk_size) : sequence_info(*is, chunk_size) { }
+  sequence_info(std::unique_ptr<std::istream>&& is, size_t chunk_size) : sequence_info(*is, chunk_size) { }
   explicit sequence_info(const char* path) : sequence_info(open_path(path), std::numeric_limits<size_t>::max()) { }
   sequence_info(sequence_info&& rhs) = default;
   sequence_info(const sequence_info& rhs) = delete;
@@ -233,6 +243,8 @@ public:
     assert(m_id < m_info.records.size());
     return m_info.headers.c_str() + m_info.records[m_id].header;
   }
+  // Index of the record in the sequence_info
+  size_t id() const { return m_id; }
   bool operator==(const FastaRecordPtr& rhs) const { return m_id == rhs.m_id; }
   bool operator<(const FastaRecordPtr& rhs) const { return m_id < rhs.m_id; }
 };
@@ -280,6 +292,7 @@ public:
   { }
 
   const mummer::sparseSA& sa() const { return m_sa; }
+  const sequence_info& reference_info() const { return m_reference_info; }
 
   // TODO: remove code duplication with thread_align_file
   // Align the sequence query against the references
@@ -382,7 +395,7 @@ public:
 
 template<typename AlignmentOut>
 void FileAligner::align_file(const char* query_path, AlignmentOut alignments, unsigned int nb_threads) const {
-  typedef jellyfish::stream_manager<const char**>          stream_manager;
+  typedef jellyfish::stream_manager<const char**, compressed::ifstream> stream_manager;
   typedef jellyfish::whole_sequence_parser<stream_manager> sequence_parser;
   stream_manager  streams(&query_path, &query_path + 1);
   sequence_parser parser(4 * nb_threads, 10, 1, streams);
@@ -393,6 +406,8 @@ void FileAligner::align_file(const char* query_path, AlignmentOut alignments, un
   }
   for(auto& th : threads)
     th.join();
+  if(parser.error())
+    std::rethrow_exception(parser.error());
 }
 
 template<typename Parser, typename AlignmentOut>
@@ -401,13 +416,17 @@ void FileAligner::thread_align_file(Parser& parser, AlignmentOut alignments) con
   std::vector<mgaps::Match_t>       fwd_matches(1), bwd_matches(1);
   std::vector<synteny_type>         syntenys;
   std::forward_list<FastaRecordPtr> records;
+  // Index in syntenys of the synteny for a given reference record
+  // id. Entries are reset after every query, only those touched.
+  static const size_t               no_synteny = std::numeric_limits<size_t>::max();
+  std::vector<size_t>               synteny_index(m_reference_info.records.size(), no_synteny);
   FastaRecordSeq                    Query("");
   mgaps::UnionFind                  UF;
   char                              cluster_dir;
   const postnuc::merge_syntenys     merger(m_options.do_delta, m_options.do_extend,
                                            m_options.to_seqend, m_options.do_shadows,
                                            m_options.break_len, m_options.banding,
-                                           sw_align::NUCLEOTIDE);
+                                           sw_align::NUCLEOTIDE, m_options.engine);
 
   auto append_cluster = [&](const mgaps::cluster_type& cluster) {
     for(size_t i = 0; i < cluster.size(); ) { // i increment in inner loop
@@ -417,17 +436,13 @@ void FileAligner::thread_align_file(Parser& parser, AlignmentOut alignments) con
       const long offset  = record.seq_offset();
       const long end     = offset + record.len();
 
-      auto       synteny = syntenys.rbegin();
-      auto       it      = records.cbegin();
-      for( ; it != records.cend(); ++it, ++synteny)
-        if(*it == record)
-          break;
-      if(it == records.cend()) {
-        assert(synteny == syntenys.rend());
+      size_t& index = synteny_index[record.id()];
+      if(index == no_synteny) {
+        index = syntenys.size();
         records.push_front(record);
         syntenys.push_back(synteny_type(&records.front()));
-        synteny = syntenys.rbegin();
       }
+      auto synteny = syntenys.begin() + index;
 
       for( ; i < cluster.size(); ++i) { // Add matches to current cluster until find a different reference
         const auto& m   = cluster[i];
@@ -456,6 +471,8 @@ void FileAligner::thread_align_file(Parser& parser, AlignmentOut alignments) con
       fwd_matches.resize(1);
       bwd_matches.resize(1);
       syntenys.clear();
+      for(const auto& record : records)
+        synteny_index[record.id()] = no_synteny;
       records.clear();
       assert(fwd_matches.size() == 1);
       assert(bwd_matches.size() == 1);
@@ -504,7 +521,8 @@ void FileAligner::align_long_sequences(const FastaRecordSeq& query, AlignmentOut
   const postnuc::merge_syntenys     merger(m_options.do_delta, m_options.do_extend,
                                            m_options.to_seqend, m_options.do_shadows,
                                            m_options.break_len, m_options.banding,
-                                           sw_align::NUCLEOTIDE);
+                                           sw_align::NUCLEOTIDE, m_options.engine,
+                                           m_options.extend_threads);
   std::mutex                        clusters_mtx;
 
   // append_cluster maybe called by multiple threads at once
@@ -6,12 +6,14 @@
 #include <iostream>
 #include <limits>
 #include <cstring>
+#include <cstdint>
 #include <memory>
 #include <iomanip>
 #include <atomic>
 
 #include "tigrinc.hh"
 #include "sw_align.hh"
+#include "bam.hh"
 
 
 namespace mummer {
@@ -181,12 +183,23 @@ struct AscendingClusterSort
   }
 };
 
+// Forward extension computed ahead of the sequential pass of
+// extendClusters: the arguments of alignTarget and its results.
+struct ForwardExtension {
+  long int              Astart, Atarget, Bstart, Btarget;
+  unsigned int          m_o; // 0 if not computed
+  bool                  reached;
+  long int              Aend, Bend;
+  std::vector<long int> delta;
+};
+
 struct merge_syntenys {
   const bool                     DO_DELTA;
   const bool                     DO_EXTEND;
   const bool                     TO_SEQEND;
   const bool                     DO_SHADOWS;
   const sw_align::aligner_buffer aligner;
+  const int                      NB_THREADS; // threads to extend the clusters of a synteny
 
   merge_syntenys(bool dd, bool de, bool ts, bool ds)
     : DO_DELTA(dd)
@@ -194,14 +207,17 @@ struct merge_syntenys {
     , TO_SEQEND(ts)
     , DO_SHADOWS(ds)
     , aligner()
+    , NB_THREADS(1)
   { }
 
-  merge_syntenys(bool dd, bool de, bool ts, bool ds, int break_len, int banding, int matrix_type)
+  merge_syntenys(bool dd, bool de, bool ts, bool ds, int break_len, int banding, int matrix_type,
+                 int engine = sw_align::DP_ENGINE, int nb_threads = 1)
     : DO_DELTA(dd)
     , DO_EXTEND(de)
     , TO_SEQEND(ts)
     , DO_SHADOWS(ds)
-    , aligner(break_len, banding, matrix_type)
+    , aligner(break_len, banding, matrix_type, engine)
+    , NB_THREADS(nb_threads)
   { }
 
   // Process all syntenys in a container
@@ -243,7 +259,12 @@ struct merge_syntenys {
 
 protected:
   bool extendForward(std::vector<Alignment>::iterator Ap, const char * A, long int targetA,
-                     const char * B, long int targetB, unsigned int m_o) const;
+                     const char * B, long int targetB, unsigned int m_o,
+                     const ForwardExtension* Ext = nullptr) const;
+
+  void precomputeExtensions(std::vector<Cluster> & Clusters,
+                            const char* A, const long Alen, const char* Bfwd, const char* Brev, const long Blen,
+                            std::vector<ForwardExtension>& Extensions, std::vector<size_t>& ExtensionIdx) const;
 
   std::vector<Cluster>::iterator getForwardTargetCluster(std::vector<Cluster> & Clusters, std::vector<Cluster>::iterator CurrCp,
                                                          long int & targetA, long int & targetB) const;
@@ -266,6 +287,20 @@ void printDeltaAlignments(const std::vector<Alignment>& Alignments,
                           const std::string& BId, const long Blen,
                           std::ostream& DeltaFile, const long minLen = 0);
 
+// Print alignments as one record of a binary delta file
+void printBinaryDeltaAlignments(const std::vector<Alignment>& Alignments,
+                                const std::string& AId, const long Alen,
+                                const std::string& BId, const long Blen,
+                                std::ostream& DeltaFile, const long minLen = 0);
+
+// Print alignments in PAF format, one line per alignment, with the
+// number of errors in the NM tag and, if cigar is true, the CIGAR in
+// the cg tag.
+void printPAFAlignments(const std::vector<Alignment>& Alignments,
+                        const std::string& AId, const long Alen,
+                        const std::string& BId, const long Blen,
+                        std::ostream& PAFFile, bool cigar = false, const long minLen = 0);
+
 template<typename FastaRecord>
 inline void printDeltaAlignments(const std::vector<Alignment>& Alignments,
                           const FastaRecord& Af, const FastaRecord& Bf,
@@ -278,7 +313,27 @@ template<typename FR1, typename FR2>
 void printSAMAlignments(const std::vector<Alignment>& Alignments,
                         const FR1& A, const FR2& B,
                         std::ostream& SAMFile, bool long_format, const long minLen = 0);
+// Same, and call record_done(Al) after the record of each alignment Al
+// is written (e.g. to sort the records)
+template<typename FR1, typename FR2, typename RecordDone>
+void printSAMAlignments(const std::vector<Alignment>& Alignments,
+                        const FR1& A, const FR2& B,
+                        std::ostream& SAMFile, bool long_format, const long minLen,
+                        RecordDone record_done);
+// Append the alignments to BAMRecords as BAM records, with the same
+// content as the SAM records. ref_id is the index of A in the
+// references of the BAM header. Calls record_done(Al) after the record
+// of each alignment Al.
+template<typename FR1, typename FR2, typename RecordDone>
+void printBAMAlignments(const std::vector<Alignment>& Alignments,
+                        const FR1& A, size_t ref_id, const FR2& B,
+                        std::string& BAMRecords, bool long_format, const long minLen,
+                        RecordDone record_done);
 std::string createCIGAR(const std::vector<long int>& ds, long int start, long int end, long int len, bool hard_clip = false);
+// CIGAR operations of createCIGAR, in the BAM encoding (length << 4 | op)
+enum cigar_op { CIGAR_MATCH = 0, CIGAR_INS = 1, CIGAR_DEL = 2, CIGAR_SOFT_CLIP = 4, CIGAR_HARD_CLIP = 5 };
+std::vector<uint32_t> createCIGAROps(const std::vector<long int>& ds, long int start, long int end, long int len,
+                                     bool hard_clip = false);
 std::string createMD(const Alignment& al, const char* ref,
                      const char* qry, size_t qry_len);
 
@@ -417,6 +472,14 @@ void printSAMAlignments(const std::vector<Alignment>& Alignments,
                         const FR1& A, const FR2& B,
                         std::ostream& SAMFile, bool long_format,
                         const long minLen) {
+  printSAMAlignments(Alignments, A, B, SAMFile, long_format, minLen, [](const Alignment&) { });
+}
+
+template<typename FR1, typename FR2, typename RecordDone>
+void printSAMAlignments(const std::vector<Alignment>& Alignments,
+                        const FR1& A, const FR2& B,
+                        std::ostream& SAMFile, bool long_format,
+                        const long minLen, RecordDone record_done) {
   const char* mapq = Alignments.size() > 1 ? "\t10\t" : "\t30\t";
   bool hard_clip = false;
   for(const auto& Al : Alignments) {
@@ -440,10 +503,33 @@ void printSAMAlignments(const std::vector<Alignment>& Alignments,
     if(long_format)
       SAMFile << "\tMD:Z:" << createMD(Al, A.seq(), B.seq(), B.len());
     SAMFile << '\n';
+    record_done(Al);
     hard_clip = true;
   }
 }
 
+template<typename FR1, typename FR2, typename RecordDone>
+void printBAMAlignments(const std::vector<Alignment>& Alignments,
+                        const FR1& A, size_t ref_id, const FR2& B,
+                        std::string& BAMRecords, bool long_format, const long minLen,
+                        RecordDone record_done) {
+  const uint8_t mapq = Alignments.size() > 1 ? 10 : 30;
+  bool hard_clip = false;
+  for(const auto& Al : Alignments) {
+    if(std::abs(Al.eA - Al.sA) < minLen && std::abs(Al.eB - Al.sB) < minLen)
+      continue;
+    const bool     fwd   = Al.dirB == FORWARD_CHAR;
+    const uint16_t flag  = (hard_clip ? 0x800 : 0) | (fwd ? 0 : 0x10);
+    const auto     start = hard_clip ? Al.sB : 1;
+    const auto     len   = long_format ? (hard_clip ? Al.eB - start + 1 : B.len()) : 0;
+    bam::append_record(BAMRecords, B.Id().c_str(), flag, ref_id, Al.sA - 1, mapq,
+                       createCIGAROps(Al.delta, Al.sB, Al.eB, B.len(), hard_clip),
+                       B.seq() + start, len, Al.Errors,
+                       long_format ? createMD(Al, A.seq(), B.seq(), B.len()) : std::string());
+    record_done(Al);
+    hard_clip = true;
+  }
+}
 
 } // namespace postnuc
 } // namespace mummer
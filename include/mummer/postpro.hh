@@ -0,0 +1,292 @@
+#ifndef __MUMMER_POSTPRO_H__
+#define __MUMMER_POSTPRO_H__
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <functional>
+#include <cassert>
+
+#include "sw_align.hh"
+
+
+namespace mummer {
+namespace postpro {
+
+//------------------------------------------------------ Type Definitions ----//
+enum LineType
+//-- The type of input line from <stdin>
+  {
+    NO_LINE, HEADER_LINE, MATCH_LINE
+  };
+
+
+class FastaRecord
+//-- The essential data of a sequence. The sequence is 1 based: the
+//   first base is in seq()[1] and seq()[0] is '\0'.
+{
+  std::string m_Id;             // the fasta ID header tag
+  std::string m_seq;            // the sequence data, prefixed with '\0'
+public:
+  FastaRecord() : m_seq(1, '\0') { }
+  FastaRecord(const std::string& Id, const std::string& seq)
+    : m_Id(Id), m_seq(1, '\0')
+  { m_seq += seq; }
+
+  const std::string& Id() const { return m_Id; }
+  long len() const { return m_seq.size() - 1; }
+  const char* seq() const { return m_seq.c_str(); }
+
+  // Read the next record from a fasta file (as Read_String). Return
+  // false at the end of the file.
+  bool read(std::istream& is);
+};
+
+
+struct Match
+//-- An exact match between two sequences A and B
+{
+  long int sA, sB, len;      // start coordinate in A, in B and the length
+};
+
+
+struct Cluster
+//-- An ordered list of matches between two sequences A and B
+{
+  bool               wasFused;  // have the cluster matches been extended yet?
+  int                frameA;    // the reference sequence frame (1-6)
+  int                frameB;    // the query sequence frame
+  std::vector<Match> matches;   // the ordered set of matches in the cluster
+  Cluster() = default;
+  Cluster(int fA, int fB) : wasFused(false), frameA(fA), frameB(fB) { }
+};
+
+
+struct Synteny
+//-- An ordered list of clusters between two sequences A and B
+{
+  const FastaRecord*   AfP;      // a pointer to the reference sequence record
+  std::string          IdB;      // the query sequence ID
+  long int             lenB;     // the query sequence length, -1 until processed
+  std::vector<Cluster> clusters; // the ordered set of clusters between A and B
+  Synteny() = default;
+  Synteny(const FastaRecord* Af, const std::string& Id) : AfP(Af), IdB(Id), lenB(-1) { }
+};
+
+
+struct Alignment
+//-- An alignment object between two sequences A and B
+{
+  int              frameA;      // the reference sequence frame (1-6)
+  int              frameB;      // the query sequence frame
+  long int         sA, sB, eA, eB; // the start in A, B and the end in A, B
+  std::vector<long int> delta;  // the delta values, with NO zero at the end
+  long int         deltaApos;   // sum of abs(deltas) - #of negative deltas
+                                //      trust me, it is a very helpful value
+  long int         Errors, SimErrors, NonAlphas; // errors, similarity errors, nonalphas
+
+  Alignment(const Match& m, const Cluster& c)
+    : frameA(c.frameA)
+    , frameB(c.frameB)
+    , sA(m.sA)
+    , sB(m.sB)
+    , eA(m.sA + m.len - 1)
+    , eB(m.sB + m.len - 1)
+    , deltaApos(0)
+    , Errors(0)
+    , SimErrors(0)
+    , NonAlphas(0)
+  { }
+  Alignment() = default;
+};
+
+
+struct AscendingClusterSort
+//-- For sorting clusters in ascending order of their sA coordinate
+{
+  bool operator() (const Cluster & pA, const Cluster & pB)
+  {
+    return ( pA.matches.front().sA < pB.matches.front().sA );
+  }
+};
+
+
+struct merge_syntenys {
+  const bool              DO_DELTA;
+  const bool              DO_EXTEND;
+  const bool              TO_SEQEND;
+  const sw_align::aligner aligner;
+
+  merge_syntenys(bool dd, bool de, bool ts, int break_len = 60, int matrix_type = sw_align::BLOSUM62)
+    : DO_DELTA(dd)
+    , DO_EXTEND(de)
+    , TO_SEQEND(ts)
+    , aligner(break_len, 0, matrix_type)
+  { }
+
+  // Process all syntenys between the references and the query Bf
+  template<typename MatchesOut>
+  void processSyntenys_each(std::vector<Synteny>& Syntenys, const FastaRecord& Bf,
+                            MatchesOut matches) const;
+
+  // Extend the clusters between Af and Bf into alignments, with
+  // their error counts. The coordinates still reference the amino
+  // acid frames.
+  void extendClusters(std::vector<Cluster>& Clusters, const FastaRecord& Af, const FastaRecord& Bf,
+                      std::vector<Alignment>& Alignments) const;
+
+  std::vector<Alignment> extendClusters(std::vector<Cluster>& Clusters,
+                                        const FastaRecord& Af, const FastaRecord& Bf) const {
+    std::vector<Alignment> res;
+    extendClusters(Clusters, Af, Bf, res);
+    return res;
+  }
+
+protected:
+  bool extendBackward(std::vector<Alignment> & Alignments, std::vector<Alignment>::iterator CurrAp,
+                      std::vector<Alignment>::iterator TargetAp, const char * A, const char * B) const;
+  bool extendForward(std::vector<Alignment>::iterator CurrAp, const char * A, long int targetA,
+                     const char * B, long int targetB, unsigned int m_o) const;
+  std::vector<Cluster>::iterator getForwardTargetCluster(std::vector<Cluster> & Clusters,
+                                                         std::vector<Cluster>::iterator CurrCp,
+                                                         long int & targetA, long int & targetB) const;
+  std::vector<Alignment>::iterator getReverseTargetAlignment(std::vector<Alignment> & Alignments,
+                                                             std::vector<Alignment>::iterator CurrAp) const;
+  void parseDelta(std::vector<Alignment> & Alignments, const FastaRecord& Af, const FastaRecord& Bf) const;
+};
+
+
+class synteny_builder
+//-- Group the clusters of matches between the concatenated six frame
+//   translations of the references (as output by prepro -r) and the
+//   six frame translations of the queries (prepro -q) into syntenys,
+//   re-mapping the reference coordinates to their sequence and
+//   frame. The syntenys of a query are passed to the process function
+//   once all its clusters have been seen.
+{
+public:
+  typedef std::function<void(std::vector<Synteny>&)> process_type;
+
+  synteny_builder(const std::vector<FastaRecord>& Af, process_type process)
+    : m_Af(Af)
+    , m_process(process)
+    , m_PrevLine(NO_LINE)
+    , m_FrameA(0)
+    , m_FrameB(0)
+    , m_CurrFrameB(-1)
+    , m_CurrSp(0)
+  { }
+
+  // Start the matches of frame frameB (1-6) of the query IdB
+  void header(const std::string& IdB, int frameB) {
+    m_CurrIdB    = IdB;
+    m_CurrFrameB = frameB;
+    m_PrevLine   = HEADER_LINE;
+  }
+  // Start a new cluster
+  void cluster() { m_PrevLine = HEADER_LINE; }
+  // Add a match. sA is 1 based in the concatenated reference
+  // translations, sB 1 based in the query frame.
+  void match(long int sA, long int sB, long int len);
+  // Process the left-over syntenys
+  void finish();
+
+private:
+  void addCluster();
+
+  const std::vector<FastaRecord>& m_Af;
+  process_type                    m_process;
+  std::vector<Synteny>            m_Syntenys;
+  LineType                        m_PrevLine;
+  std::string                     m_IdA, m_IdB, m_CurrIdB;
+  int                             m_FrameA, m_FrameB, m_CurrFrameB;
+  size_t                          m_CurrSp; // index of the current synteny
+};
+
+
+//------------------------------------------------- Function Declarations ----//
+// Translate frame Frame (1-6) of the DNA sequence Af, and mask it as
+// prepro does: stop codons become 'J' and the regions of at most
+// mask_len amino acids bounded by stop codons or the frame ends are
+// set to mask_char, as well as the 'X' produced by the translation. A
+// mask_char is appended. The result, in lower case as used by
+// mummer, is appended to res.
+void appendMaskedFrame(const FastaRecord& Af, int Frame, char mask_char, long int mask_len,
+                       std::string& res);
+// Same as appendMaskedFrame for the six frames at once, frame f
+// being appended to res[f-1].
+void appendMaskedFrames(const FastaRecord& Af, char mask_char, long int mask_len,
+                        std::string res[6]);
+
+void printDeltaAlignments(const std::vector<Alignment>& Alignments,
+                          const FastaRecord& Af, const FastaRecord& Bf,
+                          std::ostream& DeltaFile);
+
+void printSyntenys(const std::vector<Synteny>& Syntenys, std::ostream& ClusterFile);
+
+bool isShadowedCluster
+(std::vector<Cluster>::const_iterator CurrCp,
+ const std::vector<Alignment> & Alignments, std::vector<Alignment>::const_iterator Ap);
+
+inline long int revC
+(long int Coord, long int Len)
+  //  Reverse complement the given coordinate for the given length.
+{
+  assert (Len - Coord + 1 > 0);
+  return (Len - Coord + 1);
+}
+
+inline long int transC
+(long int Coord, int Frame, long int Len)
+  //  Translate an amino acid coordinate to a nucleotide coordinate
+  //  relative to the forward strand. The Len parameter should be the
+  //  length of the original DNA strand.
+{
+  assert ( Frame > 0 && Frame < 7 );
+  if ( Frame > 3 )
+    return revC ( (Coord * 3) - (3 - (Frame - 3)), Len );
+  else
+    return (Coord * 3) - (3 - (Frame));
+}
+
+inline long int refLen
+(long int ntLen)
+  //  Return the length of the concatenated amino acid sequence frames,
+  //  including the appended 'X' at the end of each sequence frame for the
+  //  given DNA input length. (The returned length will be the length of
+  //  the concatenated frames for this sequence as output by prepro.cc)
+{
+  return (ntLen + 1) << 1;
+}
+
+
+//
+// Implementation of templated methods
+//
+template<typename MatchesOut>
+void merge_syntenys::processSyntenys_each(std::vector<Synteny>& Syntenys, const FastaRecord& Bf,
+                                          MatchesOut matches) const
+
+//  For each syntenic region with clusters, extend the clusters to
+//  expand total alignment coverage. Clusters should still reference
+//  the amino acid frames, the translation back to DNA is done when
+//  printing. The syntenys are kept for printSyntenys.
+
+{
+  for(auto& CurrSp : Syntenys) {
+    //-- If no clusters, ignore
+    if(CurrSp.clusters.empty()) continue;
+
+    //-- Extend clusters and create the alignment information
+    CurrSp.lenB = Bf.len();
+    std::vector<Alignment> alignments;
+    extendClusters(CurrSp.clusters, *CurrSp.AfP, Bf, alignments);
+    if(DO_DELTA)
+      matches(std::move(alignments), *CurrSp.AfP, Bf);
+  }
+}
+
+} // namespace postpro
+} // namespace mummer
+
+#endif /* __MUMMER_POSTPRO_H__ */
@@ -0,0 +1,198 @@
+#ifndef __PROMER_H__
+#define __PROMER_H__
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <limits>
+#include <memory>
+
+#include <mummer/sparseSA.hpp>
+#include <mummer/mgaps.hh>
+#include <mummer/postpro.hh>
+
+namespace mummer {
+namespace promer {
+enum match_type { MUM, MUMREFERENCE, MAXMATCH };
+struct Options {
+  Options()
+    : match(MUMREFERENCE)
+    , min_len(6)
+    , mask_len(8)
+    , fixed_separation(5)
+    , max_separation(30)
+    , min_output_score(20)
+    , separation_factor(0.11)
+    , use_extent(false)
+    , do_delta(true)
+    , do_extend(true)
+    , to_seqend(false)
+    , break_len(60)
+    , matrix_type(sw_align::BLOSUM62)
+  { }
+
+  // Setters corresponding to promer.pl switches
+  Options& mum() { match = MUM; return *this; }
+  Options& mumcand() { return mumreference(); }
+  Options& mumreference() { match = MUMREFERENCE; return *this; }
+  Options& maxmatch() { match = MAXMATCH; return *this; }
+  Options& breaklen(long l) { break_len = l; return *this; }
+  Options& mincluster(long m) { min_output_score = m; return *this; }
+  Options& delta() { do_delta = true; return *this; }
+  Options& nodelta() { do_delta = false; return *this; }
+  Options& diagfactor(double f) { separation_factor = f; return *this; }
+  Options& extend() { do_extend = true; return *this; }
+  Options& noextend() { do_extend = false; return *this; }
+  Options& maxgap(long m) { max_separation = m; return *this; }
+  Options& minmatch(long m) { min_len = m; return *this; }
+  Options& masklen(long m) { mask_len = m; return *this; }
+  Options& optimize() { to_seqend = false; return *this; }
+  Options& nooptimize() { to_seqend = true; return *this; }
+  Options& matrix(int m) { matrix_type = m; return *this; }
+
+  // Options for prepro and mummer
+  match_type match;
+  int        min_len;
+  long       mask_len;
+
+  // Options for mgaps
+  long   fixed_separation;
+  long   max_separation;
+  long   min_output_score;
+  double separation_factor;
+  bool   use_extent;
+
+  // Options for postpro
+  bool do_delta;
+  bool do_extend;
+  bool to_seqend;
+  int  break_len;
+  int  matrix_type;
+};
+
+// Masking characters of the reference and query translations, as
+// used by prepro.
+static const char REFERENCE_MASK = 'X';
+static const char QUERY_MASK     = 'O';
+
+// Read all the records of a fasta stream
+std::vector<postpro::FastaRecord> read_records(std::istream& is);
+std::vector<postpro::FastaRecord> read_records(const char* path);
+
+// Concatenation of the masked six frame translations of the
+// references, as output by 'prepro -r' and read by mummer.
+std::string translate_references(const std::vector<postpro::FastaRecord>& references, long mask_len);
+
+// The syntenys between one query and the references, and for each
+// the alignments (empty if the synteny has no clusters or the delta is
+// not computed).
+struct QueryAlignments {
+  std::vector<postpro::Synteny>                 syntenys;
+  std::vector<std::vector<postpro::Alignment> > alignments;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Align DNA sequences through their six frame translations, as the //
+// prepro | mummer | mgaps | postpro pipeline does.                 //
+//////////////////////////////////////////////////////////////////////
+class ProteinAligner {
+  const std::vector<postpro::FastaRecord> m_references;
+  const std::string                       m_translation; // masked translations of the references
+  const mummer::sparseSA                  m_sa;
+  const mgaps::ClusterMatches             m_clusterer;
+  const postpro::merge_syntenys           m_merger;
+  const Options                           m_options;
+
+public:
+  ProteinAligner(std::vector<postpro::FastaRecord>&& references, Options opts = Options())
+    : m_references(std::move(references))
+    , m_translation(translate_references(m_references, opts.mask_len))
+    , m_sa(mummer::sparseSA::create_auto(m_translation.c_str(), m_translation.length(),
+                                         opts.min_len, false))
+    , m_clusterer(opts.fixed_separation, opts.max_separation,
+                  opts.min_output_score, opts.separation_factor,
+                  opts.use_extent)
+    , m_merger(opts.do_delta, opts.do_extend, opts.to_seqend,
+               opts.break_len, opts.matrix_type)
+    , m_options(opts)
+  { }
+  ProteinAligner(std::istream& is, Options opts = Options())
+    : ProteinAligner(read_records(is), opts)
+  { }
+  ProteinAligner(const char* reference_path, Options opts = Options())
+    : ProteinAligner(read_records(reference_path), opts)
+  { }
+
+  const std::vector<postpro::FastaRecord>& references() const { return m_references; }
+  const mummer::sparseSA& sa() const { return m_sa; }
+
+  // Find the clusters of matches between frame frameB (1-6) of the
+  // query and the reference translations, as 'mgaps' would output
+  // them.
+  void frameClusters(const postpro::FastaRecord& query, int frameB,
+                     mgaps::UnionFind& UF, mgaps::clusters_type& clusters) const;
+  // Same, given the masked translation P of the frame, as output by
+  // postpro::appendMaskedFrame.
+  void frameClusters(const std::string& P, mgaps::UnionFind& UF,
+                     mgaps::clusters_type& clusters) const;
+
+  // Align the query against the references
+  void align(const postpro::FastaRecord& query, QueryAlignments& res) const;
+
+  // Align a batch of queries, in parallel
+  void align_batch(const std::vector<postpro::FastaRecord>& queries,
+                   std::vector<QueryAlignments>& res) const;
+
+  // Align the sequences in the fasta stream against the references,
+  // by batch of at least batch_size bases aligned in parallel. The
+  // results are output in the order of the queries, like postpro:
+  // alignments(als, Af, Bf) for every synteny with clusters (if the
+  // delta is computed), then syntenys(Syntenys, Bf).
+  template<typename AlignmentOut, typename SyntenysOut>
+  void align_file(std::istream& is, AlignmentOut alignments, SyntenysOut syntenys,
+                  size_t batch_size = 10000000) const;
+  template<typename AlignmentOut>
+  void align_file(std::istream& is, AlignmentOut alignments) const {
+    align_file(is, alignments, [](const std::vector<postpro::Synteny>& s, const postpro::FastaRecord& Bf) { });
+  }
+};
+
+//
+// Implementation of templated methods
+//
+template<typename AlignmentOut, typename SyntenysOut>
+void ProteinAligner::align_file(std::istream& is, AlignmentOut alignments, SyntenysOut syntenys,
+                                size_t batch_size) const {
+  std::vector<postpro::FastaRecord> queries;
+  std::vector<QueryAlignments>      res;
+  bool                              more = true;
+
+  while(more) {
+    size_t bases = 0;
+    queries.clear();
+    while(bases < batch_size) {
+      queries.push_back(postpro::FastaRecord());
+      if(!queries.back().read(is)) {
+        queries.pop_back();
+        more = false;
+        break;
+      }
+      bases += queries.back().len();
+    }
+
+    align_batch(queries, res);
+    for(size_t i = 0; i < queries.size(); ++i) {
+      auto& Syntenys = res[i].syntenys;
+      for(size_t j = 0; j < Syntenys.size(); ++j) {
+        if(Syntenys[j].clusters.empty() || !m_options.do_delta) continue;
+        alignments(std::move(res[i].alignments[j]), *Syntenys[j].AfP, queries[i]);
+      }
+      syntenys(Syntenys, queries[i]);
+    }
+  }
+}
+
+} // namespace promer
+} // namespace mummer
+
+#endif /* __PROMER_H__ */
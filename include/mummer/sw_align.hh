@@ -17,6 +17,7 @@
 //#define _DEBUG_ASSERT      // performs assert functions to check validity
 //#define _DEBUG_VERBOSE     // outputs various alignment statistics and values
 
+#include <cstdint>
 #include <stdexcept>
 #include <vector>
 
@@ -63,80 +64,83 @@ static const unsigned int FORCED_BACKWARD_SEARCH = 0x6;
 //   If "FORCED" ignore score and force alignment to reach its target
 
 //-- Maximum number of bases (in either sequence) that the alignSearch may go
-static const long int MAX_SEARCH_LENGTH = 10000;
+static const long int MAX_SEARCH_LENGTH = 100000;
 
 //-- Maximum number of bases (in either sequence) that the alignTarget may go
-static const long int MAX_ALIGNMENT_LENGTH = 10000;
+static const long int MAX_ALIGNMENT_LENGTH = 100000;
+
+//-- Alignment engines, may be combined
+static const int DP_ENGINE        = 0; // anti-diagonal dynamic programming
+static const int WAVEFRONT_ENGINE = 1; // gap-affine wavefront, NUCLEOTIDE matrix only
+static const int BITVECTOR_SEARCH = 2; // bit-parallel edit distance for alignSearch, NUCLEOTIDE matrix only
 
 //------------------------------------------------------ Type Definitions ----//
-// An auto expanding vector
-template<typename T>
-class auto_vector {
-  std::vector<T> m_vec;
-public:
-  typedef typename std::vector<T>               vector_type;
-  typedef typename vector_type::value_type      value_type;
-  typedef typename vector_type::reference       reference;
-  typedef typename vector_type::const_reference const_reference;
-  typedef typename vector_type::size_type       size_type;
-  typedef typename vector_type::iterator        iterator;
-  typedef typename vector_type::const_iterator  const_iterator;
-
-  auto_vector() = default;
-
-  reference operator[](size_type n) {
-    if(__builtin_expect(n >= m_vec.size(), 0))
-      m_vec.resize(n + 1);
-    return m_vec[n];
-  }
-  const_reference operator[](size_type n) const {
-    return m_vec[n];
-  }
-  void clear() noexcept {
-    m_vec.clear();
-  }
-  void resize(size_type n) {
-    m_vec.resize(n);
-  }
-  void resize(size_type n, const value_type& val) {
-    m_vec.resize(n, val);
-  }
+// Scores of the nodes of one anti-diagonal of the edit matrix, one
+// array per edit (DELETE, INSERT, MATCH) so that a whole diagonal can
+// be scored with vector instructions. Scores are bounded by the
+// alignment length times the largest penalty and fit in 32 bits.
+struct DiagonalScores
+{
+  std::vector<int32_t> S[3];
 
-  iterator begin() { return m_vec.begin(); }
-  const_iterator begin() const { return m_vec.begin(); }
-  const_iterator cbegin() const { return m_vec.cbegin(); }
-  iterator end() { return m_vec.end(); }
-  const_iterator end() const { return m_vec.end(); }
-  const_iterator cend() const { return m_vec.cend(); }
+  void resize(size_t n) {
+    for(int e = 0; e < 3; ++e)
+      S[e].resize(n);
+  }
 };
 
-struct Score
+// One anti-diagonal of the edit matrix. Only the traceback is kept for
+// every diagonal: one byte per node packing four 2-bit edit codes, the
+// edit of the parent reached by the DELETE, INSERT and MATCH scores
+// (bits 0-1, 2-3 and 4-5) and the edit with the maximum score (bits
+// 6-7).
+struct Diagonal
 {
-  long int value;
-  char used;
+  long int                   lbound, rbound; // left(lower) and right(upper) bounds
+  std::vector<unsigned char> edits;
+
+  int used(int e, size_t i) const { return (edits[i] >> (2 * e)) & 0x3; }
+  int edit(size_t i) const { return edits[i] >> 6; }
 };
 
-struct Node
+// Wavefront of the WAVEFRONT_ENGINE for one penalty: the furthest
+// reaching offset in B on each diagonal (B index - A index) of [lo,
+// hi], for alignments ending with a match or mismatch (M), a base of
+// A against a gap (I) or a base of B against a gap (D), like the
+// INSERT and DELETE edits of the DP_ENGINE. Element k is stored at
+// index k - base.
+struct Wavefront
 {
-  Score S[3];
-  int   m_max;
-
-  Score& max() { return S[m_max]; }
-  const Score& max() const { return S[m_max]; }
-  void max(int i) { m_max = i; }
-  int edit() const { return m_max; }
+  long int             lo, hi, base;
+  std::vector<int32_t> M, I, D;
 };
 
-struct Diagonal
+// Blocks of the BITVECTOR_SEARCH: a column of the edit distance
+// matrix, 64 rows per word, as the bit vectors of the positive (P) and
+// negative (M) vertical differences, with the edit distance of the
+// bottom row of each block. Peq holds the rows of A matching A, C, G
+// and T.
+struct BitBlocks
 {
-  long int          lbound, rbound; // left(lower) and right(upper) bounds
-  auto_vector<Node> I;          // the matrix nodes
+  std::vector<uint64_t> Peq[4];
+  std::vector<uint64_t> P, M;
+  std::vector<long int> bottom;
+  std::vector<long int> best; // High score in the block, see _searchBitVector
 };
 
-// Auto expanding non-square matrix which minimizes allocation / free
+// Auto expanding non-square matrix which minimizes allocation /
+// free. The scores are only needed to compute the next two diagonals,
+// they are kept for the last three diagonals only. Also holds the
+// wavefronts of the WAVEFRONT_ENGINE.
 class DiagonalMatrix {
-  std::vector<Diagonal> m_diag;
-  size_t                m_size; // Actual length.
+  std::vector<Diagonal>  m_diag;
+  size_t                 m_size; // Actual length.
+  DiagonalScores         m_scores[3];
+  std::vector<int32_t>   m_match; // Match scores of the current diagonal
+  std::vector<unsigned char> m_edits; // Edits of the current diagonal, when not kept
+  std::vector<DiagonalScores> m_checkpoints; // Scores saved for the traceback
+  std::vector<Wavefront> m_wavefronts;
+  BitBlocks              m_bit_blocks;
 
 public:
   DiagonalMatrix() : m_size(0) { }
@@ -153,10 +157,44 @@ public:
     return m_diag[n];
   }
   void clear() noexcept {
-    for(size_t i = 0; i < m_size; ++i)
-      m_diag[i].I.clear();
     m_size = 0;
   }
+
+  // Scores of diagonal n. Valid for the last three diagonals only.
+  DiagonalScores& scores(size_t n) { return m_scores[n % 3]; }
+
+  int32_t* match_scores(size_t n) {
+    if(n > m_match.size())
+      m_match.resize(n);
+    return m_match.data();
+  }
+
+  unsigned char* scratch_edits(size_t n) {
+    if(n > m_edits.size())
+      m_edits.resize(n);
+    return m_edits.data();
+  }
+
+  // Saved scores of a diagonal, to recompute the edits. Expands as needed.
+  DiagonalScores& checkpoint(size_t n) {
+    if(n >= m_checkpoints.size())
+      m_checkpoints.resize(n + 1);
+    return m_checkpoints[n];
+  }
+
+  // Wavefront for penalty s. Expands as needed, the content of a new or
+  // reused wavefront is undefined.
+  Wavefront& wavefront(size_t s) {
+    if(s >= m_wavefronts.size())
+      m_wavefronts.resize(s + 1);
+    return m_wavefronts[s];
+  }
+  const Wavefront& wavefront(size_t s) const {
+    return m_wavefronts[s];
+  }
+
+  // Blocks of the bit-vector search, with undefined content.
+  BitBlocks& bit_blocks() { return m_bit_blocks; }
 };
 
 
@@ -166,18 +204,24 @@ class aligner {
   const int _break_len;
   const int _banding;
   const int _matrix_type;
+  const int _engine;
 
 public:
   aligner()
     : _break_len(200) // Number of bases to extend past global high score before giving up
     , _banding(0) // No banding by default
     , _matrix_type(NUCLEOTIDE)
+    , _engine(DP_ENGINE)
   { }
 
-  aligner(int break_len, int banding, int matrix_type)
+  // The WAVEFRONT_ENGINE and BITVECTOR_SEARCH only support the
+  // NUCLEOTIDE matrix and ignore banding. Other matrices use the
+  // DP_ENGINE.
+  aligner(int break_len, int banding, int matrix_type, int engine = DP_ENGINE)
     : _break_len(break_len)
     , _banding(banding)
     , _matrix_type(matrix_type)
+    , _engine(engine)
   {
     if(break_len < 1 || break_len > MAX_ALIGNMENT_LENGTH)
       throw std::invalid_argument("Break length must be between 1 and MAX_ALIGNMENT_LENGTH included");
@@ -185,6 +229,8 @@ public:
       throw std::invalid_argument("Banding must be >= 0");
     if(matrix_type < 0 || matrix_type > 3)
       throw std::invalid_argument("Matrix type must be between 0 and 3 included");
+    if(engine & ~(WAVEFRONT_ENGINE | BITVECTOR_SEARCH))
+      throw std::invalid_argument("Engine must be DP_ENGINE or a combination of WAVEFRONT_ENGINE and BITVECTOR_SEARCH");
   }
 
   //------------------------------------------- Public Function Definitions ----//
@@ -277,6 +323,7 @@ public:
   int breakLen() const { return _break_len; }
   int banding() const { return _banding; }
   int matrixType() const { return _matrix_type; }
+  int engine() const { return _engine; }
 
   int good_score() const { return GOOD_SCORE[_matrix_type]; }
   int cont_gap_score() const { return CONT_GAP_SCORE[_matrix_type]; }
@@ -288,8 +335,25 @@ protected:
                     const char * B0, long int Bstart, long int & Bend,
                     std::vector<long int> & Delta, unsigned int m_o, DiagonalMatrix& Diag) const;
 
-  long int scoreMatch (const Diagonal& Diag, long int Dct, long int CDi,
-                       const char * A, const char * B, long int N, unsigned int m_o) const;
+  void _scoreDiagonal(DiagonalMatrix& Diag, long int Dct,
+                      const char * A, const char * B, long int N, unsigned int m_o,
+                      unsigned char * edits, long int & best, long int & best_i) const;
+
+  bool _alignWavefront(const char * A0, long int Astart, long int & Aend,
+                       const char * B0, long int Bstart, long int & Bend,
+                       std::vector<long int> & Delta, unsigned int m_o, DiagonalMatrix& Diag) const;
+
+  bool _searchBitVector(const char * A0, long int Astart, long int & Aend,
+                        const char * B0, long int Bstart, long int & Bend,
+                        unsigned int m_o, DiagonalMatrix& Diag) const;
+
+  bool _alignUngapped(const char * A0, long int Astart,
+                      const char * B0, long int Bstart,
+                      long int N, unsigned int m_o) const;
+
+  void scoreMatches (long int Dct, long int CDs, long int CDe,
+                     const char * A, const char * B, long int N, unsigned int m_o,
+                     int32_t * scores) const;
 
 };
 
@@ -302,7 +366,8 @@ class aligner_buffer : public aligner {
   mutable DiagonalMatrix m_Diag;
 public:
   aligner_buffer() = default;
-  aligner_buffer(int break_len, int banding, int matrix_type) : aligner(break_len, banding, matrix_type) { }
+  aligner_buffer(int break_len, int banding, int matrix_type, int engine = DP_ENGINE)
+    : aligner(break_len, banding, matrix_type, engine) { }
 
   // Warning: not thread safe!
   bool alignTarget(const char * A0, long int Astart, long int & Aend,
@@ -360,7 +425,12 @@ bool aligner::alignSearch(const char * A0, long int Astart, long int & Aend,
     }
 #endif
 
-  rv = _alignEngine (A0, Astart, Aend, B0, Bstart, Bend, n_v, m_o, Diag);
+  if ( _engine & BITVECTOR_SEARCH  &&  _matrix_type == NUCLEOTIDE )
+    rv = _searchBitVector (A0, Astart, Aend, B0, Bstart, Bend, m_o, Diag);
+  else if ( _engine & WAVEFRONT_ENGINE  &&  _matrix_type == NUCLEOTIDE )
+    rv = _alignWavefront (A0, Astart, Aend, B0, Bstart, Bend, n_v, m_o, Diag);
+  else
+    rv = _alignEngine (A0, Astart, Aend, B0, Bstart, Bend, n_v, m_o, Diag);
 
 #ifdef _DEBUG_VERBOSE
   fprintf(stderr,"--------------------------------------\n");
@@ -405,7 +475,15 @@ bool aligner::alignTarget(const char * A0, long int Astart, long int & Aend,
 	   Bend - Bstart + 1 <= MAX_ALIGNMENT_LENGTH);
 #endif
 
-  rv = _alignEngine (A0, Astart, Aend, B0, Bstart, Bend, Delta, m_o, Diag);
+  //-- Equal length sequences with few mismatches align without gaps,
+  //   there is no delta information to create
+  if ( Aend - Astart == Bend - Bstart  &&
+       _alignUngapped (A0, Astart, B0, Bstart, Aend - Astart + 1, m_o) )
+    rv = true;
+  else if ( _engine & WAVEFRONT_ENGINE  &&  _matrix_type == NUCLEOTIDE )
+    rv = _alignWavefront (A0, Astart, Aend, B0, Bstart, Bend, Delta, m_o, Diag);
+  else
+    rv = _alignEngine (A0, Astart, Aend, B0, Bstart, Bend, Delta, m_o, Diag);
 
 #ifdef _DEBUG_VERBOSE
   fprintf(stderr,"--------------------------------------\n");
@@ -13,6 +13,7 @@
 #include  <cassert>
 #include  <cerrno>
 #include  <unistd.h>
+#include  <iosfwd>
 
 
 #ifndef  EXIT_FAILURE
@@ -35,6 +36,7 @@ void *  Safe_realloc  (void *, size_t);
 char  Complement  (char);
 bool CompareIUPAC (char, char);
 bool  Read_String  (FILE *, char * &, long int &, char [], bool);
+bool  Read_String  (std::istream &, char * &, long int &, char [], bool);
 void  Reverse_Complement (char S [], long int Lo, long int Hi);
 
 #endif
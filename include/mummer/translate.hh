@@ -22,6 +22,14 @@ inline long int Translate_DNA
   return Translate_DNA(A, (int)strlen(A + 1), tA, Frame);
 }
 
+void Translate_DNA_Frames
+(const char * A, long int dnaseq_len, char * const tA[6], long int tA_len[6]);
+
+     // translate the six frames of A in one pass, with the same result
+     // as Translate_DNA for frames 1 to 6. Frame f is stored in
+     // tA[f-1], each malloced to atleast (len A / 3 + 2), and its
+     // length in tA_len[f-1].
+
 
 #define BAD_PEP_CHAR	-1
 #define SKIP_PEP_CHAR	-2
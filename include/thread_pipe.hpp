@@ -4,6 +4,8 @@
 #include <iterator>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <functional>
 
 #include <thread_pipe/cooperative_pool2.hpp>
 
@@ -59,6 +61,49 @@ public:
   }
 };
 
+// Output iterator of an ostream_buffered which passes the output of the
+// thread through a filter (e.g. a compression), in chunks of at least
+// chunk_size bytes. The filter runs in the thread. The chunks of the
+// threads are written in any order, so the filter must make
+// independent pieces (e.g. gzip members). Without a filter, behaves
+// like the iterator of the ostream_buffered.
+class filtered_iterator {
+public:
+  typedef std::function<void(const std::string&, std::string&)> filter_type;
+private:
+  ostream_buffered::iterator it_;
+  const filter_type          filter_;
+  const size_t               chunk_size_;
+  std::stringstream          buffer_;
+  std::string                in_, out_;
+
+  void write_chunk() {
+    in_ = buffer_.str();
+    buffer_.str("");
+    filter_(in_, out_);
+    static_cast<std::ostream&>(*it_).write(out_.data(), out_.size());
+    ++it_;
+  }
+public:
+  filtered_iterator(ostream_buffered::iterator it, filter_type filter = filter_type(), size_t chunk_size = 1 << 18)
+    : it_(it), filter_(filter), chunk_size_(chunk_size)
+  { }
+  std::ostream& operator*() { return filter_ ? buffer_ : static_cast<std::ostream&>(*it_); }
+  std::ostream* operator->() { return &**this; }
+  // End of a piece of output
+  filtered_iterator& operator++() {
+    if(!filter_)
+      ++it_;
+    else if((size_t)buffer_.tellp() >= chunk_size_)
+      write_chunk();
+    return *this;
+  }
+  void done() {
+    if(filter_ && buffer_.tellp() > 0)
+      write_chunk();
+    it_.done();
+  }
+};
 
 template<typename I>
 class input_iterator : public producer<input_iterator<I>, typename std::iterator_traits<I>::value_type> {
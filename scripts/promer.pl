@@ -82,6 +82,8 @@ my $HELP_INFO = q~
                     alignment at the end of the sequence (default --optimize)
 
     -p|prefix       Set the prefix of the output files (default "out")
+    -t|threads      Use NUM threads for the alignment (default: number of
+                    cores)
     -V
     --version       Display the version information and exit
     -x|matrix       Set the alignment matrix number to 1 [BLOSUM 45], 2 [BLOSUM
@@ -96,11 +98,8 @@ my $USAGE_INFO = q~
 
 my @DEPEND_INFO =
     (
-     "$BIN_DIR/mummer",
-     "$AUX_BIN_DIR/mgaps",
      "$BIN_DIR/show-coords",
-     "$AUX_BIN_DIR/postpro",
-     "$AUX_BIN_DIR/prepro",
+     "$AUX_BIN_DIR/proalign",
      "$LIB_DIR/Foundation.pm"
      );
 
@@ -108,7 +107,7 @@ my @DEPEND_INFO =
 my %DEFAULT_PARAMETERS =
     (
      "OUTPUT_PREFIX"     =>   "out",      # prefix for all output files
-     "MATCH_ALGORITHM"   =>   "-mumreference", # match finding algo switch
+     "MATCH_ALGORITHM"   =>   "",         # match finding algo switch
      "MIN_MATCH"         =>   "6",        # minimum match size (aminos)
      "MAX_GAP"           =>   "30",       # maximum gap between matches (aminos)
      "MIN_CLUSTER"       =>   "20",       # minimum cluster size (aminos)
@@ -139,6 +138,7 @@ sub main ( )
     my $blsm = $DEFAULT_PARAMETERS { "BLOSUM_NUMBER" };
     my $mask = $DEFAULT_PARAMETERS { "MASKING_LENGTH" };
     my $psw = $DEFAULT_PARAMETERS { "POST_SWITCHES" };
+    my $threads;          # number of alignment threads
 
     my $maxmatch;         # matching algorithm switches
     my $mumreference;
@@ -180,6 +180,7 @@ sub main ( )
 	 "o|coords"   => \$generate_coords,
 	 "optimize!" => \$optimize,
 	 "p|prefix=s" => \$pfx,
+	 "t|threads=i" => \$threads,
 	 "x|matrix=i" => \$blsm
 	 );
 
@@ -195,28 +196,31 @@ sub main ( )
     
     #-- Set up the program parameters
     if ( ! $extend ) {
-	$psw .= "-e ";
+	$psw .= "--noextend ";
     }
     if ( ! $delta ) {
-	$psw .= "-d ";
+	$psw .= "--nodelta ";
     }
     if ( ! $optimize ) {
-	$psw .= "-t ";
+	$psw .= "--nooptimize ";
+    }
+    if ( defined ($threads) ) {
+	$psw .= "-t $threads ";
     }
 
     undef (@err);
     $err[0] = 0;
     if ( $mum ) {
 	$err[0] ++;
-	$algo = "-mum";
+	$algo = "--mum";
     }
     if ( $mumreference ) {
 	$err[0] ++;
-	$algo = "-mumreference";
+	$algo = "";
     }
     if ( $maxmatch ) {
 	$err[0] ++;
-	$algo = "-maxmatch";
+	$algo = "--maxmatch";
     }
     if ( $err[0] > 1 ) {
 	$tigr->printUsageInfo( );
@@ -226,29 +230,14 @@ sub main ( )
     }
 
     #-- Set up the program path names
-    my $algo_path = "$BIN_DIR/mummer";
-    my $mgaps_path = "$AUX_BIN_DIR/mgaps";
-    my $prepro_path = "$AUX_BIN_DIR/prepro";
-    my $postpro_path = "$AUX_BIN_DIR/postpro";
+    my $proalign_path = "$AUX_BIN_DIR/proalign";
     my $showcoords_path = "$BIN_DIR/show-coords";
 		     
     #-- Check that the files needed are all there and readable/writable
     {
 	undef (@err);
-	if ( !$tigr->isExecutableFile ($algo_path) ) {
-	    push (@err, $algo_path);
-	}
-	
-	if ( !$tigr->isExecutableFile ($mgaps_path) ) {
-	    push (@err, $mgaps_path);
-	}
-	
-	if ( !$tigr->isExecutableFile ($prepro_path) ) {
-	    push (@err, $prepro_path);
-	}
-	
-	if ( !$tigr->isExecutableFile ($postpro_path) ) {
-	    push (@err, $postpro_path);
+	if ( !$tigr->isExecutableFile ($proalign_path) ) {
+	    push (@err, $proalign_path);
 	}
 	
 	if ( !$tigr->isReadableFile ($ref_file) ) {
@@ -259,24 +248,6 @@ sub main ( )
 	    push (@err, $qry_file);
 	}
 	
-	if ( !$tigr->isCreatableFile ("$pfx.aaref") ) {
-	    if ( !$tigr->isWritableFile ("$pfx.aaref") ) {
-		push (@err, "$pfx.aaref");
-	    }
-	}
-
-	if ( !$tigr->isCreatableFile ("$pfx.aaqry") ) {
-	    if ( !$tigr->isWritableFile ("$pfx.aaqry") ) {
-		push (@err, "$pfx.aaqry");
-	    }
-	}
-	
-	if ( !$tigr->isCreatableFile ("$pfx.mgaps") ) {
-	    if ( !$tigr->isWritableFile ("$pfx.mgaps") ) {
-		push (@err, "$pfx.mgaps");
-	    }
-	}
-	
 	if ( !$tigr->isCreatableFile ("$pfx.delta") ) {
 	    if ( !$tigr->isWritableFile ("$pfx.delta") ) {
 		push (@err, "$pfx.delta");
@@ -308,55 +279,21 @@ sub main ( )
     }
     
 
-    #-- Run prepro -r and -q and assert return value is zero
-    print (STDERR "1: PREPARING DATA\n");
+    #-- Run proalign and assert return value is zero. It translates,
+    #   matches, clusters and extends in memory, as prepro, mummer,
+    #   mgaps and postpro used to do.
+    print (STDERR "1: ALIGNING TRANSLATED SEQUENCES\n");
     $err[0] = $tigr->runCommand
-	("$prepro_path -m $mask -r $ref_file > $pfx.aaref");
+	("$proalign_path $algo -l $size -m $mask -c $clus -g $gap -d $diff ".
+	 "$psw -x $blsm -b $blen -p $pfx $ref_file $qry_file");
 
     if ( $err[0] != 0 ) {
-	$tigr->bail
-	    ("ERROR: prepro -r returned non-zero\n");
-    }
-
-    $err[0] = $tigr->runCommand
-	("$prepro_path -m $mask -q $qry_file > $pfx.aaqry");
-
-    if ( $err[0] != 0 ) {
-	$tigr->bail ("ERROR: prepro -q returned non-zero\n");
-    }
-
-
-    #-- Run mummer | mgaps and assert return value is zero
-    print (STDERR "2,3: RUNNING mummer AND CREATING CLUSTERS\n");
-    open(ALGO_PIPE, "$algo_path $algo -l $size $pfx.aaref $pfx.aaqry |")
-	or $tigr->bail ("ERROR: could not open $algo_path output pipe $!");
-    open(CLUS_PIPE, "| $mgaps_path -l $clus -s $gap -f $diff > $pfx.mgaps")
-	or $tigr->bail ("ERROR: could not open $mgaps_path input pipe $!");
-    while ( <ALGO_PIPE> ) {
-	print CLUS_PIPE
-	or $tigr->bail ("ERROR: could not write to $mgaps_path pipe $!");
-    }
-    $err[0] = close(ALGO_PIPE);
-    $err[1] = close(CLUS_PIPE);
-
-    if ( $err[0] == 0  ||  $err[1] == 0 ) {
-	$tigr->bail ("ERROR: mummer and/or mgaps returned non-zero\n");
-    }
-
-
-    #-- Run postpro and assert return value is zero
-    print (STDERR "4: FINISHING DATA\n");
-    $err[0] = $tigr->runCommand
-	("$postpro_path $psw -x $blsm -b $blen ".
-	 "$ref_file $qry_file $pfx < $pfx.mgaps");
-
-    if ( $err[0] != 0 ) {
-	$tigr->bail ("ERROR: postpro returned non-zero\n");
+	$tigr->bail ("ERROR: proalign returned non-zero\n");
     }
 
     #-- If the -o flag was set, run show-coords using PROmer1.1 settings
     if ( $generate_coords ) {
-	print (STDERR "5: GENERATING COORDS FILE\n");
+	print (STDERR "2: GENERATING COORDS FILE\n");
 	$err[0] = $tigr->runCommand
 	    ("$showcoords_path -r $pfx.delta > $pfx.coords");
 	
@@ -365,14 +302,6 @@ sub main ( )
 	}
     }
  
-    #-- Remove the temporary output
-    $err[0] = unlink ("$pfx.aaref", "$pfx.aaqry", "$pfx.mgaps");
- 
-    if ( $err[0] != 3 ) {
- 	$tigr->logError ("WARNING: there was a problem deleting".
-			 " the temporary output files", 1);
-    }
- 
     #-- Return success
     return (0);
 }
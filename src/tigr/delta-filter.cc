@@ -38,6 +38,7 @@ float          OPT_MinIdentity  = 0.0;       // minimum %identity
 float          OPT_MinUnique    = 0.0;       // minimum %unique
 float          OPT_MaxOverlap   = 100.0;     // maximum olap as % of align len
 float          OPT_Epsilon      = -1.0;      // negligible alignment score
+int            OPT_Threads      = 1;         // number of threads
 
 
 //========================================================== Fuction Decs ====//
@@ -69,7 +70,7 @@ int main(int argc, char ** argv)
   const bool stream = !(OPT_MinUnique > 0) && !OPT_QLIS && !OPT_RLIS && !OPT_GLIS && !OPT_MtoM && !OPT_1to1;
   const bool noop = stream && !(OPT_MinIdentity > 0) && !(OPT_MinLength);
   if(stream) {
-    std::ifstream is(OPT_AlignName);
+    mummer::compressed::ifstream is(OPT_AlignName);
     if(!is.good()) {
       std::cerr << "Error opening delta file '" << OPT_AlignName << "'" << std::endl;
       return EXIT_FAILURE;
@@ -84,6 +85,7 @@ int main(int argc, char ** argv)
 
   //-- Build the alignment graph from the delta file
   DeltaGraph_t graph;
+  graph.threads = OPT_Threads;
   graph.build(OPT_AlignName, true);
 
   //-- Identity requirements
@@ -130,7 +132,7 @@ void ParseArgs(int argc, char ** argv)
   optarg = NULL;
   
   while ( !errflg  &&
-         ((ch = getopt(argc, argv, "e:ghi:l:o:qru:m1")) != EOF) )
+         ((ch = getopt(argc, argv, "e:ghi:l:o:qrt:u:m1")) != EOF) )
     switch (ch)
       {
       case 'e':
@@ -166,6 +168,10 @@ void ParseArgs(int argc, char ** argv)
         OPT_RLIS = true;
         break;
 
+      case 't':
+        OPT_Threads = atoi(optarg);
+        break;
+
       case 'u':
         OPT_MinUnique = atof(optarg);
         break;
@@ -206,6 +212,12 @@ void ParseArgs(int argc, char ** argv)
       errflg ++;
     }
 
+  if ( OPT_Threads < 1 )
+    {
+      cerr << "ERROR: Number of threads must be greater than zero\n";
+      errflg ++;
+    }
+
   if ( errflg > 0  ||  optind != argc - 1 )
     {
       PrintUsage(argv[0]);
@@ -238,6 +250,8 @@ void PrintHelp(const char * s)
     << "              the reference, allowing for reference overlaps\n"
     << "-r            Maps each position of each reference to its best hit\n"
     << "              in the query, allowing for query overlaps\n"
+    << "-t int        Set the number of threads, default "
+    << OPT_Threads << endl
     << "-u float      Set the minimum alignment uniqueness, i.e. percent of\n"
     << "              the alignment matching to unique reference AND query\n"
     << "              sequence [0, 100], default "
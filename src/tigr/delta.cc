@@ -9,11 +9,23 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <mummer/delta.hh>
+#include <mummer/fasta_index.hh>
+#include <mummer/translate.hh>
 #include <map>
+#include <set>
 #include <vector>
 #include <cmath>
-#include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <cassert>
+#include <stdexcept>
+#include <climits>
+#include <limits>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 using namespace std;
 
 
@@ -97,8 +109,9 @@ inline long DiffAligns
 
 
 //------------------------------------------------------------ PickBest --------
+//-- rnd is the random number, from rand(), that breaks the ties
 long PickBest
-(const LIS_t * lis, const vector<long> & allbest, float epsilon)
+(const LIS_t * lis, const vector<long> & allbest, float epsilon, int rnd)
 {
   long size = allbest.size();
   if ( epsilon < 0 && size != 0 )
@@ -108,12 +121,69 @@ long PickBest
         if ( lis[allbest[eqc]].diff != lis[allbest.front()].diff )
           break;
       
-      return (int)((double)eqc*rand() / (RAND_MAX + 1.0));
+      return (int)((double)eqc*rnd / (RAND_MAX + 1.0));
     }
   return size;
 }
 
 
+//------------------------------------------------------------ HasGood ---------
+inline bool HasGood (const DeltaEdge_t & edge)
+{
+  for ( const DeltaEdgelet_t * e : edge.edgelets )
+    if ( e->isGOOD )
+      return true;
+  return false;
+}
+
+inline bool HasGood (const DeltaNode_t & node)
+{
+  for ( const DeltaEdge_t * e : node.edges )
+    if ( HasGood (*e) )
+      return true;
+  return false;
+}
+
+
+//------------------------------------------------------------ NodeList --------
+//-- The nodes of a graph map, for the parallel loops
+static vector<DeltaNode_t *> NodeList (map<string, DeltaNode_t> & nodes)
+{
+  vector<DeltaNode_t *> res;
+  res.reserve (nodes.size());
+  for ( auto & n : nodes )
+    res.push_back (&n.second);
+  return res;
+}
+
+
+//------------------------------------------------------------ EdgeList --------
+//-- The edges of a graph, in the order of the nodes
+static vector<DeltaEdge_t *> EdgeList (map<string, DeltaNode_t> & nodes)
+{
+  vector<DeltaEdge_t *> res;
+  for ( auto & n : nodes )
+    res.insert (res.end(), n.second.edges.begin(), n.second.edges.end());
+  return res;
+}
+
+
+//------------------------------------------------------- DrawTieBreaks --------
+//-- The random numbers used by PickBest. They are drawn up front, in the
+//   order of the sequential algorithm (one per node or edge with good
+//   edgelets), so the result is the same with any number of threads.
+template<typename T>
+static vector<int> DrawTieBreaks (const vector<T *> & units, float epsilon)
+{
+  vector<int> res (units.size(), 0);
+  if ( epsilon < 0 )
+    for ( size_t i = 0; i < units.size(); ++ i )
+      if ( HasGood (*units[i]) )
+        res[i] = rand();
+  return res;
+}
+
+
 //------------------------------------------------------------------ RevC ------
 inline long RevC (const long & coord,
                   const long & len)
@@ -122,6 +192,15 @@ inline long RevC (const long & coord,
 }
 
 
+//------------------------------------------------------------------ Norm ------
+inline long Norm (long c, long l, int f, AlignmentType_t d)
+{
+  long retval = (d == PROMER_DATA ? c * 3 - (3 - abs(f)) : c);
+  if ( f < 0 ) retval = RevC (retval, l);
+  return retval;
+}
+
+
 //------------------------------------------------------------ ScoreLocal ------
 inline long ScoreLocal
 (long scorej, long leni, long lenj,
@@ -151,6 +230,75 @@ inline void Swap (long & a, long & b)
 }
 
 
+//----------------------------------------------------------- AppendDelta ------
+inline void AppendDelta (string & s, long delta)
+{
+  char buf[24];
+  char * const end = buf + sizeof (buf);
+  char * p = end;
+  *--p = '\n';
+  unsigned long u = delta < 0 ? -(unsigned long)delta : delta;
+  do { *--p = '0' + u % 10; u /= 10; } while ( u );
+  if ( delta < 0 )
+    *--p = '-';
+  s.append (p, end - p);
+}
+
+
+//------------------------------------------------------------ ChainLIS ------
+//-- One pass of the LIS dynamic programming over the unused entries of lis,
+//   for the sorted edgelets. alone(i) is the score of edgelet i alone and
+//   link(i, j, score) sets the score of i chained after j, returning false
+//   if j cannot precede i. Chaining never adds more than the score alone,
+//   so the predecessors are visited by decreasing score and the search
+//   stops when none can reach the best score found, instead of scanning
+//   every j < i. Ties are broken as by the full scan: smallest diff, then
+//   smallest j.
+template<typename Alone, typename Link>
+static void ChainLIS
+(LIS_t * lis, const vector<DeltaEdgelet_t *> & edgelets, Alone alone, Link link)
+{
+  long i, j, n, gain, score, diff;
+  set< pair<long, long> > ends;            // (-score, index) of the chains
+  set< pair<long, long> >::const_iterator ci;
+
+  n = edgelets.size();
+  for ( i = 0; i < n; ++ i )
+    {
+      if ( lis[i].used ) continue;
+
+      lis[i].a = edgelets[i];
+      lis[i].score = gain = alone (i);
+      lis[i].from = -1;
+      lis[i].diff = 0;
+
+      for ( ci = ends.begin(); ci != ends.end(); ++ ci )
+        {
+          j = ci->second;
+          if ( lis[j].score + gain < lis[i].score )
+            break;
+          if ( ! link (i, j, score)  ||  score < lis[i].score )
+            continue;
+
+          diff = lis[j].diff + DiffAligns (lis[i].a, lis[j].a);
+
+          if ( score > lis[i].score
+               ||
+               diff < lis[i].diff
+               ||
+               (diff == lis[i].diff && j < lis[i].from) )
+            {
+              lis[i].from = j;
+              lis[i].score = score;
+              lis[i].diff = diff;
+            }
+        }
+
+      ends.insert (make_pair (-lis[i].score, i));
+    }
+}
+
+
 //------------------------------------------------------------ UpdateBest ------
 bool UpdateBest
 (LIS_t * lis, long size, vector<long> & allbest, float epsilon)
@@ -258,6 +406,132 @@ bool DeltaRecord_t::read(std::istream& is) {
   return true;
 }
 
+//-- Parsing of text delta records mapped in memory. Same as the
+//   formatted input of DeltaAlignment_t::read and DeltaRecord_t::read,
+//   one character at a time.
+namespace {
+inline bool IsSpace (char c)
+{
+  return c == ' '  ||  c == '\n'  ||  c == '\t'  ||  c == '\r'  ||  c == '\v'  ||  c == '\f';
+}
+
+inline void SkipSpace (const char * & p, const char * end)
+{
+  while ( p < end  &&  IsSpace (*p) )
+    ++ p;
+}
+
+inline void SkipLine (const char * & p, const char * end)
+{
+  const char * nl = (const char *) memchr (p, '\n', end - p);
+  p = nl ? nl + 1 : end;
+}
+
+inline bool ParseLong (const char * & p, const char * end, long & x)
+{
+  SkipSpace (p, end);
+  bool neg = false;
+  if ( p < end  &&  (*p == '-'  ||  *p == '+') )
+    neg = *p++ == '-';
+  if ( p == end  ||  *p < '0'  ||  *p > '9' )
+    return false;
+  unsigned long res = 0;
+  for ( ; p < end  &&  *p >= '0'  &&  *p <= '9'; ++ p )
+    res = res * 10 + (*p - '0');
+  x = neg ? -(long)res : (long)res;
+  return true;
+}
+
+inline bool ParseToken (const char * & p, const char * end, string & s)
+{
+  SkipSpace (p, end);
+  const char * start = p;
+  while ( p < end  &&  !IsSpace (*p) )
+    ++ p;
+  s.assign (start, p - start);
+  return p != start;
+}
+
+bool ParseAlignment
+(const char * & p, const char * end, bool promer, bool read_deltas,
+ DeltaAlignment_t & a)
+{
+  long delta;
+  float total;
+
+  a.deltas.clear ();
+  if ( !ParseLong (p, end, a.sR)  ||  !ParseLong (p, end, a.eR)  ||
+       !ParseLong (p, end, a.sQ)  ||  !ParseLong (p, end, a.eQ)  ||
+       !ParseLong (p, end, a.idyc)  ||  !ParseLong (p, end, a.simc)  ||
+       !ParseLong (p, end, a.stpc) )
+    return false;
+  if ( a.sR <= 0  ||  a.eR <= 0  ||
+       a.sQ <= 0  ||  a.eQ <= 0  ||
+       a.idyc < 0  ||  a.simc < 0  ||  a.stpc < 0 )
+    return false;
+
+  total = std::abs(a.eR - a.sR) + 1.0;
+  if ( promer )
+    total /= 3.0;
+
+  do {
+    if ( !ParseLong (p, end, delta) )
+      return false;
+    if ( delta < 0 )
+      total ++;
+    if ( read_deltas )
+      a.deltas.push_back (delta);
+  } while ( delta != 0 );
+  SkipLine (p, end);
+
+  a.idy = (total - (float)a.idyc) / total * 100.0;
+  a.sim = (total - (float)a.simc) / total * 100.0;
+  a.stp = (float)a.stpc / (total * 2.0) * 100.0;
+  return true;
+}
+
+//-- Parse the record in [p, end), reusing the memory of rec
+bool ParseRecord
+(const char * p, const char * end, bool promer, bool read_deltas,
+ DeltaRecord_t & rec)
+{
+  if ( p < end  &&  *p == '>' )
+    ++ p;
+  if ( !ParseToken (p, end, rec.idR)  ||  !ParseToken (p, end, rec.idQ)  ||
+       !ParseLong (p, end, rec.lenR)  ||  !ParseLong (p, end, rec.lenQ)  ||
+       rec.lenR <= 0  ||  rec.lenQ <= 0 )
+    return false;
+  SkipLine (p, end);
+
+  size_t n = 0;
+  for ( SkipSpace (p, end); p < end  &&  *p != '>'; SkipSpace (p, end) )
+    {
+      if ( n == rec.aligns.size () )
+        rec.aligns.resize (n + 1);
+      if ( !ParseAlignment (p, end, promer, read_deltas, rec.aligns[n]) )
+        return false;
+      ++ n;
+    }
+  rec.aligns.resize (n);
+  return true;
+}
+
+//-- Start of the record following the one at p
+inline const char * NextRecord (const char * p, const char * end)
+{
+  for ( ++ p; p < end; ++ p )
+    {
+      p = (const char *) memchr (p, '>', end - p);
+      if ( p == NULL )
+        return end;
+      if ( p[-1] == '\n' )
+        return p;
+    }
+  return end;
+}
+} // namespace
+
+
 //===================================================== DeltaReader_t ==========
 //----------------------------------------------------- open -------------------
 void DeltaReader_t::open
@@ -266,11 +540,33 @@ void DeltaReader_t::open
   delta_path_m = delta_path;
 
   //-- Open the delta file
-  delta_stream_m.open (delta_path_m.c_str ());
+  try
+    {
+      delta_stream_m.open (delta_path_m.c_str (), ios::in | ios::binary);
+    }
+  catch ( const std::runtime_error & e )
+    {
+      cerr << "ERROR: " << e.what () << ", " << delta_path_m << endl;
+      delta_stream_m.setstate (ios::failbit);
+    }
   checkStream ();
 
+  //-- Binary delta file. Detected without seeking back, the input may
+  //   be a pipe.
+  string prefix;
+  while ( prefix.size () < mummer::delta_binary::MAGIC_LEN  &&
+          delta_stream_m.peek () == mummer::delta_binary::MAGIC[prefix.size ()] )
+    prefix += (char) delta_stream_m.get ();
+  if ( prefix.size () == mummer::delta_binary::MAGIC_LEN )
+    {
+      openBinary ();
+      return;
+    }
+
   //-- Read the file header
-  delta_stream_m >> reference_path_m;
+  if ( prefix.empty ()  ||  !isspace (delta_stream_m.peek ()) )
+    delta_stream_m >> reference_path_m;
+  reference_path_m.insert (0, prefix);
   delta_stream_m >> query_path_m;
   delta_stream_m >> data_type_m;
   if ( (data_type_m != NUCMER_STRING  &&  data_type_m != PROMER_STRING) )
@@ -282,6 +578,90 @@ void DeltaReader_t::open
   while ( delta_stream_m.peek () != '>' )
     if ( delta_stream_m.get () == EOF )
       break;
+
+  mapText ();
+}
+
+
+//----------------------------------------------------- mapText ----------------
+void DeltaReader_t::mapText ( )
+{
+  const streamoff pos = delta_stream_m.tellg ();
+  if ( pos < 0 )
+    return;
+
+  //-- Only regular files are mapped, others are read from the stream
+  const int fd = ::open (delta_path_m.c_str (), O_RDONLY);
+  if ( fd == -1 )
+    return;
+  struct stat st;
+  if ( fstat (fd, &st) == 0  &&  S_ISREG (st.st_mode)  &&  st.st_size > pos )
+    {
+      void * map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if ( map != MAP_FAILED )
+        {
+          madvise (map, st.st_size, MADV_SEQUENTIAL);
+          map_m = (const char *) map;
+          map_size_m = st.st_size;
+          map_pos_m = map_m + pos;
+        }
+    }
+  ::close (fd);
+}
+
+
+//----------------------------------------------------- unmap ------------------
+void DeltaReader_t::unmap ( )
+{
+  if ( map_m != NULL )
+    munmap ((void *) map_m, map_size_m);
+  map_m = map_pos_m = NULL;
+  map_size_m = 0;
+}
+
+
+//----------------------------------------------------- parseError -------------
+void DeltaReader_t::parseError ( )
+{
+  std::cerr << "ERROR: Could not parse delta file, "
+            << delta_path_m << std::endl;
+  exit (-1);
+}
+
+
+//----------------------------------------------------- openBinary -------------
+void DeltaReader_t::openBinary ( )
+{
+  using namespace mummer::delta_binary;
+
+  if ( !read_string (delta_stream_m, reference_path_m)  ||
+       !read_string (delta_stream_m, query_path_m)  ||
+       !read_string (delta_stream_m, data_type_m)  ||
+       (data_type_m != NUCMER_STRING  &&  data_type_m != PROMER_STRING) )
+    delta_stream_m.setstate (ios::failbit);
+  checkStream ();
+  records_begin_m = delta_stream_m.tellg ();
+
+  //-- Look for an index, read on demand by readRecord
+  if ( records_begin_m >= 0 )
+    {
+      uint64_t records_end;
+      is_indexed_m = read_trailer (delta_stream_m, records_end);
+      records_end_m = records_end;
+      delta_stream_m.clear ();
+      delta_stream_m.seekg (records_begin_m);
+      checkStream ();
+    }
+  else
+    {
+      //-- Not seekable, read until EOF
+      records_begin_m = 0;
+      records_end_m = numeric_limits<streamoff>::max ();
+    }
+  position_m = records_begin_m;
+
+  is_binary_m = true;
+  is_open_m = true;
 }
 
 
@@ -296,6 +676,24 @@ void DeltaReader_t::readNextAlignment
 //----------------------------------------------------- readNextRecord ---------
 bool DeltaReader_t::readNextRecord (const bool read_deltas)
 {
+  if ( is_binary_m )
+    return readNextBinaryRecord (read_deltas);
+
+  //-- Text file in memory
+  if ( map_m != NULL )
+    {
+      const char * end = map_m + map_size_m;
+      if ( map_pos_m == end  ||  *map_pos_m != '>' )
+        return false;
+      const char * next = NextRecord (map_pos_m, end);
+      is_record_m = true;
+      if ( !ParseRecord (map_pos_m, next, data_type_m == PROMER_STRING,
+                         read_deltas, record_m) )
+        parseError ();
+      map_pos_m = next;
+      return true;
+    }
+
   //-- If EOF or any other abnormality
   if ( delta_stream_m.peek () != '>' )
     return false;
@@ -324,11 +722,183 @@ bool DeltaReader_t::readNextRecord (const bool read_deltas)
 }
 
 
+//----------------------------------------------------- readNextBinaryRecord ---
+bool DeltaReader_t::readNextBinaryRecord (const bool read_deltas)
+{
+  using namespace mummer::delta_binary;
+
+  //-- Track the position, tellg is slow
+  if ( position_m >= records_end_m  ||  delta_stream_m.peek () == EOF )
+    return false;
+
+  //-- Read the whole record in memory
+  uint64_t size;
+  if ( !read_varint (delta_stream_m, size) )
+    delta_stream_m.setstate (ios::failbit);
+  checkStream ();
+  position_m += varint_size (size) + size;
+  if ( size == 0 )              // start of the footer
+    {
+      position_m = records_end_m;
+      return false;
+    }
+  buffer_m.resize (size);
+  if ( size > 0 )
+    delta_stream_m.read (&buffer_m[0], size);
+  checkStream ();
+
+  is_record_m = true;
+
+  //-- Decode the record header
+  cursor c (buffer_m.data (), buffer_m.data () + buffer_m.size ());
+  record_m.idR = c.string ();
+  record_m.idQ = c.string ();
+  record_m.lenR = c.varint ();
+  record_m.lenQ = c.varint ();
+  const uint64_t nb_aligns = c.varint ();
+  if ( !c.good  ||  nb_aligns > size )
+    delta_stream_m.setstate (ios::failbit);
+  checkStream ();
+
+  //-- For each alignment, reusing the memory of the previous record
+  const bool promer = data_type_m == PROMER_STRING;
+  record_m.aligns.resize (nb_aligns);
+  for ( DeltaAlignment_t & align : record_m.aligns )
+    {
+      align.deltas.clear ();
+      align.sR = c.varint ();
+      align.eR = c.varint ();
+      align.sQ = c.varint ();
+      align.eQ = c.varint ();
+      align.idyc = c.varint ();
+      align.simc = c.varint ();
+      align.stpc = c.varint ();
+
+      //-- Same computation as for the text deltas
+      float total = std::abs(align.eR - align.sR) + 1.0;
+      if ( promer )
+        total /= 3.0;
+      const uint64_t nb_deltas = c.varint ();
+      if ( nb_deltas > size )
+        c.good = false;
+      if ( read_deltas )
+        align.deltas.reserve (c.good ? nb_deltas + 1 : 0);
+      for ( uint64_t i = 0; c.good  &&  i < nb_deltas; ++ i )
+        {
+          const long delta = c.signed_varint ();
+          if ( delta < 0 )
+            total ++;
+          if ( read_deltas )
+            align.deltas.push_back (delta);
+        }
+      if ( read_deltas )
+        align.deltas.push_back (0);
+      if ( !c.good )
+        break;
+
+      align.idy = (total - (float)align.idyc) / total * 100.0;
+      align.sim = (total - (float)align.simc) / total * 100.0;
+      align.stp = (float)align.stpc / (total * 2.0) * 100.0;
+    }
+  if ( !c.good )
+    delta_stream_m.setstate (ios::failbit);
+  checkStream ();
+
+  return true;
+}
+
+
+//----------------------------------------------------- readNextBatch ----------
+size_t DeltaReader_t::readNextBatch
+(vector<DeltaRecord_t> & records, size_t max, bool read_deltas,
+ unsigned int threads)
+{
+  if ( records.size () < max )
+    records.resize (max);
+  is_record_m = false;
+
+  if ( map_m == NULL )
+    {
+      size_t n = 0;
+      for ( ; n < max  &&  readNextRecord (read_deltas); ++ n )
+        swap (records[n], record_m);
+      is_record_m = false;
+      return n;
+    }
+
+  //-- Split the mapped text in records, then parse them in parallel
+  const char * end = map_m + map_size_m;
+  vector<const char *> starts;
+  while ( starts.size () < max  &&  map_pos_m < end  &&  *map_pos_m == '>' )
+    {
+      starts.push_back (map_pos_m);
+      map_pos_m = NextRecord (map_pos_m, end);
+    }
+  const long n = starts.size ();
+  starts.push_back (map_pos_m);
+
+  const bool promer = data_type_m == PROMER_STRING;
+  bool good = true;
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 16) reduction(&&:good)
+  for ( long i = 0; i < n; ++ i )
+    good = ParseRecord (starts[i], starts[i + 1], promer, read_deltas,
+                        records[i]) && good;
+  if ( !good )
+    parseError ();
+
+  return n;
+}
+
+
+//----------------------------------------------------- readRecord -------------
+bool DeltaReader_t::readRecord
+(const string & idR, const string & idQ, bool read_deltas)
+{
+  if ( is_indexed_m  &&  index_m.records.empty () )
+    {
+      uint64_t records_end;
+      is_indexed_m = read_index (delta_stream_m, index_m, records_end);
+    }
+  if ( is_indexed_m )
+    {
+      const auto & ids = index_m.ids;
+      const uint64_t iR = find (ids.begin (), ids.end (), idR) - ids.begin ();
+      const uint64_t iQ = find (ids.begin (), ids.end (), idQ) - ids.begin ();
+      for ( const auto & r : index_m.records )
+        if ( r.idR == iR  &&  r.idQ == iQ )
+          {
+            delta_stream_m.clear ();
+            delta_stream_m.seekg (r.offset);
+            position_m = r.offset;
+            return readNextRecord (read_deltas);
+          }
+      return false;
+    }
+
+  //-- Read from the beginning
+  if ( is_binary_m )
+    {
+      delta_stream_m.clear ();
+      delta_stream_m.seekg (records_begin_m);
+      position_m = records_begin_m;
+    }
+  else
+    {
+      const string path = delta_path_m;
+      close ();
+      open (path);
+    }
+  while ( readNextRecord (read_deltas) )
+    if ( record_m.idR == idR  &&  record_m.idQ == idQ )
+      return true;
+  return false;
+}
+
+
 //===================================================== DeltaEdge_t ============
 //------------------------------------------------------build ------------------
 void DeltaEdge_t::build (const DeltaRecord_t & rec)
 {
-  stringstream ss;
   vector<long>::const_iterator di;
   DeltaEdgelet_t * p;
 
@@ -358,11 +928,7 @@ void DeltaEdge_t::build (const DeltaRecord_t & rec)
 
       //-- Get the delta information
       for ( di = i->deltas.begin(); di != i->deltas.end(); ++ di )
-        {
-          ss << *di << '\n';
-          p->delta.append (ss.str());
-          ss.str ("");
-        }
+        AppendDelta (p->delta, *di);
 
       //-- Force loR < hiR && loQ < hiQ
       if ( p->dirR == REVERSE_DIR )
@@ -408,44 +974,54 @@ void DeltaGraph_t::build (const string & deltapath, bool getdeltas)
   else
     datatype = NULL_DATA;
 
-  //-- Read in the next graph edge, i.e. a new delta record
-  while ( dr.readNext (getdeltas) )
+  //-- Read the records by batch, build the graph edges in parallel
+  const size_t BATCH = 4096;
+  vector<DeltaRecord_t> records;
+  vector<DeltaEdge_t *> edges (BATCH);
+  size_t n;
+  while ( (n = dr.readNextBatch (records, BATCH, getdeltas, threads)) > 0 )
     {
-      dep = new DeltaEdge_t();
-
-
-      //-- Find the reference node in the graph, add a new one if necessary
-      insret = refnodes.insert
-        (map<string, DeltaNode_t>::value_type
-         (dr.getRecord().idR, DeltaNode_t()));
-      dep->refnode = &((insret.first)->second);
-
-      //-- If a new reference node
-      if ( insret.second )
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 16)
+      for ( long i = 0; i < (long)n; ++ i )
         {
-          dep->refnode->id  = &((insret.first)->first);
-          dep->refnode->len = dr.getRecord().lenR;
+          edges[i] = new DeltaEdge_t();
+          edges[i]->build (records[i]);
         }
 
+      //-- Add the edges to the graph, in the order of the file
+      for ( size_t i = 0; i < n; ++ i )
+        {
+          const DeltaRecord_t & rec = records[i];
+          dep = edges[i];
 
-      //-- Find the query node in the graph, add a new one if necessary
-      insret = qrynodes.insert
-        (map<string, DeltaNode_t>::value_type
-         (dr.getRecord().idQ, DeltaNode_t()));
-      dep->qrynode = &((insret.first)->second);
+          //-- Find the reference node in the graph, add a new one if necessary
+          insret = refnodes.insert
+            (map<string, DeltaNode_t>::value_type (rec.idR, DeltaNode_t()));
+          dep->refnode = &((insret.first)->second);
+
+          //-- If a new reference node
+          if ( insret.second )
+            {
+              dep->refnode->id  = &((insret.first)->first);
+              dep->refnode->len = rec.lenR;
+            }
 
-      //-- If a new query node
-      if ( insret.second )
-        {
-          dep->qrynode->id  = &((insret.first)->first);
-          dep->qrynode->len = dr.getRecord().lenQ;
-        }
 
+          //-- Find the query node in the graph, add a new one if necessary
+          insret = qrynodes.insert
+            (map<string, DeltaNode_t>::value_type (rec.idQ, DeltaNode_t()));
+          dep->qrynode = &((insret.first)->second);
 
-      //-- Build the edge
-      dep->build (dr.getRecord());
-      dep->refnode->edges.push_back (dep);
-      dep->qrynode->edges.push_back (dep);
+          //-- If a new query node
+          if ( insret.second )
+            {
+              dep->qrynode->id  = &((insret.first)->first);
+              dep->qrynode->len = rec.lenQ;
+            }
+
+          dep->refnode->edges.push_back (dep);
+          dep->qrynode->edges.push_back (dep);
+        }
     }
   dr.close ();
 }
@@ -709,159 +1285,142 @@ void DeltaGraph_t::flagMtoM(float epsilon, float maxolap)
 //!
 void DeltaGraph_t::flagGLIS (float epsilon)
 {
-  LIS_t * lis = NULL;
-  long lis_size = 0;
-  long i, j, n;
-  long olap, olapQ, olapR, len, lenQ, lenR, score, diff;
-
-  vector<DeltaEdgelet_t *> edgelets;
-
-  map<string, DeltaNode_t>::const_iterator mi;
-  vector<DeltaEdge_t *>::const_iterator ei;
-  vector<DeltaEdgelet_t *>::iterator eli;
-
-
-  //-- For each reference sequence
-  for ( mi = refnodes.begin(); mi != refnodes.end(); ++ mi )
-    {
-      //-- For each query aligning to this reference
-      for ( ei  = (mi->second).edges.begin();
-            ei != (mi->second).edges.end(); ++ ei )
-        {
-          //-- Collect all the good edgelets
-          edgelets.clear();
-          for ( eli  = (*ei)->edgelets.begin();
-                eli != (*ei)->edgelets.end(); ++ eli )
-            if ( (*eli)->isGOOD )
-              {
-                edgelets.push_back (*eli);
-
-                //-- Fix the coordinates to make global LIS work
-                if ( (*eli)->dirR == (*eli)->dirQ )
-                  {
-                    (*eli)->dirQ = FORWARD_DIR;
-                  }
-                else
-                  {
-                    if ( (*eli)->dirQ == REVERSE_DIR )
-                      Swap ((*eli)->loQ, (*eli)->hiQ);
-                    (*eli)->loQ = RevC ((*eli)->loQ, (*ei)->qrynode->len);
-                    (*eli)->hiQ = RevC ((*eli)->hiQ, (*ei)->qrynode->len);
-                    (*eli)->dirQ = REVERSE_DIR;
-                  }
-              }
+  //-- The edges are independent, process them in parallel
+  const vector<DeltaEdge_t *> edges = EdgeList (refnodes);
+  const vector<int> draws = DrawTieBreaks (edges, epsilon);
 
-          //-- Resize and initialize
-          n = edgelets.size();
-          if ( n > lis_size )
-            {
-              lis = (LIS_t *) Safe_realloc (lis, sizeof (LIS_t) * n);
-              lis_size = n;
-            }
-          for ( i = 0; i < n; ++ i )
-            lis[i].used = false;
+#pragma omp parallel num_threads(threads)
+  {
+    LIS_t * lis = NULL;
+    long lis_size = 0;
+    long i, n;
 
-          //-- Sort by lo query coord
-          sort (edgelets.begin(), edgelets.end(), EdgeletQCmp_t());
+    vector<DeltaEdgelet_t *> edgelets;
 
-          //-- Continue until all equivalent repeats are extracted
-          vector<long> allbest;
-          do
-            {
-              //-- Dynamic
-              for ( i = 0; i < n; ++ i )
-                {
-                  if ( lis[i].used ) continue;
-
-                  lis[i].a = edgelets[i];
-                  
-                  lenR = lis[i].a->hiR - lis[i].a->loR + 1;
-                  lenQ = lis[i].a->hiQ - lis[i].a->loQ + 1;
-                  len = lenR > lenQ ? lenQ : lenR;
-                  lis[i].score = ScoreGlobal (0, len, 0, lis[i].a->idy);
-
-                  lis[i].from = -1;
-                  lis[i].diff = 0;
-                  
-                  for ( j = 0; j < i; ++ j )
-                    {
-                      if ( lis[j].used ) continue;
-
-                      if ( lis[i].a->dirQ != lis[j].a->dirQ )
-                        continue;
-                  
-                      lenR = lis[i].a->hiR - lis[i].a->loR + 1;
-                      lenQ = lis[i].a->hiQ - lis[i].a->loQ + 1;
-                      len = lenR > lenQ ? lenQ : lenR;
-                  
-                      olapR = lis[j].a->hiR - lis[i].a->loR + 1;
-                      olapQ = lis[j].a->hiQ - lis[i].a->loQ + 1;
-                      olap = olapR > olapQ ? olapR : olapQ;
-                      if ( olap < 0 )
-                        olap = 0;
-
-                      diff = lis[j].diff + DiffAligns (lis[i].a, lis[j].a);
-
-                      score = ScoreGlobal
-                        (lis[j].score, len, olap, lis[i].a->idy);
-
-                      if ( score > lis[i].score
-                           ||
-                           (score == lis[i].score && diff < lis[i].diff) )
-                        {
-                          lis[i].from = j;
-                          lis[i].score = score;
-                          lis[i].diff = diff;
-                        }
-                    }
-                }
-            } while ( UpdateBest (lis, n, allbest, epsilon) );
+    vector<DeltaEdgelet_t *>::iterator eli;
 
-          long beg = PickBest (lis, allbest, epsilon);
-          long end = allbest.size();
-          if ( beg == end ) beg = 0;
-          else end = beg + 1;
 
-          //-- Flag the edgelets
-          for ( ; beg < end; ++ beg )
-            for ( i = allbest[beg]; i >= 0  &&  i < n; i = lis[i].from )
-              lis[i].a->isGLIS = true;
+    //-- For each pair of aligning sequences
+#pragma omp for schedule(dynamic)
+    for ( long ni = 0; ni < (long)edges.size(); ++ ni )
+      {
+        DeltaEdge_t * edge = edges[ni];
 
-          //-- Repair the coordinates
-          for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
+        //-- Collect all the good edgelets
+        edgelets.clear();
+        for ( eli  = edge->edgelets.begin();
+              eli != edge->edgelets.end(); ++ eli )
+          if ( (*eli)->isGOOD )
             {
-              if ( ! (*eli)->isGLIS )
-                (*eli)->isGOOD = false;
+              edgelets.push_back (*eli);
 
-              if ( (*eli)->dirQ == FORWARD_DIR )
+              //-- Fix the coordinates to make global LIS work
+              if ( (*eli)->dirR == (*eli)->dirQ )
                 {
-                  (*eli)->dirQ = (*eli)->dirR;
+                  (*eli)->dirQ = FORWARD_DIR;
                 }
               else
                 {
-                  if ( (*eli)->dirR == FORWARD_DIR )
+                  if ( (*eli)->dirQ == REVERSE_DIR )
                     Swap ((*eli)->loQ, (*eli)->hiQ);
-                  (*eli)->loQ = RevC ((*eli)->loQ, (*ei)->qrynode->len);
-                  (*eli)->hiQ = RevC ((*eli)->hiQ, (*ei)->qrynode->len);
-                  (*eli)->dirQ =
-                    (*eli)->dirR == FORWARD_DIR ? REVERSE_DIR : FORWARD_DIR;
+                  (*eli)->loQ = RevC ((*eli)->loQ, edge->qrynode->len);
+                  (*eli)->hiQ = RevC ((*eli)->hiQ, edge->qrynode->len);
+                  (*eli)->dirQ = REVERSE_DIR;
                 }
             }
-        }
-    }
 
-  free (lis);
-}
+        //-- Resize and initialize
+        n = edgelets.size();
+        if ( n > lis_size )
+          {
+            lis = (LIS_t *) Safe_realloc (lis, sizeof (LIS_t) * n);
+            lis_size = n;
+          }
+        for ( i = 0; i < n; ++ i )
+          lis[i].used = false;
 
+        //-- Sort by lo query coord
+        sort (edgelets.begin(), edgelets.end(), EdgeletQCmp_t());
 
-//-------------------------------------------------------------- flagQLIS ------
-//! \brief Flag edgelets in the query LIS and unflag those who are not
-//!
-//! Runs a length*identity weighted LIS to determine the longest, QUERY
-//! consistent set of alignments for all query sequences. This effectively
-//! identifies the "best" alignments for all positions of each query.
-//!
-//! Sets isQLIS flag for good and unsets isGOOD flag for bad.
+        //-- Score an edgelet alone, and after another one
+        auto alone = [&] (long i)
+          {
+            long lenR = lis[i].a->hiR - lis[i].a->loR + 1;
+            long lenQ = lis[i].a->hiQ - lis[i].a->loQ + 1;
+            return ScoreGlobal (0, lenR > lenQ ? lenQ : lenR, 0, lis[i].a->idy);
+          };
+        auto link = [&] (long i, long j, long & score)
+          {
+            if ( lis[i].a->dirQ != lis[j].a->dirQ )
+              return false;
+
+            long lenR = lis[i].a->hiR - lis[i].a->loR + 1;
+            long lenQ = lis[i].a->hiQ - lis[i].a->loQ + 1;
+            long len = lenR > lenQ ? lenQ : lenR;
+
+            long olapR = lis[j].a->hiR - lis[i].a->loR + 1;
+            long olapQ = lis[j].a->hiQ - lis[i].a->loQ + 1;
+            long olap = olapR > olapQ ? olapR : olapQ;
+            if ( olap < 0 )
+              olap = 0;
+
+            score = ScoreGlobal (lis[j].score, len, olap, lis[i].a->idy);
+            return true;
+          };
+
+        //-- Continue until all equivalent repeats are extracted
+        vector<long> allbest;
+        do
+          {
+            //-- Dynamic
+            ChainLIS (lis, edgelets, alone, link);
+          } while ( UpdateBest (lis, n, allbest, epsilon) );
+
+        long beg = PickBest (lis, allbest, epsilon, draws[ni]);
+        long end = allbest.size();
+        if ( beg == end ) beg = 0;
+        else end = beg + 1;
+
+        //-- Flag the edgelets
+        for ( ; beg < end; ++ beg )
+          for ( i = allbest[beg]; i >= 0  &&  i < n; i = lis[i].from )
+            lis[i].a->isGLIS = true;
+
+        //-- Repair the coordinates
+        for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
+          {
+            if ( ! (*eli)->isGLIS )
+              (*eli)->isGOOD = false;
+
+            if ( (*eli)->dirQ == FORWARD_DIR )
+              {
+                (*eli)->dirQ = (*eli)->dirR;
+              }
+            else
+              {
+                if ( (*eli)->dirR == FORWARD_DIR )
+                  Swap ((*eli)->loQ, (*eli)->hiQ);
+                (*eli)->loQ = RevC ((*eli)->loQ, edge->qrynode->len);
+                (*eli)->hiQ = RevC ((*eli)->hiQ, edge->qrynode->len);
+                (*eli)->dirQ =
+                  (*eli)->dirR == FORWARD_DIR ? REVERSE_DIR : FORWARD_DIR;
+              }
+          }
+      }
+
+    free (lis);
+  }
+}
+
+
+//-------------------------------------------------------------- flagQLIS ------
+//! \brief Flag edgelets in the query LIS and unflag those who are not
+//!
+//! Runs a length*identity weighted LIS to determine the longest, QUERY
+//! consistent set of alignments for all query sequences. This effectively
+//! identifies the "best" alignments for all positions of each query.
+//!
+//! Sets isQLIS flag for good and unsets isGOOD flag for bad.
 //!
 //! \param epsilon Keep repeat alignments within epsilon % of the best align
 //! \param maxolap Only allow alignments to overlap by maxolap percent [0-100]
@@ -870,108 +1429,99 @@ void DeltaGraph_t::flagGLIS (float epsilon)
 //!
 void DeltaGraph_t::flagQLIS (float epsilon, float maxolap, bool flagbad)
 {
-  LIS_t * lis = NULL;
-  long lis_size = 0;
-  long i, j, n;
-  long olap, leni, lenj, score, diff;
-
-  vector<DeltaEdgelet_t *> edgelets;
+  //-- The nodes are independent, process them in parallel
+  const vector<DeltaNode_t *> nodes = NodeList (qrynodes);
+  const vector<int> draws = DrawTieBreaks (nodes, epsilon);
 
-  map<string, DeltaNode_t>::const_iterator mi;
-  vector<DeltaEdge_t *>::const_iterator ei;
-  vector<DeltaEdgelet_t *>::iterator eli;
+#pragma omp parallel num_threads(threads)
+  {
+    LIS_t * lis = NULL;
+    long lis_size = 0;
+    long i, n;
 
+    vector<DeltaEdgelet_t *> edgelets;
 
-  //-- For each query sequence
-  for ( mi = qrynodes.begin(); mi != qrynodes.end(); ++ mi )
-    {
-      //-- Collect all the good edgelets
-      edgelets.clear();
-      for ( ei  = (mi->second).edges.begin();
-            ei != (mi->second).edges.end(); ++ ei )
-        for ( eli  = (*ei)->edgelets.begin();
-              eli != (*ei)->edgelets.end(); ++ eli )
-          if ( (*eli)->isGOOD )
-            edgelets.push_back (*eli);
+    vector<DeltaEdge_t *>::const_iterator ei;
+    vector<DeltaEdgelet_t *>::iterator eli;
 
-      //-- Resize and initialize
-      n = edgelets.size();
-      if ( n > lis_size )
-        {
-          lis = (LIS_t *) Safe_realloc (lis, sizeof (LIS_t) * n);
-          lis_size = n;
-        }
-      for ( i = 0; i < n; ++ i )
-        lis[i].used = false;
 
-      //-- Sort by lo query coord
-      sort (edgelets.begin(), edgelets.end(), EdgeletQCmp_t());
-
-      //-- Continue until all equivalent repeats are extracted
-      vector<long> allbest;
-      do
-        {
-          //-- Dynamic
-          for ( i = 0; i < n; ++ i )
-            {
-              if ( lis[i].used ) continue;
+    //-- For each query sequence
+#pragma omp for schedule(dynamic)
+    for ( long ni = 0; ni < (long)nodes.size(); ++ ni )
+      {
+        DeltaNode_t & node = *nodes[ni];
 
-              lis[i].a = edgelets[i];
+        //-- Collect all the good edgelets
+        edgelets.clear();
+        for ( ei  = node.edges.begin();
+              ei != node.edges.end(); ++ ei )
+          for ( eli  = (*ei)->edgelets.begin();
+                eli != (*ei)->edgelets.end(); ++ eli )
+            if ( (*eli)->isGOOD )
+              edgelets.push_back (*eli);
 
-              leni = lis[i].a->hiQ - lis[i].a->loQ + 1;
-              lis[i].score =
-                ScoreLocal (0, leni, 0, 0, lis[i].a->idy, 0);
+        //-- Resize and initialize
+        n = edgelets.size();
+        if ( n > lis_size )
+          {
+            lis = (LIS_t *) Safe_realloc (lis, sizeof (LIS_t) * n);
+            lis_size = n;
+          }
+        for ( i = 0; i < n; ++ i )
+          lis[i].used = false;
 
-              lis[i].from = -1;
-              lis[i].diff = 0;
+        //-- Sort by lo query coord
+        sort (edgelets.begin(), edgelets.end(), EdgeletQCmp_t());
 
-              for ( j = 0; j < i; ++ j )
-                {
-                  if ( lis[j].used ) continue;
-                  if ( lis[j].from >= 0 &&
-                       lis[lis[j].from].a->hiQ >= lis[i].a->loQ )
-                    continue;
-
-                  leni = lis[i].a->hiQ - lis[i].a->loQ + 1;
-                  lenj = lis[j].a->hiQ - lis[j].a->loQ + 1;
-                  olap = lis[j].a->hiQ - lis[i].a->loQ + 1;
-                  if ( olap < 0 )
-                    olap = 0;
-
-                  diff = lis[j].diff + DiffAligns (lis[i].a, lis[j].a);
-
-                  score = ScoreLocal
-                    (lis[j].score, leni, lenj, olap, lis[i].a->idy, maxolap);
-
-                  if ( score > lis[i].score
-                       ||
-                       (score == lis[i].score && diff < lis[i].diff) )
-                    {
-                      lis[i].from = j;
-                      lis[i].score = score;
-                      lis[i].diff = diff;
-                    }
-                }
-            }
-        } while ( UpdateBest (lis, n, allbest, epsilon) );
+        //-- Score an edgelet alone, and after another one
+        auto alone = [&] (long i)
+          {
+            long leni = lis[i].a->hiQ - lis[i].a->loQ + 1;
+            return ScoreLocal (0, leni, 0, 0, lis[i].a->idy, 0);
+          };
+        auto link = [&] (long i, long j, long & score)
+          {
+            if ( lis[j].from >= 0 &&
+                 lis[lis[j].from].a->hiQ >= lis[i].a->loQ )
+              return false;
+
+            long leni = lis[i].a->hiQ - lis[i].a->loQ + 1;
+            long lenj = lis[j].a->hiQ - lis[j].a->loQ + 1;
+            long olap = lis[j].a->hiQ - lis[i].a->loQ + 1;
+            if ( olap < 0 )
+              olap = 0;
+
+            score = ScoreLocal
+              (lis[j].score, leni, lenj, olap, lis[i].a->idy, maxolap);
+            return true;
+          };
+
+        //-- Continue until all equivalent repeats are extracted
+        vector<long> allbest;
+        do
+          {
+            //-- Dynamic
+            ChainLIS (lis, edgelets, alone, link);
+          } while ( UpdateBest (lis, n, allbest, epsilon) );
 
-      long beg = PickBest (lis, allbest, epsilon);
-      long end = allbest.size();
-      if ( beg == end ) beg = 0;
-      else end = beg + 1;
+        long beg = PickBest (lis, allbest, epsilon, draws[ni]);
+        long end = allbest.size();
+        if ( beg == end ) beg = 0;
+        else end = beg + 1;
 
-      //-- Flag the edgelets
-      for ( ; beg < end; ++ beg )
-        for ( i = allbest[beg]; i >= 0  &&  i < n; i = lis[i].from )
-          lis[i].a->isQLIS = true;
+        //-- Flag the edgelets
+        for ( ; beg < end; ++ beg )
+          for ( i = allbest[beg]; i >= 0  &&  i < n; i = lis[i].from )
+            lis[i].a->isQLIS = true;
 
-      if ( flagbad )
-        for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
-          if ( ! (*eli)->isQLIS )
-            (*eli)->isGOOD = false;
-    }
+        if ( flagbad )
+          for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
+            if ( ! (*eli)->isQLIS )
+              (*eli)->isGOOD = false;
+      }
 
-  free (lis);
+    free (lis);
+  }
 }
 
 
@@ -991,108 +1541,99 @@ void DeltaGraph_t::flagQLIS (float epsilon, float maxolap, bool flagbad)
 //!
 void DeltaGraph_t::flagRLIS (float epsilon, float maxolap, bool flagbad)
 {
-  LIS_t * lis = NULL;
-  long lis_size = 0;
-  long i, j, n;
-  long olap, leni, lenj, score, diff;
-
-  vector<DeltaEdgelet_t *> edgelets;
-
-  map<string, DeltaNode_t>::const_iterator mi;
-  vector<DeltaEdge_t *>::const_iterator ei;
-  vector<DeltaEdgelet_t *>::iterator eli;
+  //-- The nodes are independent, process them in parallel
+  const vector<DeltaNode_t *> nodes = NodeList (refnodes);
+  const vector<int> draws = DrawTieBreaks (nodes, epsilon);
 
+#pragma omp parallel num_threads(threads)
+  {
+    LIS_t * lis = NULL;
+    long lis_size = 0;
+    long i, n;
 
-  //-- For each reference sequence
-  for ( mi = refnodes.begin(); mi != refnodes.end(); ++ mi )
-    {
-      //-- Collect all the good edgelets
-      edgelets.clear();
-      for ( ei  = (mi->second).edges.begin();
-            ei != (mi->second).edges.end(); ++ ei )
-        for ( eli  = (*ei)->edgelets.begin();
-              eli != (*ei)->edgelets.end(); ++ eli )
-          if ( (*eli)->isGOOD )
-            edgelets.push_back (*eli);
+    vector<DeltaEdgelet_t *> edgelets;
 
-      //-- Resize
-      n = edgelets.size();
-      if ( n > lis_size )
-        {
-          lis = (LIS_t *) Safe_realloc (lis, sizeof (LIS_t) * n);
-          lis_size = n;
-        }
-      for ( i = 0; i < n; ++ i )
-        lis[i].used = false;
+    vector<DeltaEdge_t *>::const_iterator ei;
+    vector<DeltaEdgelet_t *>::iterator eli;
 
-      //-- Sort by lo reference coord
-      sort (edgelets.begin(), edgelets.end(), EdgeletRCmp_t());
 
-      //-- Continue until all equivalent repeats are extracted
-      vector<long> allbest;
-      do
-        {
-          //-- Dynamic
-          for ( i = 0; i < n; ++ i )
-            {
-              if ( lis[i].used ) continue;
+    //-- For each reference sequence
+#pragma omp for schedule(dynamic)
+    for ( long ni = 0; ni < (long)nodes.size(); ++ ni )
+      {
+        DeltaNode_t & node = *nodes[ni];
 
-              lis[i].a = edgelets[i];
+        //-- Collect all the good edgelets
+        edgelets.clear();
+        for ( ei  = node.edges.begin();
+              ei != node.edges.end(); ++ ei )
+          for ( eli  = (*ei)->edgelets.begin();
+                eli != (*ei)->edgelets.end(); ++ eli )
+            if ( (*eli)->isGOOD )
+              edgelets.push_back (*eli);
 
-              leni = lis[i].a->hiR - lis[i].a->loR + 1;
-              lis[i].score =
-                ScoreLocal (0, leni, 0, 0, lis[i].a->idy, 0);
+        //-- Resize
+        n = edgelets.size();
+        if ( n > lis_size )
+          {
+            lis = (LIS_t *) Safe_realloc (lis, sizeof (LIS_t) * n);
+            lis_size = n;
+          }
+        for ( i = 0; i < n; ++ i )
+          lis[i].used = false;
 
-              lis[i].from = -1;
-              lis[i].diff = 0;
+        //-- Sort by lo reference coord
+        sort (edgelets.begin(), edgelets.end(), EdgeletRCmp_t());
 
-              for ( j = 0; j < i; ++ j )
-                {
-                  if ( lis[j].used ) continue;
-                  if ( lis[j].from >= 0 &&
-                       lis[lis[j].from].a->hiR >= lis[i].a->loR )
-                    continue;
-
-                  leni = lis[i].a->hiR - lis[i].a->loR + 1;
-                  lenj = lis[j].a->hiR - lis[j].a->loR + 1;
-                  olap = lis[j].a->hiR - lis[i].a->loR + 1;
-                  if ( olap < 0 )
-                    olap = 0;
-
-                  diff = lis[j].diff + DiffAligns (lis[i].a, lis[j].a);
-
-                  score = ScoreLocal
-                    (lis[j].score, leni, lenj, olap, lis[i].a->idy, maxolap);
-
-                  if ( score > lis[i].score
-                       ||
-                       (score == lis[i].score && diff < lis[i].diff) )
-                    {
-                      lis[i].from = j;
-                      lis[i].score = score;
-                      lis[i].diff = diff;
-                    }
-                }
-            }
-        } while ( UpdateBest (lis, n, allbest, epsilon) );
-
-      long beg = PickBest (lis, allbest, epsilon);
-      long end = allbest.size();
-      if ( beg == end ) beg = 0;
-      else end = beg + 1;
+        //-- Score an edgelet alone, and after another one
+        auto alone = [&] (long i)
+          {
+            long leni = lis[i].a->hiR - lis[i].a->loR + 1;
+            return ScoreLocal (0, leni, 0, 0, lis[i].a->idy, 0);
+          };
+        auto link = [&] (long i, long j, long & score)
+          {
+            if ( lis[j].from >= 0 &&
+                 lis[lis[j].from].a->hiR >= lis[i].a->loR )
+              return false;
+
+            long leni = lis[i].a->hiR - lis[i].a->loR + 1;
+            long lenj = lis[j].a->hiR - lis[j].a->loR + 1;
+            long olap = lis[j].a->hiR - lis[i].a->loR + 1;
+            if ( olap < 0 )
+              olap = 0;
+
+            score = ScoreLocal
+              (lis[j].score, leni, lenj, olap, lis[i].a->idy, maxolap);
+            return true;
+          };
+
+        //-- Continue until all equivalent repeats are extracted
+        vector<long> allbest;
+        do
+          {
+            //-- Dynamic
+            ChainLIS (lis, edgelets, alone, link);
+          } while ( UpdateBest (lis, n, allbest, epsilon) );
+
+        long beg = PickBest (lis, allbest, epsilon, draws[ni]);
+        long end = allbest.size();
+        if ( beg == end ) beg = 0;
+        else end = beg + 1;
       
-      //-- Flag the edgelets
-      for ( ; beg < end; ++ beg )
-        for ( i = allbest[beg]; i >= 0  &&  i < n; i = lis[i].from )
-          lis[i].a->isRLIS = true;
+        //-- Flag the edgelets
+        for ( ; beg < end; ++ beg )
+          for ( i = allbest[beg]; i >= 0  &&  i < n; i = lis[i].from )
+            lis[i].a->isRLIS = true;
 
-      if ( flagbad )
-        for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
-          if ( ! (*eli)->isRLIS )
-            (*eli)->isGOOD = false;
-    }
+        if ( flagbad )
+          for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
+            if ( ! (*eli)->isRLIS )
+              (*eli)->isGOOD = false;
+      }
 
-  free (lis);
+    free (lis);
+  }
 }
 
 
@@ -1107,26 +1648,79 @@ void DeltaGraph_t::flagRLIS (float epsilon, float maxolap, bool flagbad)
 //!
 void DeltaGraph_t::flagScore (long minlen, float minidy)
 {
-  map<string, DeltaNode_t>::const_iterator mi;
+  vector<DeltaEdgelet_t *>::iterator eli;
+
+  const vector<DeltaEdge_t *> edges = EdgeList (refnodes);
+#pragma omp parallel for num_threads(threads) private(eli) schedule(dynamic, 64)
+  for ( long ei = 0; ei < (long)edges.size(); ++ ei )
+    for ( eli  = edges[ei]->edgelets.begin();
+          eli != edges[ei]->edgelets.end(); ++ eli )
+      if ( (*eli)->isGOOD )
+        {
+          //-- Flag low identities
+          if ( (*eli)->idy * 100.0 < minidy )
+            (*eli)->isGOOD = false;
+
+          //-- Flag small lengths
+          if ( (*eli)->hiR - (*eli)->loR + 1 < minlen ||
+               (*eli)->hiQ - (*eli)->loQ + 1 < minlen )
+            (*eli)->isGOOD = false;
+        }
+}
+
+
+//---------------------------------------------------------- FlagNodeUNIQ ------
+//-- Flag the edgelets of node less than minuniq percent unique on the
+//   node. cov is a coverage buffer of size cov_size, grown as needed.
+static void FlagNodeUNIQ
+(DeltaNode_t & node, bool isref, float minuniq,
+ unsigned char * & cov, long & cov_size, vector<DeltaEdgelet_t *> & edgelets)
+{
+  long i, uniq, len, lo, hi;
   vector<DeltaEdge_t *>::const_iterator ei;
   vector<DeltaEdgelet_t *>::iterator eli;
 
-  for ( mi = refnodes.begin(); mi != refnodes.end(); ++ mi )
-    for ( ei  = (mi->second).edges.begin();
-          ei != (mi->second).edges.end(); ++ ei )
-      for ( eli  = (*ei)->edgelets.begin();
-            eli != (*ei)->edgelets.end(); ++ eli )
-        if ( (*eli)->isGOOD )
-          {
-            //-- Flag low identities
-            if ( (*eli)->idy * 100.0 < minidy )
-              (*eli)->isGOOD = false;
+  //-- Reset the coverage array
+  if ( node.len > cov_size )
+    {
+      cov = (unsigned char *) Safe_realloc (cov, node.len + 1);
+      cov_size = node.len;
+    }
+  for ( i = 1; i <= node.len; ++ i )
+    cov[i] = 0;
+
+  //-- Collect all the good edgelets
+  edgelets.clear();
+  for ( ei = node.edges.begin(); ei != node.edges.end(); ++ ei )
+    for ( eli  = (*ei)->edgelets.begin();
+          eli != (*ei)->edgelets.end(); ++ eli )
+      if ( (*eli)->isGOOD )
+        {
+          edgelets.push_back (*eli);
+
+          //-- Add to the coverage
+          lo = isref ? (*eli)->loR : (*eli)->loQ;
+          hi = isref ? (*eli)->hiR : (*eli)->hiQ;
+          for ( i = lo; i <= hi; i ++ )
+            if ( cov[i] < UCHAR_MAX )
+              cov[i] ++;
+        }
 
-            //-- Flag small lengths
-            if ( (*eli)->hiR - (*eli)->loR + 1 < minlen ||
-                 (*eli)->hiQ - (*eli)->loQ + 1 < minlen )
-              (*eli)->isGOOD = false;
-          }
+  //-- Calculate the uniqueness of each edgelet
+  for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
+    {
+      lo = isref ? (*eli)->loR : (*eli)->loQ;
+      hi = isref ? (*eli)->hiR : (*eli)->hiQ;
+      uniq = 0;
+      len = hi - lo + 1;
+      for ( i = lo; i <= hi; i ++ )
+        if ( cov[i] == 1 )
+          uniq ++;
+
+      //-- Flag low uniqueness
+      if ( (float)uniq / (float)len * 100.0 < minuniq )
+        (*eli)->isGOOD = false;
+    }
 }
 
 
@@ -1140,23 +1734,675 @@ void DeltaGraph_t::flagScore (long minlen, float minidy)
 //!
 void DeltaGraph_t::flagUNIQ (float minuniq)
 {
-  long i, uniq, len;
+  //-- For each reference sequence, then each query sequence. The nodes
+  //   of one side share no edgelets, so they are processed in parallel.
+  for ( int pass = 0; pass < 2; ++ pass )
+    {
+      const bool isref = pass == 0;
+      const vector<DeltaNode_t *> nodes = NodeList (isref ? refnodes : qrynodes);
+
+#pragma omp parallel num_threads(threads)
+      {
+        vector<DeltaEdgelet_t *> edgelets;
+        unsigned char * cov = NULL;
+        long cov_size = 0;
+
+#pragma omp for schedule(dynamic)
+        for ( long ni = 0; ni < (long)nodes.size(); ++ ni )
+          FlagNodeUNIQ (*nodes[ni], isref, minuniq, cov, cov_size, edgelets);
+
+        free (cov);
+      }
+    }
+}
+
+
+//----------------------------------------------------- LoadNodeSequences ------
+//-- Regions of the nodes to load, as sorted and disjoint 1 based closed
+//   intervals. A node without interval is loaded whole.
+typedef map<const DeltaNode_t *, vector<pair<long, long> > > NodeRegions_t;
+
+//-- Read the sequences of the nodes from a FastA file. kind is
+//   "Reference" or "Query" for the error messages. If regions is given,
+//   only its nodes are loaded and, if the file is indexed, only their
+//   regions: the rest of the sequences is left uninitialized. The
+//   indexed sequences are read with threads threads.
+static void LoadNodeSequences
+(const string & path, map<string, DeltaNode_t> & nodes, const char * kind,
+ unsigned int threads, const NodeRegions_t * regions = NULL)
+{
+  map<string, DeltaNode_t>::iterator mi;
+  bool mismatch = false;
+
+  mummer::fasta_index::indexed_fasta fasta;
+  if ( fasta.open (path) )
+    {
+      //-- Fetch only the sequences of the nodes, in parallel
+      vector<DeltaNode_t *> todo;
+      vector<const mummer::fasta_index::entry *> entries;
+      for ( mi = nodes.begin(); mi != nodes.end(); ++ mi )
+        {
+          if ( regions  &&  regions->find (&mi->second) == regions->end() )
+            continue;
+          const mummer::fasta_index::entry * e = fasta.find (mi->first);
+          if ( e == NULL )
+            continue;
+          if ( (long)e->length != mi->second.len )
+            mismatch = true;
+          todo.push_back (&mi->second);
+          entries.push_back (e);
+        }
+
+      if ( !mismatch )
+        {
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+          for ( long i = 0; i < (long)todo.size(); ++ i )
+            {
+              const long len = todo[i]->len;
+              char * seq = (char *) Safe_malloc (len + 2);
+              seq[0] = '\0';
+              const vector<pair<long, long> > * iv =
+                regions ? &regions->find (todo[i])->second : NULL;
+              if ( iv == NULL  ||  iv->empty() )
+                fasta.fetch (*entries[i], 0, len, seq + 1);
+              else
+                for ( const auto & r : *iv )
+                  fasta.fetch (*entries[i], r.first - 1, r.second - r.first + 1,
+                               seq + r.first);
+              seq[len + 1] = '\0';
+              todo[i]->seq = seq;
+            }
+        }
+    }
+  else
+    {
+      //-- Not a regular file or compressed, read all the sequences
+      mummer::compressed::ifstream file;
+      try
+        {
+          file.open (path);
+        }
+      catch ( const std::runtime_error & e )
+        {
+          cerr << "ERROR: " << e.what () << " '" << path << "'\n";
+          exit (EXIT_FAILURE);
+        }
+      if ( !file.is_open () )
+        {
+          cerr << "ERROR: Could not open " << kind << " file '" << path << "'\n";
+          exit (EXIT_FAILURE);
+        }
+      long initsize = INIT_SIZE;
+      char * S = (char *) Safe_malloc (initsize);
+      char id [MAX_LINE];
+      long len;
+      while ( !mismatch  &&  Read_String (file, S, initsize, id, false) )
+        if ( (mi = nodes.find (id)) != nodes.end()  &&
+             (regions == NULL  ||  regions->find (&mi->second) != regions->end()) )
+          {
+            len = strlen (S + 1);
+            free (mi->second.seq);
+            mi->second.seq = (char *) Safe_malloc (len + 2);
+            mi->second.seq[0] = '\0';
+            strcpy (mi->second.seq + 1, S + 1);
+            if ( len != mi->second.len )
+              mismatch = true;
+          }
+      free (S);
+      if ( file.bad () )
+        {
+          cerr << "ERROR: Could not read " << kind << " file '" << path << "'\n";
+          exit (EXIT_FAILURE);
+        }
+    }
+
+  if ( mismatch )
+    {
+      cerr << "ERROR: " << kind << " input does not match delta file\n";
+      exit (EXIT_FAILURE);
+    }
+}
+
+
+//----------------------------------------------------- loadSequences ----------
+//! \brief Load the sequence information into the DeltaNodes
+//!
+//! \return void
+//!
+void DeltaGraph_t::loadSequences ()
+{
+  map<string, DeltaNode_t>::iterator mi;
+
+  //-- Read in the reference and query sequences
+  LoadNodeSequences (refpath, refnodes, "Reference", threads);
+  LoadNodeSequences (qrypath, qrynodes, "Query", threads);
+
+
+  //-- Check that we found all the sequences
+  for ( mi = refnodes.begin(); mi != refnodes.end(); ++ mi )
+    if ( mi->second.seq == NULL )
+      {
+        cerr << "ERROR: '" << mi->first << "' not found in reference file\n";
+        exit (EXIT_FAILURE);
+      }
+
+  for ( mi = qrynodes.begin(); mi != qrynodes.end(); ++ mi )
+    if ( mi->second.seq == NULL )
+      {
+        cerr << "ERROR: '" << mi->first << "' not found in query file\n";
+        exit (EXIT_FAILURE);
+      }
+}
+
+
+//------------------------------------------------------- SNP helpers --------
+//-- A sequence as seen by the SNP search: 1 based, and reverse
+//   complemented on the fly for the nucmer reverse alignments, so the
+//   sequences are never copied.
+struct SNPSeq_t
+{
+  const char * seq;
+  long len;
+  bool rev;
 
-  vector<DeltaEdgelet_t *> edgelets;
+  char operator[] (long p) const
+  {
+    if ( !rev )
+      return seq[p];
+    return p < 1  ||  p > len ? '\0' : Complement (seq[len - p + 1]);
+  }
+};
+
+//-- Coordinates of an alignment in the direction (and for promer the
+//   translated frame) of the alignment
+struct SNPFrame_t
+{
+  long sR, eR, sQ, eQ;
+  long alenR, alenQ;      //!< length of the sequences in the frame
+  int frameR, frameQ;     //!< frame, negative on the reverse strand
+  int ri, qi;             //!< translated frame index, 1 to 6
+};
 
+static SNPFrame_t EdgeletFrame
+(const DeltaEdgelet_t & l, long lenR, long lenQ, AlignmentType_t datatype)
+{
+  SNPFrame_t f;
+  f.alenR = lenR;
+  f.alenQ = lenQ;
+
+  //-- Point the coords the right direction
+  f.frameR = 1;
+  if ( l.dirR == REVERSE_DIR )
+    {
+      f.sR = RevC (l.hiR, lenR);
+      f.eR = RevC (l.loR, lenR);
+      f.frameR += 3;
+    }
+  else
+    {
+      f.sR = l.loR;
+      f.eR = l.hiR;
+    }
+
+  f.frameQ = 1;
+  if ( l.dirQ == REVERSE_DIR )
+    {
+      f.sQ = RevC (l.hiQ, lenQ);
+      f.eQ = RevC (l.loQ, lenQ);
+      f.frameQ += 3;
+    }
+  else
+    {
+      f.sQ = l.loQ;
+      f.eQ = l.hiQ;
+    }
+
+  //-- Translate coords to AA if necessary
+  if ( datatype == PROMER_DATA )
+    {
+      f.alenR /= 3;
+      f.alenQ /= 3;
+
+      f.frameR += (f.sR + 2) % 3;
+      f.frameQ += (f.sQ + 2) % 3;
+
+      // remeber that eR and eQ point to the last base in the codon
+      f.sR = (f.sR + 2) / 3;
+      f.eR = f.eR / 3;
+      f.sQ = (f.sQ + 2) / 3;
+      f.eQ = f.eQ / 3;
+    }
+
+  f.ri = f.frameR;
+  f.qi = f.frameQ;
+
+  if ( f.frameR > 3 )
+    f.frameR = -(f.frameR - 3);
+  if ( f.frameQ > 3 )
+    f.frameQ = -(f.frameQ - 3);
+
+  return f;
+}
+
+//-- Locate the SNPs of one alignment, sort them and compute their buff
+//   distances. Only touches the edgelet, so alignments are processed in
+//   parallel.
+static void FindEdgeletSNPs
+(DeltaEdgelet_t * l, const SNPFrame_t & f, const SNPSeq_t & R, const SNPSeq_t & Q,
+ long lenR, long lenQ, AlignmentType_t datatype, bool sortbyref, int context)
+{
+  vector<SNP_t *>::iterator si, psi, nsi;
+  SNP_t * snp;
+  long i;
+  long delta;
+  int sign;
+  long rpos, qpos, remain;
+  long rctx, qctx;
+  const int frameR = f.frameR, frameQ = f.frameQ;
+  const long alenR = f.alenR, alenQ = f.alenQ;
+
+  //-- Locate the SNPs
+  rpos = f.sR;
+  qpos = f.sQ;
+  remain = f.eR - f.sR + 1;
+
+  l -> frmR = frameR;
+  l -> frmQ = frameQ;
+
+  istringstream ss;
+  ss . str (l->delta);
+
+  while ( ss >> delta && delta != 0 )
+    {
+      sign = delta > 0 ? 1 : -1;
+      delta = labs (delta);
+
+      //-- For all SNPs before the next indel
+      for ( i = 1; i < delta; i ++ )
+        if ( R [rpos ++] != Q [qpos ++] )
+          {
+            if ( datatype == NUCMER_DATA &&
+                 CompareIUPAC (R [rpos-1], Q [qpos-1]) )
+              continue;
+
+            snp = new SNP_t;
+            snp -> ep = l -> edge;
+            snp -> lp = l;
+            snp -> pR = Norm (rpos-1, lenR, frameR, datatype);
+            snp -> pQ = Norm (qpos-1, lenQ, frameQ, datatype);
+            snp -> cR = toupper (R [rpos-1]);
+            snp -> cQ = toupper (Q [qpos-1]);
+
+            for ( rctx = rpos - context - 1;
+                  rctx < rpos + context; rctx ++ )
+              if ( rctx < 1  ||  rctx > alenR )
+                snp -> ctxR . push_back (SEQEND_CHAR);
+              else if ( rctx == rpos - 1 )
+                snp -> ctxR . push_back (snp -> cR);
+              else
+                snp -> ctxR . push_back (toupper (R [rctx]));
+
+            for ( qctx = qpos - context - 1;
+                  qctx < qpos + context; qctx ++ )
+              if ( qctx < 1  ||  qctx > alenQ )
+                snp -> ctxQ . push_back (SEQEND_CHAR);
+              else if ( qctx == qpos - 1 )
+                snp -> ctxQ . push_back (snp -> cQ);
+              else
+                snp -> ctxQ . push_back (toupper (Q [qctx]));
+
+            l -> snps . push_back (snp);
+          }
+
+      //-- For the indel
+      snp = new SNP_t;
+      snp -> ep = l -> edge;
+      snp -> lp = l;
+
+      for ( rctx = rpos - context; rctx < rpos; rctx ++ )
+        if ( rctx < 1 )
+          snp -> ctxR . push_back (SEQEND_CHAR);
+        else
+          snp -> ctxR . push_back (toupper (R [rctx]));
+
+      for ( qctx = qpos - context; qctx < qpos; qctx ++ )
+        if ( qctx < 1 )
+          snp -> ctxQ . push_back (SEQEND_CHAR);
+        else
+          snp -> ctxQ . push_back (toupper (Q [qctx]));
+
+      if ( sign > 0 )
+        {
+          snp -> pR = Norm (rpos, lenR, frameR, datatype);
+          if ( frameQ > 0 )
+            snp -> pQ = Norm (qpos - 1, lenQ, frameQ, datatype);
+          else
+            snp -> pQ = Norm (qpos, lenQ, frameQ, datatype);
+
+          snp -> cR = toupper (R [rpos ++]);
+          snp -> cQ = INDEL_CHAR;
+
+          remain -= i;
+          rctx ++;
+        }
+      else
+        {
+          snp -> pQ = Norm (qpos, lenQ, frameQ, datatype);
+          if ( frameR > 0 )
+            snp -> pR = Norm (rpos - 1, lenR, frameR, datatype);
+          else
+            snp -> pR = Norm (rpos, lenR, frameR, datatype);
+
+          snp -> cR = INDEL_CHAR;
+          snp -> cQ = toupper (Q [qpos ++]);
+
+          remain -= i - 1;
+          qctx ++;
+        }
+
+      snp -> ctxR . push_back (snp -> cR);
+      for ( ; rctx < rpos + context; rctx ++ )
+        if ( rctx > alenR )
+          snp -> ctxR . push_back (SEQEND_CHAR);
+        else
+          snp -> ctxR . push_back (toupper (R [rctx]));
+
+      snp -> ctxQ . push_back (snp -> cQ);
+      for ( ; qctx < qpos + context; qctx ++ )
+        if ( qctx > alenQ )
+          snp -> ctxQ . push_back (SEQEND_CHAR);
+        else
+          snp -> ctxQ . push_back (toupper (Q [qctx]));
+
+      l -> snps . push_back (snp);
+    }
+
+  //-- For all SNPs after the final indel
+  for ( i = 0; i < remain; i ++ )
+    if ( R [rpos ++] != Q [qpos ++] )
+      {
+        if ( datatype == NUCMER_DATA &&
+             CompareIUPAC (R [rpos-1], Q [qpos-1]) )
+          continue;
+
+        snp = new SNP_t;
+        snp -> ep = l -> edge;
+        snp -> lp = l;
+        snp -> pR = Norm (rpos-1, lenR, frameR, datatype);
+        snp -> pQ = Norm (qpos-1, lenQ, frameQ, datatype);
+        snp -> cR = toupper (R [rpos-1]);
+        snp -> cQ = toupper (Q [qpos-1]);
+
+        for ( rctx = rpos - context - 1;
+              rctx < rpos + context; rctx ++ )
+          if ( rctx < 1  ||  rctx > alenR )
+            snp -> ctxR . push_back (SEQEND_CHAR);
+          else if ( rctx == rpos - 1 )
+            snp -> ctxR . push_back (snp -> cR);
+          else
+            snp -> ctxR . push_back (toupper (R [rctx]));
+
+        for ( qctx = qpos - context - 1;
+              qctx < qpos + context; qctx ++ )
+          if ( qctx < 1  ||  qctx > alenQ )
+            snp -> ctxQ . push_back (SEQEND_CHAR);
+          else if ( qctx == qpos - 1 )
+            snp -> ctxQ . push_back (snp -> cQ);
+          else
+            snp -> ctxQ . push_back (toupper (Q [qctx]));
+
+        l -> snps . push_back (snp);
+      }
+
+
+  //-- Sort SNPs and calculate distances
+  if ( sortbyref )
+    {
+      sort (l->snps.begin( ), l->snps.end( ), SNP_R_Sort( ));
+
+      for ( si = l->snps.begin(); si != l->snps.end(); ++ si )
+        {
+          psi = si - 1;
+          nsi = si + 1;
+
+          (*si) -> buff = 1 +
+            ((*si)->pR - l->loR < l->hiR - (*si)->pR ?
+             (*si)->pR - l->loR : l->hiR - (*si)->pR);
+
+          if ( psi >= l -> snps . begin( )  &&
+               (*si)->pR - (*psi)->pR < (*si)->buff )
+            (*si) -> buff = (*si)->pR - (*psi)->pR;
+
+          if ( nsi < l -> snps . end( )  &&
+               (*nsi)->pR - (*si)->pR < (*si)->buff )
+            (*si) -> buff = (*nsi)->pR - (*si)->pR;
+        }
+    }
+  else
+    {
+      sort (l->snps.begin( ), l->snps.end( ), SNP_Q_Sort( ));
+
+      for ( si = l->snps.begin(); si != l->snps.end(); ++ si )
+        {
+          psi = si - 1;
+          nsi = si + 1;
+
+          (*si) -> buff = 1 +
+            ((*si)->pQ - l->loQ < l->hiQ - (*si)->pQ ?
+             (*si)->pQ - l->loQ : l->hiQ - (*si)->pQ);
+
+          if ( psi >= l -> snps . begin( )  &&
+               (*si)->pQ - (*psi)->pQ < (*si)->buff )
+            (*si) -> buff = (*si)->pQ - (*psi)->pQ;
+
+          if ( nsi < l -> snps . end( )  &&
+               (*nsi)->pQ - (*si)->pQ < (*si)->buff )
+            (*si) -> buff = (*nsi)->pQ - (*si)->pQ;
+        }
+    }
+}
+
+//-- Add the interval [lo, hi] of node, clipped to the node, to the regions
+static void AddRegion (NodeRegions_t & regions, const DeltaNode_t * node, long lo, long hi)
+{
+  regions[node].push_back (make_pair (max (1L, lo), min (node->len, hi)));
+}
+
+//-- Sort and merge the intervals of the regions
+static void MergeRegions (NodeRegions_t & regions)
+{
+  NodeRegions_t::iterator ri;
+  for ( ri = regions.begin(); ri != regions.end(); ++ ri )
+    {
+      vector<pair<long, long> > & iv = ri->second;
+      sort (iv.begin(), iv.end());
+      size_t n = 0;
+      for ( size_t i = 0; i < iv.size(); ++ i )
+        if ( n > 0  &&  iv[i].first <= iv[n - 1].second + 1 )
+          iv[n - 1].second = max (iv[n - 1].second, iv[i].second);
+        else
+          iv[n ++] = iv[i];
+      iv.resize (n);
+    }
+}
+
+
+//---------------------------------------------------------- findSNPs ----------
+//! \brief Locate the SNPs and indels of the good alignments
+//!
+//! Populates edgelet->snps and edgelet->frmR/frmQ. The sequences not
+//! loaded yet are read for the alignments processed: for nucmer data
+//! from an indexed FastA file, only the regions covered by the
+//! alignments. The alignments are processed in parallel, each
+//! collecting its own SNPs, so the result does not depend on the number
+//! of threads.
+//!
+//! \param sortbyref Sort the SNPs of an alignment by reference position,
+//! otherwise by query position. The buff distances are computed on the
+//! sorted sequence
+//! \param context Number of characters of context to save around the SNPs
+//! \param select Only process the alignments for which select returns
+//! true. It is called sequentially, in the order of the graph
+//! \return void
+//!
+void DeltaGraph_t::findSNPs
+(bool sortbyref, int context,
+ const function<bool (const DeltaEdgelet_t &)> & select)
+{
+  map<string, DeltaNode_t>::iterator mi;
+  vector<DeltaEdge_t *>::iterator ei;
+  vector<DeltaEdgelet_t *>::iterator li;
+
+  //-- The alignments requested, grouped by edge
+  vector<DeltaEdge_t *> edges;
+  vector<vector<DeltaEdgelet_t *> > work;
+  for ( mi = refnodes.begin( ); mi != refnodes.end( ); ++ mi )
+    for ( ei = mi->second.edges.begin( ); ei != mi->second.edges.end( ); ++ ei )
+      {
+        vector<DeltaEdgelet_t *> aligns;
+        for (li = (*ei)->edgelets.begin( ); li != (*ei)->edgelets.end( ); ++ li)
+          if ( (*li) -> isGOOD  &&  (!select || select (**li)) )
+            aligns . push_back (*li);
+        if ( aligns . empty( ) )
+          continue;
+        edges . push_back (*ei);
+        work . push_back (aligns);
+      }
+
+  //-- Load the missing sequences. Promer translates whole sequences
+  const bool whole = datatype == PROMER_DATA;
+  const long margin = context + 1;
+  NodeRegions_t refregions, qryregions;
+  for ( size_t e = 0; e < edges . size( ); ++ e )
+    {
+      const DeltaNode_t * refnode = edges[e] -> refnode;
+      const DeltaNode_t * qrynode = edges[e] -> qrynode;
+      for ( li = work[e].begin( ); li != work[e].end( ); ++ li )
+        {
+          if ( refnode -> seq == NULL )
+            {
+              if ( whole )
+                refregions[refnode];
+              else
+                AddRegion (refregions, refnode, (*li)->loR - margin, (*li)->hiR + margin);
+            }
+          if ( qrynode -> seq == NULL )
+            {
+              if ( whole )
+                qryregions[qrynode];
+              else
+                AddRegion (qryregions, qrynode, (*li)->loQ - margin, (*li)->hiQ + margin);
+            }
+        }
+    }
+  MergeRegions (refregions);
+  MergeRegions (qryregions);
+  if ( !refregions . empty( ) )
+    LoadNodeSequences (refpath, refnodes, "Reference", threads, &refregions);
+  if ( !qryregions . empty( ) )
+    LoadNodeSequences (qrypath, qrynodes, "Query", threads, &qryregions);
+  for ( size_t e = 0; e < edges . size( ); ++ e )
+    {
+      if ( edges[e] -> refnode -> seq == NULL )
+        {
+          cerr << "ERROR: '" << *edges[e]->refnode->id << "' not found in reference file\n";
+          exit (EXIT_FAILURE);
+        }
+      if ( edges[e] -> qrynode -> seq == NULL )
+        {
+          cerr << "ERROR: '" << *edges[e]->qrynode->id << "' not found in query file\n";
+          exit (EXIT_FAILURE);
+        }
+    }
+
+  if ( datatype == PROMER_DATA )
+    {
+      //-- By edge, sharing the translated frames of the sequences
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+      for ( long e = 0; e < (long)edges . size( ); ++ e )
+        {
+          const long lenR = edges[e] -> refnode -> len;
+          const long lenQ = edges[e] -> qrynode -> len;
+          char * R[] = {edges[e]->refnode->seq, NULL, NULL, NULL, NULL, NULL, NULL};
+          char * Q[] = {edges[e]->qrynode->seq, NULL, NULL, NULL, NULL, NULL, NULL};
+
+          for ( size_t i = 0; i < work[e] . size( ); ++ i )
+            {
+              const SNPFrame_t f = EdgeletFrame (*work[e][i], lenR, lenQ, datatype);
+
+              //-- Generate the sequences if needed
+              if ( R [f.ri] == NULL )
+                {
+                  R [f.ri] = (char *) Safe_malloc (f.alenR + 2);
+                  R [f.ri][0] = '\0';
+                  Translate_DNA (R [0], R [f.ri], f.ri);
+                }
+              if ( Q [f.qi] == NULL )
+                {
+                  Q [f.qi] = (char *) Safe_malloc (f.alenQ + 2);
+                  Q [f.qi][0] = '\0';
+                  Translate_DNA (Q [0], Q [f.qi], f.qi);
+                }
+
+              const SNPSeq_t SR = { R [f.ri], f.alenR, false };
+              const SNPSeq_t SQ = { Q [f.qi], f.alenQ, false };
+              FindEdgeletSNPs (work[e][i], f, SR, SQ, lenR, lenQ, datatype, sortbyref, context);
+            }
+
+          //-- Clear up the seq
+          for ( int i = 1; i <= 6; i ++ )
+            {
+              free (R[i]);
+              free (Q[i]);
+            }
+        }
+    }
+  else
+    {
+      //-- By alignment
+      vector<DeltaEdgelet_t *> aligns;
+      for ( size_t e = 0; e < work . size( ); ++ e )
+        aligns . insert (aligns . end( ), work[e] . begin( ), work[e] . end( ));
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 16)
+      for ( long i = 0; i < (long)aligns . size( ); ++ i )
+        {
+          DeltaEdgelet_t * l = aligns[i];
+          const DeltaNode_t * refnode = l -> edge -> refnode;
+          const DeltaNode_t * qrynode = l -> edge -> qrynode;
+          const SNPFrame_t f = EdgeletFrame (*l, refnode->len, qrynode->len, datatype);
+          const SNPSeq_t SR = { refnode->seq, refnode->len, l->dirR == REVERSE_DIR };
+          const SNPSeq_t SQ = { qrynode->seq, qrynode->len, l->dirQ == REVERSE_DIR };
+          FindEdgeletSNPs (l, f, SR, SQ, refnode->len, qrynode->len, datatype, sortbyref, context);
+        }
+    }
+}
+
+
+//--------------------------------------------------------- checkSNPs ----------
+//! \brief Count the good alignments overlapping each SNP
+//!
+//! Sets snp->conR and snp->conQ to the number of other good alignments
+//! covering the SNP position in the reference and query.
+//!
+//! \return void
+//!
+void DeltaGraph_t::checkSNPs ()
+{
   map<string, DeltaNode_t>::const_iterator mi;
   vector<DeltaEdge_t *>::const_iterator ei;
   vector<DeltaEdgelet_t *>::iterator eli;
-
+  vector<SNP_t *>::iterator si;
+  long i;
 
   //-- For each reference sequence
   long ref_size = 0;
   long ref_len = 0;
   unsigned char * ref_cov = NULL;
-  for ( mi = refnodes.begin(); mi != refnodes.end(); ++ mi )
+  for ( mi = refnodes.begin( ); mi != refnodes.end( ); ++ mi )
     {
       //-- Reset the reference coverage array
-      ref_len = (mi->second).len;
+      ref_len = (mi -> second) . len;
       if ( ref_len > ref_size )
         {
           ref_cov = (unsigned char *) Safe_realloc (ref_cov, ref_len + 1);
@@ -1165,35 +2411,23 @@ void DeltaGraph_t::flagUNIQ (float minuniq)
       for ( i = 1; i <= ref_len; ++ i )
         ref_cov[i] = 0;
 
-      //-- Collect all the good edgelets
-      edgelets.clear();
-      for ( ei  = (mi->second).edges.begin();
-            ei != (mi->second).edges.end(); ++ ei )
-        for ( eli  = (*ei)->edgelets.begin();
-              eli != (*ei)->edgelets.end(); ++ eli )
-          if ( (*eli)->isGOOD )
-            {
-              edgelets.push_back (*eli);
-
-              //-- Add to the reference coverage
-              for ( i = (*eli)->loR; i <= (*eli)->hiR; i ++ )
-                if ( ref_cov[i] < UCHAR_MAX )
-                  ref_cov[i] ++;
-            }
-
-      //-- Calculate the uniqueness of each edgelet
-      for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
-        {
-          uniq = 0;
-          len = (*eli)->hiR - (*eli)->loR + 1;
-          for ( i = (*eli)->loR; i <= (*eli)->hiR; i ++ )
-            if ( ref_cov[i] == 1 )
-              uniq ++;
-
-          //-- Flag low reference uniqueness
-          if ( (float)uniq / (float)len * 100.0 < minuniq )
-            (*eli)->isGOOD = false;
-        }
+      //-- Add to the reference coverage
+      for ( ei  = (mi -> second) . edges . begin( );
+            ei != (mi -> second) . edges . end( ); ++ ei )
+        for ( eli  = (*ei) -> edgelets . begin( );
+              eli != (*ei) -> edgelets . end( ); ++ eli )
+          if ( (*eli) -> isGOOD )
+            for ( i = (*eli) -> loR; i <= (*eli) -> hiR; i ++ )
+              if ( ref_cov [i] < UCHAR_MAX )
+                ref_cov [i] ++;
+
+      //-- Set the SNP conflict counter
+      for ( ei  = (mi -> second) . edges . begin( );
+            ei != (mi -> second) . edges . end( ); ++ ei )
+        for ( eli  = (*ei) -> edgelets . begin( );
+              eli != (*ei) -> edgelets . end( ); ++ eli )
+          for ( si = (*eli)->snps.begin( ); si != (*eli)->snps.end( ); ++ si )
+            (*si) -> conR = ref_cov [(*si)->pR] - 1;
     }
   free (ref_cov);
 
@@ -1202,10 +2436,10 @@ void DeltaGraph_t::flagUNIQ (float minuniq)
   long qry_size = 0;
   long qry_len = 0;
   unsigned char * qry_cov = NULL;
-  for ( mi = qrynodes.begin(); mi != qrynodes.end(); ++ mi )
+  for ( mi = qrynodes.begin( ); mi != qrynodes.end( ); ++ mi )
     {
       //-- Reset the query coverage array
-      qry_len = (mi->second).len;
+      qry_len = (mi -> second) . len;
       if ( qry_len > qry_size )
         {
           qry_cov = (unsigned char *) Safe_realloc (qry_cov, qry_len + 1);
@@ -1214,110 +2448,321 @@ void DeltaGraph_t::flagUNIQ (float minuniq)
       for ( i = 1; i <= qry_len; ++ i )
         qry_cov[i] = 0;
 
-      //-- Collect all the good edgelets
-      edgelets.clear();
-      for ( ei  = (mi->second).edges.begin();
-            ei != (mi->second).edges.end(); ++ ei )
-        for ( eli  = (*ei)->edgelets.begin();
-              eli != (*ei)->edgelets.end(); ++ eli )
-          if ( (*eli)->isGOOD )
-            {
-              edgelets.push_back (*eli);
-
-              //-- Add to the query coverage
-              for ( i = (*eli)->loQ; i <= (*eli)->hiQ; i ++ )
-                if ( qry_cov[i] < UCHAR_MAX )
-                  qry_cov[i] ++;
-            }
-
-      //-- Calculate the uniqueness of each edgelet
-      for ( eli = edgelets.begin(); eli != edgelets.end(); ++ eli )
-        {
-          uniq = 0;
-          len = (*eli)->hiQ - (*eli)->loQ + 1;
-          for ( i = (*eli)->loQ; i <= (*eli)->hiQ; i ++ )
-            if ( qry_cov[i] == 1 )
-              uniq ++;
-          
-          //-- Flag low query uniqueness
-          if ( (float)uniq / (float)len * 100.0 < minuniq )
-            (*eli)->isGOOD = false;
-        }
+      //-- Add to the query coverage
+      for ( ei  = (mi -> second) . edges . begin( );
+            ei != (mi -> second) . edges . end( ); ++ ei )
+        for ( eli  = (*ei) -> edgelets . begin( );
+              eli != (*ei) -> edgelets . end( ); ++ eli )
+          if ( (*eli) -> isGOOD )
+            for ( i = (*eli) -> loQ; i <= (*eli) -> hiQ; i ++ )
+              if ( qry_cov [i] < UCHAR_MAX )
+                qry_cov [i] ++;
+
+      //-- Set the SNP conflict counter
+      for ( ei  = (mi -> second) . edges . begin( );
+            ei != (mi -> second) . edges . end( ); ++ ei )
+        for ( eli  = (*ei) -> edgelets . begin( );
+              eli != (*ei) -> edgelets . end( ); ++ eli )
+          for ( si = (*eli)->snps.begin( ); si != (*eli)->snps.end( ); ++ si )
+            (*si) -> conQ = qry_cov [(*si)->pQ] - 1;
     }
   free (qry_cov);
 }
 
 
-//----------------------------------------------------- loadSequences ----------
-//! \brief Load the sequence information into the DeltaNodes
+//------------------------------------------------------- Diff comparators ----
+//-- Orderings of the alignments of a sequence, for findDiffs. They are
+//   used with stable_sort and compare the sequence IDs, so ties come
+//   out in the same order whatever the graph was built from.
+struct EdgeletLoQCmp_t
+//!< Sorts query by lo coord, lo to hi
+{
+  bool operator()(const DeltaEdgelet_t * i, const DeltaEdgelet_t * j) const
+  { return ( i->loQ < j->loQ ); }
+};
+
+struct EdgeletIdQLoQCmp_t
+//!< Sorts query by ID and lo coord, lo to hi
+{
+  bool operator()(const DeltaEdgelet_t * i, const DeltaEdgelet_t * j) const
+  {
+    if ( i->edge && j->edge )
+      {
+        int c = i->edge->qrynode->id->compare (*(j->edge->qrynode->id));
+        if ( c < 0 )
+          return true;
+        else if ( c > 0 )
+          return false;
+      }
+    else if ( !i->edge && j->edge )
+      return true;
+    else if ( i->edge && !j->edge )
+      return false;
+    return ( i->loQ < j->loQ );
+  }
+};
+
+struct EdgeletLoRCmp_t
+//!< Sorts reference by lo coord, lo to hi
+{
+  bool operator()(const DeltaEdgelet_t * i, const DeltaEdgelet_t * j) const
+  { return ( i->loR < j->loR ); }
+};
+
+struct EdgeletIdRLoRCmp_t
+//!< Sorts reference by ID and lo coord, lo to hi
+{
+  bool operator()(const DeltaEdgelet_t * i, const DeltaEdgelet_t * j) const
+  {
+    if ( i->edge && j->edge )
+      {
+        int c = i->edge->refnode->id->compare (*(j->edge->refnode->id));
+        if ( c < 0 )
+          return true;
+        else if ( c > 0 )
+          return false;
+      }
+    else if ( !i->edge && j->edge )
+      return true;
+    else if ( i->edge && !j->edge )
+      return false;
+    return ( i->loR < j->loR );
+  }
+};
+
+
+//------------------------------------------------------------ findDiffs -------
+//! \brief Classify the breakpoints between the alignments of each sequence
+//!
+//! Walks the RLIS (ref) or QLIS (!ref) alignments of every reference or
+//! query sequence, low to high, and reports the breakpoints between
+//! them. Expects a graph flagged by flagMtoM, only the good edgelets
+//! are considered. Overrides the stpc value of the edgelets with their
+//! rank in the other sequence. Empty DIFF_BRK breakpoints are not
+//! reported.
 //!
+//! \param ref Walk the reference sequences, otherwise the query sequences
+//! \param report Called with the sequence and each of its breakpoints
 //! \return void
 //!
-void DeltaGraph_t::loadSequences ()
+void DeltaGraph_t::findDiffs
+(bool ref,
+ const function<void (const DeltaNode_t &, const DeltaDiff_t &)> & report)
 {
-  map<string, DeltaNode_t>::iterator mi;
+  long i,j;
+  long nAligns, gapR, gapQ;
+  DeltaEdgelet_t lpad, rpad;          // padding for the alignment vector
+  lpad.isRLIS = rpad.isRLIS = true;
+  lpad.isQLIS = rpad.isQLIS = true;
+  lpad.loR = lpad.hiR = lpad.loQ = lpad.hiQ = 0;
 
-  FILE * qryfile, * reffile;
-  char * R = NULL;
-  char * Q = NULL;
-  char id [MAX_LINE];
-  long initsize;
-  long len;
+  DeltaEdgelet_t *A, *PA, *PGA;       // alignment, prev, prev global
+  vector<DeltaEdgelet_t *> aligns;
 
-  //-- Read in the reference sequences
-  reffile = File_Open (refpath.c_str(), "r");
-  initsize = INIT_SIZE;
-  R = (char *) Safe_malloc (initsize);
-  while ( Read_String (reffile, R, initsize, id, false) )
-    if ( (mi = refnodes.find (id)) != refnodes.end() )
+  map<string, DeltaNode_t>::const_iterator mi;
+  vector<DeltaEdge_t *>::const_iterator ei;
+  vector<DeltaEdgelet_t *>::iterator eli;
+
+  DeltaDiff_t diff;
+  auto emit = [&] (const DeltaNode_t & node, DiffType_t type, long s, long e)
+    {
+      if ( type == DIFF_BRK  &&  e-s+1 <= 0 )
+        return;
+      diff.type = type;
+      diff.s = s;
+      diff.e = e;
+      report (node, diff);
+    };
+
+  //-- For each reference sequence
+  if ( ref )
+    for ( mi = refnodes.begin(); mi != refnodes.end(); ++ mi )
       {
-        len = strlen (R + 1);
-        mi->second.seq = (char *) Safe_malloc (len + 2);
-        mi->second.seq[0] = '\0';
-        strcpy (mi->second.seq + 1, R + 1);
-        if ( len != mi->second.len )
+        const DeltaNode_t & node = mi->second;
+
+        //-- Collect all alignments for this reference sequence
+        aligns.clear();
+        for ( ei  = node.edges.begin();
+              ei != node.edges.end(); ++ei )
+          for ( eli  = (*ei)->edgelets.begin();
+                eli != (*ei)->edgelets.end(); ++eli )
+            if ( (*eli)->isGOOD )
+              aligns.push_back(*eli);
+        if ( aligns.empty() )
+          continue;
+
+        //-- Pad the front and back of the alignment vector
+        rpad.loR = rpad.hiR = node.len + 1;
+        rpad.loQ = rpad.hiQ = LONG_MAX;
+        aligns.push_back(&lpad);
+        aligns.push_back(&rpad);
+
+        nAligns = aligns.size();
+
+        //-- OVERRIDE *stpc* value with loQ QLIS ordering
+        stable_sort(aligns.begin(), aligns.end(), EdgeletIdQLoQCmp_t());
+        for ( i = 0, j = 0; i != nAligns; ++i )
+          aligns[i]->stpc = aligns[i]->isQLIS ? j++ : -1;
+
+        //-- Sort by reference order
+        stable_sort(aligns.begin(), aligns.end(), EdgeletLoRCmp_t());
+        assert ( aligns[0] == &lpad && aligns[nAligns-1] == &rpad );
+
+        //-- Walk reference cover alignments, low to high
+        PA = PGA = aligns[0];
+        for ( i = 1; i != nAligns; ++i )
           {
-            cerr << "ERROR: Reference input does not match delta file\n";
-            exit (EXIT_FAILURE);
+            //-- Only interested in reference covering alignments
+            if ( !aligns[i]->isRLIS ) continue;
+
+            A = aligns[i];
+            gapR = A->loR - PA->hiR - 1;
+
+            //-- Reached end of alignments
+            if ( A->edge == NULL )
+              {
+                emit(node, DIFF_BRK, PA->hiR+1, A->loR-1);
+              }
+            //-- 1-to-1 alignment
+            else if ( A->isQLIS && A->edge == PGA->edge )
+              {
+                //-- Jump within Q
+                if ( A->slope() != PGA->slope() ||
+                     A->stpc != PGA->stpc + PGA->slope() )
+                  {
+                    if ( A->slope() == PGA->slope() )
+                      emit(node, DIFF_JMP, PA->hiR+1, A->loR-1);
+                    else
+                      emit(node, DIFF_INV, PA->hiR+1, A->loR-1);
+                  }
+                //-- Lined up, nothing in between
+                else if ( PA == PGA )
+                  {
+                    gapQ = A->isPositive() ?
+                      A->loQ - PGA->hiQ - 1 :
+                      PGA->loQ - A->hiQ - 1;
+                    diff.gap1 = gapR;
+                    diff.gap2 = gapQ;
+                    emit(node, DIFF_GAP, PA->hiR+1, A->loR-1);
+                  }
+                //-- Lined up, duplication in between
+                else
+                  {
+                    emit(node, DIFF_BRK, PA->hiR+1, A->loR-1);
+                  }
+              }
+            //-- Not in QLIS? Must be a duplication in R
+            else if ( !A->isQLIS )
+              {
+                emit(node, DIFF_BRK, PA->hiR+1, A->loR-1);
+                emit(node, DIFF_DUP, A->loR, A->hiR);
+              }
+            //-- A->edge != PGA->edge? Jump to different query sequence
+            else if ( PGA->edge != NULL )
+              {
+                diff.prev = PGA->edge->qrynode->id;
+                diff.next = A->edge->qrynode->id;
+                emit(node, DIFF_SEQ, PA->hiR+1, A->loR-1);
+              }
+            //-- Gap before first alignment
+            else
+              {
+                emit(node, DIFF_BRK, PA->hiR+1, A->loR-1);
+              }
+
+            if ( A->isQLIS )
+              PGA = A;
+            PA = A;
           }
       }
-  fclose (reffile);
-  free (R);
-
-  //-- Read in the query sequences
-  qryfile = File_Open (qrypath.c_str(), "r");
-  initsize = INIT_SIZE;
-  Q = (char *) Safe_malloc (initsize);
-  while ( Read_String (qryfile, Q, initsize, id, false) )
-    if ( (mi = qrynodes.find (id)) != qrynodes.end() )
+
+
+  //---------- WARNING! Same code as above but Q's for R's and R's for Q's
+  if ( !ref )
+    for ( mi = qrynodes.begin(); mi != qrynodes.end(); ++ mi )
       {
-        len = strlen (Q + 1);
-        mi->second.seq = (char *) Safe_malloc (len + 2);
-        mi->second.seq[0] = '\0';
-        strcpy (mi->second.seq + 1, Q + 1);
-        if ( len != mi->second.len )
+        const DeltaNode_t & node = mi->second;
+
+        aligns.clear();
+        for ( ei  = node.edges.begin();
+              ei != node.edges.end(); ++ei )
+          for ( eli  = (*ei)->edgelets.begin();
+                eli != (*ei)->edgelets.end(); ++eli )
+            if ( (*eli)->isGOOD )
+              aligns.push_back(*eli);
+        if ( aligns.empty() )
+          continue;
+
+        rpad.loQ = rpad.hiQ = node.len + 1;
+        rpad.loR = rpad.hiR = LONG_MAX;
+        aligns.push_back(&lpad);
+        aligns.push_back(&rpad);
+
+        nAligns = aligns.size();
+
+        stable_sort(aligns.begin(), aligns.end(), EdgeletIdRLoRCmp_t());
+        for ( i = 0, j = 0; i != nAligns; ++i )
+          aligns[i]->stpc = aligns[i]->isRLIS ? j++ : -1;
+
+        stable_sort(aligns.begin(), aligns.end(), EdgeletLoQCmp_t());
+        assert ( aligns[0] == &lpad && aligns[nAligns-1] == &rpad );
+
+        PA = PGA = aligns[0];
+        for ( i = 1; i != nAligns; ++i )
           {
-            cerr << "ERROR: Query input does not match delta file\n";
-            exit (EXIT_FAILURE);
-          }
-      }
-  fclose (qryfile);
-  free (Q);
+            if ( !aligns[i]->isQLIS ) continue;
 
+            A = aligns[i];
+            gapQ = A->loQ - PA->hiQ - 1;
 
-  //-- Check that we found all the sequences
-  for ( mi = refnodes.begin(); mi != refnodes.end(); ++ mi )
-    if ( mi->second.seq == NULL )
-      {
-        cerr << "ERROR: '" << mi->first << "' not found in reference file\n";
-        exit (EXIT_FAILURE);
-      }
+            if ( A->edge == NULL )
+              {
+                emit(node, DIFF_BRK, PA->hiQ+1, A->loQ-1);
+              }
+            else if ( A->isRLIS && A->edge == PGA->edge )
+              {
+                if ( A->slope() != PGA->slope() ||
+                     A->stpc != PGA->stpc + PGA->slope() )
+                  {
+                    if ( A->slope() == PGA->slope() )
+                      emit(node, DIFF_JMP, PA->hiQ+1, A->loQ-1);
+                    else
+                      emit(node, DIFF_INV, PA->hiQ+1, A->loQ-1);
+                  }
+                else if ( PA == PGA )
+                  {
+                    gapR = A->isPositive() ?
+                      A->loR - PGA->hiR - 1 :
+                      PGA->loR - A->hiR - 1;
+                    diff.gap1 = gapQ;
+                    diff.gap2 = gapR;
+                    emit(node, DIFF_GAP, PA->hiQ+1, A->loQ-1);
+                  }
+                else
+                  {
+                    emit(node, DIFF_BRK, PA->hiQ+1, A->loQ-1);
+                  }
+              }
+            else if ( !A->isRLIS )
+              {
+                emit(node, DIFF_BRK, PA->hiQ+1, A->loQ-1);
+                emit(node, DIFF_DUP, A->loQ, A->hiQ);
+              }
+            else if ( PGA->edge != NULL )
+              {
+                diff.prev = PA->edge->refnode->id;
+                diff.next = A->edge->refnode->id;
+                emit(node, DIFF_SEQ, PA->hiQ+1, A->loQ-1);
+              }
+            else
+              {
+                emit(node, DIFF_BRK, PA->hiQ+1, A->loQ-1);
+              }
 
-  for ( mi = qrynodes.begin(); mi != qrynodes.end(); ++ mi )
-    if ( mi->second.seq == NULL )
-      {
-        cerr << "ERROR: '" << mi->first << "' not found in query file\n";
-        exit (EXIT_FAILURE);
+            if ( A->isRLIS )
+              PGA = A;
+            PA = A;
+          }
       }
 }
 
@@ -1338,7 +2783,7 @@ ostream & DeltaGraph_t::outputDelta (ostream & out)
   vector<DeltaEdgelet_t *>::const_iterator eli;
  
   //-- Print the file header
-  cout
+  out
     << refpath << ' ' << qrypath << '\n'
     << (datatype == PROMER_DATA ? PROMER_STRING : NUCMER_STRING) << '\n';
  
@@ -1358,7 +2803,7 @@ ostream & DeltaGraph_t::outputDelta (ostream & out)
               //-- Print the sequence header
               if ( ! header )
                 {
-                  cout
+                  out
                     << '>'
                     << *((*ei)->refnode->id) << ' '
                     << *((*ei)->qrynode->id) << ' '
@@ -1376,7 +2821,7 @@ ostream & DeltaGraph_t::outputDelta (ostream & out)
               if ( (*eli)->dirQ == REVERSE_DIR )
                 Swap (s2, e2);
 
-              cout
+              out
                 << s1 << ' ' << e1 << ' ' << s2 << ' ' << e2 << ' '
                 << (*eli)->idyc << ' '
                 << (*eli)->simc << ' '
@@ -0,0 +1,196 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Source for the binary delta files functions of delta_binary.hh
+//!
+//! \see delta_binary.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#include <mummer/delta_binary.hh>
+#include <fstream>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace mummer {
+namespace delta_binary {
+
+bool read_varint(std::istream& is, uint64_t& x) {
+  x = 0;
+  for(int shift = 0; shift < 64; shift += 7) {
+    const int c = is.get();
+    if(c == EOF) return false;
+    x |= (uint64_t)(c & 0x7f) << shift;
+    if(!(c & 0x80)) return true;
+  }
+  return false;
+}
+
+bool read_string(std::istream& is, std::string& s) {
+  uint64_t len;
+  if(!read_varint(is, len)) return false;
+  s.resize(len);
+  return len == 0 || is.read(&s[0], len);
+}
+
+uint64_t write_header(std::ostream& os, const std::string& reference_path,
+                      const std::string& query_path, const std::string& data_type) {
+  std::string buf(MAGIC, MAGIC_LEN);
+  put_string(buf, reference_path);
+  put_string(buf, query_path);
+  put_string(buf, data_type);
+  os.write(buf.data(), buf.size());
+  return buf.size();
+}
+
+static uint64_t id_index(const std::string& id, index_t& index,
+                         std::unordered_map<std::string, uint64_t>& id_map) {
+  auto res = id_map.insert(std::make_pair(id, (uint64_t)index.ids.size()));
+  if(res.second)
+    index.ids.push_back(id);
+  return res.first->second;
+}
+
+bool scan_records(std::istream& is, uint64_t offset, index_t& index) {
+  std::unordered_map<std::string, uint64_t> id_map;
+  for(uint64_t i = 0; i < index.ids.size(); ++i)
+    id_map[index.ids[i]] = i;
+
+  std::string idR, idQ;
+  is.clear();
+  is.seekg(offset);
+  while(is.peek() != EOF) {
+    uint64_t size;
+    if(!read_varint(is, size)) return false;
+    if(size == 0) break;        // Existing footer
+    const uint64_t start = is.tellg();
+    if(!read_string(is, idR) || !read_string(is, idQ)) return false;
+    index.records.push_back({ offset, id_index(idR, index, id_map), id_index(idQ, index, id_map) });
+    offset = start + size;
+    is.seekg(offset);
+    if(!is.good()) return false;
+  }
+  is.clear();
+  return true;
+}
+
+void write_index(std::ostream& os, const index_t& index) {
+  const uint64_t footer = os.tellp();
+  std::string    buf;
+  put_varint(buf, 0);
+  put_varint(buf, index.ids.size());
+  for(const auto& id : index.ids)
+    put_string(buf, id);
+  put_varint(buf, index.records.size());
+  uint64_t prev = 0;
+  for(const auto& r : index.records) {
+    put_varint(buf, r.offset - prev);
+    put_varint(buf, r.idR);
+    put_varint(buf, r.idQ);
+    prev = r.offset;
+  }
+  for(int i = 0; i < 8; ++i)
+    buf += (char)(footer >> (8 * i));
+  buf.append(INDEX_MAGIC, MAGIC_LEN);
+  os.write(buf.data(), buf.size());
+}
+
+bool read_trailer(std::istream& is, uint64_t& records_end) {
+  is.clear();
+  is.seekg(0, std::ios::end);
+  records_end = is.tellg();
+  if(records_end < MAGIC_LEN + TRAILER_LEN) return false;
+
+  char trailer[TRAILER_LEN];
+  is.seekg(records_end - TRAILER_LEN);
+  if(!is.read(trailer, TRAILER_LEN) || memcmp(trailer + 8, INDEX_MAGIC, MAGIC_LEN))
+    return false;
+  uint64_t footer = 0;
+  for(int i = 0; i < 8; ++i)
+    footer |= (uint64_t)(unsigned char)trailer[i] << (8 * i);
+  if(footer > records_end - TRAILER_LEN) return false;
+  records_end = footer;
+  return true;
+}
+
+bool read_index(std::istream& is, index_t& index, uint64_t& records_end) {
+  index.clear();
+  if(!read_trailer(is, records_end)) return false;
+
+  is.seekg(0, std::ios::end);
+  std::string buf((uint64_t)is.tellg() - TRAILER_LEN - records_end, '\0');
+  is.seekg(records_end);
+  if(!is.read(&buf[0], buf.size())) return false;
+  cursor c(buf.data(), buf.data() + buf.size());
+  if(c.varint() != 0) return false;
+  index.ids.resize(c.varint());
+  for(auto& id : index.ids)
+    id = c.string();
+  index.records.resize(c.varint());
+  uint64_t prev = 0;
+  for(auto& r : index.records) {
+    r.offset = prev + c.varint();
+    r.idR    = c.varint();
+    r.idQ    = c.varint();
+    prev     = r.offset;
+    if(r.idR >= index.ids.size() || r.idQ >= index.ids.size()) c.good = false;
+  }
+  if(!c.good) index.clear();
+  return c.good;
+}
+
+bool append_index(const std::string& path) {
+  struct stat st;
+  if(stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode)) return false;
+  std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+  if(!fs.good()) return false;
+  uint64_t records_end;
+  if(read_trailer(fs, records_end)) return true; // Already indexed
+  fs.clear();
+  fs.seekg(0);
+
+  char magic[MAGIC_LEN];
+  std::string ignore;
+  if(!fs.read(magic, MAGIC_LEN) || memcmp(magic, MAGIC, MAGIC_LEN)) return false;
+  for(int i = 0; i < 3; ++i)
+    if(!read_string(fs, ignore)) return false;
+
+  index_t index;
+  if(!scan_records(fs, fs.tellg(), index)) return false;
+  fs.clear();
+  fs.seekp(0, std::ios::end);
+  write_index(fs, index);
+  return fs.good();
+}
+
+writer::writer(std::ostream& os, const std::string& reference_path,
+               const std::string& query_path, const std::string& data_type)
+  : os_m(os)
+  , offset_m(write_header(os, reference_path, query_path, data_type))
+{ }
+
+uint64_t writer::id_index(const std::string& id) {
+  return delta_binary::id_index(id, index_m, id_map_m);
+}
+
+record_encoder& writer::begin(const std::string& idR, const std::string& idQ, long lenR, long lenQ,
+                              uint64_t nb_aligns) {
+  entry_m = { offset_m, id_index(idR), id_index(idQ) };
+  encoder_m.begin(idR, idQ, lenR, lenQ, nb_aligns);
+  return encoder_m;
+}
+
+void writer::end() {
+  buf_m.clear();
+  encoder_m.finish(buf_m);
+  os_m.write(buf_m.data(), buf_m.size());
+  index_m.records.push_back(entry_m);
+  offset_m += buf_m.size();
+}
+
+void writer::close() {
+  write_index(os_m, index_m);
+  os_m.flush();
+}
+
+} // namespace delta_binary
+} // namespace mummer
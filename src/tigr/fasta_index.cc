@@ -0,0 +1,198 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Source for the indexed FASTA files of fasta_index.hh
+//!
+//! \see fasta_index.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#include <mummer/fasta_index.hh>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mummer {
+namespace fasta_index {
+
+static inline bool is_space(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool indexed_fasta::open(const std::string& path) {
+  close();
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd == -1) return false;
+  struct stat st;
+  if(fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if(map == MAP_FAILED) return false;
+  // Only a plain FASTA file is indexed: not a compressed file (gzip
+  // magic number 1f 8b) nor any other file not starting with a header.
+  if(*(const char*)map != '>') {
+    munmap(map, st.st_size);
+    return false;
+  }
+  path_m = path;
+  data_m = (const char*)map;
+  size_m = st.st_size;
+
+  // Use the .fai index if it is not older than the FASTA file
+  const std::string fai_path = path + ".fai";
+  struct stat fai_st;
+  if(stat(fai_path.c_str(), &fai_st) == 0 && fai_st.st_mtime >= st.st_mtime && load_index(fai_path))
+    return true;
+  build_index();
+  save_index(fai_path);
+  return true;
+}
+
+void indexed_fasta::close() {
+  if(data_m)
+    munmap((void*)data_m, size_m);
+  data_m = nullptr;
+  size_m = 0;
+  path_m.clear();
+  entries_m.clear();
+  names_m.clear();
+}
+
+void indexed_fasta::add_entry(entry&& e) {
+  names_m.insert(std::make_pair(e.name, entries_m.size()));
+  entries_m.push_back(std::move(e));
+}
+
+bool indexed_fasta::load_index(const std::string& fai_path) {
+  std::ifstream is(fai_path);
+  std::string   line;
+  while(std::getline(is, line)) {
+    std::istringstream ls(line);
+    entry e;
+    if(!std::getline(ls, e.name, '\t') || !(ls >> e.length >> e.offset >> e.line_bases >> e.line_width)
+       || e.line_bases == 0 || e.line_width <= e.line_bases || e.offset > size_m) {
+      entries_m.clear();
+      names_m.clear();
+      return false;
+    }
+    add_entry(std::move(e));
+  }
+  return true;
+}
+
+void indexed_fasta::build_index() {
+  const char*       p   = data_m;
+  const char* const end = data_m + size_m;
+  while(p < end) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    nl             = nl ? nl + 1 : end;
+    if(*p != '>') { // Not a header, ignore
+      p = nl;
+      continue;
+    }
+    entry e;
+    const char* ns = p + 1;
+    while(ns < nl && !is_space(*ns)) ++ns;
+    e.name.assign(p + 1, ns);
+    e.offset     = nl - data_m;
+    e.length     = 0;
+    e.line_bases = e.line_width = 0;
+
+    // Sequence lines, up to the next header. All the lines must have
+    // the same number of bases (except the last ones, shorter or
+    // empty) and the same terminator.
+    bool regular = true, last = false;
+    for(p = nl; p < end && *p != '>'; p = nl) {
+      nl = (const char*)memchr(p, '\n', end - p);
+      nl = nl ? nl + 1 : end;
+      uint64_t bases = 0;
+      for(const char* c = p; c < nl; ++c)
+        bases += !is_space(*c);
+      e.length += bases;
+      if(!regular) continue;
+      const char* te = nl;
+      while(te > p && is_space(te[-1])) --te;
+      // Width of the line, as if the last line of the file had a newline
+      const uint64_t width = nl - p + (nl[-1] != '\n');
+      if(bases == 0) {                      // Blank line, only at the end
+        last = true;
+      } else if(bases != (uint64_t)(te - p)) { // Space within a line
+        regular = false;
+      } else if(e.line_bases == 0) {
+        e.line_bases = bases;
+        e.line_width = width;
+      } else if(last || bases > e.line_bases || width - bases != e.line_width - e.line_bases) {
+        regular = false;
+      } else {
+        last = bases < e.line_bases;
+      }
+    }
+    if(!regular)
+      e.line_bases = e.line_width = 0;
+    add_entry(std::move(e));
+  }
+}
+
+bool indexed_fasta::save_index(const std::string& fai_path) const {
+  for(const auto& e : entries_m)
+    if(e.line_bases == 0 && e.length > 0) return false;
+  std::ofstream os(fai_path);
+  for(const auto& e : entries_m)
+    os << e.name << '\t' << e.length << '\t' << e.offset << '\t'
+       << std::max(e.line_bases, (uint64_t)1) << '\t' << std::max(e.line_width, (uint64_t)2) << '\n';
+  os.close();
+  if(!os.good()) {
+    unlink(fai_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+const entry* indexed_fasta::find(const std::string& name) const {
+  auto it = names_m.find(name);
+  return it == names_m.end() ? nullptr : &entries_m[it->second];
+}
+
+uint64_t indexed_fasta::fetch(const entry& e, uint64_t start, uint64_t len, char* out) const {
+  if(start >= e.length) return 0;
+  len = std::min(len, e.length - start);
+
+  // Skip directly to the line of start if the lines are regular, base by
+  // base otherwise
+  uint64_t skip = start;
+  uint64_t pos  = e.offset;
+  if(e.line_bases > 0) {
+    pos += (start / e.line_bases) * e.line_width + start % e.line_bases;
+    skip = 0;
+  }
+  const char*       p   = data_m + pos;
+  const char* const end = data_m + size_m;
+  uint64_t          res = 0;
+  for( ; res < len && p < end && *p != '>'; ++p) {
+    if(is_space(*p)) continue;
+    if(skip) {
+      --skip;
+      continue;
+    }
+    out[res++] = tolower(*p);
+  }
+  return res;
+}
+
+bool indexed_fasta::fetch(const std::string& name, std::string& seq) const {
+  const entry* e = find(name);
+  if(!e) return false;
+  seq.assign(e->length + 1, '\0');
+  seq.resize(fetch(*e, 0, e->length, &seq[1]) + 1);
+  return true;
+}
+
+} // namespace fasta_index
+} // namespace mummer
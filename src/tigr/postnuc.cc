@@ -14,6 +14,11 @@
 #include <mummer/postnuc.hh>
 #include <mummer/tigrinc.hh>
 #include <mummer/sw_align.hh>
+#include <mummer/delta_binary.hh>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace mummer {
 namespace postnuc {
@@ -124,6 +129,32 @@ void merge_syntenys::extendClusters(std::vector<Cluster> & Clusters,
   std::vector<Alignment>::iterator CurrAp = Alignments.begin( );   // current align
   std::vector<Alignment>::iterator TargetAp;                // target align
 
+  //-- The sequence B in the direction dirB
+  auto directionB = [&](char dirB) -> const char* {
+    if ( dirB == FORWARD_CHAR )
+      return Bseq;
+    if ( ! Brev ) {
+      Brev.reset(new char[Blen + 2]);
+      memcpy ( Brev.get() + 1, Bseq + 1, Blen );
+      Brev[0] = Brev[Blen+1] = '\0';
+      Reverse_Complement (Brev.get(), 1, Blen);
+    }
+    return Brev.get();
+  };
+
+  //-- With many threads, compute beforehand the forward extensions
+  //   that depend only on the clusters. The loop below uses them when
+  //   it makes the same call to alignTarget.
+  std::vector<ForwardExtension> Extensions;
+  std::vector<size_t>           ExtensionIdx;
+#ifdef _OPENMP
+  if ( NB_THREADS > 1 ) {
+    for ( const auto& C : Clusters )
+      directionB (C.dirB);
+    precomputeExtensions (Clusters, A, Alen, Bseq, Brev.get( ), Blen, Extensions, ExtensionIdx);
+  }
+#endif
+
 
   //-- Extend each cluster
   auto TargetCp = Clusters.end(); // the target cluster
@@ -141,17 +172,7 @@ void merge_syntenys::extendClusters(std::vector<Cluster> & Clusters,
     }
 
     //-- Pick the right directional sequence for B
-    if ( CurrCp->dirB == FORWARD_CHAR )
-      B = Bseq;
-    else if ( Brev )
-      B = Brev.get();
-    else {
-      Brev.reset(new char[Blen + 2]);
-      memcpy ( Brev.get() + 1, Bseq + 1, Blen );
-      Brev[0] = Brev[Blen+1] = '\0';
-      Reverse_Complement (Brev.get(), 1, Blen);
-      B = Brev.get();
-    }
+    B = directionB (CurrCp->dirB);
 
     //-- Extend each match in the cluster
     for ( Mp = CurrCp->matches.begin( ); Mp < CurrCp->matches.end( ); ++Mp) {
@@ -191,6 +212,8 @@ void merge_syntenys::extendClusters(std::vector<Cluster> & Clusters,
       }
 
       m_o = sw_align::FORWARD_ALIGN;
+      const ForwardExtension* Ext = Extensions.empty( ) ? nullptr
+        : &Extensions[ExtensionIdx[CurrCp - Clusters.begin( )] + (Mp - CurrCp->matches.begin( ))];
 
       //-- Try to extend the current match forwards
       if ( Mp < CurrCp->matches.end( ) - 1 ) {
@@ -199,7 +222,7 @@ void merge_syntenys::extendClusters(std::vector<Cluster> & Clusters,
         targetB = (Mp + 1)->sB;
 
         //-- Extend the current alignment object forward
-        target_reached = extendForward (CurrAp, A, targetA, B, targetB, m_o);
+        target_reached = extendForward (CurrAp, A, targetA, B, targetB, m_o, Ext);
       } else if ( DO_EXTEND ) {
         targetA = Alen;
         targetB = Blen;
@@ -215,7 +238,7 @@ void merge_syntenys::extendClusters(std::vector<Cluster> & Clusters,
         }
 
         //-- Extend the current alignment object forward
-        target_reached = extendForward (CurrAp, A, targetA, B, targetB, m_o);
+        target_reached = extendForward (CurrAp, A, targetA, B, targetB, m_o, Ext);
       }
     }
     if ( TargetCp == Clusters.end( ) )
@@ -333,40 +356,27 @@ bool merge_syntenys::extendBackward(std::vector<Alignment> & Alignments, std::ve
 
 
 
-bool merge_syntenys::extendForward(std::vector<Alignment>::iterator CurrAp, const char * A, long int targetA,
-                                   const char * B, long int targetB, unsigned int m_o) const
+static bool clipForwardTarget(long int eA, long int eB, long int & targetA, long int & targetB,
+                              unsigned int & m_o)
 
-//  Extend an alignment forwards off the current alignment object until
-//  target or end of sequence is reached, and merge the delta values of the
-//  alignment object with the new delta values generated by the extension.
-//  Return true if the target was reached, else false
+//  Bring the target of a forward extension from (eA, eB) within
+//  MAX_ALIGNMENT_LENGTH and adjust m_o accordingly. Return true if
+//  the target was moved, else false
 
 {
-  long int ValA;
-  long int ValB;
-  unsigned int Di;
-  bool target_reached;
   bool overflow_flag = false;
   bool double_flag = false;
-  std::vector<long int>::iterator Dp;
-
-  //-- Set Di to the end of the delta vector
-  Di = CurrAp->delta.size( );
-
-  //-- Calculate the distance between the start and end positions
-  ValA = targetA - CurrAp->eA + 1;
-  ValB = targetB - CurrAp->eB + 1;
 
   //-- If the distance is too long, shrink it and set the overflow_flag
-  if ( ValA > sw_align::MAX_ALIGNMENT_LENGTH )
+  if ( targetA - eA + 1 > sw_align::MAX_ALIGNMENT_LENGTH )
     {
-      targetA = CurrAp->eA + sw_align::MAX_ALIGNMENT_LENGTH - 1;
+      targetA = eA + sw_align::MAX_ALIGNMENT_LENGTH - 1;
       overflow_flag = true;
       m_o |= sw_align::OPTIMAL_BIT;
     }
-  if ( ValB > sw_align::MAX_ALIGNMENT_LENGTH )
+  if ( targetB - eB + 1 > sw_align::MAX_ALIGNMENT_LENGTH )
     {
-      targetB = CurrAp->eB + sw_align::MAX_ALIGNMENT_LENGTH - 1;
+      targetB = eB + sw_align::MAX_ALIGNMENT_LENGTH - 1;
       if ( overflow_flag )
         double_flag = true;
       else
@@ -377,9 +387,42 @@ bool merge_syntenys::extendForward(std::vector<Alignment>::iterator CurrAp, cons
   if ( double_flag )
     m_o &= ~sw_align::SEQEND_BIT;
 
-  target_reached = aligner.alignTarget (A, CurrAp->eA, targetA,
-                                        B, CurrAp->eB, targetB,
-                                        CurrAp->delta, m_o);
+  return overflow_flag;
+}
+
+bool merge_syntenys::extendForward(std::vector<Alignment>::iterator CurrAp, const char * A, long int targetA,
+                                   const char * B, long int targetB, unsigned int m_o,
+                                   const ForwardExtension* Ext) const
+
+//  Extend an alignment forwards off the current alignment object until
+//  target or end of sequence is reached, and merge the delta values of the
+//  alignment object with the new delta values generated by the extension.
+//  If Ext is the same extension computed beforehand, use its result.
+//  Return true if the target was reached, else false
+
+{
+  long int ValA;
+  unsigned int Di;
+  bool target_reached;
+  std::vector<long int>::iterator Dp;
+
+  //-- Set Di to the end of the delta vector
+  Di = CurrAp->delta.size( );
+
+  const bool overflow_flag = clipForwardTarget (CurrAp->eA, CurrAp->eB, targetA, targetB, m_o);
+
+  if ( Ext  &&  Ext->m_o == m_o  &&
+       Ext->Astart == CurrAp->eA  &&  Ext->Atarget == targetA  &&
+       Ext->Bstart == CurrAp->eB  &&  Ext->Btarget == targetB ) {
+    CurrAp->delta.insert (CurrAp->delta.end( ), Ext->delta.begin( ), Ext->delta.end( ));
+    target_reached = Ext->reached;
+    targetA        = Ext->Aend;
+    targetB        = Ext->Bend;
+  } else {
+    target_reached = aligner.alignTarget (A, CurrAp->eA, targetA,
+                                          B, CurrAp->eB, targetB,
+                                          CurrAp->delta, m_o);
+  }
 
   //-- Notify user if alignment was chopped short
   if ( target_reached  &&  overflow_flag )
@@ -409,6 +452,74 @@ bool merge_syntenys::extendForward(std::vector<Alignment>::iterator CurrAp, cons
   return target_reached;
 }
 
+void merge_syntenys::precomputeExtensions(std::vector<Cluster> & Clusters,
+                                          const char* A, const long Alen, const char* Bfwd, const char* Brev, const long Blen,
+                                          std::vector<ForwardExtension>& Extensions, std::vector<size_t>& ExtensionIdx) const
+
+//  Compute in parallel the forward extensions of extendClusters that
+//  depend only on the clusters: from each match to the next one in its
+//  cluster and, if DO_EXTEND, from the last match to the target given by
+//  getForwardTargetCluster. The extension of the i-th match of the c-th
+//  cluster is Extensions[ExtensionIdx[c] + i]. The clusters must be
+//  sorted and Brev must be set if any cluster is reversed.
+
+{
+  ExtensionIdx.resize(Clusters.size( ) + 1);
+  ExtensionIdx[0] = 0;
+  for ( size_t c = 0; c < Clusters.size( ); ++c )
+    ExtensionIdx[c + 1] = ExtensionIdx[c] + Clusters[c].matches.size( );
+  Extensions.assign(ExtensionIdx.back( ), ForwardExtension( ));
+
+  //-- Set the arguments of alignTarget, as extendClusters does
+  std::vector<std::pair<size_t, bool>> Todo; // extension, forward B
+  for ( auto Cp = Clusters.begin( ); Cp < Clusters.end( ); ++Cp ) {
+    const size_t offset = ExtensionIdx[Cp - Clusters.begin( )];
+    for ( auto Mp = Cp->matches.cbegin( ); Mp < Cp->matches.cend( ); ++Mp ) {
+      long int     targetA, targetB;
+      unsigned int m_o = sw_align::FORWARD_ALIGN;
+      if ( Mp < Cp->matches.cend( ) - 1 ) {
+        targetA = (Mp + 1)->sA;
+        targetB = (Mp + 1)->sB;
+      } else if ( DO_EXTEND ) {
+        targetA = Alen;
+        targetB = Blen;
+        if ( getForwardTargetCluster (Clusters, Cp, targetA, targetB) == Clusters.end( ) ) {
+          m_o |= sw_align::OPTIMAL_BIT;
+          if ( TO_SEQEND )
+            m_o |= sw_align::SEQEND_BIT;
+        }
+      } else {
+        continue;
+      }
+
+      ForwardExtension& Ext = Extensions[offset + (Mp - Cp->matches.cbegin( ))];
+      Ext.Astart = Mp->sA + Mp->len - 1;
+      Ext.Bstart = Mp->sB + Mp->len - 1;
+      clipForwardTarget (Ext.Astart, Ext.Bstart, targetA, targetB, m_o);
+      Ext.Atarget = targetA;
+      Ext.Btarget = targetB;
+      Ext.m_o     = m_o;
+      Todo.push_back({ offset + (Mp - Cp->matches.cbegin( )), Cp->dirB == FORWARD_CHAR });
+    }
+  }
+
+  //-- The buffer of aligner is not thread safe, each thread has its own
+  const sw_align::aligner& al = aligner;
+#pragma omp parallel num_threads(NB_THREADS)
+  {
+    sw_align::DiagonalMatrix Diag;
+#pragma omp for schedule(dynamic)
+    for ( size_t t = 0; t < Todo.size( ); ++t ) {
+      ForwardExtension& Ext = Extensions[Todo[t].first];
+      Ext.Aend    = Ext.Atarget;
+      Ext.Bend    = Ext.Btarget;
+      Ext.reached = al.alignTarget (A, Ext.Astart, Ext.Aend,
+                                    Todo[t].second ? Bfwd : Brev, Ext.Bstart, Ext.Bend,
+                                    Ext.delta, Ext.m_o, Diag);
+    }
+  }
+}
+
 std::vector<Cluster>::iterator merge_syntenys::getForwardTargetCluster
 (std::vector<Cluster> & Clusters, std::vector<Cluster>::iterator CurrCp,
  long int & targetA, long int & targetB) const
@@ -829,13 +940,85 @@ void printDeltaAlignments(const std::vector<Alignment>& Alignments,
   }
 }
 
-std::string createCIGAR(const std::vector<long int>& ds, long int start, long int end, long int len,
-                        bool hard_clip) {
-  std::string res;
-  long int    off   = 0;
-  long int    range = 0;
+void printBinaryDeltaAlignments(const std::vector<Alignment>& Alignments,
+                                const std::string& AId, const long Alen,
+                                const std::string& BId, const long Blen,
+                                std::ostream& DeltaFile, const long minLen)
+//  Same as printDeltaAlignments, in the binary delta format. The
+//  record is self contained and written in one piece.
+{
+  auto keep = [&](const Alignment& A) {
+    return std::abs(A.eA - A.sA) + 1 >= minLen || std::abs(A.eB - A.sB) + 1 >= minLen;
+  };
+  const auto nb_aligns = std::count_if(Alignments.cbegin(), Alignments.cend(), keep);
+  if(nb_aligns == 0) return;
+
+  delta_binary::record_encoder encoder;
+  encoder.begin(AId, BId, Alen, Blen, nb_aligns);
+  for(const auto& A : Alignments) {
+    if(!keep(A)) continue;
+    const bool fwd = A.dirB == FORWARD_CHAR;
+    encoder.alignment({ A.sA, A.eA, fwd ? A.sB : revC(A.sB, Blen), fwd ? A.eB : revC(A.eB, Blen),
+                        A.Errors, A.SimErrors, A.NonAlphas },
+                      A.delta.cbegin(), A.delta.cend());
+  }
+  std::string buf;
+  encoder.finish(buf);
+  DeltaFile.write(buf.data(), buf.size());
+}
+
+void printPAFAlignments(const std::vector<Alignment>& Alignments,
+                        const std::string& AId, const long Alen,
+                        const std::string& BId, const long Blen,
+                        std::ostream& PAFFile, bool cigar, const long minLen)
+//  The lengths and the number of matches are computed from the
+//  delta vector, without building the CIGAR unless asked for. The
+//  lines are formatted in a buffer reused by the thread.
+{
+  static const char               ops[] = "MIDNSHP=X";
+  static thread_local std::string buffer;
+  buffer.clear();
+  const char* const mapq = Alignments.size() > 1 ? "\t10" : "\t30";
+  for(const auto& A : Alignments) {
+    if(std::abs(A.eA - A.sA) + 1 < minLen && std::abs(A.eB - A.sB) + 1 < minLen)
+      continue;
+    const bool fwd        = A.dirB == FORWARD_CHAR;
+    const long insertions = std::count_if(A.delta.cbegin(), A.delta.cend(), [](long d) { return d < 0; });
+    const long block      = A.eA - A.sA + 1 + insertions;
+    buffer += BId;
+    buffer += '\t'; buffer += std::to_string(Blen);
+    buffer += '\t'; buffer += std::to_string(fwd ? A.sB - 1 : Blen - A.eB);
+    buffer += '\t'; buffer += std::to_string(fwd ? A.eB : Blen - A.sB + 1);
+    buffer += fwd ? "\t+\t" : "\t-\t";
+    buffer += AId;
+    buffer += '\t'; buffer += std::to_string(Alen);
+    buffer += '\t'; buffer += std::to_string(A.sA - 1);
+    buffer += '\t'; buffer += std::to_string(A.eA);
+    buffer += '\t'; buffer += std::to_string(block - A.Errors);
+    buffer += '\t'; buffer += std::to_string(block);
+    buffer += mapq;
+    buffer += "\ttp:A:P\tNM:i:"; buffer += std::to_string(A.Errors);
+    if(cigar) {
+      buffer += "\tcg:Z:";
+      for(const auto op : createCIGAROps(A.delta, A.sB, A.eB, Blen)) {
+        if((op & 0xf) == CIGAR_SOFT_CLIP) continue;
+        buffer += std::to_string(op >> 4);
+        buffer += ops[op & 0xf];
+      }
+    }
+    buffer += '\n';
+  }
+  PAFFile.write(buffer.data(), buffer.size());
+}
+
+std::vector<uint32_t> createCIGAROps(const std::vector<long int>& ds, long int start, long int end, long int len,
+                                     bool hard_clip) {
+  std::vector<uint32_t> res;
+  long int              off   = 0;
+  long int              range = 0;
+  auto add = [&res](long int n, cigar_op op) { res.push_back((uint32_t)n << 4 | op); };
   if(start > 1) {
-    res += std::to_string(start - 1) + (hard_clip ? 'H' : 'S');
+    add(start - 1, hard_clip ? CIGAR_HARD_CLIP : CIGAR_SOFT_CLIP);
     off += start - 1;
   }
   for(const auto& id : ds) {
@@ -847,25 +1030,36 @@ std::string createCIGAR(const std::vector<long int>& ds, long int start, long in
       }
     }
     if(range) {
-      res += std::to_string(std::abs(range)) + (range > 0 ? 'D' : 'I');
+      add(std::abs(range), range > 0 ? CIGAR_DEL : CIGAR_INS);
       if(range < 0)
         off += std::abs(range);
       range = 0;
     }
-    res += std::to_string(std::abs(id) - 1) + 'M';
+    add(std::abs(id) - 1, CIGAR_MATCH);
     off += std::abs(id) - 1;
     range = (id > 0 ? 1 : -1);
     assert(off <= end);
   }
   if(range) {
-    res += std::to_string(std::abs(range)) + (range > 0 ? 'D' : 'I');
+    add(std::abs(range), range > 0 ? CIGAR_DEL : CIGAR_INS);
     if(range < 0)
       off += std::abs(range);
   }
   if(off < end)
-    res += std::to_string(end - off) + 'M';
+    add(end - off, CIGAR_MATCH);
   if(end < len)
-    res += std::to_string(len - end) + (hard_clip ? 'H' : 'S');
+    add(len - end, hard_clip ? CIGAR_HARD_CLIP : CIGAR_SOFT_CLIP);
+  return res;
+}
+
+std::string createCIGAR(const std::vector<long int>& ds, long int start, long int end, long int len,
+                        bool hard_clip) {
+  static const char ops[] = "MIDNSHP=X";
+  std::string res;
+  for(const auto op : createCIGAROps(ds, start, end, len, hard_clip)) {
+    res += std::to_string(op >> 4);
+    res += ops[op & 0xf];
+  }
   return res;
 }
 
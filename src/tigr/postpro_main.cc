@@ -0,0 +1,255 @@
+//------------------------------------------------------------------------------
+//   Programmer: Adam M Phillippy, The Institute for Genomic Research
+//         File: postpro.cc
+//         Date: 08 / 20 / 2002
+//
+//      Purpose: To translate the coordinates referencing the concatenated
+//              reference sequences back to the individual sequences and deal
+//             with any conflict that may have arisen (i.e. a MUM that spans
+//            the boundry between two sequences). Then to extend each cluster
+//           via Smith-Waterman techniques to expand the alignment coverage.
+//          Alignments which encounter each other will be fused to form one
+//         encompasing alignment when appropriate.
+//
+//        Input: Input is the output of the .mgaps program from stdin. On the
+//              command line, the file names of the two original sequence files
+//             should come first, followed by the prefix <pfx> that should be
+//            placed in front of the two output filenames <pfx>.cluster and
+//           <pfx>.delta
+//
+// NOTE: Cluster file is now suppressed by default (see -d option).
+//
+//       Output: Output is to two output files, <pfx>.cluster and <pfx>.delta.
+//              <pfx>.cluster lists MUM clusters as identified by "mgaps".
+//             However, the clusters now reference their corresponding
+//            sequence and are all listed under headers that specify this
+//           sequence. In addition, the coordinates now reference the original
+//          DNA input and not the amino acid translations. The <pfx>.delta file
+//         is the alignment object that contains all the information necessary
+//        to reproduce the alignments generated by the MUM extension process.
+//       The coordinates in this file reference the original DNA input, however
+//      the delta values represent amino acids, so 1 delta = 3 nucleotides.
+//     Please refer to the output file documentation for an in-depth
+//    description of these file formats.
+//
+//        Usage: postpro  <reference>  <query>  <pfx>  <  <input>
+//           Where <reference> and <query> are the original input sequences of
+//          PROmer and <pfx> is the prefix that should be added to the
+//         beginning of the <pfx>.cluster and <pfx>.delta output filenames.
+//
+//------------------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <mummer/postpro.hh>
+#include <mummer/tigrinc.hh>
+#include <mummer/sw_align.hh>
+
+using namespace std;
+using namespace mummer::postpro;
+
+//------------------------------------------------------ Globals -------------//
+bool DO_DELTA = true;
+bool DO_EXTEND = true;
+bool TO_SEQEND = false;
+int  break_len = 60;
+int  matrix_type = mummer::sw_align::BLOSUM62;
+
+
+void parseAbort
+     (const std::string& s)
+
+     //  Abort the program if there was an error in parsing file 's'
+
+{
+  cerr << "ERROR: Could not parse input from '" << s << "'. \n"
+       << "Please check the filename and format, or file a bug report\n";
+  exit (EXIT_FAILURE);
+}
+
+
+void printHelp
+     (const char * s)
+
+     //  Display the program's help information to stderr.
+
+{
+  cerr << "\nUSAGE: " << s << "  [options]  <reference>  <query>  <pfx>  <  <input>\n\n"
+       << "-b int   set the alignment break (give-up) length to int (amino acids)\n"
+       << "-d       output only match clusters rather than extended alignments\n"
+       << "-e       do not extend alignments outward from clusters\n"
+       << "-h       display help information\n"
+       << "-t       force alignment to ends of sequence if within -b distance\n"
+       << "-x type  set the matrix type to \"type\" - Default is 2 (BLOSUM 62),\n"
+       << "         other options include 1 (BLOSUM 45) and 3 (BLOSUM 80)\n\n"
+       << "  Input is the output of the \"mgaps\" program from stdin, and\n"
+       << "the two original PROmer sequence files passed on the command\n"
+       << "line. <pfx> is the prefix to be added to the front of the\n"
+       << "output file <pfx>.delta\n"
+       << "  <pfx>.delta is the alignment object that catalogs the distance\n"
+       << "between insertions and deletions. For further information\n"
+       << "regarding this file, please refer to the documentation under\n"
+       << "the .delta output description.\n\n";
+}
+
+
+void printUsage
+     (const char * s)
+
+     //  Display the program's usage information to stderr.
+
+{
+  cerr << "\nUSAGE: " << s << "  [options]  <reference>  <query>  <pfx>  <  <input>\n\n"
+       << "Try '" << s << " -h' for more information.\n";
+}
+
+
+void parse_options(int argc, char* argv[]) {
+  optarg = NULL;
+  int ch, errflg = 0;
+  while ( !errflg  &&  ((ch = getopt (argc, argv, "dehb:tx:")) != EOF) ) {
+    switch (ch) {
+    case 'b' :
+      break_len = atoi (optarg);
+      break;
+
+    case 'd' :
+      DO_DELTA = false;
+      break;
+
+    case 'e' :
+      DO_EXTEND = false;
+      break;
+
+    case 'h' :
+      printHelp (argv[0]);
+      exit (EXIT_SUCCESS);
+
+    case 't' :
+      TO_SEQEND = true;
+      break;
+
+    case 'x' :
+      matrix_type = atoi(optarg);
+      if ( matrix_type == mummer::sw_align::NUCLEOTIDE || matrix_type < 0 || matrix_type > 3 ) {
+        cerr << "WARNING: invalid matrix type " << matrix_type << ", ignoring\n";
+        matrix_type = mummer::sw_align::BLOSUM62;
+      }
+      break;
+
+    default :
+      errflg ++;
+    }
+  }
+  if ( errflg > 0 || argc - optind != 3 ) {
+    printUsage (argv[0]);
+    exit (EXIT_FAILURE);
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  std::ios::sync_with_stdio(false);
+
+  std::vector<FastaRecord> Af;  // array of all the reference sequences
+  FastaRecord              Bf;  // the current query sequence
+  string                   Line; // a single line of input
+  long int                 sA, sB, len; // current match start in A, B and length
+
+  //-- Parse the command line arguments
+  parse_options(argc, argv);
+
+  const merge_syntenys merger(DO_DELTA, DO_EXTEND, TO_SEQEND, break_len, matrix_type);
+
+  //-- Read and create the I/O file names
+  string RefFileName(argv[optind ++]);
+  string QryFileName(argv[optind ++]);
+  string ClusterFileName(argv[optind ++]);
+  string DeltaFileName(ClusterFileName);
+  ClusterFileName += ".cluster";
+  DeltaFileName   += ".delta";
+
+  //-- Open all the files
+  std::ifstream RefFile(RefFileName);
+  if(!RefFile.good())
+    parseAbort(RefFileName);
+  std::ifstream QryFile(QryFileName);
+  if(!QryFile.good())
+    parseAbort(QryFileName);
+  std::ofstream OutFile(DO_DELTA ? DeltaFileName : ClusterFileName);
+  if(!OutFile.good()) {
+    cerr << "ERROR: Could not open file " << (DO_DELTA ? DeltaFileName : ClusterFileName) << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  //-- Print the headers of the output files
+  OutFile << RefFileName << ' ' << QryFileName << "\nPROMER\n";
+
+  //-- Generate the array of the reference sequences
+  do {
+    Af.push_back(FastaRecord());
+  } while(Af.back().read(RefFile));
+  Af.pop_back();
+  RefFile.close();
+  if(Af.empty())
+    parseAbort(RefFileName);
+
+  auto print_delta = [&](std::vector<Alignment>&& Alignments,
+                         const FastaRecord& Af, const FastaRecord& Bf) {
+    printDeltaAlignments(Alignments, Af, Bf, OutFile);
+  };
+
+  //-- For each syntenic region with clusters, read in the B sequence
+  //   and extend the clusters. IMPORTANT: The B sequences are assumed
+  //   to be ordered as output by mgaps, if they are not in order the
+  //   program will fail.
+  auto process = [&](std::vector<Synteny>& Syntenys) {
+    bool has_clusters = false;
+    for(const auto& Sp : Syntenys)
+      has_clusters = has_clusters || !Sp.clusters.empty();
+    if(has_clusters) {
+      const string& IdB = Syntenys.front().IdB;
+      while(IdB != Bf.Id() && Bf.read(QryFile)) ;
+      if(IdB != Bf.Id()) {
+        cerr << IdB << '\n';
+        parseAbort("Query File");
+      }
+      merger.processSyntenys_each(Syntenys, Bf, print_delta);
+    }
+    if(!DO_DELTA)
+      printSyntenys(Syntenys, OutFile);
+  };
+  synteny_builder builder(Af, process);
+
+  //-- Process the input from <stdin> line by line
+  while(std::getline(std::cin, Line)) {
+    if(Line[0] == '>') {
+      //-- If the current line is a fasta HEADER_LINE
+      const size_t start = Line.find_first_not_of(" \t", 1);
+      const size_t end   = Line.find_first_of(" \t", start);
+      if(start == string::npos)
+        parseAbort("stdin");
+      string CurrIdB = Line.substr(start, end - start);
+      const int CurrFrameB = atoi(CurrIdB.c_str() + CurrIdB.size() - 1);
+      CurrIdB.resize(CurrIdB.size() >= 2 ? CurrIdB.size() - 2 : 0);
+      builder.header(CurrIdB, CurrFrameB);
+    } else if(Line[0] == '#') {
+      //-- If the current line is a cluster HEADER_LINE
+      builder.cluster();
+    } else {
+      //-- If the current line is a MATCH_LINE
+      if(sscanf(Line.c_str(), "%ld %ld %ld", &sA, &sB, &len) != 3)
+        parseAbort("stdin");
+      builder.match(sA, sB, len);
+    }
+  }
+
+  //-- Process the left-over syntenys
+  builder.finish();
+
+  return EXIT_SUCCESS;
+}
@@ -70,6 +70,8 @@ int main
   long int last_index;
 
   char * A, * tA;
+  char * tAs [6];               // the six frame translations
+  long int LentAs [6];
   char mask_char = 0;
   char Id [MAX_LINE];
   char InputFileName [MAX_LINE];
@@ -127,8 +129,11 @@ int main
 
   InitSize = INIT_SIZE;
   A = (char *) Safe_malloc ( sizeof(char) * InitSize );
-  tA = (char *) Safe_malloc ( sizeof(char) );
-  tA [0] = '\0';
+  for ( frame = 0; frame < 6; frame ++ )
+    {
+      tAs [frame] = (char *) Safe_malloc ( sizeof(char) );
+      tAs [frame][0] = '\0';
+    }
   
   ct = 0;
   if ( isReference )
@@ -137,14 +142,19 @@ int main
     {
       LenA = strlen(A + 1);
 
+      //-- Translate the six frames at once
+      for ( frame = 0; frame < 6; frame ++ )
+	tAs [frame] = (char *) Safe_realloc
+	  (tAs [frame], sizeof(char) * ( (LenA / 3) + 2) );
+      Translate_DNA_Frames (A, LenA, tAs, LentAs);
+
       for ( frame = 1; frame <= 6; frame ++ )
 	{
 	  if ( isQuery )
 	    printf (">%s.%d\n", Id, frame);
 
-	  //-- Translate the current frame
-	  tA = (char *) Safe_realloc (tA, sizeof(char) * ( (LenA / 3) + 2) );
-	  LentA = Translate_DNA (A, tA, frame);
+	  tA = tAs [frame - 1];
+	  LentA = LentAs [frame - 1];
 	  tA[++ LentA] = mask_char;
 	  
 	  //-- Mask the current frame
@@ -189,7 +199,8 @@ int main
   fclose(InputFile);
 
   free(A);
-  free(tA);
+  for ( frame = 0; frame < 6; frame ++ )
+    free(tAs [frame]);
 
   return EXIT_SUCCESS;
 }
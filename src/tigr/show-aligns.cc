@@ -17,6 +17,7 @@
 #include <sys/ioctl.h>
 
 #include <mummer/delta.hh>
+#include <mummer/fasta_index.hh>
 #include <mummer/tigrinc.hh>
 #include <mummer/translate.hh>
 #include <mummer/sw_alignscore.hh>
@@ -30,7 +31,7 @@ using namespace std;
 
 //------------------------------------------------------------- Jellyfish parser ----//
 typedef std::vector<std::string>::const_iterator         path_iterator;
-typedef jellyfish::stream_manager<path_iterator>         stream_manager;
+typedef jellyfish::stream_manager<path_iterator, mummer::compressed::ifstream> stream_manager;
 typedef jellyfish::whole_sequence_parser<stream_manager> sequence_parser;
 
 
@@ -57,6 +58,10 @@ int Screen_Width = 0;
 #define DEFAULT_MARKER_WIDTH 10
 int Marker_Width = DEFAULT_MARKER_WIDTH;
 
+//-- Alignments formatted in parallel before writing them out in order
+#define PRINT_BATCH 64
+int Nb_Threads = 1;
+
 bool Colorize = false;
 
 class ColoredBuffer {
@@ -140,6 +145,30 @@ struct AlignStats
 
 
 
+struct SeqView
+     //-- A sequence, or a region of a sequence, in memory: the forward
+     //   base at position p (1 based) is seq[p - off]. The reverse
+     //   complement strand is read on the fly
+{
+  const char * seq;
+  long int off;                         // position of seq[0]
+  long int len;                         // length of the whole sequence
+  bool rev;
+
+  SeqView ( ) : seq (NULL), off (0), len (0), rev (false) { }
+  SeqView (const char * s, long int o, long int l, bool r)
+    : seq (s), off (o), len (l), rev (r) { }
+
+  char operator[] (long int p) const
+  {
+    if ( !rev )
+      return seq[p - off];
+    return Complement (seq[len - p + 1 - off]);
+  }
+};
+
+
+
 struct sR_Sort
 //-- For sorting alignments by their sR coordinate
 {
@@ -191,16 +220,21 @@ void parseDelta
 (vector<AlignStats> & Aligns, const std::string& IdR, const std::string& IdQ);
 
 void printAlignments
-(vector<AlignStats> Aligns, const std::string& R, const std::string& Q);
+(const vector<AlignStats>& Aligns, const std::string& R, long int offR, long int SeqLenR,
+ const std::string& Q, long int offQ, long int SeqLenQ);
+
+void formatAlignment
+(const AlignStats& Al, const SeqView* A, const SeqView* B, long int SeqLenR, long int SeqLenQ,
+ std::string& out);
 
 void add_prefix(ColoredBuffer& Buff, long int pos, long int seqlen, int frame);
 
 void append(ColoredBuffer& Buff1, ColoredBuffer& Buff2, std::string &Buff3,
             char c1, char c2, char c3);
 
-void print_buffers(ColoredBuffer& b1, ColoredBuffer& b2, std::string& b3);
+void print_buffers(std::string& out, ColoredBuffer& b1, ColoredBuffer& b2, std::string& b3);
 
-void print_markers(int max_len = Screen_Width);
+void print_markers(std::string& out, int max_len = Screen_Width);
 
 void printHelp
      (const char * s);
@@ -211,7 +245,8 @@ void printUsage
 long int revC
      (long int coord, long int len);
 
-bool find_sequence(const std::vector<string>& paths, const std::string& IdS, std::string& seq);
+bool find_sequence(const std::vector<string>& paths, const std::string& IdS, std::string& seq,
+                   long int lo, long int hi, long int& off, long int& len);
 
 //-------------------------------------------------- Function Definitions ----//
 int main
@@ -221,7 +256,8 @@ int main
 
   vector<AlignStats> Aligns;
 
-  std::string R, Q; // Reference & Query sequence
+  std::string R, Q; // Reference & Query sequence, or the aligned regions
+  long int offR, offQ, SeqLenR, SeqLenQ;
 
   std::string IdR, IdQ;
 
@@ -231,7 +267,7 @@ int main
     optarg = NULL;
 
     while ( !errflg  &&  ((ch = getopt
-                           (argc, argv, "hqrw:x:m:c")) != EOF) )
+                           (argc, argv, "hqrt:w:x:m:c")) != EOF) )
       switch (ch)
         {
         case 'h' :
@@ -247,6 +283,17 @@ int main
 	  isSortByReference = true;
 	  break;
 
+	case 't' :
+	  Nb_Threads = atoi (optarg);
+	  if ( Nb_Threads < 1 )
+	    {
+	      fprintf(stderr,
+		      "WARNING: invalid number of threads %d, using 1\n",
+		      Nb_Threads);
+	      Nb_Threads = 1;
+	    }
+	  break;
+
 	case 'w' :
 	  Screen_Width = atoi (optarg);
 	  if ( Screen_Width <= LINE_PREFIX_LEN )
@@ -301,14 +348,24 @@ int main
   //-- Read in the alignment data
   parseDelta (Aligns, IdR.c_str(), IdQ.c_str());
 
-  //-- Find, and read in the reference sequence
-  if(!find_sequence(RefFileNames, IdR, R))
+  //-- Find, and read in the aligned regions of the sequences. Promer
+  //   translates whole sequences
+  long int loR = LONG_MAX, hiR = 0, loQ = LONG_MAX, hiQ = 0;
+  if ( DATA_TYPE == NUCMER_DATA )
+    for ( i = 0; i < (long int)Aligns.size( ); i ++ )
+      {
+        loR = min(loR, min(Aligns[i].sR, Aligns[i].eR));
+        hiR = max(hiR, max(Aligns[i].sR, Aligns[i].eR));
+        loQ = min(loQ, min(Aligns[i].sQ, Aligns[i].eQ));
+        hiQ = max(hiQ, max(Aligns[i].sQ, Aligns[i].eQ));
+      }
+  if(!find_sequence(RefFileNames, IdR, R, loR, hiR, offR, SeqLenR))
     {
       fprintf(stderr,"ERROR: Could not find %s in the reference file\n", IdR.c_str());
       exit (EXIT_FAILURE);
     }
 
-  if(!find_sequence(QryFileNames, IdQ, Q))
+  if(!find_sequence(QryFileNames, IdQ, Q, loQ, hiQ, offQ, SeqLenQ))
   {
     fprintf(stderr,"ERROR: Could not find %s in the query file\n", IdQ.c_str());
     exit (EXIT_FAILURE);
@@ -326,7 +383,7 @@ int main
   printf("%s %s\n\n", RefFileNames[0].c_str(), QryFileNames[0].c_str());
   for ( i = 0; i < Screen_Width; i ++ ) printf("=");
   printf("\n-- Alignments between %s and %s\n\n", IdR.c_str(), IdQ.c_str());
-  printAlignments (Aligns, R, Q);
+  printAlignments (Aligns, R, offR, SeqLenR, Q, offQ, SeqLenQ);
   printf("\n");
   for ( i = 0; i < Screen_Width; i ++ ) printf("=");
   printf("\n");
@@ -365,7 +422,6 @@ void parseDelta
 
 {
   AlignStats aStats;                     //  single alignment region
-  bool found = false;
 
   DeltaReader_t dr;
   dr.open (InputFileName);
@@ -374,16 +430,7 @@ void parseDelta
   RefFileNames.push_back(dr.getReferencePath());
   QryFileNames.push_back(dr.getQueryPath());
 
-  while ( dr.readNext( ) )
-    {
-      if ( dr.getRecord( ).idR == IdR  &&
-	   dr.getRecord( ).idQ == IdQ )
-	{
-	  found = true;
-	  break;
-	}
-    }
-  if ( !found )
+  if ( !dr.readRecord( IdR, IdQ ) )
     {
       fprintf(stderr, "ERROR: Could not find any alignments for %s and %s\n",
 	      IdR.c_str(), IdQ.c_str());
@@ -411,16 +458,92 @@ void parseDelta
 
 
 void printAlignments
-(vector<AlignStats> Aligns, const std::string& R, const std::string& Q)
+(const vector<AlignStats>& Aligns, const std::string& R, long int offR, long int SeqLenR,
+ const std::string& Q, long int offQ, long int SeqLenQ)
 
-     // Print the alignments to the screen
+     // Print the alignments to the screen. Alignments are formatted in
+     // parallel, PRINT_BATCH at a time, and written in order
 
 {
-  vector<AlignStats>::iterator Ap;
-  vector<long int>::iterator Dp;
+  SeqView A[7], B[7];
+  std::string translated[7][2];
+  long int i;
+
+  if ( DATA_TYPE == NUCMER_DATA )
+    {
+      A[1] = SeqView (R.c_str(), offR, SeqLenR, false);
+      A[4] = SeqView (R.c_str(), offR, SeqLenR, true);
+      B[1] = SeqView (Q.c_str(), offQ, SeqLenQ, false);
+      B[4] = SeqView (Q.c_str(), offQ, SeqLenQ, true);
+    }
+  else
+    {
+      //-- Translate the frames used by the alignments
+      for ( i = 0; i < (long int)Aligns.size( ); i ++ )
+        {
+          long int sR = Aligns[i].sR, eR = Aligns[i].eR;
+          long int sQ = Aligns[i].sQ, eQ = Aligns[i].eQ;
+          int Ai = 1, Bi = 1;
+          if ( sR > eR )
+            {
+              sR = revC (sR, SeqLenR);
+              Ai += 3;
+            }
+          if ( sQ > eQ )
+            {
+              sQ = revC (sQ, SeqLenQ);
+              Bi += 3;
+            }
+          Ai += (sR + 2) % 3;
+          Bi += (sQ + 2) % 3;
+
+          if ( A[Ai].seq == NULL )
+            {
+              std::string& t = translated[Ai][0];
+              t.assign(SeqLenR / 3 + 2, '\0');
+              Translate_DNA ( R.c_str(), SeqLenR, &t[0], Ai );
+              A[Ai] = SeqView (t.c_str(), 0, SeqLenR / 3, false);
+            }
+          if ( B[Bi].seq == NULL )
+            {
+              std::string& t = translated[Bi][1];
+              t.assign(SeqLenQ / 3 + 2, '\0');
+              Translate_DNA ( Q.c_str(), SeqLenQ, &t[0], Bi );
+              B[Bi] = SeqView (t.c_str(), 0, SeqLenQ / 3, false);
+            }
+        }
+    }
+
+  std::vector<std::string> out;
+  for ( long int first = 0; first < (long int)Aligns.size( ); first += PRINT_BATCH )
+    {
+      const long int last = min((long int)Aligns.size( ), first + PRINT_BATCH);
+      out.resize(last - first);
+
+#pragma omp parallel for num_threads(Nb_Threads) schedule(dynamic)
+      for ( i = first; i < last; i ++ )
+        {
+          out[i - first].clear( );
+          formatAlignment (Aligns[i], A, B, SeqLenR, SeqLenQ, out[i - first]);
+        }
+
+      for ( i = first; i < last; i ++ )
+        fwrite (out[i - first].data( ), 1, out[i - first].size( ), stdout);
+    }
+}
+
+
+
+
+void formatAlignment
+(const AlignStats& Al, const SeqView* A, const SeqView* B, long int SeqLenR, long int SeqLenQ,
+ std::string& out)
+
+     // Format an alignment
+
+{
+  vector<long int>::const_iterator Dp;
 
-  const char * A[7] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL};
-  const char * B[7] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL};
   int Ai, Bi, i;
 
   ColoredBuffer Buff1, Buff2;
@@ -432,190 +555,91 @@ void printAlignments
   // long int Errors;
   long int Pos;
   char c; // Character to add to Buff3
+  char line[256];
 
   long int sR, eR, sQ, eQ;
   long int Apos, Bpos;
-  long int SeqLenR, SeqLenQ;
   int frameR, frameQ;
 
-  SeqLenR = R.size() - 1; // strlen (R + 1);
-  SeqLenQ = Q.size() - 1; // strlen (Q + 1);
+  sR = Al.sR;
+  eR = Al.eR;
+  sQ = Al.sQ;
+  eQ = Al.eQ;
 
-  if ( DATA_TYPE == NUCMER_DATA )
+  //-- Get the coords and frame right
+  frameR = 1;
+  if ( sR > eR )
     {
-      A[1] = R.c_str();
-      char* rcR = (char *) Safe_malloc ( sizeof(char) * (SeqLenR + 2) );
-      strcpy ( rcR + 1, A[1] + 1 );
-      rcR[0] = '\0';
-      Reverse_Complement ( rcR, 1, SeqLenR );
-      A[4] = rcR;
-
-      B[1] = Q.c_str();
-      char* rcQ = (char *) Safe_malloc ( sizeof(char) * (SeqLenQ + 2) );
-      strcpy ( rcQ + 1, B[1] + 1 );
-      rcQ[0] = '\0';
-      Reverse_Complement ( rcQ, 1, SeqLenQ );
-      B[4] = rcQ;
+      sR = revC (sR, SeqLenR);
+      eR = revC (eR, SeqLenR);
+      frameR += 3;
     }
-
-  for ( Ap = Aligns.begin( ); Ap < Aligns.end( ); Ap ++ )
+  frameQ = 1;
+  if ( sQ > eQ )
     {
-      sR = Ap->sR;
-      eR = Ap->eR;
-      sQ = Ap->sQ;
-      eQ = Ap->eQ;
-
-      //-- Get the coords and frame right
-      frameR = 1;
-      if ( sR > eR )
-	{
-	  sR = revC (sR, SeqLenR);
-	  eR = revC (eR, SeqLenR);
-	  frameR += 3;
-	}
-      frameQ = 1;
-      if ( sQ > eQ )
-	{
-	  sQ = revC (sQ, SeqLenQ);
-	  eQ = revC (eQ, SeqLenQ);
-	  frameQ += 3;
-	}
-
-      if ( DATA_TYPE == PROMER_DATA )
-	{
-	  frameR += (sR + 2) % 3;
-	  frameQ += (sQ + 2) % 3;
-
-	  //-- Translate the coordinates from DNA to Amino Acid
-	  //   remeber that eR and eQ point to the last nucleotide in the codon
-	  sR = (sR + 2) / 3;
-	  eR = eR / 3;
-	  sQ = (sQ + 2) / 3;
-	  eQ = eQ / 3;
-	}
-      Ai = frameR;
-      Bi = frameQ;
-      if ( frameR > 3 )
-	frameR = -(frameR - 3);
-      if ( frameQ > 3 )
-	frameQ = -(frameQ - 3);
-
-      //-- Get the sequence
-      if ( A[Ai] == NULL )
-	{
-	  assert ( DATA_TYPE == PROMER_DATA );
-	  char* translated = (char *) Safe_malloc ( sizeof(char) * ( SeqLenR / 3 + 2 ) );
-	  translated[0] = '\0';
-	  Translate_DNA ( R.c_str(), R.size() - 1, translated, Ai );
-          A[Ai] = translated;
-	}
-      if ( B[Bi] == NULL )
-	{
-	  assert ( DATA_TYPE == PROMER_DATA );
-          char* translated = (char *) Safe_malloc ( sizeof(char) * ( SeqLenQ / 3 + 2 ) );
-	  translated[0] = '\0';
-	  Translate_DNA ( Q.c_str(), Q.size() - 1, translated, Bi );
-	  B[Bi] = translated;
-
-	}
-
-
-      //-- Generate the alignment
-      printf("-- BEGIN alignment [ %s%d %ld - %ld | %s%d %ld - %ld ]\n\n",
-	     frameR > 0 ? "+" : "-", abs(frameR), Ap->sR, Ap->eR,
-	     frameQ > 0 ? "+" : "-", abs(frameQ), Ap->sQ, Ap->eQ);
-
-      Apos = sR;
-      Bpos = sQ;
-
-      //      Errors = 0;
-      Total = 0;
-      Remain = eR - sR + 1;
-
-      add_prefix(Buff1, Apos, SeqLenR, frameR);
-      add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
-      Pos = LINE_PREFIX_LEN;
-
-      for ( Dp = Ap->Delta.begin( );
-	    Dp < Ap->Delta.end( ) &&
-	    *Dp != 0; Dp ++ )
-	{
-	  Delta = *Dp;
-	  Sign = Delta > 0 ? 1 : -1;
-	  Delta = labs ( Delta );
-
-
-	  //-- For all the bases before the next indel
-	  for ( i = 1; i < Delta; i ++ )
-	    {
-	      if ( Pos >= Screen_Width ) {
-                print_buffers(Buff1, Buff2, Buff3);
-                add_prefix(Buff1, Apos, SeqLenR, frameR);
-                add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
-                Pos = LINE_PREFIX_LEN;
-              }
-
-	      if ( DATA_TYPE == NUCMER_DATA )
-                c = A[Ai][Apos] == B[Bi][Bpos] ? NUCMER_MATCH_CHAR : NUCMER_MISMATCH_CHAR;
-              else if ( A[Ai][Apos] == B[Bi][Bpos] )
-                c = A[Ai][Apos];
-	      else
-		c = mummer::sw_align::MATCH_SCORE
-		  [MATRIX_TYPE]
-		  [toupper(A[Ai][Apos]) - 'A']
-		  [toupper(B[Bi][Bpos]) - 'A'] > 0 ?
-		  PROMER_SIM_CHAR : PROMER_MISMATCH_CHAR;
-              append(Buff1, Buff2, Buff3, A[Ai][Apos++], B[Bi][Bpos++], c);
-              ++Pos;
-	    }
-
-
-	  //-- For the indel
-	  Remain -= i - 1;
-
-	  if ( Pos >= Screen_Width ) {
-            print_buffers(Buff1, Buff2, Buff3);
-            add_prefix(Buff1, Apos, SeqLenR, frameR);
-            add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
-            Pos = LINE_PREFIX_LEN;
-          }
+      sQ = revC (sQ, SeqLenQ);
+      eQ = revC (eQ, SeqLenQ);
+      frameQ += 3;
+    }
 
-	  if ( Sign == 1 )
-	    {
-	      if ( DATA_TYPE == NUCMER_DATA )
-		c = NUCMER_MISMATCH_CHAR;
-	      else
-		c = PROMER_MISMATCH_CHAR;
-              append(Buff1, Buff2, Buff3, A[Ai][Apos++], '.', c);
-	      Remain --;
-              ++Pos;
-	    }
-	  else
-	    {
-	      if ( DATA_TYPE == NUCMER_DATA )
-		c = NUCMER_MISMATCH_CHAR;
-	      else
-		c = PROMER_MISMATCH_CHAR;
-              append(Buff1, Buff2, Buff3, '.', B[Bi][Bpos++], c);
-	      Total ++;
-              ++Pos;
-	    }
-	}
+  if ( DATA_TYPE == PROMER_DATA )
+    {
+      frameR += (sR + 2) % 3;
+      frameQ += (sQ + 2) % 3;
+
+      //-- Translate the coordinates from DNA to Amino Acid
+      //   remeber that eR and eQ point to the last nucleotide in the codon
+      sR = (sR + 2) / 3;
+      eR = eR / 3;
+      sQ = (sQ + 2) / 3;
+      eQ = eQ / 3;
+    }
+  Ai = frameR;
+  Bi = frameQ;
+  if ( frameR > 3 )
+    frameR = -(frameR - 3);
+  if ( frameQ > 3 )
+    frameQ = -(frameQ - 3);
+
+  //-- Generate the alignment
+  snprintf(line, sizeof(line),
+           "-- BEGIN alignment [ %s%d %ld - %ld | %s%d %ld - %ld ]\n\n",
+           frameR > 0 ? "+" : "-", abs(frameR), Al.sR, Al.eR,
+           frameQ > 0 ? "+" : "-", abs(frameQ), Al.sQ, Al.eQ);
+  out += line;
+
+  Apos = sR;
+  Bpos = sQ;
+
+  //      Errors = 0;
+  Total = 0;
+  Remain = eR - sR + 1;
+
+  add_prefix(Buff1, Apos, SeqLenR, frameR);
+  add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
+  Pos = LINE_PREFIX_LEN;
+
+  for ( Dp = Al.Delta.begin( );
+	Dp < Al.Delta.end( ) &&
+	*Dp != 0; Dp ++ )
+    {
+      Delta = *Dp;
+      Sign = Delta > 0 ? 1 : -1;
+      Delta = labs ( Delta );
 
 
-      //-- For all the bases remaining after the last indel
-      for ( i = 0; i < Remain; i ++ )
+      //-- For all the bases before the next indel
+      for ( i = 1; i < Delta; i ++ )
 	{
 	  if ( Pos >= Screen_Width ) {
-            print_buffers(Buff1, Buff2, Buff3);
-            add_prefix(Buff1, Apos, SeqLenR, frameR);
-            add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
-            Pos = LINE_PREFIX_LEN;
-          }
+	    print_buffers(out, Buff1, Buff2, Buff3);
+	    add_prefix(Buff1, Apos, SeqLenR, frameR);
+	    add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
+	    Pos = LINE_PREFIX_LEN;
+	  }
 
 	  if ( DATA_TYPE == NUCMER_DATA )
-	    c = A[Ai][Apos] == B[Bi][Bpos] ?
-	      NUCMER_MATCH_CHAR : NUCMER_MISMATCH_CHAR;
+	    c = A[Ai][Apos] == B[Bi][Bpos] ? NUCMER_MATCH_CHAR : NUCMER_MISMATCH_CHAR;
 	  else if ( A[Ai][Apos] == B[Bi][Bpos] )
 	    c = A[Ai][Apos];
 	  else
@@ -624,34 +648,83 @@ void printAlignments
 	      [toupper(A[Ai][Apos]) - 'A']
 	      [toupper(B[Bi][Bpos]) - 'A'] > 0 ?
 	      PROMER_SIM_CHAR : PROMER_MISMATCH_CHAR;
-          append(Buff1, Buff2, Buff3, A[Ai][Apos++], B[Bi][Bpos++], c);
-          ++Pos;
+	  append(Buff1, Buff2, Buff3, A[Ai][Apos++], B[Bi][Bpos++], c);
+	  ++Pos;
 	}
 
 
-      //-- For the remaining buffered output
-      if ( Pos > LINE_PREFIX_LEN ) {
-        print_buffers(Buff1, Buff2, Buff3);
-        add_prefix(Buff1, Apos, SeqLenR, frameR);
-        add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
-        Pos = LINE_PREFIX_LEN;
+      //-- For the indel
+      Remain -= i - 1;
+
+      if ( Pos >= Screen_Width ) {
+	print_buffers(out, Buff1, Buff2, Buff3);
+	add_prefix(Buff1, Apos, SeqLenR, frameR);
+	add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
+	Pos = LINE_PREFIX_LEN;
       }
 
-      printf("\n--   END alignment [ %s%d %ld - %ld | %s%d %ld - %ld ]\n",
-	     frameR > 0 ? "+" : "-", abs(frameR), Ap->sR, Ap->eR,
-	     frameQ > 0 ? "+" : "-", abs(frameQ), Ap->sQ, Ap->eQ);
+      if ( Sign == 1 )
+	{
+	  if ( DATA_TYPE == NUCMER_DATA )
+	    c = NUCMER_MISMATCH_CHAR;
+	  else
+	    c = PROMER_MISMATCH_CHAR;
+	  append(Buff1, Buff2, Buff3, A[Ai][Apos++], '.', c);
+	  Remain --;
+	  ++Pos;
+	}
+      else
+	{
+	  if ( DATA_TYPE == NUCMER_DATA )
+	    c = NUCMER_MISMATCH_CHAR;
+	  else
+	    c = PROMER_MISMATCH_CHAR;
+	  append(Buff1, Buff2, Buff3, '.', B[Bi][Bpos++], c);
+	  Total ++;
+	  ++Pos;
+	}
     }
 
-  //-- Free the sequences, except for the originals
-  for ( i = 0; i < 7; i ++ )
+
+  //-- For all the bases remaining after the last indel
+  for ( i = 0; i < Remain; i ++ )
     {
-      if ( (DATA_TYPE != NUCMER_DATA || i != 1)  &&  A[i] != NULL )
-	free ( (void*)A[i] );
-      if ( (DATA_TYPE != NUCMER_DATA || i != 1)  &&  B[i] != NULL )
-	free ( (void*)B[i] );
+      if ( Pos >= Screen_Width ) {
+	print_buffers(out, Buff1, Buff2, Buff3);
+	add_prefix(Buff1, Apos, SeqLenR, frameR);
+	add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
+	Pos = LINE_PREFIX_LEN;
+      }
+
+      if ( DATA_TYPE == NUCMER_DATA )
+	c = A[Ai][Apos] == B[Bi][Bpos] ?
+	  NUCMER_MATCH_CHAR : NUCMER_MISMATCH_CHAR;
+      else if ( A[Ai][Apos] == B[Bi][Bpos] )
+	c = A[Ai][Apos];
+      else
+	c = mummer::sw_align::MATCH_SCORE
+	  [MATRIX_TYPE]
+	  [toupper(A[Ai][Apos]) - 'A']
+	  [toupper(B[Bi][Bpos]) - 'A'] > 0 ?
+	  PROMER_SIM_CHAR : PROMER_MISMATCH_CHAR;
+      append(Buff1, Buff2, Buff3, A[Ai][Apos++], B[Bi][Bpos++], c);
+      ++Pos;
     }
 
-  return;
+
+  //-- For the remaining buffered output
+  if ( Pos > LINE_PREFIX_LEN ) {
+    print_buffers(out, Buff1, Buff2, Buff3);
+    add_prefix(Buff1, Apos, SeqLenR, frameR);
+    add_prefix(Buff2, Bpos, SeqLenQ, frameQ);
+    Pos = LINE_PREFIX_LEN;
+  }
+
+  snprintf(line, sizeof(line),
+           "\n--   END alignment [ %s%d %ld - %ld | %s%d %ld - %ld ]\n",
+           frameR > 0 ? "+" : "-", abs(frameR), Al.sR, Al.eR,
+           frameQ > 0 ? "+" : "-", abs(frameQ), Al.sQ, Al.eQ);
+  out += line;
 }
 
 void base_color(ColoredBuffer& b, char c, bool m) {
@@ -691,8 +764,8 @@ void add_prefix(ColoredBuffer& Buff, long int pos, long int seqlen, int frame) {
   Buff += b;
 }
 
-void print_buffers(ColoredBuffer& Buff1, ColoredBuffer& Buff2, std::string& Buff3) {
-  print_markers(Buff1.bases());
+void print_buffers(std::string& out, ColoredBuffer& Buff1, ColoredBuffer& Buff2, std::string& Buff3) {
+  print_markers(out, Buff1.bases());
   if(Colorize) { // Make sure that we reset any color/property setting
     Buff1.reset();
     Buff2.reset();
@@ -702,40 +775,42 @@ void print_buffers(ColoredBuffer& Buff1, ColoredBuffer& Buff2, std::string& Buff
   const char* b3 = Buff3.c_str();
   if(DATA_TYPE != NUCMER_DATA)
     std::swap(b2, b3);
-  printf("%s\n"
-         "%s\n"
-         "%*s%s\n",
-         Buff1.c_str(),
-         Buff2.c_str(),
-         LINE_PREFIX_LEN, "", Buff3.c_str());
+  out += Buff1.c_str();
+  out += '\n';
+  out += Buff2.c_str();
+  out += '\n';
+  out.append(LINE_PREFIX_LEN, ' ');
+  out += Buff3;
+  out += '\n';
   Buff1.clear(); Buff2.clear(); Buff3.clear();
 }
 
-void print_markers(int max_len) {
+void print_markers(std::string& out, int max_len) {
   static const int maximums[7] = {1, 10, 100, 1000, 10000, 100000, 1000000};
   if(Marker_Width <= 0) {
-    printf("\n");
+    out += '\n';
     return;
   }
 
   const int max = maximums[std::min(6, Marker_Width - 1)];
-  printf("%*s", LINE_PREFIX_LEN, "");
+  out.append(LINE_PREFIX_LEN, ' ');
   if(Colorize)
-    printf("%s", ANSI_UNDERLINE);
+    out += ANSI_UNDERLINE;
   int i = Marker_Width;
   for( ; i <= max_len - LINE_PREFIX_LEN; i += Marker_Width) {
-    if(i < max)
-      printf("%*d|", Marker_Width - 1, i);
-    else
-      printf("%*s|", Marker_Width - 1, "");
+    const std::string n = i < max ? std::to_string(i) : std::string();
+    if(Marker_Width - 1 > (int)n.size())
+      out.append(Marker_Width - 1 - n.size(), ' ');
+    out += n;
+    out += '|';
   }
   if(Colorize) {
     i -= Marker_Width;
     if(i < max_len - LINE_PREFIX_LEN)
-      printf("%*s", max_len - LINE_PREFIX_LEN - i, "");
-    printf("%s", ANSI_RESET);
+      out.append(max_len - LINE_PREFIX_LEN - i, ' ');
+    out += ANSI_RESET;
   }
-  printf("\n");
+  out += '\n';
 }
 
 
@@ -751,6 +826,8 @@ void printHelp
            "-h            Display help information\n"
            "-q            Sort alignments by the query start coordinate\n"
            "-r            Sort alignments by the reference start coordinate\n"
+           "-t int        Set the number of threads formatting the alignments\n"
+           "              - default is 1\n"
            "-w int        Set the screen width - default is terminal width\n"
            "-c            Colorize bases on output\n"
            "-x int        Set the matrix type - default is 2 (BLOSUM 62)\n"
@@ -791,9 +868,9 @@ long int revC
   return len - coord + 1;
 }
 
-bool find_sequence(const std::vector<string>& paths, const std::string& Id, std::string& seq)
+static bool scan_sequence(const std::vector<string>& paths, const std::string& Id, std::string& seq)
 {
-  //-- Find, and read in sequences. Return if find one with name Id, and store it in seq.
+  //-- Read the sequences until one with name Id
   stream_manager streams(paths.cbegin(), paths.cend());
   sequence_parser parser(16, 10, 1, streams);
   bool found = false;
@@ -812,5 +889,46 @@ bool find_sequence(const std::vector<string>& paths, const std::string& Id, std:
       }
     }
   }
+  if(!found && parser.error()) {
+    try {
+      rethrow_exception(parser.error());
+    } catch(const exception& e) {
+      fprintf(stderr, "ERROR: Could not read %s: %s\n", paths.front().c_str(), e.what());
+      exit (EXIT_FAILURE);
+    }
+  }
   return found;
 }
+
+bool find_sequence(const std::vector<string>& paths, const std::string& Id, std::string& seq,
+                   long int lo, long int hi, long int& off, long int& len)
+{
+  //-- Find, and read in sequences. Return if find one with name Id, and store it in seq.
+  //   Use the index of a file when possible (see fasta_index.hh), read it sequentially
+  //   otherwise. With an index, only the region [lo, hi] (1 based) is read when lo <= hi,
+  //   and its first base is at seq[0] (off = lo). Otherwise seq is the whole sequence, 1
+  //   based (off = 0).
+  for(const auto& path : paths) {
+    mummer::fasta_index::indexed_fasta fasta;
+    if(fasta.open(path)) {
+      const auto e = fasta.find(Id);
+      if(!e) continue;
+      len = e->length;
+      if(lo > hi || lo < 1 || hi > len) {
+        off = 0;
+        return fasta.fetch(Id, seq);
+      }
+      off = lo;
+      seq.assign(hi - lo + 2, '\0');
+      seq.resize(fasta.fetch(*e, lo - 1, hi - lo + 1, &seq[0]));
+      seq += '\0';
+      return true;
+    }
+    if(scan_sequence(std::vector<string>(1, path), Id, seq)) {
+      off = 0;
+      len = seq.size() - 1;
+      return true;
+    }
+  }
+  return false;
+}
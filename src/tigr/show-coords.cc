@@ -17,7 +17,12 @@
 #include <mummer/delta.hh>
 #include <mummer/tigrinc.hh>
 #include <mummer/redirect_to_pager.hpp>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string>
 #include <vector>
+#include <deque>
+#include <queue>
 #include <algorithm>
 using namespace std;
 
@@ -30,6 +35,13 @@ const float MIN_LENGTH_P = 0.75; // winner must be atleast this big as loser
 const float MAX_OHANG_P = 0.05; // max overlap hang as a percentage of overlap
 const float MAX_PIDYDIFF = 0.01;
 
+//-- for the output, rows formatted before writing, and rows per thread task
+const size_t PRINT_BATCH = 1 << 14;
+const size_t PRINT_CHUNK = 256;
+
+//-- for the -r and -q options, sorted runs merged at once
+const size_t MAX_MERGE_RUNS = 64;
+
 
 //------------------------------------------------------ Type Definitions ----//
 struct AlignStats
@@ -42,11 +54,46 @@ struct AlignStats
   int FrameA, FrameB;                     // reading frame
   long int sA, eA, sB, eB;                // start, end in A, start, end in B
   long int SeqLenA, SeqLenB;              // length of seq A, seq B
-  char * IdA, * IdB;                      // Id of seq A, Id of seq B
+  const char * IdA, * IdB;                // Id of seq A, Id of seq B
   char annot [12];                        // annotation string
 };
 
 
+struct AlignBatch
+     //-- Alignment rows waiting to be sorted or printed, with the storage
+     //   of their sequence Ids
+{
+  vector<AlignStats> Stats;
+  deque<string> Ids;                      // pairs of Ids, stable addresses
+  size_t bytes;                           // approximate memory used
+
+  AlignBatch ( ) : bytes (0) { }
+
+  void push (const AlignStats & S)
+  {
+    size_t n = Ids.size( );
+    if ( n < 2  ||  Ids[n - 2] != S.IdA  ||  Ids[n - 1] != S.IdB )
+      {
+	Ids.push_back (S.IdA);
+	Ids.push_back (S.IdB);
+	bytes += 2 * sizeof (string) + Ids[n].size( ) + Ids[n + 1].size( );
+	n += 2;
+      }
+    Stats.push_back (S);
+    Stats.back( ).IdA = Ids[n - 2].c_str( );
+    Stats.back( ).IdB = Ids[n - 1].c_str( );
+    bytes += sizeof (AlignStats);
+  }
+
+  void clear ( )
+  {
+    vector<AlignStats>( ).swap (Stats);
+    Ids.clear( );
+    bytes = 0;
+  }
+};
+
+
 struct LASstats
 {
   bool ori;
@@ -167,6 +214,44 @@ struct IdB_sB_IdA_sA_Sort
 
 
 
+struct Row_Sort
+     //-- For sorting AlignStats as requested by the -r or -q option
+{
+  bool operator() (const AlignStats & pA, const AlignStats & pB) const;
+};
+
+
+struct RunHead
+     //-- Next row of a sorted run being merged
+{
+  FILE * f;
+  AlignStats S;
+  string IdA, IdB;
+};
+
+
+struct RunHead_Sort
+     //-- Orders the heads of the runs so the smallest row is on top of a
+     //   priority queue, breaking ties by run to keep the sort stable
+{
+  const vector<RunHead> * heads;
+
+  bool operator() (size_t i, size_t j) const
+  {
+    const AlignStats & pA = (*heads)[i].S;
+    const AlignStats & pB = (*heads)[j].S;
+    if ( Row_Sort( ) (pB, pA) )
+      return true;
+    else if ( Row_Sort( ) (pA, pB) )
+      return false;
+    else
+      return j < i;
+  }
+};
+
+
+
+
 //--------------------------------------------------- Global Option Flags ----//
 bool isKnockout = false;                // -k option
 bool isAnnotateOverlaps = false;        // -o option
@@ -185,9 +270,13 @@ bool isPrintHeader = true;              // -H option
 bool isAnnotation = false;              // true if either -w or -o
 float idyCutoff = 0;                    // -I option
 long int lenCutoff = 0;                 // -L option
+size_t SortMemory = 1UL << 30;          // -M option
+int  nbThreads = 1;                     // -t option
 int  whichDataType = NUCMER_DATA;       // set by .delta header
 char InputFileName [MAX_LINE];          //  I/O filenames
 char RefFileName [MAX_LINE], QryFileName [MAX_LINE];
+char BtabDate [MAX_LINE];               // date and type of the btab rows
+const char * BtabType;
 
 
 
@@ -207,17 +296,33 @@ void annotateOverlaps
 void flagLAS
      (vector<AlignStats> & Stats);
 
-void parseDelta
-     (vector<AlignStats> & Stats);
+void openDelta
+     (DeltaReader_t & dr);
+
+void parseRecord
+     (const DeltaRecord_t & Rec, const char * IdA, const char * IdB,
+      vector<AlignStats> & Stats);
+
+void formatBtab
+     (const AlignStats & S, string & out);
+
+void formatHuman
+     (const AlignStats & S, string & out);
+
+void formatTabular
+     (const AlignStats & S, string & out);
 
-void printBtab
-     (vector<AlignStats> Stats);
+void printHeader
+     ( );
 
-void printHuman
-     (vector<AlignStats> Stats);
+void printRows
+     (AlignBatch & Batch);
 
-void printTabular
-     (vector<AlignStats> Stats);
+FILE * spillRun
+     (AlignBatch & Batch);
+
+void mergeRuns
+     (vector<FILE *> & Runs, AlignBatch & Batch);
 
 inline long int revC
      (long int Coord, long int Len);
@@ -246,7 +351,7 @@ inline void swap
 int main
      (int argc, char ** argv)
 {  
-  vector<AlignStats> Stats;            //  all the alignment regions
+  vector<AlignStats> Stats;            //  alignments of a sequence pair
 
   //-- Parse the command line arguments
   {
@@ -254,7 +359,7 @@ int main
     optarg = NULL;
 
     while ( !errflg &&
-	    ((ch = getopt (argc, argv, "bkBdhTHqrgGclowI:L:")) != EOF) )
+	    ((ch = getopt (argc, argv, "bkBdhTHqrgGclowI:L:M:t:")) != EOF) )
       switch (ch)
 	{
 	case 'b' :
@@ -298,6 +403,20 @@ int main
 	  lenCutoff = atol (optarg);
 	  break;
 
+	case 'M' :
+	  {
+	    char * end;
+	    double size = strtod (optarg, &end);
+	    switch ( toupper (*end) )
+	      {
+	      case 'G' : size *= 1024;
+	      case 'M' : size *= 1024;
+	      case 'K' : size *= 1024;
+	      }
+	    SortMemory = size > 0 ? (size_t)size : 0;
+	  }
+	  break;
+
 	case 'o' :
 	  isAnnotateOverlaps = true;
 	  break;
@@ -319,6 +438,10 @@ int main
 	  isWLAS = true;
 	  break;
 
+	case 't' :
+	  nbThreads = atoi (optarg);
+	  break;
+
 	case 'T' :
 	  isPrintTabular = true;
 	  break;
@@ -394,15 +517,30 @@ int main
 	exit (EXIT_FAILURE);
       }
 
+    if ( SortMemory == 0 )
+      {
+	fprintf(stderr,
+		"\nERROR: Memory limit must be positive\n");
+	exit (EXIT_FAILURE);
+      }
+
+    if ( nbThreads < 1 )
+      {
+	fprintf(stderr,
+		"\nERROR: Number of threads must be positive\n");
+	exit (EXIT_FAILURE);
+      }
+
     if ( isShowWarnings || isAnnotateOverlaps )
       isAnnotation = true;
   }
 
   srand (time (NULL));
 
-  //-- Open and parse the delta file
+  //-- Open the delta file
   strcpy (InputFileName, argv[optind ++]);
-  parseDelta (Stats);
+  DeltaReader_t dr;
+  openDelta (dr);
 
   //-- Can only pick best frame for promer data
   if ( isKnockout && whichDataType != PROMER_DATA )
@@ -414,39 +552,63 @@ int main
   if ( whichDataType == PROMER_DATA )
     isShowDir = true;
 
-  //-- NOTE: simplifyAlignments assumes all alignments from two
-  //   sequences are grouped together (as ouput be postpro/nuc)
-  if ( isBrief || isKnockout )
-    simplifyAlignments (Stats);
-
-  //-- NOTE: flagLAS assumes all alignments from two
-  //   sequences are grouped together (as ouput be postpro/nuc)
-  if ( isLAS )
-    flagLAS (Stats);
-
-  //-- Sort the alignment regions if user passed -r or -q option
-  if ( isSortByReference )
-    sort (Stats.begin( ), Stats.end( ), IdA_sA_IdB_sB_Sort( ));
-  else if ( isSortByQuery )
-    sort (Stats.begin( ), Stats.end( ), IdB_sB_IdA_sA_Sort( ));
-
-
-  //-- Generate overlap warnings if user passed -w option
-  if ( isShowWarnings )
-    generateWarnings (Stats);
-
-  //-- Generate overlap annotations if user passed -o option
-  if ( isAnnotateOverlaps )
-    annotateOverlaps (Stats);
-
   //-- Output data to stdout, tabular if -T option was used
   stdio_launch_pager redirect_to_pager;
-  if ( isBtab )
-    printBtab (Stats);
-  else if ( isPrintTabular )
-    printTabular (Stats);
-  else
-    printHuman (Stats);
+  printHeader ( );
+
+  //-- Stream the delta file, one sequence pair at a time. Unsorted rows
+  //   are printed as they come, sorted rows are kept in memory up to the
+  //   -M limit and then spilled to disk as sorted runs
+  const bool isSorted = isSortByReference || isSortByQuery;
+  AlignBatch Batch;
+  vector<FILE *> Runs;
+  string IdA, IdB;
+  bool more = dr.readNextHeadersOnly( );
+  while ( more )
+    {
+      Stats.clear( );
+      IdA = dr.getRecord( ).idR;
+      IdB = dr.getRecord( ).idQ;
+      do
+	{
+	  parseRecord (dr.getRecord( ), IdA.c_str( ), IdB.c_str( ), Stats);
+	  more = dr.readNextHeadersOnly( );
+	}
+      while ( more  &&
+	      dr.getRecord( ).idR == IdA  &&  dr.getRecord( ).idQ == IdB );
+
+      //-- NOTE: simplifyAlignments assumes all alignments from two
+      //   sequences are grouped together (as ouput be postpro/nuc)
+      if ( isBrief || isKnockout )
+	simplifyAlignments (Stats);
+
+      //-- NOTE: flagLAS assumes all alignments from two
+      //   sequences are grouped together (as ouput be postpro/nuc)
+      if ( isLAS )
+	flagLAS (Stats);
+
+      //-- Rows knocked out above are never printed
+      for ( vector<AlignStats>::iterator Sip = Stats.begin( );
+	    Sip < Stats.end( ); Sip ++ )
+	if ( Sip->sA >= 0 )
+	  Batch.push (*Sip);
+
+      if ( isSorted  &&  Batch.bytes >= SortMemory )
+	Runs.push_back (spillRun (Batch));
+      else if ( !isSorted  &&  Batch.Stats.size( ) >= PRINT_BATCH )
+	printRows (Batch);
+    }
+  dr.close( );
+
+  //-- Sort the alignment regions if user passed -r or -q option
+  if ( isSorted  &&  !Runs.empty( ) )
+    {
+      Runs.push_back (spillRun (Batch));
+      mergeRuns (Runs, Batch);
+    }
+  else if ( isSorted )
+    stable_sort (Batch.Stats.begin( ), Batch.Stats.end( ), Row_Sort( ));
+  printRows (Batch);
   fclose(stdout);
 
   return EXIT_SUCCESS;
@@ -702,34 +864,37 @@ void generateWarnings
 
      //  Generate warnings for each alignment region if it overlaps or in any
      //  other way conflicts with the alignment preceding it. Set its
-     //  warning field appropriately.
+     //  warning field appropriately. The rows are printed in batches, so the
+     //  preceding alignment may belong to the previous batch.
 
 {  
+  static AlignStats Prev;
+  static string PrevIdA, PrevIdB;
+  static bool isPrev = false;
   vector<AlignStats>::iterator Sip;
-  vector<AlignStats>::iterator Sprev;
+  const AlignStats * Sprev = &Prev;
   long int s1, e1, s2, e2, ps1, pe1, ps2, pe2;
   long int tmp;
 
-  if ( !Stats.empty( ) )
-    Stats.begin()->annot [0] = '\0';
-  for ( Sip = Stats.begin( ) + 1; Sip < Stats.end( ); Sip ++ )
+  for ( Sip = Stats.begin( ); Sip < Stats.end( ); Sip ++ )
     {
       Sip->annot [0] = '\0';
 
       if ( Sip->sA < 0 )
 	continue;
 
-      for ( Sprev = Sip - 1;
-	    Sprev >= Stats.begin( )  &&  Sprev->sA < 0;
-	    Sprev -- )
-	{ };
-
-      if ( Sprev < Stats.begin( ) ||
+      if ( !isPrev ||
 	   //	   Sip->FrameA != Sprev->FrameA  ||
 	   //	   Sip->FrameB != Sprev->FrameB  ||
-	   strcmp ( Sip->IdA , Sprev->IdA ) != 0 ||
-	   strcmp ( Sip->IdB , Sprev->IdB ) != 0 )
-	continue;
+	   PrevIdA != Sip->IdA  ||
+	   PrevIdB != Sip->IdB )
+	{
+	  Prev = *Sip;
+	  PrevIdA = Sip->IdA;
+	  PrevIdB = Sip->IdB;
+	  isPrev = true;
+	  continue;
+	}
 
       ps1 = Sprev->sA;
       pe1 = Sprev->eA;
@@ -781,159 +946,173 @@ void generateWarnings
       else if ( (s2 >= ps2 && s2 <= pe2) || (e2 >= ps2 && e2 <= pe2) )
 	strcpy ( Sip->annot , "[OVERLAPS]" );
       //-- else No Conflict
+
+      Prev = *Sip;
     }
 }
 
 
 
 
-void printBtab
-     (vector<AlignStats> Stats)
-{
-  time_t currtime;
-  const char * type;
-  char date[MAX_LINE];
-  long int len;
-  vector<AlignStats>::iterator Sip;
+static void appendf
+     (string & out, const char * format, ...)
 
-  currtime = time(NULL);
-  strftime (date, MAX_LINE, "%b %d %Y", localtime(&currtime));
-  if ( whichDataType == NUCMER_DATA )
-    type = "NUCMER";
-  else if ( whichDataType == PROMER_DATA )
-    type = "PROMER";
-  else
-    type = "NULL";
-  
-  //-- Print the stats
-  for ( Sip = Stats.begin( ); Sip < Stats.end( ); Sip ++ )
+     //  Append a printf formatted string to out
+
+{
+  char buff [256];
+  va_list ap;
+  va_start (ap, format);
+  int n = vsnprintf (buff, sizeof (buff), format, ap);
+  va_end (ap);
+  if ( n < (int)sizeof (buff) )
     {
-      if ( Sip->sA < 0 )
-	continue;
+      out.append (buff, n);
+      return;
+    }
 
-      len = labs(Sip->eB - Sip->sB) + 1;
+  size_t size = out.size( );
+  out.resize (size + n + 1);
+  va_start (ap, format);
+  vsnprintf (&out[size], n + 1, format, ap);
+  va_end (ap);
+  out.resize (size + n);
+}
 
-      //-- Output the stats for this alignment in btab format
-      printf("%s\t%s\t%ld\t%s\t%s\t%s\t",
-	     Sip->IdB, date, Sip->SeqLenB, type, RefFileName, Sip->IdA);
 
-      printf("%ld\t%ld\t%ld\t%ld\t%f\t%f\t%ld\t0\t0\tNULL\t",
-	     Sip->sB, Sip->eB, Sip->sA, Sip->eA,
-	     Sip->Idy, Sip->Sim, len);
 
-      printf("%d\t%s\t%ld\t0\t0\n",
-	     whichDataType == NUCMER_DATA ? 0 : Sip->FrameA,
-	     Sip->FrameB < 0 ? "Minus" : "Plus", Sip->SeqLenA);
-    }
 
-  return;
+void formatBtab
+     (const AlignStats & S, string & out)
+
+     //  Format an alignment in btab format
+
+{
+  long int len;
+
+  len = labs(S.eB - S.sB) + 1;
+
+  //-- Output the stats for this alignment in btab format
+  appendf(out, "%s\t%s\t%ld\t%s\t%s\t%s\t",
+	  S.IdB, BtabDate, S.SeqLenB, BtabType, RefFileName, S.IdA);
+
+  appendf(out, "%ld\t%ld\t%ld\t%ld\t%f\t%f\t%ld\t0\t0\tNULL\t",
+	  S.sB, S.eB, S.sA, S.eA,
+	  S.Idy, S.Sim, len);
+
+  appendf(out, "%d\t%s\t%ld\t0\t0\n",
+	  whichDataType == NUCMER_DATA ? 0 : S.FrameA,
+	  S.FrameB < 0 ? "Minus" : "Plus", S.SeqLenA);
 }
 
 
 
 
-void printHuman
-     (vector<AlignStats> Stats)
+void formatHuman
+     (const AlignStats & S, string & out)
 
-     //  Print stats in a human readable format
+     //  Format an alignment in a human readable format
 
 {
   long int len1, len2;
   float covA, covB;
-  vector<AlignStats>::iterator Sip;
 
-  //-- Print the output header
-  if ( isPrintHeader )
+  len1 = labs(S.eA - S.sA) + 1;
+  len2 = labs(S.eB - S.sB) + 1;
+  covA = (float)len1 / (float)S.SeqLenA * 100.0;
+  covB = (float)len2 / (float)S.SeqLenB * 100.0;
+
+  //-- Output the statistics for this alignment region
+  appendf(out, "%8ld %8ld  | ", S.sA, S.eA);
+  appendf(out, "%8ld %8ld  | ", S.sB, S.eB);
+  appendf(out, "%8ld %8ld  | ", len1, len2);
+  if ( !isBrief )
     {
-      printf ("%s %s\n%s\n\n", RefFileName, QryFileName,
-	      whichDataType == NUCMER_DATA ? "NUCMER" : "PROMER");
-      printf("%8s %8s  | ", "[S1]", "[E1]");
-      printf("%8s %8s  | ", "[S2]", "[E2]");
-      printf("%8s %8s  | ", "[LEN 1]", "[LEN 2]");
-      if ( !isBrief )
-	{
-	  printf("%8s ", "[% IDY]");
-	  if ( whichDataType == PROMER_DATA )
-	    printf("%8s %8s ", "[% SIM]", "[% STP]");
-	  printf(" | ");
-	}
-      if ( isShowSeqLens )
-	printf("%8s %8s  | ", "[LEN R]", "[LEN Q]");
-      if ( isShowCoverage )
-	printf("%8s %8s  | ", "[COV R]", "[COV Q]");
-      if ( !isBrief  &&  isShowDir )
-	printf("%5s  ", "[FRM]");
-      printf("%s", "[TAGS]");
-      printf("\n");
-      if ( isShowSeqLens )
-	printf("=====================");
-      if ( isShowCoverage )
-	printf("=====================");
-      if ( !isBrief )
-	{
-	  printf("============");
-	  if ( isShowDir )
-	    printf("=======");
-	  if ( whichDataType == PROMER_DATA )
-	    printf("==================");
-	}
-      printf("===================================="
-	     "=====================================\n");
+      appendf(out, "%8.2f ", S.Idy);
+      if ( whichDataType == PROMER_DATA )
+	appendf(out, "%8.2f %8.2f ", S.Sim, S.Stp);
+      out += " | ";
     }
+  if ( isShowSeqLens )
+    appendf(out, "%8ld %8ld  | ", S.SeqLenA, S.SeqLenB);
+  if ( isShowCoverage )
+    appendf(out, "%8.2f %8.2f  | ", covA, covB);
+  if ( !isBrief  &&  isShowDir )
+    appendf(out, "%2d %2d  ", S.FrameA, S.FrameB);
+  appendf(out, "%s\t%s", S.IdA, S.IdB);
+  if ( isAnnotation )
+    appendf(out, "\t%s", S.annot);
+
+  out += '\n';
+}
 
-  //-- Print the stats
-  for ( Sip = Stats.begin( ); Sip < Stats.end( ); Sip ++ )
-    {
-      if ( Sip->sA < 0 )
-	continue;
 
-      len1 = labs(Sip->eA - Sip->sA) + 1;
-      len2 = labs(Sip->eB - Sip->sB) + 1;
-      covA = (float)len1 / (float)Sip->SeqLenA * 100.0;
-      covB = (float)len2 / (float)Sip->SeqLenB * 100.0;
 
-      //-- Output the statistics for this alignment region
-      printf("%8ld %8ld  | ", Sip->sA, Sip->eA);
-      printf("%8ld %8ld  | ", Sip->sB, Sip->eB);
-      printf("%8ld %8ld  | ", len1, len2);
-      if ( !isBrief )
-	{
-	  printf("%8.2f ", Sip->Idy);
-	  if ( whichDataType == PROMER_DATA )
-	    printf("%8.2f %8.2f ", Sip->Sim, Sip->Stp);
-	  printf(" | ");
-	}
-      if ( isShowSeqLens )
-	printf("%8ld %8ld  | ", Sip->SeqLenA, Sip->SeqLenB);
-      if ( isShowCoverage )
-	printf("%8.2f %8.2f  | ", covA, covB);
-      if ( !isBrief  &&  isShowDir )
-	printf("%2d %2d  ", Sip->FrameA, Sip->FrameB);
-      printf("%s\t%s", Sip->IdA, Sip->IdB);
-      if ( isAnnotation )
-	printf("\t%s", Sip->annot);
 
-      printf("\n");
-    }
+void formatTabular
+     (const AlignStats & S, string & out)
 
-  return;
+     //  Format an alignment in a column delimited format
+
+{
+  long int len1, len2;
+  float covA, covB;
+
+  len1 = labs(S.eA - S.sA) + 1;
+  len2 = labs(S.eB - S.sB) + 1;
+  covA = (float)len1 / (float)S.SeqLenA * 100.0;
+  covB = (float)len2 / (float)S.SeqLenB * 100.0;
+
+  //-- Output the statistics for this alignment region
+  appendf(out, "%ld\t%ld\t", S.sA, S.eA);
+  appendf(out, "%ld\t%ld\t", S.sB, S.eB);
+  appendf(out, "%ld\t%ld\t", len1, len2);
+  if ( !isBrief )
+    {
+      appendf(out, "%.2f\t", S.Idy);
+      if ( whichDataType == PROMER_DATA )
+	appendf(out, "%.2f\t%.2f\t", S.Sim, S.Stp);
+    }
+  if ( isShowSeqLens )
+    appendf(out, "%ld\t%ld\t", S.SeqLenA, S.SeqLenB);
+  if ( isShowCoverage )
+    appendf(out, "%.2f\t%.2f\t", covA, covB);
+  if ( !isBrief  &&  isShowDir )
+    appendf(out, "%d\t%d\t", S.FrameA, S.FrameB);
+  appendf(out, "%s\t%s", S.IdA, S.IdB);
+  if ( isAnnotation )
+    appendf(out, "\t%s", S.annot);
+  out += '\n';
 }
 
 
 
 
-void printTabular
-     (vector<AlignStats> Stats)
+void printHeader
+     ( )
 
-     //  Print stats in a column delimited format
+     //  Print the output header, human readable or tabular
 
 {
-  long int len1, len2;
-  float covA, covB;
-  vector<AlignStats>::iterator Sip;
+  time_t currtime;
 
-  //-- Print the output header
-  if ( isPrintHeader )
+  if ( isBtab )
+    {
+      currtime = time(NULL);
+      strftime (BtabDate, MAX_LINE, "%b %d %Y", localtime(&currtime));
+      if ( whichDataType == NUCMER_DATA )
+	BtabType = "NUCMER";
+      else if ( whichDataType == PROMER_DATA )
+	BtabType = "PROMER";
+      else
+	BtabType = "NULL";
+      return;
+    }
+
+  if ( !isPrintHeader )
+    return;
+
+  if ( isPrintTabular )
     {
       printf ("%s %s\n%s\n\n", RefFileName, QryFileName,
 	      whichDataType == NUCMER_DATA ? "NUCMER" : "PROMER");
@@ -953,160 +1132,383 @@ void printTabular
       if ( !isBrief  &&  isShowDir )
 	printf("%s\t", "[FRM]");
       printf("%s\n", "[TAGS]");
+      return;
     }
 
-  //-- Print the stats
-  for ( Sip = Stats.begin( ); Sip < Stats.end( ); Sip ++ )
+  printf ("%s %s\n%s\n\n", RefFileName, QryFileName,
+	  whichDataType == NUCMER_DATA ? "NUCMER" : "PROMER");
+  printf("%8s %8s  | ", "[S1]", "[E1]");
+  printf("%8s %8s  | ", "[S2]", "[E2]");
+  printf("%8s %8s  | ", "[LEN 1]", "[LEN 2]");
+  if ( !isBrief )
     {
-      if ( Sip->sA < 0 )
-	continue;
+      printf("%8s ", "[% IDY]");
+      if ( whichDataType == PROMER_DATA )
+	printf("%8s %8s ", "[% SIM]", "[% STP]");
+      printf(" | ");
+    }
+  if ( isShowSeqLens )
+    printf("%8s %8s  | ", "[LEN R]", "[LEN Q]");
+  if ( isShowCoverage )
+    printf("%8s %8s  | ", "[COV R]", "[COV Q]");
+  if ( !isBrief  &&  isShowDir )
+    printf("%5s  ", "[FRM]");
+  printf("%s", "[TAGS]");
+  printf("\n");
+  if ( isShowSeqLens )
+    printf("=====================");
+  if ( isShowCoverage )
+    printf("=====================");
+  if ( !isBrief )
+    {
+      printf("============");
+      if ( isShowDir )
+	printf("=======");
+      if ( whichDataType == PROMER_DATA )
+	printf("==================");
+    }
+  printf("===================================="
+	 "=====================================\n");
+}
 
-      len1 = labs(Sip->eA - Sip->sA) + 1;
-      len2 = labs(Sip->eB - Sip->sB) + 1;
-      covA = (float)len1 / (float)Sip->SeqLenA * 100.0;
-      covB = (float)len2 / (float)Sip->SeqLenB * 100.0;
 
-      //-- Output the statistics for this alignment region
-      printf("%ld\t%ld\t", Sip->sA, Sip->eA);
-      printf("%ld\t%ld\t", Sip->sB, Sip->eB);
-      printf("%ld\t%ld\t", len1, len2);
-      if ( !isBrief )
+
+
+void printRows
+     (AlignBatch & Batch)
+
+     //  Annotate, format and print the rows of the batch, in order. Rows
+     //  are formatted in parallel, PRINT_BATCH rows at a time
+
+{
+  vector<string> out;
+  vector<AlignStats> & Stats = Batch.Stats;
+
+  //-- Generate overlap warnings if user passed -w option
+  if ( isShowWarnings )
+    generateWarnings (Stats);
+
+  //-- Generate overlap annotations if user passed -o option
+  if ( isAnnotateOverlaps )
+    annotateOverlaps (Stats);
+
+  for ( size_t first = 0; first < Stats.size( ); first += PRINT_BATCH )
+    {
+      const size_t last = min (Stats.size( ), first + PRINT_BATCH);
+      const long chunks = (last - first + PRINT_CHUNK - 1) / PRINT_CHUNK;
+      out.resize (chunks);
+
+#pragma omp parallel for num_threads(nbThreads) schedule(dynamic)
+      for ( long c = 0; c < chunks; c ++ )
 	{
-	  printf("%.2f\t", Sip->Idy);
-	  if ( whichDataType == PROMER_DATA )
-	    printf("%.2f\t%.2f\t", Sip->Sim, Sip->Stp);
+	  const size_t end = min (last, first + (c + 1) * PRINT_CHUNK);
+	  out[c].clear( );
+	  for ( size_t i = first + c * PRINT_CHUNK; i < end; i ++ )
+	    {
+	      if ( isBtab )
+		formatBtab (Stats[i], out[c]);
+	      else if ( isPrintTabular )
+		formatTabular (Stats[i], out[c]);
+	      else
+		formatHuman (Stats[i], out[c]);
+	    }
 	}
-      if ( isShowSeqLens )
-	  printf("%ld\t%ld\t", Sip->SeqLenA, Sip->SeqLenB);
-      if ( isShowCoverage )
-	  printf("%.2f\t%.2f\t", covA, covB);
-      if ( !isBrief  &&  isShowDir )
-	printf("%d\t%d\t", Sip->FrameA, Sip->FrameB);
-      printf("%s\t%s", Sip->IdA, Sip->IdB);
-      if ( isAnnotation )
-	printf("\t%s", Sip->annot);
-      printf("\n");
+
+      for ( long c = 0; c < chunks; c ++ )
+	fwrite (out[c].data( ), 1, out[c].size( ), stdout);
     }
 
-  return;
+  Batch.clear( );
 }
 
 
 
 
-void parseDelta
-     (vector<AlignStats> & Stats)
+bool Row_Sort::operator()
+     (const AlignStats & pA, const AlignStats & pB) const
+{
+  if ( isSortByReference )
+    return IdA_sA_IdB_sB_Sort( ) (pA, pB);
+  else
+    return IdB_sB_IdA_sA_Sort( ) (pA, pB);
+}
+
+
 
-     //  parse the delta file
+
+static FILE * tempRun
+     ( )
+
+     //  Open an anonymous temporary file, in $TMPDIR or /tmp
 
 {
-  int frameA, frameB;                  //  sequence frame
-  long int sA, eA, sB, eB;
-  AlignStats CurrStats;                //  single alignment region
+  const char * dir = getenv ("TMPDIR");
+  string path = string (dir && *dir ? dir : "/tmp") + "/show-coords.XXXXXX";
+  int fd = mkstemp (&path[0]);
+  FILE * f = fd < 0 ? NULL : fdopen (fd, "w+");
+  if ( f == NULL )
+    {
+      fprintf (stderr, "ERROR: Could not create temporary file in %s, %s\n",
+	       dir && *dir ? dir : "/tmp", strerror (errno));
+      exit (EXIT_FAILURE);
+    }
+  unlink (path.c_str( ));
+  return f;
+}
 
-  DeltaReader_t dr;
+
+
+
+static void writeRow
+     (FILE * f, const AlignStats & S)
+{
+  unsigned int lenA = strlen (S.IdA), lenB = strlen (S.IdB);
+  fwrite (&S, sizeof (AlignStats), 1, f);
+  fwrite (&lenA, sizeof (lenA), 1, f);
+  fwrite (&lenB, sizeof (lenB), 1, f);
+  fwrite (S.IdA, 1, lenA, f);
+  fwrite (S.IdB, 1, lenB, f);
+}
+
+
+
+
+static bool readRow
+     (RunHead & h)
+{
+  unsigned int lenA, lenB;
+  if ( fread (&h.S, sizeof (AlignStats), 1, h.f) != 1 )
+    return false;
+  if ( fread (&lenA, sizeof (lenA), 1, h.f) != 1  ||
+       fread (&lenB, sizeof (lenB), 1, h.f) != 1 )
+    return false;
+  h.IdA.resize (lenA);
+  h.IdB.resize (lenB);
+  if ( fread (&h.IdA[0], 1, lenA, h.f) != lenA  ||
+       fread (&h.IdB[0], 1, lenB, h.f) != lenB )
+    return false;
+  h.S.IdA = h.IdA.c_str( );
+  h.S.IdB = h.IdB.c_str( );
+  return true;
+}
+
+
+
+
+static void finishRun
+     (FILE * f)
+{
+  if ( fflush (f) != 0  ||  ferror (f)  ||  fseek (f, 0, SEEK_SET) != 0 )
+    {
+      fprintf (stderr, "ERROR: Could not write temporary file, %s\n",
+	       strerror (errno));
+      exit (EXIT_FAILURE);
+    }
+}
+
+
+
+
+FILE * spillRun
+     (AlignBatch & Batch)
+
+     //  Sort the rows of the batch and write them to a temporary file
+
+{
+  FILE * f = tempRun( );
+  vector<AlignStats>::iterator Sip;
+
+  stable_sort (Batch.Stats.begin( ), Batch.Stats.end( ), Row_Sort( ));
+  for ( Sip = Batch.Stats.begin( ); Sip < Batch.Stats.end( ); Sip ++ )
+    writeRow (f, *Sip);
+  finishRun (f);
+  Batch.clear( );
+
+  return f;
+}
+
+
+
+
+static void mergeRange
+     (vector<FILE *>::iterator first, vector<FILE *>::iterator last,
+      FILE * out, AlignBatch & Batch)
+
+     //  Merge the sorted runs [first, last) into out, or into the batch
+     //  (printed as it fills up) if out is NULL. Rows comparing equal are
+     //  taken from the earliest run, so the merge is stable
+
+{
+  vector<RunHead> heads (last - first);
+  RunHead_Sort cmp;
+  cmp.heads = &heads;
+  priority_queue<size_t, vector<size_t>, RunHead_Sort> queue (cmp);
+
+  for ( size_t i = 0; i < heads.size( ); i ++ )
+    {
+      heads[i].f = first[i];
+      if ( readRow (heads[i]) )
+	queue.push (i);
+    }
+
+  while ( !queue.empty( ) )
+    {
+      size_t i = queue.top( );
+      queue.pop( );
+      if ( out != NULL )
+	writeRow (out, heads[i].S);
+      else
+	{
+	  Batch.push (heads[i].S);
+	  if ( Batch.Stats.size( ) >= PRINT_BATCH )
+	    printRows (Batch);
+	}
+      if ( readRow (heads[i]) )
+	queue.push (i);
+    }
+
+  for ( size_t i = 0; i < heads.size( ); i ++ )
+    fclose (heads[i].f);
+}
+
+
+
+
+void mergeRuns
+     (vector<FILE *> & Runs, AlignBatch & Batch)
+
+     //  Merge the sorted runs into the batch, MAX_MERGE_RUNS at a time. The
+     //  earliest runs are merged first, and replaced by their merge
+
+{
+  while ( Runs.size( ) > MAX_MERGE_RUNS )
+    {
+      FILE * f = tempRun( );
+      mergeRange (Runs.begin( ), Runs.begin( ) + MAX_MERGE_RUNS, f, Batch);
+      finishRun (f);
+      Runs.erase (Runs.begin( ) + 1, Runs.begin( ) + MAX_MERGE_RUNS);
+      Runs[0] = f;
+    }
+  mergeRange (Runs.begin( ), Runs.end( ), NULL, Batch);
+  Runs.clear( );
+}
+
+
+
+
+void openDelta
+     (DeltaReader_t & dr)
+
+     //  open the delta file and read its header
+
+{
   dr.open (InputFileName);
   whichDataType = dr.getDataType( ) == NUCMER_STRING ?
     NUCMER_DATA : PROMER_DATA;
   strcpy (RefFileName, dr.getReferencePath( ).c_str( ));
   strcpy (QryFileName, dr.getQueryPath( ).c_str( ));
+}
 
-  //-- for each delta record
-  while ( dr.readNext( ) )
-    {
-      CurrStats.SeqLenA = dr.getRecord( ).lenR;
-      CurrStats.SeqLenB = dr.getRecord( ).lenQ;
 
-      CurrStats.IdA = (char *) Safe_malloc (dr.getRecord( ).idR.length( ) + 1);
-      CurrStats.IdB = (char *) Safe_malloc (dr.getRecord( ).idQ.length( ) + 1);
-      strcpy (CurrStats.IdA, dr.getRecord( ).idR.c_str( ));
-      strcpy (CurrStats.IdB, dr.getRecord( ).idQ.c_str( ));
 
-      //-- for each alignment
-      for ( unsigned int i = 0; i < dr.getRecord( ).aligns.size( ); i ++ )
-	{
-	  CurrStats.sA = dr.getRecord( ).aligns[i].sR;
-	  CurrStats.eA = dr.getRecord( ).aligns[i].eR;
-	  CurrStats.sB = dr.getRecord( ).aligns[i].sQ;
-	  CurrStats.eB = dr.getRecord( ).aligns[i].eQ;
-	  CurrStats.Idy = dr.getRecord( ).aligns[i].idy;
-	  CurrStats.Sim = dr.getRecord( ).aligns[i].sim;
-	  CurrStats.Stp = dr.getRecord( ).aligns[i].stp;
-
-	  if ( CurrStats.Idy < idyCutoff )
-	    continue;
 
-	  if ( CurrStats.Idy > 99.99  &&  CurrStats.Idy != 100 )
-	    CurrStats.Idy = 99.99;
-	  if ( CurrStats.Sim > 99.99  &&  CurrStats.Sim != 100 )
-	    CurrStats.Sim = 99.99;
-	  if ( CurrStats.Stp > 99.99  &&  CurrStats.Stp != 100 )
-	    CurrStats.Stp = 99.99;
-	  if ( CurrStats.Stp < 0.01  &&  CurrStats.Stp != 0 )
-	    CurrStats.Stp = 0.01;
-
-	  if ( labs (CurrStats.sA - CurrStats.eA) + 1 < lenCutoff  ||
-	       labs (CurrStats.sB - CurrStats.eB) + 1 < lenCutoff )
-	    continue;
+void parseRecord
+     (const DeltaRecord_t & Rec, const char * IdA, const char * IdB,
+      vector<AlignStats> & Stats)
 
-	  sA = CurrStats.sA;
-	  eA = CurrStats.eA;
-	  sB = CurrStats.sB;
-	  eB = CurrStats.eB;
+     //  parse the alignments of a delta record
 
-	  //-- Reset the coordinates to reference the appropriate strand
-	  frameA = 1;
-	  frameB = 1;
-	  if ( sA > eA )
-	    {
-	      sA = revC (sA, CurrStats.SeqLenA);
-	      eA = revC (eA, CurrStats.SeqLenA);
-	      frameA += 3;
-	    }
-	  if ( sB > eB )
-	    {
-	      sB = revC (sB, CurrStats.SeqLenB);
-	      eB = revC (eB, CurrStats.SeqLenB);
-	      frameB += 3;
-	    }
+{
+  int frameA, frameB;                  //  sequence frame
+  long int sA, eA, sB, eB;
+  AlignStats CurrStats;                //  single alignment region
 
-	  if ( isBrief )
-	    {
-	      CurrStats.FrameA = frameA > 3 ? (frameA - 3) * -1 : frameA;
-	      CurrStats.FrameB = frameB > 3 ? (frameB - 3) * -1 : frameB;
-	      Stats.push_back (CurrStats);
-	      continue;
-	    }
+  CurrStats.SeqLenA = Rec.lenR;
+  CurrStats.SeqLenB = Rec.lenQ;
+  CurrStats.IdA = IdA;
+  CurrStats.IdB = IdB;
 
-	  //-- Set/Generate the correct frame for sequences A and B
-	  if ( whichDataType == NUCMER_DATA )
-	    assert ( frameA == 1  &&  (frameB == 1 || frameB == 4));
-	  else   // PROMER_DATA
-	    {
-	      //-- Set the reading frame
-	      frameA += (sA + 2) % 3;
-	      frameB += (sB + 2) % 3;
-
-              //-- Translated the coordinates from DNA to Amino Acid
-              //   remeber that eA and eB point to the last nucleotide in the
-              //   end codon
-              sA = (sA + 2) / 3;
-              eA = (eA) / 3;
-              sB = (sB + 2) / 3;
-              eB = (eB) / 3;
-	    }
+  //-- for each alignment
+  for ( unsigned int i = 0; i < Rec.aligns.size( ); i ++ )
+    {
+      CurrStats.sA = Rec.aligns[i].sR;
+      CurrStats.eA = Rec.aligns[i].eR;
+      CurrStats.sB = Rec.aligns[i].sQ;
+      CurrStats.eB = Rec.aligns[i].eQ;
+      CurrStats.Idy = Rec.aligns[i].idy;
+      CurrStats.Sim = Rec.aligns[i].sim;
+      CurrStats.Stp = Rec.aligns[i].stp;
+
+      if ( CurrStats.Idy < idyCutoff )
+	continue;
+
+      if ( CurrStats.Idy > 99.99  &&  CurrStats.Idy != 100 )
+	CurrStats.Idy = 99.99;
+      if ( CurrStats.Sim > 99.99  &&  CurrStats.Sim != 100 )
+	CurrStats.Sim = 99.99;
+      if ( CurrStats.Stp > 99.99  &&  CurrStats.Stp != 100 )
+	CurrStats.Stp = 99.99;
+      if ( CurrStats.Stp < 0.01  &&  CurrStats.Stp != 0 )
+	CurrStats.Stp = 0.01;
+
+      if ( labs (CurrStats.sA - CurrStats.eA) + 1 < lenCutoff  ||
+	   labs (CurrStats.sB - CurrStats.eB) + 1 < lenCutoff )
+	continue;
+
+      sA = CurrStats.sA;
+      eA = CurrStats.eA;
+      sB = CurrStats.sB;
+      eB = CurrStats.eB;
+
+      //-- Reset the coordinates to reference the appropriate strand
+      frameA = 1;
+      frameB = 1;
+      if ( sA > eA )
+	{
+	  sA = revC (sA, CurrStats.SeqLenA);
+	  eA = revC (eA, CurrStats.SeqLenA);
+	  frameA += 3;
+	}
+      if ( sB > eB )
+	{
+	  sB = revC (sB, CurrStats.SeqLenB);
+	  eB = revC (eB, CurrStats.SeqLenB);
+	  frameB += 3;
+	}
 
-	  //-- Set the statistics for this alignment region
+      if ( isBrief )
+	{
 	  CurrStats.FrameA = frameA > 3 ? (frameA - 3) * -1 : frameA;
 	  CurrStats.FrameB = frameB > 3 ? (frameB - 3) * -1 : frameB;
-	  
-	  //-- Add the alignment region
 	  Stats.push_back (CurrStats);
+	  continue;
 	}
-    }
-  dr.close ( );
 
-  return;
+      //-- Set/Generate the correct frame for sequences A and B
+      if ( whichDataType == NUCMER_DATA )
+	assert ( frameA == 1  &&  (frameB == 1 || frameB == 4));
+      else   // PROMER_DATA
+	{
+	  //-- Set the reading frame
+	  frameA += (sA + 2) % 3;
+	  frameB += (sB + 2) % 3;
+
+	  //-- Translated the coordinates from DNA to Amino Acid
+	  //   remeber that eA and eB point to the last nucleotide in the
+	  //   end codon
+	  sA = (sA + 2) / 3;
+	  eA = (eA) / 3;
+	  sB = (sB + 2) / 3;
+	  eB = (eB) / 3;
+	}
+
+      //-- Set the statistics for this alignment region
+      CurrStats.FrameA = frameA > 3 ? (frameA - 3) * -1 : frameA;
+      CurrStats.FrameB = frameB > 3 ? (frameB - 3) * -1 : frameB;
+
+      //-- Add the alignment region
+      Stats.push_back (CurrStats);
+    }
 }
 
 
@@ -1278,10 +1680,15 @@ void printHelp
        "            (promer only)\n"
        "-l          Include the sequence length information in the output\n"
        "-L long     Set minimum alignment length to display\n"
+       "-M size     Set the memory used to sort the output (-q or -r), with\n"
+       "            an optional k, M or G suffix. Larger outputs are sorted\n"
+       "            with temporary files in $TMPDIR (default 1G)\n"
        "-o          Annotate maximal alignments between two sequences, i.e.\n"
        "            overlaps between reference and query sequences\n"
        "-q          Sort output lines by query IDs and coordinates\n"
        "-r          Sort output lines by reference IDs and coordinates\n"
+       "-t int      Set the number of threads formatting the output\n"
+       "            (default 1)\n"
        "-T          Switch output to tab-delimited format\n\n");
   fprintf (stderr,
 	   "  Input is the .delta output of either the \"nucmer\" or the\n"
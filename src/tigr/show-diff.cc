@@ -13,8 +13,6 @@
 #include <mummer/redirect_to_pager.hpp>
 #include <string>
 #include <cstdlib>
-#include <cassert>
-#include <climits>
 #include <algorithm>
 #include <vector>
 
@@ -30,61 +28,6 @@ bool    OPT_PrintHeader = true;   // -H option
 
 
 //=========================================================== Declarations ====
-struct EdgeletLoQCmp_t
-//!< Sorts query by lo coord, lo to hi
-{
-  bool operator()(const DeltaEdgelet_t * i, const DeltaEdgelet_t * j) const
-  { return ( i->loQ < j->loQ ); }
-};
-
-struct EdgeletIdQLoQCmp_t
-//!< Sorts query by ID and lo coord, lo to hi
-{
-  bool operator()(const DeltaEdgelet_t * i, const DeltaEdgelet_t * j) const
-  {
-    if ( i->edge && j->edge )
-      {
-        if ( i->edge->qrynode < j->edge->qrynode )
-          return true;
-        else if ( i->edge->qrynode > j->edge->qrynode )
-          return false;
-      }
-    else if ( !i->edge && j->edge )
-      return true;
-    else if ( i->edge && !j->edge )
-      return false;
-    return ( i->loQ < j->loQ );
-  }
-};
-
-struct EdgeletLoRCmp_t
-//!< Sorts reference by lo coord, lo to hi
-{
-  bool operator()(const DeltaEdgelet_t * i, const DeltaEdgelet_t * j) const
-  { return ( i->loR < j->loR ); }
-};
-
-struct EdgeletIdRLoRCmp_t
-//!< Sorts reference by ID and lo coord, lo to hi
-{
-  bool operator()(const DeltaEdgelet_t * i, const DeltaEdgelet_t * j) const
-  {
-    if ( i->edge && j->edge )
-      {
-        if ( i->edge->refnode < j->edge->refnode )
-          return true;
-        else if ( i->edge->refnode > j->edge->refnode )
-          return false;
-      }
-    else if ( !i->edge && j->edge )
-      return true;
-    else if ( i->edge && !j->edge )
-      return false;
-    return ( i->loR < j->loR );
-  }
-};
-
-
 void PrintDiff(DeltaGraph_t & graph);
 void PrintBrk(const char* seq, long s, long e);
 void PrintSeqJmp(const char* seq,
@@ -132,204 +75,27 @@ void PrintDiff(DeltaGraph_t & graph)
               "[SEQ]", "[TYPE]", "[S1]", "[E1]", "[LEN 1]");
     }
 
-  const char* refid;
-  const char* qryid;
-  long i,j;
-  long nAligns, gapR, gapQ;
-  DeltaEdgelet_t lpad, rpad;          // padding for the alignment vector
-  lpad.isRLIS = rpad.isRLIS = true;
-  lpad.isQLIS = rpad.isQLIS = true;
-  lpad.loR = lpad.hiR = lpad.loQ = lpad.hiQ = 0;
-
-  DeltaEdgelet_t *A, *PA, *PGA;       // alignment, prev, prev global
-  vector<DeltaEdgelet_t *> aligns;
-
-  map<string, DeltaNode_t>::const_iterator mi;
-  vector<DeltaEdge_t *>::const_iterator ei;
-  vector<DeltaEdgelet_t *>::iterator eli;
+  auto print = [] (const DeltaNode_t & node, const DeltaDiff_t & d)
+    {
+      const char* seq = node.id->c_str();
+      switch ( d.type )
+        {
+        case DIFF_GAP: PrintGap(seq, d.s, d.e, d.gap1, d.gap2); break;
+        case DIFF_DUP: PrintDup(seq, d.s, d.e); break;
+        case DIFF_BRK: PrintBrk(seq, d.s, d.e); break;
+        case DIFF_JMP: PrintLisJmp(seq, d.s, d.e); break;
+        case DIFF_INV: PrintInv(seq, d.s, d.e); break;
+        case DIFF_SEQ:
+          PrintSeqJmp(seq, d.prev->c_str(), d.next->c_str(), d.s, d.e);
+          break;
+        }
+    };
 
-  //-- For each reference sequence
   if ( OPT_RefDiff )
-    for ( mi = graph.refnodes.begin(); mi != graph.refnodes.end(); ++ mi )
-      {
-        refid = mi->first.c_str();
-
-        //-- Collect all alignments for this reference sequence
-        aligns.clear();
-        for ( ei  = (mi->second).edges.begin();
-              ei != (mi->second).edges.end(); ++ei )
-          for ( eli  = (*ei)->edgelets.begin();
-                eli != (*ei)->edgelets.end(); ++eli )
-            aligns.push_back(*eli);
-
-        //-- Pad the front and back of the alignment vector
-        rpad.loR = rpad.hiR = mi->second.len + 1;
-        rpad.loQ = rpad.hiQ = LONG_MAX;
-        aligns.push_back(&lpad);
-        aligns.push_back(&rpad);
-
-        nAligns = aligns.size();
-
-        //-- OVERRIDE *stpc* value with loQ QLIS ordering
-        sort(aligns.begin(), aligns.end(), EdgeletIdQLoQCmp_t());
-        for ( i = 0, j = 0; i != nAligns; ++i )
-          aligns[i]->stpc = aligns[i]->isQLIS ? j++ : -1;
-
-        //-- Sort by reference order
-        sort(aligns.begin(), aligns.end(), EdgeletLoRCmp_t());
-        assert ( aligns[0] == &lpad && aligns[nAligns-1] == &rpad );
-
-        //-- Walk reference cover alignments, low to high
-        PA = PGA = aligns[0];
-        for ( i = 1; i != nAligns; ++i )
-          {
-            //-- Only interested in reference covering alignments
-            if ( !aligns[i]->isRLIS ) continue;
-
-            A = aligns[i];
-            gapR = A->loR - PA->hiR - 1;
-
-            //-- Reached end of alignments
-            if ( A->edge == NULL )
-              {
-                PrintBrk(refid, PA->hiR+1, A->loR-1);
-              }
-            //-- 1-to-1 alignment
-            else if ( A->isQLIS && A->edge == PGA->edge )
-              {
-                //-- Jump within Q
-                if ( A->slope() != PGA->slope() ||
-                     A->stpc != PGA->stpc + PGA->slope() )
-                  {
-                    if ( A->slope() == PGA->slope() )
-                      PrintLisJmp(refid, PA->hiR+1, A->loR-1);
-                    else
-                      PrintInv(refid, PA->hiR+1, A->loR-1);
-                  }
-                //-- Lined up, nothing in between
-                else if ( PA == PGA )
-                  {
-                    gapQ = A->isPositive() ?
-                      A->loQ - PGA->hiQ - 1 :
-                      PGA->loQ - A->hiQ - 1;
-                    PrintGap(refid, PA->hiR+1, A->loR-1, gapR, gapQ);
-                  }
-                //-- Lined up, duplication in between
-                else
-                  {
-                    PrintBrk(refid, PA->hiR+1, A->loR-1);
-                  }
-              }
-            //-- Not in QLIS? Must be a duplication in R
-            else if ( !A->isQLIS )
-              {
-                PrintBrk(refid, PA->hiR+1, A->loR-1);
-                PrintDup(refid, A->loR, A->hiR);
-              }
-            //-- A->edge != PGA->edge? Jump to different query sequence
-            else if ( PGA->edge != NULL )
-              {
-                PrintSeqJmp(refid,
-                            PGA->edge->qrynode->id->c_str(),
-                            A->edge->qrynode->id->c_str(),
-                            PA->hiR+1, A->loR-1);
-              }
-            //-- Gap before first alignment
-            else
-              {
-                PrintBrk(refid, PA->hiR+1, A->loR-1);
-              }
-
-            if ( A->isQLIS )
-              PGA = A;
-            PA = A;
-          }
-      }
-
+    graph.findDiffs(true, print);
 
-  //---------- WARNING! Same code as above but Q's for R's and R's for Q's
   if ( OPT_QryDiff )
-    for ( mi = graph.qrynodes.begin(); mi != graph.qrynodes.end(); ++ mi )
-      {
-        qryid = mi->first.c_str();
-
-        aligns.clear();
-        for ( ei  = (mi->second).edges.begin();
-              ei != (mi->second).edges.end(); ++ei )
-          for ( eli  = (*ei)->edgelets.begin();
-                eli != (*ei)->edgelets.end(); ++eli )
-            aligns.push_back(*eli);
-
-        rpad.loQ = rpad.hiQ = mi->second.len + 1;
-        rpad.loR = rpad.hiR = LONG_MAX;
-        aligns.push_back(&lpad);
-        aligns.push_back(&rpad);
-
-        nAligns = aligns.size();
-
-        sort(aligns.begin(), aligns.end(), EdgeletIdRLoRCmp_t());
-        for ( i = 0, j = 0; i != nAligns; ++i )
-          aligns[i]->stpc = aligns[i]->isRLIS ? j++ : -1;
-
-        sort(aligns.begin(), aligns.end(), EdgeletLoQCmp_t());
-        assert ( aligns[0] == &lpad && aligns[nAligns-1] == &rpad );
-
-        PA = PGA = aligns[0];
-        for ( i = 1; i != nAligns; ++i )
-          {
-            if ( !aligns[i]->isQLIS ) continue;
-
-            A = aligns[i];
-            gapQ = A->loQ - PA->hiQ - 1;
-
-            if ( A->edge == NULL )
-              {
-                PrintBrk(qryid, PA->hiQ+1, A->loQ-1);
-              }
-            else if ( A->isRLIS && A->edge == PGA->edge )
-              {
-                if ( A->slope() != PGA->slope() ||
-                     A->stpc != PGA->stpc + PGA->slope() )
-                  {
-                    if ( A->slope() == PGA->slope() )
-                      PrintLisJmp(qryid, PA->hiQ+1, A->loQ-1);
-                    else
-                      PrintInv(qryid, PA->hiQ+1, A->loQ-1);
-                  }
-                else if ( PA == PGA )
-                  {
-                    gapR = A->isPositive() ?
-                      A->loR - PGA->hiR - 1 :
-                      PGA->loR - A->hiR - 1;
-                    PrintGap(qryid, PA->hiQ+1, A->loQ-1, gapQ, gapR);
-                  }
-                else
-                  {
-                    PrintBrk(qryid, PA->hiQ+1, A->loQ-1);
-                  }
-              }
-            else if ( !A->isRLIS )
-              {
-                PrintBrk(qryid, PA->hiQ+1, A->loQ-1);
-                PrintDup(qryid, A->loQ, A->hiQ);
-              }
-            else if ( PGA->edge != NULL )
-              {
-                PrintSeqJmp(qryid,
-                            PA->edge->refnode->id->c_str(),
-                            A->edge->refnode->id->c_str(),
-                            PA->hiQ+1, A->loQ-1);
-              }
-            else
-              {
-                PrintBrk(qryid, PA->hiQ+1, A->loQ-1);
-              }
-
-            if ( A->isRLIS )
-              PGA = A;
-            PA = A;
-          }
-      }
+    graph.findDiffs(false, print);
 }
 
 
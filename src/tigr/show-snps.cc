@@ -27,6 +27,7 @@
 #include <map>
 #include <set>
 #include <cstdio>
+#include <functional>
 using namespace std;
 
 
@@ -47,126 +48,14 @@ bool    OPT_PrintHeader   = true;       // -H option
 bool    OPT_SelectAligns  = false;      // -S option
 
 int     OPT_Context       = 0;          // -x option
+int     OPT_Threads       = 1;          // -t option
 
 set<string> OPT_Aligns;                 // -S option
 
 
 
 
-//============================================================= Constants ====//
-const char  INDEL_CHAR = '.';
-const char SEQEND_CHAR = '-';
-
-
-
-struct SNP_R_Sort
-{
-  bool operator() (const SNP_t * a, const SNP_t * b)
-  {
-    int i = a->ep->refnode->id->compare (*(b->ep->refnode->id));
-
-    if ( i < 0 )
-      return true;
-    else if ( i > 0 )
-      return false;
-    else
-      {
-        if ( a -> pR < b -> pR )
-          return true;
-        else if ( a -> pR > b -> pR )
-          return false;
-        else
-          {
-            int j = a->ep->qrynode->id->compare (*(b->ep->qrynode->id));
-
-            if ( j < 0 )
-              return true;
-            else if ( j > 0 )
-              return false;
-            else
-              {
-                if ( a -> pQ < b -> pQ )
-                  return true;
-                else
-                  return false;
-              }
-          }
-      }
-  }
-};
-
-
-struct SNP_Q_Sort
-{
-  bool operator() (const SNP_t * a, const SNP_t * b)
-  {
-    int i = a->ep->qrynode->id->compare (*(b->ep->qrynode->id));
-
-    if ( i < 0 )
-      return true;
-    else if ( i > 0 )
-      return false;
-    else
-      {
-        if ( a -> pQ < b -> pQ )
-          return true;
-        else if ( a -> pQ > b -> pQ )
-          return false;
-        else
-          {
-            int j = a->ep->refnode->id->compare (*(b->ep->refnode->id));
-
-            if ( j < 0 )
-              return true;
-            else if ( j > 0 )
-              return false;
-            else
-              {
-                if ( a -> pR < b -> pR )
-                  return true;
-                else
-                  return false;
-              }
-          }
-      }
-  }
-};
-
-
-
-
 //========================================================== Fuction Decs ====//
-//------------------------------------------------------------------ RevC ----//
-inline long RevC (long coord, long len)
-{
-  return len - coord + 1;
-}
-
-
-//------------------------------------------------------------------ Norm ----//
-inline long Norm (long c, long l, int f, AlignmentType_t d)
-{
-  long retval = (d == PROMER_DATA ? c * 3 - (3 - abs(f)) : c);
-  if ( f < 0 ) retval = RevC (retval, l);
-  return retval;
-}
-
-
-//------------------------------------------------------------------ Swap ----//
-inline void Swap (long & a, long & b)
-{
-  long t = a; a = b; b = t;
-}
-
-
-//------------------------------------------------------------- CheckSNPs ----//
-void CheckSNPs (DeltaGraph_t & graph);
-
-
-//-------------------------------------------------------------- FindSNPs ----//
-void FindSNPs (DeltaGraph_t & graph);
-
-
 //------------------------------------------------------------ PrintHuman ----//
 void PrintHuman (const vector<const SNP_t *> & snps,
                  const DeltaGraph_t & graph);
@@ -210,16 +99,46 @@ int main (int argc, char ** argv)
     SelectAligns ( );
 
   //-- Build the alignment graph from the delta file
+  graph . threads = OPT_Threads;
   graph . build (OPT_AlignName, true);
 
-  //-- Read sequences
-  graph . loadSequences ( );
+  //-- Locate the SNPs, only in the alignments requested by user. The
+  //   sequence regions of these alignments are read as needed
+  function<bool (const DeltaEdgelet_t &)> select;
+  if ( OPT_SelectAligns )
+    select = [] (const DeltaEdgelet_t & l)
+      {
+        ostringstream ss;
+        set<string>::iterator si;
+
+        if ( l . dirR == FORWARD_DIR )
+          ss << l . loR << ' ' << l . hiR << ' ';
+        else
+          ss << l . hiR << ' ' << l . loR << ' ';
+
+        if ( l . dirQ == FORWARD_DIR )
+          ss << l . loQ << ' ' << l . hiQ << ' ';
+        else
+          ss << l . hiQ << ' ' << l . loQ << ' ';
+
+        ss << *(l.edge->refnode->id) << ' ' << *(l.edge->qrynode->id);
 
-  //-- Locate the SNPs
-  FindSNPs (graph);
+        si = OPT_Aligns . find (ss .str( ));
+        if ( si == OPT_Aligns . end( ) )
+          return false;
+        OPT_Aligns . erase (si);
+        return true;
+      };
+  graph . findSNPs (OPT_SortReference, OPT_Context, select);
+
+  if ( OPT_SelectAligns  &&  ! OPT_Aligns . empty( ) )
+    {
+      cerr << "ERROR: One or more alignments from stdin could not be found\n";
+      exit (EXIT_FAILURE);
+    }
 
   //-- Check for ambiguous alignment regions
-  CheckSNPs (graph);
+  graph . checkSNPs ( );
 
 
   //-- Collect and sort the SNPs
@@ -257,452 +176,6 @@ int main (int argc, char ** argv)
 
 
 
-//------------------------------------------------------------- CheckSNPs ----//
-void CheckSNPs (DeltaGraph_t & graph)
-{
-  map<string, DeltaNode_t>::const_iterator mi;
-  vector<DeltaEdge_t *>::const_iterator ei;
-  vector<DeltaEdgelet_t *>::iterator eli;
-  vector<SNP_t *>::iterator si;
-  long i;
-
-  //-- For each reference sequence
-  long ref_size = 0;
-  long ref_len = 0;
-  unsigned char * ref_cov = NULL;
-  for ( mi = graph.refnodes.begin( ); mi != graph.refnodes.end( ); ++ mi )
-    {
-      //-- Reset the reference coverage array
-      ref_len = (mi -> second) . len;
-      if ( ref_len > ref_size )
-        {
-          ref_cov = (unsigned char *) Safe_realloc (ref_cov, ref_len + 1);
-          ref_size = ref_len;
-        }
-      for ( i = 1; i <= ref_len; ++ i )
-        ref_cov[i] = 0;
-
-      //-- Add to the reference coverage
-      for ( ei  = (mi -> second) . edges . begin( );
-            ei != (mi -> second) . edges . end( ); ++ ei )
-        for ( eli  = (*ei) -> edgelets . begin( );
-              eli != (*ei) -> edgelets . end( ); ++ eli )
-          for ( i = (*eli) -> loR; i <= (*eli) -> hiR; i ++ )
-            if ( ref_cov [i] < UCHAR_MAX )
-              ref_cov [i] ++;
-
-      //-- Set the SNP conflict counter
-      for ( ei  = (mi -> second) . edges . begin( );
-            ei != (mi -> second) . edges . end( ); ++ ei )
-        for ( eli  = (*ei) -> edgelets . begin( );
-              eli != (*ei) -> edgelets . end( ); ++ eli )
-          for ( si = (*eli)->snps.begin( ); si != (*eli)->snps.end( ); ++ si )
-            (*si) -> conR = ref_cov [(*si)->pR] - 1;
-    }
-  free (ref_cov);
-
-
-  //-- For each query sequence
-  long qry_size = 0;
-  long qry_len = 0;
-  unsigned char * qry_cov = NULL;
-  for ( mi = graph.qrynodes.begin( ); mi != graph.qrynodes.end( ); ++ mi )
-    {
-      //-- Reset the query coverage array
-      qry_len = (mi -> second) . len;
-      if ( qry_len > qry_size )
-        {
-          qry_cov = (unsigned char *) Safe_realloc (qry_cov, qry_len + 1);
-          qry_size = qry_len;
-        }
-      for ( i = 1; i <= qry_len; ++ i )
-        qry_cov[i] = 0;
-
-      //-- Add to the query coverage
-      for ( ei  = (mi -> second) . edges . begin( );
-            ei != (mi -> second) . edges . end( ); ++ ei )
-        for ( eli  = (*ei) -> edgelets . begin( );
-              eli != (*ei) -> edgelets . end( ); ++ eli )
-          for ( i = (*eli) -> loQ; i <= (*eli) -> hiQ; i ++ )
-            if ( qry_cov [i] < UCHAR_MAX )
-              qry_cov [i] ++;
-
-      //-- Set the SNP conflict counter
-      for ( ei  = (mi -> second) . edges . begin( );
-            ei != (mi -> second) . edges . end( ); ++ ei )
-        for ( eli  = (*ei) -> edgelets . begin( );
-              eli != (*ei) -> edgelets . end( ); ++ eli )
-          for ( si = (*eli)->snps.begin( ); si != (*eli)->snps.end( ); ++ si )
-            (*si) -> conQ = qry_cov [(*si)->pQ] - 1;
-    }
-  free (qry_cov);
-}
-
-
-
-
-//-------------------------------------------------------------- FindSNPs ----//
-void FindSNPs (DeltaGraph_t & graph)
-{
-  map<string, DeltaNode_t>::iterator mi;
-  vector<DeltaEdge_t *>::iterator ei;
-  vector<DeltaEdgelet_t *>::iterator li;
-  vector<SNP_t *>::iterator si, psi, nsi;
-
-  //-- For each alignment, identify the SNPs
-  for ( mi = graph.refnodes.begin( ); mi != graph.refnodes.end( ); ++ mi )
-    for ( ei = mi->second.edges.begin( ); ei != mi->second.edges.end( ); ++ ei )
-      {
-        SNP_t * snp;
-        int ri, qi;
-        char * R[] = {(*ei)->refnode->seq, NULL, NULL, NULL, NULL, NULL, NULL};
-        char * Q[] = {(*ei)->qrynode->seq, NULL, NULL, NULL, NULL, NULL, NULL};
-
-        long i;
-        long lenR = (*ei) -> refnode -> len;
-        long lenQ = (*ei) -> qrynode -> len;
-
-        for (li = (*ei)->edgelets.begin( ); li != (*ei)->edgelets.end( ); ++ li)
-          {
-            long delta;
-            int frameR, frameQ, sign;
-            long sR, eR, sQ, eQ;
-            long rpos, qpos, remain;
-            long rctx, qctx;
-            long alenR = lenR;
-            long alenQ = lenQ;
-
-            //-- Only do the ones requested by user
-            if ( OPT_SelectAligns )
-              {
-                ostringstream ss;
-                set<string>::iterator si;
-
-                if ( (*li) -> dirR == FORWARD_DIR )
-                  ss << (*li) -> loR << ' ' << (*li) -> hiR << ' ';
-                else
-                  ss << (*li) -> hiR << ' ' << (*li) -> loR << ' ';
-
-                if ( (*li) -> dirQ == FORWARD_DIR )
-                  ss << (*li) -> loQ << ' ' << (*li) -> hiQ << ' ';
-                else
-                  ss << (*li) -> hiQ << ' ' << (*li) -> loQ << ' ';
-
-                ss << *((*ei)->refnode->id) << ' ' << *((*ei)->qrynode->id);
-
-                si = OPT_Aligns . find (ss .str( ));
-                if ( si == OPT_Aligns . end( ) )
-                  continue;
-                else
-                  OPT_Aligns . erase (si);
-              }
-
-            //-- Point the coords the right direction
-            frameR = 1;
-            if ( (*li) -> dirR == REVERSE_DIR )
-              {
-                sR = RevC ((*li) -> hiR, lenR);
-                eR = RevC ((*li) -> loR, lenR);
-                frameR += 3;
-              }
-            else
-              {
-                sR = (*li) -> loR;
-                eR = (*li) -> hiR;
-              }
-
-            frameQ = 1;
-            if ( (*li) -> dirQ == REVERSE_DIR )
-              {
-                sQ = RevC ((*li) -> hiQ, lenQ);
-                eQ = RevC ((*li) -> loQ, lenQ);
-                frameQ += 3;
-              }
-            else
-              {
-                sQ = (*li) -> loQ;
-                eQ = (*li) -> hiQ;
-              }
-
-            //-- Translate coords to AA if necessary
-            if ( graph . datatype == PROMER_DATA )
-              {
-                alenR /= 3;
-                alenQ /= 3;
-
-                frameR += (sR + 2) % 3;
-                frameQ += (sQ + 2) % 3;
-
-                // remeber that eR and eQ point to the last base in the codon
-                sR = (sR + 2) / 3;
-                eR = eR / 3;
-                sQ = (sQ + 2) / 3;
-                eQ = eQ / 3;
-              }
-
-            ri = frameR;
-            qi = frameQ;
-
-            if ( frameR > 3 )
-              frameR = -(frameR - 3);
-            if ( frameQ > 3 )
-              frameQ = -(frameQ - 3);
-
-            //-- Generate the sequences if needed
-            if ( R [ri] == NULL )
-              {
-                if ( graph . datatype == PROMER_DATA )
-                  {
-                    R [ri] = (char *) Safe_malloc (alenR + 2);
-                    R [ri][0] = '\0';
-                    Translate_DNA (R [0], R [ri], ri);
-                  }
-                else
-                  {
-                    R [ri] = (char *) Safe_malloc (alenR + 2);
-                    R [ri][0] = '\0';
-                    strcpy (R [ri] + 1, R [0] + 1);
-                    if ( (*li) -> dirR == REVERSE_DIR )
-                      Reverse_Complement (R [ri], 1, lenR);
-                  }
-              }
-            if ( Q [qi] == NULL )
-              {
-                if ( graph . datatype == PROMER_DATA )
-                  {
-                    Q [qi] = (char *) Safe_malloc (alenQ + 2);
-                    Q [qi][0] = '\0';
-                    Translate_DNA (Q [0], Q [qi], qi);
-                  }
-                else
-                  {
-                    Q [qi] = (char *) Safe_malloc (alenQ + 2);
-                    Q [qi][0] = '\0';
-                    strcpy (Q [qi] + 1, Q [0] + 1);
-                    if ( (*li) -> dirQ == REVERSE_DIR )
-                      Reverse_Complement (Q [qi], 1, lenQ);
-                  }
-              }
-
-            //-- Locate the SNPs
-            rpos = sR;
-            qpos = sQ;
-            remain = eR - sR + 1;
-
-            (*li) -> frmR = frameR;
-            (*li) -> frmQ = frameQ;
-
-            istringstream ss;
-            ss . str ((*li)->delta);
-
-            while ( ss >> delta && delta != 0 )
-              {
-                sign = delta > 0 ? 1 : -1;
-                delta = labs (delta);
-
-                //-- For all SNPs before the next indel
-                for ( i = 1; i < delta; i ++ )
-                  if ( R [ri] [rpos ++] != Q [qi] [qpos ++] )
-                    {
-                      if ( graph.datatype == NUCMER_DATA &&
-                           CompareIUPAC (R [ri][rpos-1], Q [qi][qpos-1]) )
-                        continue;
-
-                      snp = new SNP_t;
-                      snp -> ep = *ei;
-                      snp -> lp = *li;
-                      snp -> pR = Norm (rpos-1, lenR, frameR, graph.datatype);
-                      snp -> pQ = Norm (qpos-1, lenQ, frameQ, graph.datatype);
-                      snp -> cR = toupper (R [ri] [rpos-1]);
-                      snp -> cQ = toupper (Q [qi] [qpos-1]);
-
-                      for ( rctx = rpos - OPT_Context - 1;
-                            rctx < rpos + OPT_Context; rctx ++ )
-                        if ( rctx < 1  ||  rctx > alenR )
-                          snp -> ctxR . push_back (SEQEND_CHAR);
-                        else if ( rctx == rpos - 1 )
-                          snp -> ctxR . push_back (snp -> cR);
-                        else
-                          snp -> ctxR . push_back (toupper (R [ri] [rctx]));
-                          
-                      for ( qctx = qpos - OPT_Context - 1;
-                            qctx < qpos + OPT_Context; qctx ++ )
-                        if ( qctx < 1  ||  qctx > alenQ )
-                          snp -> ctxQ . push_back (SEQEND_CHAR);
-                        else if ( qctx == qpos - 1 )
-                          snp -> ctxQ . push_back (snp -> cQ);
-                        else
-                          snp -> ctxQ . push_back (toupper (Q [qi] [qctx]));
-
-                      (*li) -> snps . push_back (snp);
-                    }
-
-                //-- For the indel
-                snp = new SNP_t;
-                snp -> ep = *ei;
-                snp -> lp = *li;
-
-                for ( rctx = rpos - OPT_Context; rctx < rpos; rctx ++ )
-                  if ( rctx < 1 )
-                    snp -> ctxR . push_back (SEQEND_CHAR);
-                  else
-                    snp -> ctxR . push_back (toupper (R [ri] [rctx]));
-                
-                for ( qctx = qpos - OPT_Context; qctx < qpos; qctx ++ )
-                  if ( qctx < 1 )
-                    snp -> ctxQ . push_back (SEQEND_CHAR);
-                  else
-                    snp -> ctxQ . push_back (toupper (Q [qi] [qctx]));
-
-                if ( sign > 0 )
-                  {
-                    snp -> pR = Norm (rpos, lenR, frameR, graph.datatype);
-                    if ( frameQ > 0 )
-                      snp -> pQ = Norm (qpos - 1, lenQ, frameQ, graph.datatype);
-                    else
-                      snp -> pQ = Norm (qpos, lenQ, frameQ, graph.datatype);
-
-                    snp -> cR = toupper (R [ri] [rpos ++]);
-                    snp -> cQ = INDEL_CHAR;
-
-                    remain -= i;
-                    rctx ++;
-                  }
-                else
-                  {
-                    snp -> pQ = Norm (qpos, lenQ, frameQ, graph.datatype);
-                    if ( frameR > 0 )
-                      snp -> pR = Norm (rpos - 1, lenR, frameR, graph.datatype);
-                    else
-                      snp -> pR = Norm (rpos, lenR, frameR, graph.datatype);
-
-                    snp -> cR = INDEL_CHAR;
-                    snp -> cQ = toupper (Q [qi] [qpos ++]);
-
-                    remain -= i - 1;
-                    qctx ++;
-                  }
-
-                snp -> ctxR . push_back (snp -> cR);
-                for ( ; rctx < rpos + OPT_Context; rctx ++ )
-                  if ( rctx > alenR )
-                    snp -> ctxR . push_back (SEQEND_CHAR);
-                  else
-                    snp -> ctxR . push_back (toupper (R [ri] [rctx]));
-                
-                snp -> ctxQ . push_back (snp -> cQ);
-                for ( ; qctx < qpos + OPT_Context; qctx ++ )
-                  if ( qctx > alenQ )
-                    snp -> ctxQ . push_back (SEQEND_CHAR);
-                  else
-                    snp -> ctxQ . push_back (toupper (Q [qi] [qctx]));
-                
-                (*li) -> snps . push_back (snp);
-              }
-
-            //-- For all SNPs after the final indel
-            for ( i = 0; i < remain; i ++ )
-              if ( R [ri] [rpos ++] != Q [qi] [qpos ++] )
-                {
-                  if ( graph.datatype == NUCMER_DATA &&
-                       CompareIUPAC (R [ri][rpos-1], Q [qi][qpos-1]) )
-                    continue;
-
-                  snp = new SNP_t;
-                  snp -> ep = *ei;
-                  snp -> lp = *li;
-                  snp -> pR = Norm (rpos-1, lenR, frameR, graph.datatype);
-                  snp -> pQ = Norm (qpos-1, lenQ, frameQ, graph.datatype);
-                  snp -> cR = toupper (R [ri] [rpos-1]);
-                  snp -> cQ = toupper (Q [qi] [qpos-1]);
-
-                  for ( rctx = rpos - OPT_Context - 1;
-                        rctx < rpos + OPT_Context; rctx ++ )
-                    if ( rctx < 1  ||  rctx > alenR )
-                      snp -> ctxR . push_back (SEQEND_CHAR);
-                    else if ( rctx == rpos - 1 )
-                      snp -> ctxR . push_back (snp -> cR);
-                    else
-                      snp -> ctxR . push_back (toupper (R [ri] [rctx]));
-                  
-                  for ( qctx = qpos - OPT_Context - 1;
-                        qctx < qpos + OPT_Context; qctx ++ )
-                    if ( qctx < 1  ||  qctx > alenQ )
-                      snp -> ctxQ . push_back (SEQEND_CHAR);
-                    else if ( qctx == qpos - 1 )
-                      snp -> ctxQ . push_back (snp -> cQ);
-                    else
-                      snp -> ctxQ . push_back (toupper (Q [qi] [qctx]));
-
-                  (*li) -> snps . push_back (snp);
-                }
-
-
-            //-- Sort SNPs and calculate distances
-            if ( OPT_SortReference )
-              {
-                sort ((*li)->snps.begin( ), (*li)->snps.end( ), SNP_R_Sort( ));
-
-                for ( si = (*li)->snps.begin(); si != (*li)->snps.end(); ++ si )
-                  {
-                    psi = si - 1;
-                    nsi = si + 1;
-
-                    (*si) -> buff = 1 +
-                      ((*si)->pR - (*li)->loR < (*li)->hiR - (*si)->pR ?
-                       (*si)->pR - (*li)->loR : (*li)->hiR - (*si)->pR);
-
-                    if ( psi >= (*li) -> snps . begin( )  &&
-                         (*si)->pR - (*psi)->pR < (*si)->buff )
-                      (*si) -> buff = (*si)->pR - (*psi)->pR;
-                    
-                    if ( nsi < (*li) -> snps . end( )  &&
-                         (*nsi)->pR - (*si)->pR < (*si)->buff )
-                      (*si) -> buff = (*nsi)->pR - (*si)->pR;
-                  }
-              }
-            else
-              {
-                sort ((*li)->snps.begin( ), (*li)->snps.end( ), SNP_Q_Sort( ));
-
-                for ( si = (*li)->snps.begin(); si != (*li)->snps.end(); ++ si )
-                  {
-                    psi = si - 1;
-                    nsi = si + 1;
- 
-                    (*si) -> buff = 1 +
-                      ((*si)->pQ - (*li)->loQ < (*li)->hiQ - (*si)->pQ ?
-                       (*si)->pQ - (*li)->loQ : (*li)->hiQ - (*si)->pQ);
-
-                    if ( psi >= (*li) -> snps . begin( )  &&
-                         (*si)->pQ - (*psi)->pQ < (*si)->buff )
-                      (*si) -> buff = (*si)->pQ - (*psi)->pQ;
-                    
-                    if ( nsi < (*li) -> snps . end( )  &&
-                         (*nsi)->pQ - (*si)->pQ < (*si)->buff )
-                      (*si) -> buff = (*nsi)->pQ - (*si)->pQ;
-                  }
-              }
-          }
-
-        //-- Clear up the seq
-        for ( i = 1; i <= 6; i ++ )
-          {
-            free (R[i]);
-            free (Q[i]);
-          }
-      }
-
-  if ( OPT_SelectAligns  &&  ! OPT_Aligns . empty( ) )
-    {
-      cerr << "ERROR: One or more alignments from stdin could not be found\n";
-      exit (EXIT_FAILURE);
-    }
-}
-
-
-
-
 //------------------------------------------------------------ PrintHuman ----//
 void PrintHuman (const vector<const SNP_t *> & snps,
                  const DeltaGraph_t & graph)
@@ -888,7 +361,7 @@ void ParseArgs (int argc, char ** argv)
   optarg = NULL;
   
   while ( !errflg  &&
-          ((ch = getopt (argc, argv, "ChHIlqrSTx:")) != EOF) )
+          ((ch = getopt (argc, argv, "ChHIlqrSt:Tx:")) != EOF) )
     switch (ch)
       {
       case 'C':
@@ -924,6 +397,10 @@ void ParseArgs (int argc, char ** argv)
         OPT_SelectAligns = true;
         break;
 
+      case 't':
+        OPT_Threads = atoi (optarg);
+        break;
+
       case 'T':
         OPT_PrintTabular = true;
         break;
@@ -942,6 +419,12 @@ void ParseArgs (int argc, char ** argv)
       errflg ++;
     }
 
+  if ( OPT_Threads < 1 )
+    {
+      cerr << "ERROR: Number of threads must be greater than zero\n";
+      errflg ++;
+    }
+
   if ( OPT_SortReference  &&  OPT_SortQuery )
     cerr << "WARNING: both -r and -q were passed, -q ignored\n";
 
@@ -977,6 +460,9 @@ void PrintHelp (const char * s)
     << "-r            Sort output lines by reference IDs and SNP positions\n"
     << "-S            Specify which alignments to report by passing\n"
     << "              'show-coords' lines to stdin\n"
+    << "-t int        Set the number of threads searching the alignments\n"
+    << "              for SNPs, default "
+    << OPT_Threads << endl
     << "-T            Switch to tab-delimited format\n"
     << "-x int        Include x characters of surrounding SNP context in the\n"
     << "              output, default "
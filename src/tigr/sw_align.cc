@@ -1,7 +1,14 @@
 #include <math.h>
+#include <string.h>
 #include <limits>
+#include <algorithm>
 #include <mummer/sw_align.hh>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SW_ALIGN_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
 namespace mummer {
 namespace sw_align {
 
@@ -12,16 +19,56 @@ static const int MATCH  = 2;
 static const int START  = 3;
 static const int NONE   = 4;
 
+static const int32_t min_score = std::numeric_limits<int32_t>::min(); // minimum possible score
+
+//-- Largest N + M for which the edits of the whole matrix are kept
+static const long int FULL_TRACEBACK_LENGTH = 2 * 10000;
+
+//-- Arguments of the kernels scoring the nodes of one diagonal. Node i
+//   has its DELETE parent at index Poff + i of the P arrays (previous
+//   diagonal), its INSERT parent at Poff + i + 1 and its MATCH parent at
+//   index PPoff + i of the PP arrays (diagonal before the previous one).
+struct DiagonalArgs
+{
+  const int32_t *Pdel, *Pins, *Pmat;
+  const int32_t *PPdel, *PPins, *PPmat;
+  long int       Poff, PPoff;
+  const int32_t *match;         // match score of each node
+  int32_t       *del, *ins, *mat;
+  unsigned char *edits;         // packed traceback of each node
+  int32_t        open, cont;    // gap scores
+};
+
+//-- Score the nodes [start, end) of a diagonal, all of which have their
+//   three parents within bounds. best and best_i are the running
+//   maximum score and the (last) node index where it is reached, and
+//   are only updated if a node scores at least best.
+typedef void (*DiagonalKernel)
+     (const DiagonalArgs & a, long int start, long int end,
+      long int & best, long int & best_i);
+
 //----------------------------------------- Private Function Declarations ----//
+template<typename Restore>
 static void generateDelta
-     (const DiagonalMatrix& Diag, long int FinishCt, long int FinishCDi,
-      long int N, std::vector<long int> & Delta);
+     (DiagonalMatrix& Diag, long int FinishCt, long int FinishCDi,
+      long int N, std::vector<long int> & Delta, Restore restore);
+
+
+static inline int maxScore(int32_t del, int32_t ins, int32_t mat);
+
+static inline int scoreEdit
+     (int32_t & value, const int32_t del, const int32_t ins, const int32_t mat);
+
+static inline void scoreNode
+     (const DiagonalArgs & a, long int i, bool del_ok, bool ins_ok, bool mat_ok,
+      long int & best, long int & best_i);
 
+static inline long int maxValue
+     (const unsigned char * edits, const DiagonalScores & S, long int i);
 
-static inline int maxScore(Score S[3]);
+static DiagonalKernel selectKernel();
 
-static inline void scoreEdit
-     (Score & curr, const long int del, const long int ins, const long int mat);
+static const DiagonalKernel scoreDiagonal = selectKernel();
 
 
 //------------------------------------------ Private Function Definitions ----//
@@ -46,15 +93,12 @@ bool aligner::_alignEngine
   bool        TargetReached;    // the target was reached
   const char *A, *B;            // the sequence pointers to be used by this func
 
-  static const long int min_score   = std::numeric_limits<long>::min(); // minimum possible score
   long int              high_score  = min_score; // global maximum score
   long int              xhigh_score = min_score; // non-optimal high score
   const long int        max_diff    = good_score() * _break_len; // max score difference
 
-  long int CDi;                 // conceptual diagonal index (not relating to mem)
-  long int Dct, Di;             // diagonal counter, actual diagonal index
-  long int PDi, PPDi;           // previous diagonal index and prev prev diag index
-  long int Ds, PDs, PPDs;       // diagonal size, prev, prev prev diagonal size where 'size' = rbound - lbound + 1
+  long int Dct;                 // diagonal counter
+  long int Ds;                  // diagonal size where 'size' = rbound - lbound + 1
 
   long int Dl         = 2;      // current conceptual diagonal length
   long int lbound     = 0;      // current diagonal left(lower) node bound index
@@ -69,8 +113,6 @@ bool aligner::_alignEngine
   double   Dmid  = .5;          // diag midpoint
   double   Dband = _banding/2.0; // diag banding
 
-  int Iadj, Dadj, Madj;         // insert, delete and match adjust values
-
 #ifdef _DEBUG_VERBOSE
   long int MaxL = 0;             // biggest diagonal seen
   long int TrimCt = 0;           // counter of nodes trimmed
@@ -95,19 +137,31 @@ bool aligner::_alignEngine
   { auto& D0 = Diag[0];
     D0.lbound = lbound;
     D0.rbound = rbound ++;
-    auto& I0 = D0.I[0];
-    I0.S[DELETE].value = min_score;
-    I0.S[INSERT].value = min_score;
-    I0.S[MATCH].value  = 0;
-    I0.max(MATCH);
-
-    I0.S[DELETE].used = NONE;
-    I0.S[INSERT].used = NONE;
-    I0.S[MATCH].used  = START;
+    D0.edits.assign(1, MATCH << 6); // the origin is recognized by its diagonal (START)
+    auto& S0 = Diag.scores(0);
+    S0.resize(1);
+    S0.S[DELETE][0] = min_score;
+    S0.S[INSERT][0] = min_score;
+    S0.S[MATCH][0]  = 0;
   }
 
   L = N < M ? N : M;
 
+  //-- Keep the edits of every node for the traceback only up to
+  //   FULL_TRACEBACK_LENGTH. Beyond, the scores of two consecutive
+  //   diagonals are saved every 'stride' diagonals (12 bytes per node
+  //   each) and the edits (1 byte per node) are recomputed from these
+  //   checkpoints one stride at a time during the traceback. The
+  //   memory is then O(sqrt(N + M)) diagonals instead of O(N + M).
+  //   A search needs the edits of the current diagonal only.
+  long int stride = 0;
+  if(m_o & SEARCH_BIT)
+    stride = std::numeric_limits<long>::max();
+  else if(N + M > FULL_TRACEBACK_LENGTH) {
+    stride = (long int)sqrt(24.0 * (N + M));
+    Diag.checkpoint(1) = Diag.scores(0);
+  }
+
   //-- **START** of diagonal processing loop
   //-- Calculate the rest of the diagonals until goal reached or score worsens
   for(Dct = 1; Dct <= N + M  && (Dct - FinishCt) <= _break_len  && lbound <= rbound; Dct++) {
@@ -115,8 +169,16 @@ bool aligner::_alignEngine
     CurD.lbound = lbound;
     CurD.rbound = rbound;
 
-    //-- malloc space for the edit char and score nodes
+    //-- malloc space for the edit char nodes. The scores are allocated
+    //   by _scoreDiagonal
     Ds = rbound - lbound + 1;
+    unsigned char* edits;
+    if(stride == 0) {
+      CurD.edits.resize(Ds);
+      edits = CurD.edits.data();
+    } else
+      edits = Diag.scratch_edits(Ds);
+    const auto& CurS = Diag.scores(Dct);
 
 #ifdef _DEBUG_VERBOSE
     //-- Keep count of trimmed and calculated nodes
@@ -126,92 +188,24 @@ bool aligner::_alignEngine
       MaxL = Ds;
 #endif
 
-    //-- Set diagonal index adjustment values
-    if(Dct <= N) {
-      Iadj = 0;
-      Madj = -1;
-    } else {
-      Iadj = 1;
-      Madj = Dct == N + 1 ? 0 : 1;
-    }
-    Dadj = Iadj - 1;
-
-    //-- Set parent diagonal values
-    const auto& PrevD = Diag[Dct - 1] ; // previous diagonal
-    PDs               = PrevD.rbound - PrevD.lbound + 1;
-    PDi               = lbound + Dadj;
-    PDi               = PDi - PrevD.lbound;
-
-    //-- Set grandparent diagonal values
-    const long PPDct = Dct - 2; //  prev prev diagonal
-    const Diagonal& PPrevD = Diag[std::max((long)0, PPDct)]; // if PPDct < 0, not PPrevD is not used
-    if(PPDct >= 0) {
-      PPDs   = PPrevD.rbound - PPrevD.lbound + 1;
-      PPDi   = lbound + Madj;
-      PPDi   = PPDi - PPrevD.lbound;
-    } else
-      PPDi = PPDs = 0;
-
     //-- If forced alignment, don't keep track of global max
     if(m_o & FORCED_BIT )
       high_score = min_score;
 
     //-- **START** of internal node scoring loop
-    //-- Calculate scores for every node (within bounds) for diagonal Dct
-    for(CDi = lbound; CDi <= rbound; CDi ++) {
-      //-- Set the index (in memory) of current node and clear score
-      Di = CDi - CurD.lbound;
-      auto& CurDi = CurD.I[Di];
-
-      //-- Calculate DELETE score
-      if(PDi >= 0  &&  PDi < PDs ) {
-        const auto& PrevDi = PrevD.I[PDi];
-        scoreEdit(CurDi.S[DELETE],
-                  PrevDi.S[DELETE].value + (PrevDi.S[DELETE].used == NONE ? 0 : CONT_GAP_SCORE [_matrix_type]),
-                  PrevDi.S[INSERT].value + (PrevDi.S[INSERT].used == NONE ? 0 : OPEN_GAP_SCORE [_matrix_type]),
-                  PrevDi.S[MATCH].value  + (PrevDi.S[MATCH].used == NONE  ? 0 : OPEN_GAP_SCORE [_matrix_type]));
-      } else {
-        CurDi.S[DELETE].value = min_score;
-        CurDi.S[DELETE].used  = NONE;
-      }
-
-      PDi ++;
-
-      //-- Calculate INSERT score
-      if(PDi >= 0  &&  PDi < PDs ) {
-        const auto& PrevDi = PrevD.I[PDi];
-        scoreEdit(CurDi.S[INSERT],
-                  PrevDi.S[DELETE].value + (PrevDi.S[DELETE].used == NONE ? 0 : OPEN_GAP_SCORE [_matrix_type]),
-                  PrevDi.S[INSERT].value + (PrevDi.S[INSERT].used == NONE ? 0 : CONT_GAP_SCORE [_matrix_type]),
-                  PrevDi.S[MATCH].value  + (PrevDi.S[MATCH].used == NONE  ? 0 : OPEN_GAP_SCORE [_matrix_type]));
-      } else {
-        CurDi.S[INSERT].value = min_score;
-        CurDi.S[INSERT].used  = NONE;
-      }
-
-      //-- Calculate MATCH/MIS-MATCH score
-      if(PPDi >= 0  &&  PPDi < PPDs) {
-        const auto& PPrevDi = PPrevD.I[PPDi];
-        scoreEdit(CurDi.S[MATCH],
-                  PPrevDi.S[DELETE].value,
-                  PPrevDi.S[INSERT].value,
-                  PPrevDi.S[MATCH].value);
-        CurDi.S[MATCH].value += scoreMatch(CurD, Dct, CDi, A, B, N, m_o);
-      } else {
-        CurDi.S[MATCH].value = min_score;
-        CurDi.S[MATCH].used  = NONE;
-      }
-
-      PPDi ++;
-
-      CurDi.max(maxScore (CurDi.S));
+    long int best   = high_score;
+    long int best_i = -1;
+    _scoreDiagonal(Diag, Dct, A, B, N, m_o, edits, best, best_i);
+    if(stride > 0  &&  Dct % stride == 0) {
+      Diag.checkpoint(2 * (Dct / stride))     = Diag.scores(Dct - 1);
+      Diag.checkpoint(2 * (Dct / stride) + 1) = Diag.scores(Dct);
+    }
 
-      //-- Reset high_score if new global max was found
-      if(CurDi.max().value >= high_score) {
-        high_score = CurDi.max().value;
-        FinishCt   = Dct;
-        FinishCDi  = CDi;
-      }
+    //-- Reset high_score if new global max was found
+    if(best_i >= 0) {
+      high_score = best;
+      FinishCt   = Dct;
+      FinishCDi  = lbound + best_i;
     }
     //-- **END** of internal node scoring loop
 
@@ -220,16 +214,16 @@ bool aligner::_alignEngine
     if(m_o & SEQEND_BIT  &&  Dct >= L) {
       if(L == N) {
         if(lbound == 0) {
-          if(CurD.I[0].max().value >= xhigh_score) {
-            xhigh_score = CurD.I[0].max().value;
+          if(maxValue(edits, CurS, 0) >= xhigh_score) {
+            xhigh_score = maxValue(edits, CurS, 0);
             xFinishCt   = Dct;
             xFinishCDi  = 0;
           }
         }
       } else  { // L == M
         if(rbound == M) {
-          if(CurD.I[M-CurD.lbound].max().value >= xhigh_score) {
-            xhigh_score = CurD.I[M-CurD.lbound].max().value;
+          if(maxValue(edits, CurS, M-CurD.lbound) >= xhigh_score) {
+            xhigh_score = maxValue(edits, CurS, M-CurD.lbound);
             xFinishCt   = Dct;
             xFinishCDi  = M;
           }
@@ -244,16 +238,14 @@ bool aligner::_alignEngine
 
 
     //-- Trim hopeless diagonal nodes
-    const auto CurDi_start = CurD.I.cbegin();
-    const auto CurDi_end   = CurDi_start + Ds;
-    for(auto it = CurDi_start ; it < CurDi_end; ++it) {
-      if(high_score - it->max().value > max_diff )
+    for(long int i = 0; i < Ds; ++i) {
+      if(high_score - maxValue(edits, CurS, i) > max_diff )
         lbound ++;
       else
         break;
     }
-    for(auto it = CurDi_end - 1; it >= CurDi_start; --it) {
-      if(high_score - it->max().value > max_diff )
+    for(long int i = Ds - 1; i >= 0; --i) {
+      if(high_score - maxValue(edits, CurS, i) > max_diff )
         rbound --;
       else
         break;
@@ -320,70 +312,270 @@ bool aligner::_alignEngine
   //-- Ouput calculation statistics
   if(TargetReached )
     fprintf(stderr,"Finish score = %ld : %ld,%ld\n",
-	    Diag[FinishCt].I[0].max().value, N, M);
+	    high_score, N, M);
   else
     fprintf(stderr,"High score = %ld : %ld,%ld\n", high_score,
 	    labs(Aadj) + 1, labs(Badj) + 1);
   fprintf(stderr, "%ld nodes calculated, %ld nodes trimmed\n", CalcCt, TrimCt);
-  if(m_o & DIRECTION_BIT )
-    fprintf(stderr, "%ld bytes used\n",
-	    (long int)sizeof(Diagonal) * Dct + (long int)sizeof(Node) * CalcCt);
-  else
-    fprintf(stderr, "%ld bytes used\n",
-	    ((long int)sizeof(Diagonal) + (long int)sizeof(Node) * MaxL) * 2);
+  fprintf(stderr, "%ld bytes used\n",
+          (long int)sizeof(Diagonal) * Dct + (long int)sizeof(unsigned char) * CalcCt
+          + (long int)sizeof(int32_t) * 3 * 3 * MaxL);
 #endif
 
   //-- If in forward alignment m_o, create the Delta information
-  if(~m_o & SEARCH_BIT )
-    generateDelta(Diag, FinishCt, FinishCDi, N, Delta);
+  if(~m_o & SEARCH_BIT ) {
+    //-- Recompute the edits of the stride below diagonal Dct when the
+    //   traceback leaves the diagonals [restored, FinishCt] and release
+    //   the stride above
+    long int restored = FinishCt + 1, restored_end = FinishCt;
+    auto restore = [&](long int Dct) {
+      if(stride == 0  ||  Dct >= restored  ||  Dct == 0)
+        return;
+      for(long int d = restored; d <= restored_end; ++d)
+        std::vector<unsigned char>().swap(Diag[d].edits);
+      const long int c = (Dct - 1) / stride * stride;
+      restored_end = restored - 1;
+      restored     = c + 1;
+      if(c > 0)
+        Diag.scores(c - 1) = Diag.checkpoint(2 * (c / stride));
+      Diag.scores(c) = Diag.checkpoint(2 * (c / stride) + 1);
+      for(long int d = restored; d <= restored_end; ++d) {
+        auto& D = Diag[d];
+        D.edits.resize(D.rbound - D.lbound + 1);
+        long int best = min_score, best_i = -1;
+        _scoreDiagonal(Diag, d, A, B, N, m_o, D.edits.data(), best, best_i);
+      }
+    };
+    generateDelta(Diag, FinishCt, FinishCDi, N, Delta, restore);
+  }
 
   return TargetReached;
 }
 
-long int aligner::scoreMatch
-     (const Diagonal& Diag, long int Dct, long int CDi,
-      const char * A, const char * B, long int N, unsigned int m_o) const
+void aligner::_scoreDiagonal
+     (DiagonalMatrix& Diag, long int Dct,
+      const char * A, const char * B, long int N, unsigned int m_o,
+      unsigned char * edits, long int & best, long int & best_i) const
+
+     //  Score the nodes of diagonal Dct, within its bounds, from the
+     //  scores of the two previous diagonals. edits receives the packed
+     //  traceback of the nodes. best and best_i are updated as by the
+     //  kernels, best_i being the node index relative to the lbound.
+
+{
+  const long int lbound = Diag[Dct].lbound;
+  const long int Ds     = Diag[Dct].rbound - lbound + 1;
+  auto&          CurS   = Diag.scores(Dct);
+  CurS.resize(Ds);
+
+  //-- Set diagonal index adjustment values
+  int Iadj, Dadj, Madj;       // insert, delete and match adjust values
+  if(Dct <= N) {
+    Iadj = 0;
+    Madj = -1;
+  } else {
+    Iadj = 1;
+    Madj = Dct == N + 1 ? 0 : 1;
+  }
+  Dadj = Iadj - 1;
+
+  //-- Set parent diagonal values
+  const auto& PrevD = Diag[Dct - 1] ; // previous diagonal
+  const auto& PrevS = Diag.scores(Dct - 1);
+  const long int PDs = PrevD.rbound - PrevD.lbound + 1;
+  const long int PDi = lbound + Dadj - PrevD.lbound;
+
+  //-- Set grandparent diagonal values
+  const long PPDct = Dct - 2; //  prev prev diagonal
+  const Diagonal& PPrevD = Diag[std::max((long)0, PPDct)]; // if PPDct < 0, not PPrevD is not used
+  const auto& PPrevS = Diag.scores(std::max((long)0, PPDct));
+  long int PPDi = 0, PPDs = 0;
+  if(PPDct >= 0) {
+    PPDs   = PPrevD.rbound - PPrevD.lbound + 1;
+    PPDi   = lbound + Madj - PPrevD.lbound;
+  }
+
+  //-- Nodes [Mlo, Mhi) have a MATCH parent, nodes [lo, hi) have all
+  //   three parents within the bounds of the previous diagonals
+  const long int Mlo = std::min(Ds, std::max(0L, -PPDi));
+  const long int Mhi = std::max(Mlo, std::min(Ds, PPDs - PPDi));
+  const long int lo  = std::min(Ds, std::max(Mlo, -PDi));
+  const long int hi  = std::max(lo, std::min(Mhi, PDs - 1 - PDi));
+
+  int32_t* match = Diag.match_scores(Ds);
+  scoreMatches(Dct, lbound + Mlo, lbound + Mhi, A, B, N, m_o, match + Mlo);
+
+  DiagonalArgs args;
+  args.Pdel  = PrevS.S[DELETE].data();
+  args.Pins  = PrevS.S[INSERT].data();
+  args.Pmat  = PrevS.S[MATCH].data();
+  args.PPdel = PPrevS.S[DELETE].data();
+  args.PPins = PPrevS.S[INSERT].data();
+  args.PPmat = PPrevS.S[MATCH].data();
+  args.Poff  = PDi;
+  args.PPoff = PPDi;
+  args.match = match;
+  args.del   = CurS.S[DELETE].data();
+  args.ins   = CurS.S[INSERT].data();
+  args.mat   = CurS.S[MATCH].data();
+  args.edits = edits;
+  args.open  = OPEN_GAP_SCORE[_matrix_type];
+  args.cont  = CONT_GAP_SCORE[_matrix_type];
+
+  //-- Calculate scores for every node (within bounds) for diagonal Dct.
+  //   The nodes at the ends with a parent out of bounds are scored one
+  //   at a time, the others by the vectorized kernel.
+  for(long int i = 0; i < lo; ++i)
+    scoreNode(args, i, PDi + i >= 0 && PDi + i < PDs, PDi + i + 1 >= 0 && PDi + i + 1 < PDs,
+              i >= Mlo && i < Mhi, best, best_i);
+  scoreDiagonal(args, lo, hi, best, best_i);
+  for(long int i = hi; i < Ds; ++i)
+    scoreNode(args, i, PDi + i >= 0 && PDi + i < PDs, PDi + i + 1 >= 0 && PDi + i + 1 < PDs,
+              i >= Mlo && i < Mhi, best, best_i);
+}
+
 
-     //  Diag is the single diagonal that contains the node to be scored
-     //  Dct is Diag's diagonal index in the edit matrix
-     //  CDi is the conceptual node to be scored in Diag
+
+
+static inline uint64_t zeroBytes(uint64_t v)
+
+     //  Set the high bit of the bytes of v which are zero
+
+{
+  const uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+  return ~(((v & low7) + low7) | v | low7);
+}
+
+
+
+
+static inline int matchingBases(uint64_t a, uint64_t b)
+
+     //  Number of the 8 bases packed in a and b that score a nucleotide
+     //  match: identical A, C, G or T, regardless of case
+
+{
+  const uint64_t ones = 0x0101010101010101ULL;
+  a |= 0x20 * ones; // lower case
+  b |= 0x20 * ones;
+  const uint64_t acgt = zeroBytes(a ^ ('a' * ones)) | zeroBytes(a ^ ('c' * ones))
+    | zeroBytes(a ^ ('g' * ones)) | zeroBytes(a ^ ('t' * ones));
+  return __builtin_popcountll(zeroBytes(a ^ b) & acgt);
+}
+
+
+
+
+bool aligner::_alignUngapped
+     (const char * A0, long int Astart, const char * B0, long int Bstart,
+      long int N, unsigned int m_o) const
+
+     //  Fast path of alignTarget for N bases of A0 and B0 starting at
+     //  Astart and Bstart. Returns true if _alignEngine is known to reach
+     //  the target along the gapless alignment, and false if it cannot
+     //  tell (the caller must then run _alignEngine).
+     //
+     //  With s the match score, c the cost of a mismatch relative to a
+     //  match and o the gap open score, the gapless alignment with mm
+     //  mismatches scores s*N - c*mm. A gapped alignment ending at the
+     //  target must use both an insertion and a deletion and scores at
+     //  most s*(N-1) + 2*o. If c*mm < s - 2*o, the gapless path is then
+     //  strictly the best to every node along it, so it is the one traced
+     //  back. No node of the path is trimmed if c*mm - o <= max_diff, and
+     //  the search does not break before the target if 2*N <= break_len.
+
+{
+  if ( _matrix_type != NUCLEOTIDE  ||  m_o & (SEARCH_BIT | OPTIMAL_BIT)  ||
+       ~m_o & DIRECTION_BIT  ||  2 * N > _break_len )
+    return false;
+
+  const long int s        = MATCH_SCORE [NUCLEOTIDE] ['A' - 'A'] ['A' - 'A'];
+  const long int c        = s - MATCH_SCORE [NUCLEOTIDE] ['A' - 'A'] ['C' - 'A'];
+  const long int o        = OPEN_GAP_SCORE [NUCLEOTIDE];
+  const long int max_diff = good_score() * _break_len;
+  if ( max_diff + o < 0 )
+    return false;
+  const long int max_mm   = std::min ( (s - 2 * o - 1) / c, (max_diff + o) / c );
+
+  //-- Count the mismatches, 8 bases at a time
+  const char *A = A0 + Astart;
+  const char *B = B0 + Bstart;
+  long int    mm = 0;
+  long int    i  = 0;
+  for ( ; i + 8 <= N; i += 8 )
+    {
+      uint64_t a, b;
+      memcpy (&a, A + i, sizeof(a));
+      memcpy (&b, B + i, sizeof(b));
+      mm += 8 - matchingBases (a, b);
+      if ( mm > max_mm )
+        return false;
+    }
+  for ( ; i < N; ++i )
+    {
+      char Ac = isalpha(A[i]) ? toupper(A[i]) : STOP_CHAR;
+      char Bc = isalpha(B[i]) ? toupper(B[i]) : STOP_CHAR;
+      mm += MATCH_SCORE [NUCLEOTIDE] [Ac - 'A'] [Bc - 'A'] != s;
+    }
+
+  return mm <= max_mm;
+}
+
+
+
+void aligner::scoreMatches
+     (long int Dct, long int CDs, long int CDe,
+      const char * A, const char * B, long int N, unsigned int m_o,
+      int32_t * scores) const
+
+     //  Dct is the index of the diagonal in the edit matrix
+     //  CDs and CDe are the first and past the last conceptual nodes
+     //      to be scored on the diagonal
      //  A and B are the alignment sequences
      //  N is the alignment target index in A
      //  m_o is the modus operandi of the alignment:
      //      FORWARD_ALIGN, FORWARD_SEARCH, BACKWARD_SEARCH
+     //  scores receives the match score of every node
 
 {
   int Dir;
-  char Ac, Bc;
+  const char *Ap, *Bp;
 
   //-- 1 for forward, -1 for reverse
   Dir = m_o & DIRECTION_BIT ? 1 : -1;
 
-  //-- Locate the characters that need to be compared
+  //-- Locate the characters that need to be compared for the first
+  //   node. Going down the diagonal, A goes back and B goes forward
   if ( Dct <= N )
     {
-      Ac = *( A + ( (Dct - CDi) * Dir ) );
-      Bc = *( B + ( (CDi) * Dir ) );
+      Ap = A + ( (Dct - CDs) * Dir );
+      Bp = B + ( (CDs) * Dir );
     }
   else
     {
-      Ac = *( A + ( (N - CDi) * Dir ) );
-      Bc = *( B + ( (Dct - N + CDi) * Dir ) );
+      Ap = A + ( (N - CDs) * Dir );
+      Bp = B + ( (Dct - N + CDs) * Dir );
     }
 
-  if ( ! isalpha(Ac) )
-    Ac = STOP_CHAR;
-  if ( ! isalpha(Bc) )
-    Bc = STOP_CHAR;
-
-  return MATCH_SCORE [_matrix_type] [toupper(Ac) - 'A'] [toupper(Bc) - 'A'];
+  const auto& score = MATCH_SCORE [_matrix_type];
+  for ( long int CDi = CDs; CDi < CDe; ++CDi, Ap -= Dir, Bp += Dir )
+    {
+      char Ac = *Ap;
+      char Bc = *Bp;
+      if ( ! isalpha(Ac) )
+        Ac = STOP_CHAR;
+      if ( ! isalpha(Bc) )
+        Bc = STOP_CHAR;
+      *scores++ = score [toupper(Ac) - 'A'] [toupper(Bc) - 'A'];
+    }
 }
 
 
 
+template<typename Restore>
 static void generateDelta
-     (const DiagonalMatrix& Diag, long int FinishCt, long int FinishCDi,
-      long int N, std::vector<long int> & Delta)
+     (DiagonalMatrix& Diag, long int FinishCt, long int FinishCDi,
+      long int N, std::vector<long int> & Delta, Restore restore)
 
      //  Diag is the list of diagonals that compose the edit matrix
      //  FinishCt is the diagonal that contains the finishing node
@@ -391,6 +583,7 @@ static void generateDelta
      //  N & M are the target positions for the alignment
      //  Delta is the vector in which to store the alignment data, new data
      //      will be appended onto any existing data.
+     //  restore(Dct) is called before the edits of diagonal Dct are read
      //  NOTE: there will be no zero at the end of the data, end of data
      //        is signaled by the end of the vector
      //  Return is void
@@ -410,15 +603,15 @@ static void generateDelta
   long int PSize = 100;     // capacity of the path space
   char * Reverse_Path;       // path space
 
-  Score curr_score;
-  int edit;
+  int edit, next;
 
   //-- malloc space for the edit path
   Reverse_Path = (char *) Safe_malloc ( PSize * sizeof(char) );
 
   //-- Which Score index is the maximum value in? Store in edit
+  restore(Dct);
   Di = CDi - Diag[Dct] . lbound;
-  edit = Diag[Dct].I[Di].edit();
+  edit = Diag[Dct].edit(Di);
 
 
   //-- Walk the path backwards through the edit space
@@ -429,8 +622,9 @@ static void generateDelta
       Reverse_Path = (char *) Safe_realloc( Reverse_Path, sizeof(char) * PSize );
     }
 
+    restore(Dct);
     Di = CDi - Diag[Dct].lbound;
-    curr_score = Diag[Dct].I[Di].S[edit];
+    next = Dct == 0 ? START : Diag[Dct].used(edit, Di);
 
     Reverse_Path[Pi ++] = edit;
     switch ( edit ) {
@@ -453,7 +647,7 @@ static void generateDelta
       exit ( EXIT_FAILURE );
     }
 
-    edit = curr_score.used;
+    edit = next;
   }
 
   //-- Generate the delta information
@@ -488,41 +682,330 @@ static void generateDelta
 
 
 
-static inline int maxScore(Score S[3])
+static inline int maxScore(int32_t del, int32_t ins, int32_t mat)
 
-     //  Return a pointer to the maximum score in the score array
+     //  Return the edit with the maximum score
 
 {
-  if(S[DELETE].value > S[INSERT].value)
-    return S[DELETE].value > S[MATCH].value ? DELETE : MATCH;
+  if(del > ins)
+    return del > mat ? DELETE : MATCH;
   else
-    return S[INSERT].value > S[MATCH].value ? INSERT : MATCH;
+    return ins > mat ? INSERT : MATCH;
 }
 
 
 
 
-static inline void scoreEdit
-     (Score & curr, const long int del, const long int ins, const long int mat)
+static inline int scoreEdit
+     (int32_t & value, const int32_t del, const int32_t ins, const int32_t mat)
 
-     //  Assign current edit a maximal score using either del, ins or mat
+     //  Assign current edit a maximal score using either del, ins or mat,
+     //  return the edit used
 
 {
-  if ( del > ins ) {
-    if ( del > mat ) {
-      curr.value = del;
-      curr.used = DELETE;
-    } else {
-      curr.value = mat;
-      curr.used = MATCH;
+  const int edit = maxScore(del, ins, mat);
+  value = edit == DELETE ? del : (edit == INSERT ? ins : mat);
+  return edit;
+}
+
+
+
+
+static inline long int maxValue
+     (const unsigned char * edits, const DiagonalScores & S, long int i)
+
+     //  Maximum score of node i of a diagonal, whose packed traceback
+     //  and scores are edits and S
+
+{
+  return S.S[edits[i] >> 6][i];
+}
+
+
+
+
+static inline int32_t gapScore(int32_t value, int32_t gap)
+
+     //  Score of opening or extending a gap from value. An edit not used
+     //  (min_score) stays unreachable
+
+{
+  return value == min_score ? value : value + gap;
+}
+
+
+
+
+static inline void scoreNode
+     (const DiagonalArgs & a, long int i, bool del_ok, bool ins_ok, bool mat_ok,
+      long int & best, long int & best_i)
+
+     //  Score node i of the diagonal described by a. del_ok, ins_ok and
+     //  mat_ok tell whether the DELETE, INSERT and MATCH parents are within
+     //  bounds. Update best and best_i if the node scores at least best.
+
+{
+  long int j;
+  int      udel = DELETE, uins = DELETE, umat = DELETE;
+
+  //-- Calculate DELETE score
+  if(del_ok) {
+    j    = a.Poff + i;
+    udel = scoreEdit(a.del[i],
+                     gapScore(a.Pdel[j], a.cont),
+                     gapScore(a.Pins[j], a.open),
+                     gapScore(a.Pmat[j], a.open));
+  } else
+    a.del[i] = min_score;
+
+  //-- Calculate INSERT score
+  if(ins_ok) {
+    j    = a.Poff + i + 1;
+    uins = scoreEdit(a.ins[i],
+                     gapScore(a.Pdel[j], a.open),
+                     gapScore(a.Pins[j], a.cont),
+                     gapScore(a.Pmat[j], a.open));
+  } else
+    a.ins[i] = min_score;
+
+  //-- Calculate MATCH/MIS-MATCH score
+  if(mat_ok) {
+    j        = a.PPoff + i;
+    umat     = scoreEdit(a.mat[i], a.PPdel[j], a.PPins[j], a.PPmat[j]);
+    a.mat[i] = gapScore(a.mat[i], a.match[i]);
+  } else
+    a.mat[i] = min_score;
+
+  const int edit = maxScore(a.del[i], a.ins[i], a.mat[i]);
+  a.edits[i] = udel | (uins << 2) | (umat << 4) | (edit << 6);
+  const int32_t value = edit == DELETE ? a.del[i] : (edit == INSERT ? a.ins[i] : a.mat[i]);
+  if(value >= best) {
+    best   = value;
+    best_i = i;
+  }
+}
+
+
+
+
+static void scoreDiagonalGeneric
+     (const DiagonalArgs & a, long int start, long int end,
+      long int & best, long int & best_i)
+
+     //  Portable kernel, one node at a time
+
+{
+  for(long int i = start; i < end; ++i)
+    scoreNode(a, i, true, true, true, best, best_i);
+}
+
+
+
+
+#ifdef SW_ALIGN_X86_KERNELS
+//-- Vectorized kernels, 4 nodes at once with SSE4.1 and 8 with AVX2.
+//   The edits are chosen with the same comparisons as maxScore and
+//   scoreEdit, hence the scores and the alignments are identical to
+//   the portable kernel.
+#define SW_ALIGN_AVX2 __attribute__((target("avx2")))
+#define SW_ALIGN_SSE41 __attribute__((target("sse4.1")))
+
+SW_ALIGN_AVX2 static inline __m256i gapScore256(__m256i v, __m256i gap, __m256i vmin)
+{
+  return _mm256_blendv_epi8(_mm256_add_epi32(v, gap), v, _mm256_cmpeq_epi32(v, vmin));
+}
+
+// Best of del, ins and mat, the edit chosen is stored in edit
+SW_ALIGN_AVX2 static inline __m256i maxScore256(__m256i del, __m256i ins, __m256i mat, __m256i& edit)
+{
+  const __m256i di = _mm256_cmpgt_epi32(del, ins);
+  const __m256i v1 = _mm256_blendv_epi8(ins, del, di);
+  const __m256i gt = _mm256_cmpgt_epi32(v1, mat);
+  edit = _mm256_blendv_epi8(_mm256_set1_epi32(MATCH),
+                            _mm256_blendv_epi8(_mm256_set1_epi32(INSERT), _mm256_set1_epi32(DELETE), di),
+                            gt);
+  return _mm256_blendv_epi8(mat, v1, gt);
+}
+
+// Store the low byte of the 8 32-bit lanes of v
+SW_ALIGN_AVX2 static inline void storeEdits256(unsigned char* p, __m256i v)
+{
+  const __m256i sh = _mm256_shuffle_epi8(v, _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                             0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+  const __m256i pk = _mm256_permutevar8x32_epi32(sh, _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1));
+  _mm_storel_epi64((__m128i*)p, _mm256_castsi256_si128(pk));
+}
+
+SW_ALIGN_AVX2 static void scoreDiagonalAVX2
+     (const DiagonalArgs & a, long int i, long int end,
+      long int & best, long int & best_i)
+{
+  const __m256i vmin    = _mm256_set1_epi32(min_score);
+  const __m256i vopen   = _mm256_set1_epi32(a.open);
+  const __m256i vcont   = _mm256_set1_epi32(a.cont);
+  __m256i       vbest   = vmin;
+  __m256i       vbest_i = _mm256_set1_epi32(-1);
+  __m256i       vi      = _mm256_add_epi32(_mm256_set1_epi32(i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  const bool    any     = i + 8 <= end;
+
+  for( ; i + 8 <= end; i += 8, vi = _mm256_add_epi32(vi, _mm256_set1_epi32(8))) {
+    __m256i udel, uins, umat, edit, v;
+
+    //-- DELETE score
+    const long int j = a.Poff + i;
+    const __m256i del = maxScore256(gapScore256(_mm256_loadu_si256((const __m256i*)(a.Pdel + j)), vcont, vmin),
+                                    gapScore256(_mm256_loadu_si256((const __m256i*)(a.Pins + j)), vopen, vmin),
+                                    gapScore256(_mm256_loadu_si256((const __m256i*)(a.Pmat + j)), vopen, vmin), udel);
+    _mm256_storeu_si256((__m256i*)(a.del + i), del);
+
+    //-- INSERT score
+    const __m256i ins = maxScore256(gapScore256(_mm256_loadu_si256((const __m256i*)(a.Pdel + j + 1)), vopen, vmin),
+                                    gapScore256(_mm256_loadu_si256((const __m256i*)(a.Pins + j + 1)), vcont, vmin),
+                                    gapScore256(_mm256_loadu_si256((const __m256i*)(a.Pmat + j + 1)), vopen, vmin), uins);
+    _mm256_storeu_si256((__m256i*)(a.ins + i), ins);
+
+    //-- MATCH/MIS-MATCH score
+    const long int k = a.PPoff + i;
+    v = maxScore256(_mm256_loadu_si256((const __m256i*)(a.PPdel + k)),
+                    _mm256_loadu_si256((const __m256i*)(a.PPins + k)),
+                    _mm256_loadu_si256((const __m256i*)(a.PPmat + k)), umat);
+    const __m256i mat = gapScore256(v, _mm256_loadu_si256((const __m256i*)(a.match + i)), vmin);
+    _mm256_storeu_si256((__m256i*)(a.mat + i), mat);
+
+    //-- Maximum score of the nodes, keep the last index reaching it
+    v = maxScore256(del, ins, mat, edit);
+    edit = _mm256_or_si256(_mm256_or_si256(udel, _mm256_slli_epi32(uins, 2)),
+                           _mm256_or_si256(_mm256_slli_epi32(umat, 4), _mm256_slli_epi32(edit, 6)));
+    storeEdits256(a.edits + i, edit);
+    const __m256i lt = _mm256_cmpgt_epi32(vbest, v);
+    vbest   = _mm256_blendv_epi8(v, vbest, lt);
+    vbest_i = _mm256_blendv_epi8(vi, vbest_i, lt);
+  }
+
+  if(any) {
+    int32_t lbest[8], lbest_i[8];
+    _mm256_storeu_si256((__m256i*)lbest, vbest);
+    _mm256_storeu_si256((__m256i*)lbest_i, vbest_i);
+    int32_t b = lbest[0], bi = lbest_i[0];
+    for(int l = 1; l < 8; ++l) {
+      if(lbest[l] > b || (lbest[l] == b && lbest_i[l] > bi)) {
+        b  = lbest[l];
+        bi = lbest_i[l];
+      }
+    }
+    if(b >= best) {
+      best   = b;
+      best_i = bi;
+    }
+  }
+  scoreDiagonalGeneric(a, i, end, best, best_i);
+}
+
+SW_ALIGN_SSE41 static inline __m128i gapScore128(__m128i v, __m128i gap, __m128i vmin)
+{
+  return _mm_blendv_epi8(_mm_add_epi32(v, gap), v, _mm_cmpeq_epi32(v, vmin));
+}
+
+SW_ALIGN_SSE41 static inline __m128i maxScore128(__m128i del, __m128i ins, __m128i mat, __m128i& edit)
+{
+  const __m128i di = _mm_cmpgt_epi32(del, ins);
+  const __m128i v1 = _mm_blendv_epi8(ins, del, di);
+  const __m128i gt = _mm_cmpgt_epi32(v1, mat);
+  edit = _mm_blendv_epi8(_mm_set1_epi32(MATCH),
+                         _mm_blendv_epi8(_mm_set1_epi32(INSERT), _mm_set1_epi32(DELETE), di),
+                         gt);
+  return _mm_blendv_epi8(mat, v1, gt);
+}
+
+SW_ALIGN_SSE41 static inline void storeEdits128(unsigned char* p, __m128i v)
+{
+  const int32_t x = _mm_cvtsi128_si32(_mm_shuffle_epi8(v, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,
+                                                                        -1, -1, -1, -1, -1, -1, -1, -1)));
+  memcpy(p, &x, sizeof(x));
+}
+
+SW_ALIGN_SSE41 static void scoreDiagonalSSE41
+     (const DiagonalArgs & a, long int i, long int end,
+      long int & best, long int & best_i)
+{
+  const __m128i vmin    = _mm_set1_epi32(min_score);
+  const __m128i vopen   = _mm_set1_epi32(a.open);
+  const __m128i vcont   = _mm_set1_epi32(a.cont);
+  __m128i       vbest   = vmin;
+  __m128i       vbest_i = _mm_set1_epi32(-1);
+  __m128i       vi      = _mm_add_epi32(_mm_set1_epi32(i), _mm_setr_epi32(0, 1, 2, 3));
+  const bool    any     = i + 4 <= end;
+
+  for( ; i + 4 <= end; i += 4, vi = _mm_add_epi32(vi, _mm_set1_epi32(4))) {
+    __m128i udel, uins, umat, edit, v;
+
+    //-- DELETE score
+    const long int j = a.Poff + i;
+    const __m128i del = maxScore128(gapScore128(_mm_loadu_si128((const __m128i*)(a.Pdel + j)), vcont, vmin),
+                                    gapScore128(_mm_loadu_si128((const __m128i*)(a.Pins + j)), vopen, vmin),
+                                    gapScore128(_mm_loadu_si128((const __m128i*)(a.Pmat + j)), vopen, vmin), udel);
+    _mm_storeu_si128((__m128i*)(a.del + i), del);
+
+    //-- INSERT score
+    const __m128i ins = maxScore128(gapScore128(_mm_loadu_si128((const __m128i*)(a.Pdel + j + 1)), vopen, vmin),
+                                    gapScore128(_mm_loadu_si128((const __m128i*)(a.Pins + j + 1)), vcont, vmin),
+                                    gapScore128(_mm_loadu_si128((const __m128i*)(a.Pmat + j + 1)), vopen, vmin), uins);
+    _mm_storeu_si128((__m128i*)(a.ins + i), ins);
+
+    //-- MATCH/MIS-MATCH score
+    const long int k = a.PPoff + i;
+    v = maxScore128(_mm_loadu_si128((const __m128i*)(a.PPdel + k)),
+                    _mm_loadu_si128((const __m128i*)(a.PPins + k)),
+                    _mm_loadu_si128((const __m128i*)(a.PPmat + k)), umat);
+    const __m128i mat = gapScore128(v, _mm_loadu_si128((const __m128i*)(a.match + i)), vmin);
+    _mm_storeu_si128((__m128i*)(a.mat + i), mat);
+
+    //-- Maximum score of the nodes, keep the last index reaching it
+    v = maxScore128(del, ins, mat, edit);
+    edit = _mm_or_si128(_mm_or_si128(udel, _mm_slli_epi32(uins, 2)),
+                        _mm_or_si128(_mm_slli_epi32(umat, 4), _mm_slli_epi32(edit, 6)));
+    storeEdits128(a.edits + i, edit);
+    const __m128i lt = _mm_cmpgt_epi32(vbest, v);
+    vbest   = _mm_blendv_epi8(v, vbest, lt);
+    vbest_i = _mm_blendv_epi8(vi, vbest_i, lt);
+  }
+
+  if(any) {
+    int32_t lbest[4], lbest_i[4];
+    _mm_storeu_si128((__m128i*)lbest, vbest);
+    _mm_storeu_si128((__m128i*)lbest_i, vbest_i);
+    int32_t b = lbest[0], bi = lbest_i[0];
+    for(int l = 1; l < 4; ++l) {
+      if(lbest[l] > b || (lbest[l] == b && lbest_i[l] > bi)) {
+        b  = lbest[l];
+        bi = lbest_i[l];
+      }
+    }
+    if(b >= best) {
+      best   = b;
+      best_i = bi;
     }
-  } else if ( ins > mat ) {
-    curr.value = ins;
-    curr.used = INSERT;
-  }  else {
-    curr.value = mat;
-    curr.used = MATCH;
   }
+  scoreDiagonalGeneric(a, i, end, best, best_i);
+}
+#endif // SW_ALIGN_X86_KERNELS
+
+
+
+
+static DiagonalKernel selectKernel()
+
+     //  Pick the fastest diagonal kernel supported by the CPU
+
+{
+#ifdef SW_ALIGN_X86_KERNELS
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+    return scoreDiagonalAVX2;
+  if(__builtin_cpu_supports("sse4.1"))
+    return scoreDiagonalSSE41;
+#endif
+  return scoreDiagonalGeneric;
 }
 
 } // namespace sw_align
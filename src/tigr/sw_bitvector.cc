@@ -0,0 +1,245 @@
+#include <limits>
+#include <algorithm>
+#include <mummer/sw_align.hh>
+
+namespace mummer {
+namespace sw_align {
+
+static const long int WORD_SIZE = 64;
+
+//----------------------------------------- Private Function Declarations ----//
+static inline int baseCode(char c);
+
+static inline int advanceBlock(uint64_t & P, uint64_t & M, uint64_t Eq, int hin);
+
+static inline long int popcount(uint64_t x) { return __builtin_popcountll(x); }
+
+
+//------------------------------------------ Private Function Definitions ----//
+bool aligner::_searchBitVector
+     (const char* A0, long int Astart, long int & Aend,
+      const char* B0, long int Bstart, long int & Bend,
+      unsigned int m_o, DiagonalMatrix& Diag) const
+
+     //  Same interface and modus operandi as _alignEngine in search
+     //  mode, for the NUCLEOTIDE matrix. Only the end of the extension is
+     //  needed, which is estimated from the edit distance D(i, j) between
+     //  A[1..i] and B[1..j] computed with the bit-parallel algorithm of
+     //  Myers, 64 rows of a column per machine word.
+     //
+     //  The score of the cell (i, j) is estimated as
+     //  (s * (i + j) - x * D(i, j)) / 2, with s the match score and x
+     //  twice the difference between the match and mismatch scores. It
+     //  is exact for ungapped alignments and slightly underestimates the
+     //  gaps. Like the nodes trimmed by _alignEngine, the blocks scoring
+     //  more than good_score * break_len below the high score are dropped
+     //  from the ends of the column (Ukkonen banding), and the search
+     //  stops when no block is left.
+
+{
+  const char *A, *B;            // the sequence pointers to be used by this func
+  long int    N, M;             // lengths of A and B
+  int         Dir;              // 1 for forward, -1 for reverse
+
+  //-- Set up character pointers for the appropriate m_o
+  if(m_o & DIRECTION_BIT) {
+    A   = A0 + ( Astart - 1 );
+    B   = B0 + ( Bstart - 1 );
+    N   = Aend - Astart + 1;
+    M   = Bend - Bstart + 1;
+    Dir = 1;
+  } else {
+    A   = A0 + ( Astart + 1 );
+    B   = B0 + ( Bstart + 1 );
+    N   = Astart - Aend + 1;
+    M   = Bstart - Bend + 1;
+    Dir = -1;
+  }
+
+  //-- Score estimate, see above (doubled)
+  const long int sm       = MATCH_SCORE [NUCLEOTIDE] ['A' - 'A'] ['A' - 'A'];
+  const long int x        = 2 * (sm - MATCH_SCORE [NUCLEOTIDE] ['A' - 'A'] ['C' - 'A']);
+  const long int max_diff = 2 * (long int)good_score() * _break_len;
+  const bool     forced   = m_o & FORCED_BIT;
+
+  BitBlocks&     Blocks  = Diag.bit_blocks();
+  const long int nblocks = (N + WORD_SIZE - 1) / WORD_SIZE;
+  for(auto& peq : Blocks.Peq)
+    peq.resize(nblocks);
+  Blocks.P.resize(nblocks);
+  Blocks.M.resize(nblocks);
+  Blocks.bottom.resize(nblocks);
+  Blocks.best.resize(nblocks);
+
+  //-- Add block b below the last block of column j. Its rows are not
+  //   computed yet and get the edit distance of a gap in B, which is
+  //   never lower than the actual distance.
+  auto addBlock = [&](long int b) {
+    for(auto& peq : Blocks.Peq)
+      peq[b] = 0;
+    const long int rows = std::min(WORD_SIZE, N - b * WORD_SIZE);
+    for(long int t = 0; t < rows; ++t) {
+      const int c = baseCode(A[(b * WORD_SIZE + t + 1) * Dir]);
+      if(c >= 0)
+        Blocks.Peq[c][b] |= (uint64_t)1 << t;
+    }
+    Blocks.P[b]      = ~(uint64_t)0;
+    Blocks.M[b]      = 0;
+    Blocks.bottom[b] = (b == 0 ? 0 : Blocks.bottom[b - 1]) + WORD_SIZE;
+  };
+
+  //-- Score of row b * WORD_SIZE + t of column j, t in [0, WORD_SIZE]
+  auto rowScore = [&](long int b, long int j, long int t) -> long int {
+    const uint64_t mask  = t == WORD_SIZE ? ~(uint64_t)0 : ((uint64_t)1 << t) - 1;
+    const long int Dtop  = Blocks.bottom[b] - popcount(Blocks.P[b]) + popcount(Blocks.M[b]);
+    const long int D     = Dtop + popcount(Blocks.P[b] & mask) - popcount(Blocks.M[b] & mask);
+    return sm * (b * WORD_SIZE + t + j) - x * D;
+  };
+
+  long int high_score = 0, xhigh_score = std::numeric_limits<long>::min();
+  long int Fi = 0, Fj = 0, xFi = -1, xFj = 0; // cells of the high scores
+  bool     TargetReached = false;
+  long int first = 0, last = 0;                // band of blocks
+  addBlock(0);
+
+  //-- **START** of column loop
+  for(long int j = 0; ; ++j) {
+    if(j > 0) {
+      const int c   = baseCode(B[j * Dir]);
+      int       hin = 1; // D(0, j) = j
+      for(long int b = first; b <= last; ++b) {
+        hin = advanceBlock(Blocks.P[b], Blocks.M[b], c < 0 ? 0 : Blocks.Peq[c][b], hin);
+        Blocks.bottom[b] += hin;
+      }
+    }
+
+    //-- High score of each block. Within a block, the score increases
+    //   at each row except below a positive vertical difference: the
+    //   maximum is at the start of a run of positive differences or at
+    //   the last row.
+    long int col_score = std::numeric_limits<long>::min(), col_i = 0;
+    for(long int b = first; b <= last; ++b) {
+      const long int rows = std::min(WORD_SIZE, N - b * WORD_SIZE);
+      uint64_t       runs = Blocks.P[b] & ~(Blocks.P[b] << 1);
+      if(rows < WORD_SIZE)
+        runs &= ((uint64_t)1 << rows) - 1;
+      long int best = rowScore(b, j, rows), best_t = rows;
+      for( ; runs; runs &= runs - 1) {
+        const long int t  = __builtin_ctzll(runs);
+        const long int sc = rowScore(b, j, t);
+        if(sc > best) {
+          best   = sc;
+          best_t = t;
+        }
+      }
+      Blocks.best[b] = best;
+      if(best >= col_score) {
+        col_score = best;
+        col_i     = b * WORD_SIZE + best_t;
+      }
+    }
+    if(col_score >= high_score) {
+      high_score = col_score;
+      Fi = col_i; Fj = j;
+    }
+
+    //-- Cells of the last row, last column and target
+    const bool     last_row = last == nblocks - 1;
+    const long int row_score = last_row ? rowScore(last, j, N - last * WORD_SIZE) : 0;
+    if(m_o & SEQEND_BIT) {
+      if(N <= M && last_row && row_score >= xhigh_score) {
+        xhigh_score = row_score;
+        xFi = N; xFj = j;
+      } else if(N > M && j == M) {
+        xhigh_score = col_score;
+        xFi = col_i; xFj = j;
+      }
+    }
+    if(j == M) {
+      if(last_row)
+        TargetReached = forced  ||  row_score >= high_score - max_diff;
+      break;
+    }
+
+    if(!forced) {
+      //-- Drop the hopeless blocks and stop when none is left
+      while(first <= last && Blocks.best[first] < high_score - max_diff)
+        ++first;
+      while(last > first && Blocks.best[last] < high_score - max_diff)
+        --last;
+      if(first > last)
+        break;
+    }
+
+    //-- Grow the band down while the bottom row is not hopeless
+    while(last < nblocks - 1  &&  (forced  ||  rowScore(last, j, WORD_SIZE) >= high_score - max_diff)) {
+      addBlock(++last);
+      Blocks.best[last] = std::numeric_limits<long>::min();
+    }
+  }
+  //-- **END** of column loop
+
+  //-- If OPTIMAL, end at the high score unless it is the target
+  if(TargetReached && m_o & OPTIMAL_BIT && ~m_o & SEQEND_BIT && !(Fi == N && Fj == M))
+    TargetReached = false;
+  long int Ei = N, Ej = M;
+  if(!TargetReached) {
+    if(m_o & SEQEND_BIT  &&  xFi >= 0) {
+      //-- non-optimal, extend alignment to end of shortest seq if possible
+      Ei = xFi; Ej = xFj;
+    } else {
+      Ei = Fi; Ej = Fj;
+    }
+  }
+
+  //-- Set A/Bend to finish positions
+  Aend = Astart + Dir * (Ei - 1);
+  Bend = Bstart + Dir * (Ej - 1);
+
+  return TargetReached;
+}
+
+
+
+static inline int baseCode(char c)
+
+     //  Index of the base c in the match masks, -1 if c never matches
+     //  with the NUCLEOTIDE matrix
+
+{
+  switch(c) {
+  case 'a': case 'A': return 0;
+  case 'c': case 'C': return 1;
+  case 'g': case 'G': return 2;
+  case 't': case 'T': return 3;
+  default: return -1;
+  }
+}
+
+
+
+static inline int advanceBlock(uint64_t & P, uint64_t & M, uint64_t Eq, int hin)
+
+     //  Myers' step to the next column on a block of 64 rows. P and M
+     //  are the vertical differences, Eq the rows matching the base of
+     //  the column and hin the horizontal difference in the row above
+     //  the block. Returns the horizontal difference in the bottom row.
+
+{
+  const uint64_t hneg = hin < 0;
+  const uint64_t hpos = hin > 0;
+  const uint64_t Xv   = Eq | M;
+  Eq                 |= hneg;
+  const uint64_t Xh   = (((Eq & P) + P) ^ P) | Eq;
+  uint64_t       Ph   = M | ~(Xh | P);
+  uint64_t       Mh   = P & Xh;
+  const int      hout = (int)(Ph >> (WORD_SIZE - 1)) - (int)(Mh >> (WORD_SIZE - 1));
+  Ph                  = (Ph << 1) | hpos;
+  Mh                  = (Mh << 1) | hneg;
+  P                   = Mh | ~(Xv | Ph);
+  M                   = Ph & Xv;
+  return hout;
+}
+
+} // namespace sw_align
+} // namespace mummer
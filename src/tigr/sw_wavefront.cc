@@ -0,0 +1,315 @@
+#include <ctype.h>
+#include <limits>
+#include <algorithm>
+#include <mummer/sw_align.hh>
+
+namespace mummer {
+namespace sw_align {
+
+//-- Edits of the alignment path, as in sw_align.cc
+static const int DELETE = 0;
+static const int INSERT = 1;
+static const int MATCH  = 2;
+
+//-- Offset of an unreachable cell. Stays negative when incremented
+static const int32_t no_offset = std::numeric_limits<int32_t>::min() / 2;
+
+//----------------------------------------- Private Function Declarations ----//
+static inline bool sameBase(char a, char b);
+
+static inline int32_t getOffset
+     (const DiagonalMatrix& W, long int s, long int k, std::vector<int32_t> Wavefront::* comp);
+
+static inline int32_t mismatchOffset
+     (const DiagonalMatrix& W, long int s, long int k, long int N, long int M);
+
+
+//------------------------------------------ Private Function Definitions ----//
+bool aligner::_alignWavefront
+     (const char* A0, long int Astart, long int & Aend,
+      const char* B0, long int Bstart, long int & Bend,
+      std::vector<long int>& Delta, unsigned int m_o,
+      DiagonalMatrix& W) const
+
+     //  Same interface and modus operandi as _alignEngine, for the
+     //  NUCLEOTIDE matrix. The gap-affine wavefront algorithm explores
+     //  the alignments by increasing penalty, the work is proportional to
+     //  the number of edits instead of the length of the sequences.
+     //
+     //  The scores are turned into penalties: with s the match score, an
+     //  alignment ending at (i, j) with penalty p has score
+     //  (s * (i + j) - p) / 2 where a mismatch costs 2 * (s - mismatch), the
+     //  first base of a gap s - 2 * open and the next ones s - 2 * cont.
+     //  The maximum score alignments are the minimum penalty alignments.
+     //
+     //  Unless FORCED, diagonals are dropped from the ends of a wavefront
+     //  when their score falls more than good_score * break_len below the
+     //  high score (X-drop), like the nodes trimmed by _alignEngine, and
+     //  the search stops when no diagonal is left. Banding is ignored.
+     //  If the wavefronts grow larger than a band of the dynamic
+     //  programming matrix would, the sequences are too divergent and
+     //  the alignment is done by _alignEngine.
+
+{
+  const char *A, *B;            // the sequence pointers to be used by this func
+  long int    N, M;             // lengths of A and B
+  int         Dir;              // 1 for forward, -1 for reverse
+
+  //-- Set up character pointers for the appropriate m_o
+  if(m_o & DIRECTION_BIT) {
+    A   = A0 + ( Astart - 1 );
+    B   = B0 + ( Bstart - 1 );
+    N   = Aend - Astart + 1;
+    M   = Bend - Bstart + 1;
+    Dir = 1;
+  } else {
+    A   = A0 + ( Astart + 1 );
+    B   = B0 + ( Bstart + 1 );
+    N   = Astart - Aend + 1;
+    M   = Bstart - Bend + 1;
+    Dir = -1;
+  }
+
+  //-- Penalties, see above
+  const long int sm = MATCH_SCORE [NUCLEOTIDE] ['A' - 'A'] ['A' - 'A'];
+  const long int x  = 2 * (sm - MATCH_SCORE [NUCLEOTIDE] ['A' - 'A'] ['C' - 'A']);
+  const long int oe = sm - 2 * OPEN_GAP_SCORE [NUCLEOTIDE];
+  const long int e  = sm - 2 * CONT_GAP_SCORE [NUCLEOTIDE];
+
+  const long int max_diff  = 2 * (long int)good_score() * _break_len; // max score difference (doubled)
+  const long int max_cells = 16 * (N + M + 1); // cells computed before giving up for _alignEngine
+  const bool     forced    = m_o & FORCED_BIT;
+  const long int target_k  = M - N;          // diagonal of the target
+
+  //-- Extend along the matches from offset j on diagonal k
+  auto extend = [&](long int k, int32_t j) -> int32_t {
+    long int i = j - k;
+    while(i < N && j < M && sameBase(A[(i + 1) * Dir], B[(j + 1) * Dir])) {
+      ++i;
+      ++j;
+    }
+    return j;
+  };
+  auto score = [&](long int s, long int k, int32_t j) -> long int {
+    return sm * (2 * j - k) - s;
+  };
+
+  long int high_score = std::numeric_limits<long>::min(); // doubled score of the best cell
+  long int xhigh_score = high_score;                       // non-optimal high score
+  long int Fs = 0, Fk = 0, xFs = -1, xFk = 0;              // penalty and diagonal of the best cells
+  int32_t  Fj = 0, xFj = 0;                                // and their offset
+  long int cells = 0;
+  long int last_s = 0;                                     // last non-empty wavefront
+  bool     TargetReached = false;
+
+  //-- **START** of wavefront loop
+  long int s;
+  for(s = 0; ; ++s) {
+    Wavefront& w = W.wavefront(s);
+
+    //-- Diagonal range from the source wavefronts
+    long int lo = s == 0 ? 0 : std::numeric_limits<long>::max();
+    long int hi = s == 0 ? 0 : std::numeric_limits<long>::min();
+    if(s >= x && W.wavefront(s - x).lo <= W.wavefront(s - x).hi) {
+      lo = std::min(lo, W.wavefront(s - x).lo);
+      hi = std::max(hi, W.wavefront(s - x).hi);
+    }
+    for(long int p : { s - oe, s - e }) {
+      if(p >= 0 && W.wavefront(p).lo <= W.wavefront(p).hi) {
+        lo = std::min(lo, W.wavefront(p).lo - 1);
+        hi = std::max(hi, W.wavefront(p).hi + 1);
+      }
+    }
+    lo     = std::max(lo, -N);
+    hi     = std::min(hi, M);
+    w.base = lo;
+
+    //-- Compute the furthest reaching offsets
+    if(lo <= hi) {
+      const size_t size = hi - lo + 1;
+      w.M.resize(size);
+      w.I.resize(size);
+      w.D.resize(size);
+      cells += size;
+      for(long int k = lo; k <= hi; ++k) {
+        int32_t ins = std::max(getOffset(W, s - oe, k + 1, &Wavefront::M), getOffset(W, s - e, k + 1, &Wavefront::I));
+        if(ins - k > N)
+          ins = no_offset;
+        int32_t del = std::max(getOffset(W, s - oe, k - 1, &Wavefront::M), getOffset(W, s - e, k - 1, &Wavefront::D)) + 1;
+        if(del > M)
+          del = no_offset;
+        const int32_t mat = s == 0 ? 0 : std::max(mismatchOffset(W, s - x, k, N, M), std::max(ins, del));
+        w.I[k - lo] = ins;
+        w.D[k - lo] = del;
+        w.M[k - lo] = mat >= 0 ? extend(k, mat) : no_offset;
+      }
+    }
+    w.lo = lo;
+    w.hi = hi;
+
+    //-- Keep track of the high scores and of the target
+    for(long int k = lo; k <= hi; ++k) {
+      const int32_t j = w.M[k - lo];
+      if(j < 0)
+        continue;
+      const long int sc = score(s, k, j);
+      if(sc >= high_score) {
+        high_score = sc;
+        Fs = s; Fk = k; Fj = j;
+      }
+      if(m_o & SEQEND_BIT  &&  (N <= M ? j - k == N : j == M)  &&  sc >= xhigh_score) {
+        xhigh_score = sc;
+        xFs = s; xFk = k; xFj = j;
+      }
+      if(k == target_k  &&  j == M)
+        TargetReached = true;
+    }
+    if(TargetReached)
+      break;
+
+    if(!forced) {
+      //-- Drop hopeless diagonals
+      while(w.lo <= w.hi && (w.M[w.lo - lo] < 0 || high_score - score(s, w.lo, w.M[w.lo - lo]) > max_diff))
+        ++w.lo;
+      while(w.hi >= w.lo && (w.M[w.hi - lo] < 0 || high_score - score(s, w.hi, w.M[w.hi - lo]) > max_diff))
+        --w.hi;
+
+      //-- Stop when no wavefront is left to grow from or when no cell
+      //   can score within max_diff of the high score
+      if(w.lo <= w.hi)
+        last_s = s;
+      else if(s - last_s > std::max(x, oe))
+        break;
+      if(high_score - (sm * (N + M) - s) > max_diff)
+        break;
+    }
+
+    if(cells > max_cells)
+      return _alignEngine(A0, Astart, Aend, B0, Bstart, Bend, Delta, m_o, W);
+  }
+  //-- **END** of wavefront loop
+
+  //-- Pick the end of the alignment
+  //   If OPTIMAL, end at the high score unless it is the target
+  long int Es, Ek;
+  int32_t  Ej;
+  if(TargetReached  &&  (~m_o & OPTIMAL_BIT  ||  m_o & SEQEND_BIT  ||
+                         (Fs == s  &&  Fk == target_k  &&  Fj == M))) {
+    Es = s; Ek = target_k; Ej = M;
+  } else {
+    TargetReached = false;
+    if(m_o & SEQEND_BIT  &&  xFs >= 0) {
+      //-- non-optimal, extend alignment to end of shortest seq if possible
+      Es = xFs; Ek = xFk; Ej = xFj;
+    } else {
+      Es = Fs; Ek = Fk; Ej = Fj;
+    }
+  }
+
+  //-- Set A/Bend to finish positions
+  Aend = Astart + Dir * (Ej - Ek - 1);
+  Bend = Bstart + Dir * (Ej - 1);
+
+  if(m_o & SEARCH_BIT)
+    return TargetReached;
+
+  //-- Trace the path back through the wavefronts
+  std::vector<char> Reverse_Path;
+  int               edit = MATCH;
+  int32_t           j    = Ej;
+  s                      = Es;
+  for(long int k = Ek; ; ) {
+    const Wavefront& w = W.wavefront(s);
+    if(edit == MATCH) {
+      int32_t mis = no_offset, from = 0;
+      if(s > 0) {
+        mis  = mismatchOffset(W, s - x, k, N, M);
+        from = std::max(mis, std::max(w.I[k - w.base], w.D[k - w.base]));
+      }
+      for( ; j > from; --j)
+        Reverse_Path.push_back(MATCH);
+      if(s == 0)
+        break;
+      if(from == mis) {
+        Reverse_Path.push_back(MATCH);
+        --j;
+        s -= x;
+      } else if(from == w.I[k - w.base]) {
+        edit = INSERT;
+      } else {
+        edit = DELETE;
+      }
+    } else if(edit == INSERT) { // base of A against a gap, from diagonal k + 1
+      Reverse_Path.push_back(INSERT);
+      ++k;
+      if(getOffset(W, s - oe, k, &Wavefront::M) == j) {
+        s   -= oe;
+        edit = MATCH;
+      } else {
+        s -= e;
+      }
+    } else { // base of B against a gap, from diagonal k - 1
+      Reverse_Path.push_back(DELETE);
+      --k;
+      --j;
+      if(getOffset(W, s - oe, k, &Wavefront::M) == j) {
+        s   -= oe;
+        edit = MATCH;
+      } else {
+        s -= e;
+      }
+    }
+  }
+
+  //-- Generate the delta information
+  long int Count = 1;
+  for(auto it = Reverse_Path.crbegin(); it != Reverse_Path.crend(); ++it) {
+    switch(*it) {
+    case DELETE: Delta.push_back(-Count); Count = 1; break;
+    case INSERT: Delta.push_back(Count); Count = 1; break;
+    default: Count++; break;
+    }
+  }
+
+  return TargetReached;
+}
+
+
+
+static inline bool sameBase(char a, char b)
+
+     //  Whether a and b score a match with the NUCLEOTIDE matrix
+
+{
+  a = toupper(a);
+  return a == toupper(b) && (a == 'A' || a == 'C' || a == 'G' || a == 'T');
+}
+
+
+
+static inline int32_t getOffset
+     (const DiagonalMatrix& W, long int s, long int k, std::vector<int32_t> Wavefront::* comp)
+
+     //  Offset on diagonal k of the component comp of wavefront s
+
+{
+  if(s < 0)
+    return no_offset;
+  const Wavefront& w = W.wavefront(s);
+  return k >= w.lo && k <= w.hi ? (w.*comp)[k - w.base] : no_offset;
+}
+
+
+
+static inline int32_t mismatchOffset
+     (const DiagonalMatrix& W, long int s, long int k, long int N, long int M)
+
+     //  Offset on diagonal k after a mismatch from wavefront s
+
+{
+  const int32_t j = getOffset(W, s, k, &Wavefront::M) + 1;
+  return j > M || j - k > N ? no_offset : j;
+}
+
+} // namespace sw_align
+} // namespace mummer
@@ -1,5 +1,6 @@
 #include <mummer/tigrinc.hh>
 #include <unistd.h>
+#include <istream>
 
 FILE *  File_Open  (const char * Filename, const char * Mode)
 
@@ -314,8 +315,32 @@ bool CompareIUPAC (char x, char y)
 }
 
 
-bool Read_String  (FILE * fp, char * & T, long int & Size, char Name [],
-                   bool Partial)
+//-- Character sources of Read_String
+struct File_Source
+  {
+   FILE * fp;
+   int  get  ()  { return fgetc (fp); }
+   void  unget  (int Ch)  { ungetc (Ch, fp); }
+   bool  gets  (char Line [], int N)  { return fgets (Line, N, fp) != NULL; }
+  };
+
+struct Stream_Source
+  {
+   std::istream & is;
+   int  get  ()  { return is.get (); }
+   void  unget  (int Ch)  { is.putback (Ch); }
+   bool  gets  (char Line [], int N)    // As fgets, keep the newline
+     {
+      if  (! is.getline (Line, N - 1))
+          return  false;
+      strcat (Line, "\n");
+      return  true;
+     }
+  };
+
+template<typename Source>
+static bool Read_String_From  (Source & fp, char * & T, long int & Size, char Name [],
+                               bool Partial)
 
 /* Read next string from  fp  (assuming FASTA format) into  T [1 ..]
 *  which has  Size  characters.  Allocate extra memory if needed
@@ -329,13 +354,13 @@ bool Read_String  (FILE * fp, char * & T, long int & Size, char Name [],
    long int  Len, Lo, Hi;
    int  Ch, Ct;
 
-   while  ((Ch = fgetc (fp)) != EOF && Ch != '>')
+   while  ((Ch = fp.get ()) != EOF && Ch != '>')
      ;
 
    if  (Ch == EOF)
        return  false;
 
-   if(!fgets (Line, MAX_LINE, fp)) return false;
+   if(!fp.gets (Line, MAX_LINE)) return false;
    Len = strlen (Line);
    assert (Len > 0 && Line [Len - 1] == '\n');
    P = strtok (Line, " \t\n");
@@ -360,7 +385,7 @@ bool Read_String  (FILE * fp, char * & T, long int & Size, char Name [],
    Ct = 0;
    T [0] = '\0';
    Len = 1;
-   while  ((Ch = fgetc (fp)) != EOF && Ch != '>')
+   while  ((Ch = fp.get ()) != EOF && Ch != '>')
      {
       if  (isspace (Ch))
           continue;
@@ -388,13 +413,35 @@ bool Read_String  (FILE * fp, char * & T, long int & Size, char Name [],
 
    T [Len] = '\0';
    if  (Ch == '>')
-       ungetc (Ch, fp);
+       fp.unget (Ch);
 
    return  true;
   }
 
 
 
+bool Read_String  (FILE * fp, char * & T, long int & Size, char Name [],
+                   bool Partial)
+  {
+   File_Source  source = { fp };
+   return  Read_String_From (source, T, Size, Name, Partial);
+  }
+
+
+bool Read_String  (std::istream & is, char * & T, long int & Size, char Name [],
+                   bool Partial)
+
+/* As above, reading from the stream  is, e.g. a compressed file
+*  (see compressed_stream.hh).
+*/
+
+  {
+   Stream_Source  source = { is };
+   return  Read_String_From (source, T, Size, Name, Partial);
+  }
+
+
+
 void  Reverse_Complement
     (char S [], long int Lo, long int Hi)
 
@@ -1,6 +1,63 @@
 #include <mummer/translate.hh>
 
 
+namespace {
+//-- Lookup tables for the codons made only of a, c, g and t/u. These
+//   are packed on 2 bits per base, the translation of a codon is a
+//   single lookup in a 64 entries table. The codons with any other
+//   (ambiguous or invalid) base go through the universal table.
+struct codon_tables {
+  unsigned char code[256];      // 2 bit code of a base, 4 if not a, c, g, t/u
+  char          aa[64];         // translation of the 2 bit packed codons
+
+  codon_tables() {
+    for ( int c = 0; c < 256; c ++ )
+      code[c] = transdna[c] >= DNA_A && transdna[c] <= DNA_TU ? transdna[c] : 4;
+    for ( int i = 0; i < 64; i ++ )
+      aa[i] = universal[((i >> 4) << 8) | (((i >> 2) & 3) << 4) | (i & 3)];
+  }
+};
+
+const codon_tables& tables() {
+  static const codon_tables t;
+  return t;
+}
+
+inline int dna_symbol(char c)
+     //  Universal table symbol of a base, forcing unrecognized
+     //  characters to N
+{
+  int dna_int = transdna [ (unsigned char)c ];
+  if ( dna_int < 0 ) {
+    fprintf(stderr,"WARNING: Forcing unrecognized DNA char to N\n");
+    dna_int = DNA_XN;
+  }
+  return dna_int;
+}
+
+char slow_codon(char c1, char c2, char c3)
+     //  Translate a codon with ambiguous bases
+{
+  return universal [ (dna_symbol(c1) << 8) | (dna_symbol(c2) << 4) | dna_symbol(c3) ];
+}
+
+char slow_rev_codon(char c1, char c2, char c3)
+     //  Translate the reverse complement codon of c1 c2 c3 (read in
+     //  that order on the reverse strand)
+{
+  return universal [ (compdna [ dna_symbol(c1) ] << 8) |
+                     (compdna [ dna_symbol(c2) ] << 4) |
+                     compdna [ dna_symbol(c3) ] ];
+}
+
+inline long int frame_len(long int nb_codons, int frame)
+     //  Number of codons in frame (0 based) from nb_codons positions
+{
+  return nb_codons > frame ? (nb_codons - frame + 2) / 3 : 0;
+}
+} // namespace
+
+
 long int Translate_DNA
 (const char * A, int dnaseq_len, char * tA, int Frame)
 
@@ -12,11 +69,10 @@ long int Translate_DNA
      // returns new (strlen(tA+1)) or -1 on error
 
 {
-  int         dna_int;
-  int         aaseq_len;
-  int         aa_index;
+  const codon_tables& t = tables();
   const char *dna_seq, *dna_ptr, *dna_end;
   char       *aa_ptr;
+  unsigned    c1, c2, c3;
 
   aa_ptr =  tA + 1;
   dna_seq = A + 1;
@@ -25,79 +81,89 @@ long int Translate_DNA
   if ( Frame >= 1  &&  Frame <= 3 )
     {
       dna_end -= 2;
-      dna_ptr = dna_seq + Frame - 1;
-      for (; dna_ptr <= dna_end;)
+      for ( dna_ptr = dna_seq + Frame - 1; dna_ptr <= dna_end; dna_ptr += 3 )
 	{
-	  dna_int = transdna [ int(*dna_ptr++) ];
-	  if ( dna_int == BAD_PEP_CHAR ) {
-	    fprintf(stderr,"WARNING: Forcing unrecognized DNA char to N\n");
-	    dna_int = DNA_XN;
-	  }
-	  aa_index = dna_int;
-	  aa_index <<= 4;
-
-	  dna_int = transdna [ int(*dna_ptr++) ];
-	  if ( dna_int == BAD_PEP_CHAR ) {
-	    fprintf(stderr,"WARNING: Forcing unrecognized DNA char to N\n");
-	    dna_int = DNA_XN;
-	  }
-	  aa_index += dna_int;
-	  aa_index <<= 4;
-	  
-	  dna_int = transdna [ int(*dna_ptr++) ];
-	  if ( dna_int == BAD_PEP_CHAR ) {
-	    fprintf(stderr,"WARNING: Forcing unrecognized DNA char to N\n");
-	    dna_int = DNA_XN;
-	  }
-	  aa_index += dna_int;
-	  
-	  *(aa_ptr++) = universal[aa_index];
+	  c1 = t.code [ (unsigned char)dna_ptr[0] ];
+	  c2 = t.code [ (unsigned char)dna_ptr[1] ];
+	  c3 = t.code [ (unsigned char)dna_ptr[2] ];
+	  *(aa_ptr++) = (c1 | c2 | c3) < 4
+	    ? t.aa [ (c1 << 4) | (c2 << 2) | c3 ]
+	    : slow_codon (dna_ptr[0], dna_ptr[1], dna_ptr[2]);
 	}
-      
-      *aa_ptr = '\0';
-      aaseq_len = strlen ( tA + 1 );
     }
   else if ( Frame >= 4  &&  Frame <= 6 )
     {
       Frame -= 3;
 
       dna_seq += 2;
-      dna_ptr = dna_end - Frame + 1;
-      for (; dna_ptr >= dna_seq;)
+      for ( dna_ptr = dna_end - Frame + 1; dna_ptr >= dna_seq; dna_ptr -= 3 )
 	{
-	  dna_int = compdna [ transdna [ int(*dna_ptr--)] ];
-	  if ( dna_int == BAD_PEP_CHAR ) {
-	    fprintf(stderr,"WARNING: Forcing unrecognized DNA char to N\n");
-	    dna_int = DNA_XN;
-	  }
-	  aa_index = dna_int;
-	  aa_index <<= 4;
-	  
-	  dna_int = compdna [ transdna [ int(*dna_ptr--)] ];
-	  if ( dna_int == BAD_PEP_CHAR ) {
-	    fprintf(stderr,"WARNING: Forcing unrecognized DNA char to N\n");
-	    dna_int = DNA_XN;
-	  }
-	  aa_index += dna_int;
-	  aa_index <<= 4;
-	  
-	  dna_int = compdna [ transdna [ int(*dna_ptr--)] ];
-	  if ( dna_int == BAD_PEP_CHAR ) {
-	    fprintf(stderr,"WARNING: Forcing unrecognized DNA char to N\n");
-	    dna_int = DNA_XN;
-	  }
-	  aa_index += dna_int;
-	  
-	  *(aa_ptr++) = universal[aa_index];
+	  c1 = t.code [ (unsigned char)dna_ptr[0] ];
+	  c2 = t.code [ (unsigned char)dna_ptr[-1] ];
+	  c3 = t.code [ (unsigned char)dna_ptr[-2] ];
+	  *(aa_ptr++) = (c1 | c2 | c3) < 4
+	    ? t.aa [ 63 - ((c1 << 4) | (c2 << 2) | c3) ]
+	    : slow_rev_codon (dna_ptr[0], dna_ptr[-1], dna_ptr[-2]);
 	}
-      
-      *aa_ptr = '\0';
-      aaseq_len = strlen ( tA + 1 );
     }
   else
-    aaseq_len = -1;
-     
+    return -1;
 
-  return aaseq_len;
+  *aa_ptr = '\0';
+  return aa_ptr - (tA + 1);
 }
 
+
+void Translate_DNA_Frames
+(const char * A, long int dnaseq_len, char * const tA[6], long int tA_len[6])
+
+     // translate the six frames of A in a single pass. The codons are
+     // packed on 2 bits per base while scanning A. The codon starting
+     // at position i is the next amino acid of forward frame
+     // ((i-1) % 3)+1, and its reverse complement is the next amino
+     // acid, from the end, of a reverse frame.
+
+{
+  const codon_tables& t = tables();
+  const char *        dna_seq = A + 1;
+  const long int      nb_codons = dnaseq_len >= 3 ? dnaseq_len - 2 : 0;
+
+  for ( int f = 0; f < 3; f ++ )
+    {
+      tA_len[f] = tA_len[f + 3] = frame_len(nb_codons, f);
+      tA[f][tA_len[f] + 1] = '\0';
+      tA[f + 3][tA_len[f + 3] + 1] = '\0';
+    }
+
+  //-- fwd holds the last 3 bases packed, rev the same bases in
+  //   reverse order. good is the number of last consecutive bases
+  //   that are a, c, g or t/u.
+  unsigned fwd = 0, rev = 0;
+  int      good = 0;
+  long int s = 0;               // 0 based start of the codon
+  int      ff = 0;              // forward frame of s (0 based)
+  long int m = nb_codons - 1;   // position of s in the reverse frames
+  int      rf = (int)(m % 3);   // reverse frame of s (0 based)
+  for ( long int i = 0; i < dnaseq_len; i ++ )
+    {
+      const unsigned c = t.code [ (unsigned char)dna_seq[i] ];
+      fwd  = ((fwd << 2) | c) & 63;
+      rev  = (rev >> 2) | ((c & 3) << 4);
+      good = c < 4 ? good + 1 : 0;
+      if ( i < 2 )
+	continue;
+
+      const char * const codon = dna_seq + s;
+      tA[ff][s / 3 + 1] = good >= 3
+	? t.aa [ fwd ]
+	: slow_codon (codon[0], codon[1], codon[2]);
+      tA[rf + 3][m / 3 + 1] = good >= 3
+	? t.aa [ 63 - rev ]
+	: slow_rev_codon (codon[2], codon[1], codon[0]);
+
+      ++ s;
+      ff = ff == 2 ? 0 : ff + 1;
+      -- m;
+      rf = rf == 0 ? 2 : rf - 1;
+    }
+}
@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Source for the BAM encoding of bam.hh
+//!
+//! \see bam.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#include <mummer/bam.hh>
+#include <cstring>
+#include <algorithm>
+
+namespace mummer {
+namespace bam {
+
+static const uint32_t CIGAR_SOFT_CLIP = 4;
+static const uint32_t CIGAR_REF_SKIP  = 3;
+static const size_t   MAX_CIGAR_OPS   = 0xffff;
+
+template<typename T>
+static void put(std::string& out, T x) {
+  for(size_t i = 0; i < sizeof(T); ++i, x >>= 8)
+    out += (char)(x & 0xff);
+}
+
+// 4 bit code of a base, '=ACMGRSVTWYHKDBN'
+static uint8_t base_code(char c) {
+  switch(c) {
+  case '=': return 0;
+  case 'A': case 'a': return 1;
+  case 'C': case 'c': return 2;
+  case 'M': case 'm': return 3;
+  case 'G': case 'g': return 4;
+  case 'R': case 'r': return 5;
+  case 'S': case 's': return 6;
+  case 'V': case 'v': return 7;
+  case 'T': case 't': return 8;
+  case 'W': case 'w': return 9;
+  case 'Y': case 'y': return 10;
+  case 'H': case 'h': return 11;
+  case 'K': case 'k': return 12;
+  case 'D': case 'd': return 13;
+  case 'B': case 'b': return 14;
+  default: return 15;
+  }
+}
+
+int reg2bin(int64_t beg, int64_t end) {
+  --end;
+  if(beg >> 14 == end >> 14) return ((1 << 15) - 1) / 7 + (beg >> 14);
+  if(beg >> 17 == end >> 17) return ((1 << 12) - 1) / 7 + (beg >> 17);
+  if(beg >> 20 == end >> 20) return ((1 << 9) - 1) / 7 + (beg >> 20);
+  if(beg >> 23 == end >> 23) return ((1 << 6) - 1) / 7 + (beg >> 23);
+  if(beg >> 26 == end >> 26) return ((1 << 3) - 1) / 7 + (beg >> 26);
+  return 0;
+}
+
+int64_t reference_span(const std::vector<uint32_t>& cigar) {
+  int64_t res = 0;
+  for(const auto op : cigar) {
+    switch(op & 0xf) {
+    case 0: case 2: case 3: case 7: case 8: // M, D, N, =, X
+      res += op >> 4;
+    }
+  }
+  return res;
+}
+
+void append_header(std::string& out, const std::string& text,
+                   const std::vector<std::pair<std::string, long>>& references) {
+  out.append("BAM\1", 4);
+  put<int32_t>(out, text.size());
+  out += text;
+  put<int32_t>(out, references.size());
+  for(const auto& ref : references) {
+    put<int32_t>(out, ref.first.size() + 1);
+    out.append(ref.first.c_str(), ref.first.size() + 1);
+    put<int32_t>(out, ref.second);
+  }
+}
+
+void append_record(std::string& out, const char* qname, uint16_t flag,
+                   int32_t ref_id, int32_t pos, uint8_t mapq,
+                   const std::vector<uint32_t>& cigar,
+                   const char* seq, size_t seq_len,
+                   int32_t nm, const std::string& md) {
+  const size_t  start    = out.size();
+  const size_t  name_len = strlen(qname) + 1;
+  const int64_t span     = reference_span(cigar);
+  // A CIGAR too long for the record is stored in the CG tag, and
+  // replaced by the placeholder kSmN (k query length, m reference span)
+  const bool    long_cigar = cigar.size() > MAX_CIGAR_OPS;
+
+  put<int32_t>(out, 0);         // block_size, set at the end
+  put<int32_t>(out, ref_id);
+  put<int32_t>(out, pos);
+  put<uint8_t>(out, name_len);
+  put<uint8_t>(out, mapq);
+  put<uint16_t>(out, reg2bin(pos, pos + std::max(span, (int64_t)1)));
+  put<uint16_t>(out, long_cigar ? 2 : cigar.size());
+  put<uint16_t>(out, flag);
+  put<int32_t>(out, seq_len);
+  put<int32_t>(out, -1);        // next ref_id
+  put<int32_t>(out, -1);        // next pos
+  put<int32_t>(out, 0);         // template length
+  out.append(qname, name_len);
+  if(long_cigar) {
+    int64_t qlen = 0;
+    for(const auto op : cigar)
+      if((op & 0xf) <= 1 || (op & 0xf) == CIGAR_SOFT_CLIP || (op & 0xf) >= 7) // M, I, S, =, X
+        qlen += op >> 4;
+    put<uint32_t>(out, qlen << 4 | CIGAR_SOFT_CLIP);
+    put<uint32_t>(out, span << 4 | CIGAR_REF_SKIP);
+  } else {
+    for(const auto op : cigar)
+      put<uint32_t>(out, op);
+  }
+  for(size_t i = 0; i < seq_len; i += 2)
+    out += (char)(base_code(seq[i]) << 4 | (i + 1 < seq_len ? base_code(seq[i + 1]) : 0));
+  out.append(seq_len, '\xff'); // no quality values
+
+  out.append("NMi", 3);
+  put<int32_t>(out, nm);
+  if(!md.empty()) {
+    out.append("MDZ", 3);
+    out.append(md.c_str(), md.size() + 1);
+  }
+  if(long_cigar) {
+    out.append("CGBI", 4);
+    put<int32_t>(out, cigar.size());
+    for(const auto op : cigar)
+      put<uint32_t>(out, op);
+  }
+
+  const uint32_t block_size = out.size() - start - sizeof(int32_t);
+  for(size_t i = 0; i < sizeof(block_size); ++i)
+    out[start + i] = (char)((block_size >> (8 * i)) & 0xff);
+}
+
+} // namespace bam
+} // namespace mummer
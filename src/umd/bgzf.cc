@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Source for the BGZF compression of bgzf.hh
+//!
+//! \see bgzf.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#include <config.h>
+#include <mummer/bgzf.hh>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mummer {
+namespace bgzf {
+
+const char EOF_BLOCK[EOF_BLOCK_LEN] = {
+  '\x1f', '\x8b', '\x08', '\x04', 0, 0, 0, 0, 0, '\xff', '\x06', 0, 'B', 'C', '\x02', 0,
+  '\x1b', 0, '\x03', 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+#ifdef HAVE_ZLIB
+// gzip header of a block: magic, deflate, FEXTRA flag, mtime, xfl, OS,
+// XLEN, and the BC subfield with the size of the block (filled later)
+static const char   HEADER[]    = { '\x1f', '\x8b', '\x08', '\x04', 0, 0, 0, 0, 0, '\xff', '\x06', 0, 'B', 'C', '\x02', 0 };
+static const size_t HEADER_LEN  = sizeof(HEADER) + 2;
+static const size_t TRAILER_LEN = 8;
+static const size_t MAX_BLOCK   = 0x10000;
+
+static void put_le(char* p, uint32_t x, int bytes) {
+  for(int i = 0; i < bytes; ++i, x >>= 8)
+    p[i] = (char)(x & 0xff);
+}
+
+bool available() { return true; }
+
+void compress(const char* data, size_t len, std::string& out, int level) {
+  z_stream zs;
+  zs.zalloc = Z_NULL;
+  zs.zfree  = Z_NULL;
+  zs.opaque = Z_NULL;
+  if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw std::runtime_error("Failed to initialize zlib");
+
+  do {
+    const size_t in_len = std::min(len, BLOCK_SIZE);
+    const size_t start  = out.size();
+    out.resize(start + MAX_BLOCK);
+    char* const block = &out[start];
+    zs.next_in   = (Bytef*)data;
+    zs.avail_in  = in_len;
+    zs.next_out  = (Bytef*)block + HEADER_LEN;
+    zs.avail_out = MAX_BLOCK - HEADER_LEN - TRAILER_LEN;
+    if(deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+      deflateEnd(&zs);
+      throw std::runtime_error("BGZF block overflow");
+    }
+    const size_t block_len = HEADER_LEN + zs.total_out + TRAILER_LEN;
+    std::copy(HEADER, HEADER + sizeof(HEADER), block);
+    put_le(block + sizeof(HEADER), block_len - 1, 2);
+    char* const trailer = block + HEADER_LEN + zs.total_out;
+    put_le(trailer, crc32(crc32(0, Z_NULL, 0), (const Bytef*)data, in_len), 4);
+    put_le(trailer + 4, in_len, 4);
+    out.resize(start + block_len);
+    deflateReset(&zs);
+    data += in_len;
+    len  -= in_len;
+  } while(len > 0);
+  deflateEnd(&zs);
+}
+#else // HAVE_ZLIB
+bool available() { return false; }
+
+void compress(const char*, size_t, std::string&, int) {
+  throw std::runtime_error("Compressed output is not supported: compiled without zlib");
+}
+#endif // HAVE_ZLIB
+
+//
+// writer
+//
+writer::writer(std::ostream& os, unsigned int threads, int level)
+  : os_m(os)
+  , threads_m(std::max(1u, threads))
+  , level_m(level)
+{
+  buffer_m.reserve(4 * threads_m * BLOCK_SIZE);
+}
+
+// Compress the buffer, blocks in parallel, and write the blocks in order
+void writer::compress_buffer() {
+  const size_t nb_blocks = (buffer_m.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  std::vector<std::string> blocks(nb_blocks);
+#pragma omp parallel for num_threads(threads_m) schedule(dynamic)
+  for(size_t i = 0; i < nb_blocks; ++i) {
+    const size_t start = i * BLOCK_SIZE;
+    compress(buffer_m.data() + start, std::min(BLOCK_SIZE, buffer_m.size() - start), blocks[i], level_m);
+  }
+  for(const auto& block : blocks)
+    os_m.write(block.data(), block.size());
+  buffer_m.clear();
+}
+
+void writer::write(const char* data, size_t len) {
+  buffer_m.append(data, len);
+  if(buffer_m.size() >= 4 * threads_m * BLOCK_SIZE)
+    compress_buffer();
+}
+
+void writer::flush() {
+  if(!buffer_m.empty())
+    compress_buffer();
+}
+
+void writer::close() {
+  flush();
+  os_m.write(EOF_BLOCK, EOF_BLOCK_LEN);
+}
+
+} // namespace bgzf
+} // namespace mummer
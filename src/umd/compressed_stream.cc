@@ -0,0 +1,304 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Source for the decompressing streams of compressed_stream.hh
+//!
+//! \see compressed_stream.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#include <config.h>
+#include <mummer/compressed_stream.hh>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mummer {
+namespace compressed {
+
+// The first byte of the gzip magic number starts no text file
+// (sequence, delta or SAM) nor binary delta file.
+bool is_gzip(std::streambuf* sb) {
+  return sb->sgetc() == 0x1f;
+}
+
+#ifdef HAVE_ZLIB
+static const size_t BGZF_BATCH = 64;        // BGZF blocks decompressed at once
+static const size_t GZIP_IN    = 1 << 16;   // compressed data read at once
+static const size_t GZIP_OUT   = 1 << 20;   // decompressed data produced at once
+static const size_t READ_AHEAD = 2;         // decompressed chunks ready for the reader
+static const size_t GZIP_HEADER = 12;       // fixed part of a gzip header
+
+static uint32_t get_le(const char* p, int bytes) {
+  uint32_t res = 0;
+  for(int i = bytes - 1; i >= 0; --i)
+    res = res << 8 | (uint8_t)p[i];
+  return res;
+}
+
+// Read from sb until s has len bytes. Returns false at end of file.
+static bool read_to(std::streambuf* sb, std::string& s, size_t len) {
+  if(s.size() >= len) return true;
+  const size_t start = s.size();
+  s.resize(len);
+  const auto got = sb->sgetn(&s[start], len - start);
+  s.resize(start + std::max((std::streamsize)0, got));
+  return s.size() == len;
+}
+
+// Size of the BGZF block starting with header, which holds at least
+// the gzip header. 0 if not a BGZF block.
+static size_t bgzf_block_size(const std::string& header) {
+  if((uint8_t)header[0] != 0x1f || (uint8_t)header[1] != 0x8b || !(header[3] & 4))
+    return 0;
+  const size_t xlen = get_le(&header[10], 2);
+  for(size_t i = GZIP_HEADER; i + 4 <= GZIP_HEADER + xlen; ) {
+    const size_t slen = get_le(&header[i + 2], 2);
+    if(header[i] == 'B' && header[i + 1] == 'C' && slen == 2)
+      return get_le(&header[i + 4], 2) + 1;
+    i += 4 + slen;
+  }
+  return 0;
+}
+
+// Read the gzip header at the start of s, up to the extra field
+static bool read_header(std::streambuf* sb, std::string& s) {
+  if(!read_to(sb, s, GZIP_HEADER)) return false;
+  if(!(s[3] & 4)) return true;
+  return read_to(sb, s, GZIP_HEADER + get_le(&s[10], 2));
+}
+
+struct inflate_streambuf::state {
+  bool                     bgzf;
+  bool                     eof;
+  bool                     in_member; // within a gzip member
+  std::string              pending; // data read ahead from the source
+  z_stream                 zs;
+  std::vector<std::string> blocks;
+  std::vector<std::string> outs;
+
+  // Decompression thread and the chunks it has produced, in order
+  std::thread             thread;
+  std::mutex              mutex;
+  std::condition_variable cond;
+  std::deque<std::string> chunks;
+  bool                    done;  // no more chunks
+  bool                    stop;  // reader is gone
+  std::exception_ptr      error;
+
+  state() : bgzf(false), eof(false), in_member(true), blocks(BGZF_BATCH), outs(BGZF_BATCH)
+          , done(false), stop(false) {
+    zs.zalloc = Z_NULL;
+    zs.zfree  = Z_NULL;
+    zs.opaque = Z_NULL;
+    zs.next_in  = Z_NULL;
+    zs.avail_in = 0;
+  }
+};
+
+inflate_streambuf::inflate_streambuf(std::streambuf* source, unsigned int threads)
+  : source_m(source)
+  , threads_m(std::max(1u, threads))
+  , state_m(new state)
+{
+  state& st = *state_m;
+  if(!read_header(source_m, st.pending))
+    throw std::runtime_error("Truncated gzip file");
+  st.bgzf = bgzf_block_size(st.pending) > 0;
+  if(!st.bgzf && inflateInit2(&st.zs, 15 + 16) != Z_OK)
+    throw std::runtime_error("Failed to initialize zlib");
+  st.thread = std::thread([this]() { read_ahead(); });
+}
+
+inflate_streambuf::~inflate_streambuf() {
+  state& st = *state_m;
+  {
+    std::lock_guard<std::mutex> lock(st.mutex);
+    st.stop = true;
+  }
+  st.cond.notify_all();
+  st.thread.join();
+  if(!st.bgzf)
+    inflateEnd(&st.zs);
+}
+
+// Decompression thread: fill chunks ahead of the reader, at most
+// READ_AHEAD at a time. An error is passed on to the reader.
+void inflate_streambuf::read_ahead() {
+  state& st = *state_m;
+  try {
+    while(true) {
+      std::string chunk;
+      if(!(st.bgzf ? fill_bgzf(chunk) : fill_gzip(chunk)))
+        break;
+      std::unique_lock<std::mutex> lock(st.mutex);
+      st.cond.wait(lock, [&st]() { return st.stop || st.chunks.size() < READ_AHEAD; });
+      if(st.stop) return;
+      st.chunks.push_back(std::move(chunk));
+      st.cond.notify_all();
+    }
+  } catch(...) {
+    std::lock_guard<std::mutex> lock(st.mutex);
+    st.error = std::current_exception();
+  }
+  std::lock_guard<std::mutex> lock(st.mutex);
+  st.done = true;
+  st.cond.notify_all();
+}
+
+// Read many BGZF blocks and decompress them in parallel
+bool inflate_streambuf::fill_bgzf(std::string& out) {
+  state& st = *state_m;
+  size_t nb_blocks = 0;
+  for( ; nb_blocks < BGZF_BATCH; ++nb_blocks) {
+    std::string& block = st.blocks[nb_blocks];
+    block.swap(st.pending);
+    st.pending.clear();
+    if(block.empty() && source_m->sgetc() == EOF) break;
+    if(!read_header(source_m, block))
+      throw std::runtime_error("Truncated BGZF block");
+    const size_t size = bgzf_block_size(block);
+    if(size < block.size() + 8)
+      throw std::runtime_error("Invalid BGZF block");
+    if(!read_to(source_m, block, size))
+      throw std::runtime_error("Truncated BGZF block");
+  }
+  if(nb_blocks == 0) return false;
+
+  bool error = false;
+#pragma omp parallel for num_threads(threads_m) schedule(dynamic)
+  for(size_t i = 0; i < nb_blocks; ++i) {
+    const std::string& block = st.blocks[i];
+    std::string&       res   = st.outs[i];
+    res.resize(get_le(&block[block.size() - 4], 4) + 1);
+    z_stream zs;
+    zs.zalloc    = Z_NULL;
+    zs.zfree     = Z_NULL;
+    zs.opaque    = Z_NULL;
+    zs.next_in   = (Bytef*)block.data();
+    zs.avail_in  = block.size();
+    zs.next_out  = (Bytef*)&res[0];
+    zs.avail_out = res.size();
+    if(inflateInit2(&zs, 15 + 16) != Z_OK || inflate(&zs, Z_FINISH) != Z_STREAM_END ||
+       zs.total_out != res.size() - 1) {
+#pragma omp atomic write
+      error = true;
+    }
+    inflateEnd(&zs);
+    res.resize(zs.total_out);
+  }
+  if(error)
+    throw std::runtime_error("Corrupted BGZF block");
+
+  out.clear();
+  for(size_t i = 0; i < nb_blocks; ++i)
+    out += st.outs[i];
+  return true;
+}
+
+// Decompress the next piece of a gzip file, with possibly many members
+bool inflate_streambuf::fill_gzip(std::string& out) {
+  state& st = *state_m;
+  if(st.eof) return false;
+  out.resize(GZIP_OUT);
+  st.zs.next_out  = (Bytef*)&out[0];
+  st.zs.avail_out = out.size();
+  while(st.zs.avail_out > 0) {
+    if(st.zs.avail_in == 0) {
+      if(st.pending.empty() && !read_to(source_m, st.pending, GZIP_IN) && st.pending.empty()) {
+        if(st.in_member)
+          throw std::runtime_error("Truncated gzip file");
+        st.eof = true;
+        break;
+      }
+      st.zs.next_in  = (Bytef*)&st.pending[0];
+      st.zs.avail_in = st.pending.size();
+    }
+    const int ret = inflate(&st.zs, Z_NO_FLUSH);
+    if(st.zs.avail_in == 0)
+      st.pending.clear();
+    if(ret == Z_STREAM_END) { // Next member, if any
+      inflateReset(&st.zs);
+      st.in_member = false;
+    } else if(ret == Z_OK || ret == Z_BUF_ERROR) {
+      st.in_member = true;
+    } else {
+      throw std::runtime_error("Corrupted gzip file");
+    }
+  }
+  out.resize(out.size() - st.zs.avail_out);
+  return !out.empty();
+}
+
+#else // HAVE_ZLIB
+struct inflate_streambuf::state { };
+
+inflate_streambuf::inflate_streambuf(std::streambuf* source, unsigned int threads)
+  : source_m(source)
+  , threads_m(threads)
+{
+  throw std::runtime_error("Compressed input is not supported: compiled without zlib");
+}
+inflate_streambuf::~inflate_streambuf() { }
+bool inflate_streambuf::fill_bgzf(std::string&) { return false; }
+bool inflate_streambuf::fill_gzip(std::string&) { return false; }
+void inflate_streambuf::read_ahead() { }
+#endif // HAVE_ZLIB
+
+inflate_streambuf::int_type inflate_streambuf::underflow() {
+  if(gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+#ifdef HAVE_ZLIB
+  state& st = *state_m;
+  buffer_m.clear();
+  while(buffer_m.empty()) {
+    std::unique_lock<std::mutex> lock(st.mutex);
+    st.cond.wait(lock, [&st]() { return st.done || !st.chunks.empty(); });
+    if(st.chunks.empty()) {
+      if(st.error) std::rethrow_exception(st.error);
+      return traits_type::eof();
+    }
+    buffer_m.swap(st.chunks.front());
+    st.chunks.pop_front();
+    st.cond.notify_all();
+  }
+#else
+  return traits_type::eof();
+#endif
+  char* const p = &buffer_m[0];
+  setg(p, p, p + buffer_m.size());
+  return traits_type::to_int_type(*p);
+}
+
+//
+// ifstream
+//
+void ifstream::open(const char* path, std::ios::openmode mode, unsigned int threads) {
+  close();
+  if(!file_m.open(path, mode | std::ios::in | std::ios::binary)) {
+    setstate(std::ios::failbit);
+    return;
+  }
+  clear();
+  if(is_gzip(&file_m)) {
+    inflate_m.reset(new inflate_streambuf(&file_m, threads));
+    rdbuf(inflate_m.get());
+  }
+}
+
+void ifstream::close() {
+  rdbuf(&file_m);
+  inflate_m.reset();
+  if(file_m.is_open() && !file_m.close())
+    setstate(std::ios::failbit);
+}
+
+} // namespace compressed
+} // namespace mummer
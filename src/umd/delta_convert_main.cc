@@ -0,0 +1,49 @@
+#include <iostream>
+#include <fstream>
+#include <mummer/delta.hh>
+#include <mummer/delta_binary.hh>
+#include <src/umd/delta_convert_cmdline.hpp>
+
+static void to_text(DeltaReader_t& dr, std::ostream& os) {
+  os << dr.getReferencePath() << ' ' << dr.getQueryPath() << '\n'
+     << dr.getDataType() << '\n';
+  while(dr.readNext()) {
+    const DeltaRecord_t& r = dr.getRecord();
+    os << r << '\n';
+    for(const auto& a : r.aligns)
+      os << a;
+  }
+}
+
+static void to_binary(DeltaReader_t& dr, std::ostream& os) {
+  mummer::delta_binary::writer writer(os, dr.getReferencePath(), dr.getQueryPath(), dr.getDataType());
+  while(dr.readNext()) {
+    const DeltaRecord_t& r = dr.getRecord();
+    auto& encoder = writer.begin(r.idR, r.idQ, r.lenR, r.lenQ, r.aligns.size());
+    for(const auto& a : r.aligns)
+      encoder.alignment({ a.sR, a.eR, a.sQ, a.eQ, a.idyc, a.simc, a.stpc }, a.deltas.cbegin(), a.deltas.cend());
+    writer.end();
+  }
+  writer.close();
+}
+
+int main(int argc, char *argv[]) {
+  std::ios::sync_with_stdio(false);
+  delta_convert_cmdline args(argc, argv);
+
+  DeltaReader_t dr;
+  dr.open(args.delta_arg);
+  std::ofstream os(args.output_arg, std::ios::out | std::ios::binary);
+  if(!os.good())
+    delta_convert_cmdline::error() << "Failed to open output file '" << args.output_arg << '\'';
+
+  if(dr.isBinary())
+    to_text(dr, os);
+  else
+    to_binary(dr, os);
+  os.close();
+  if(!os.good())
+    delta_convert_cmdline::error() << "Failed to write output file '" << args.output_arg << '\'';
+
+  return 0;
+}
@@ -0,0 +1,544 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <climits>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <mummer/delta.hh>
+#include <mummer/tigrinc.hh>
+#include <mummer/fasta_index.hh>
+#include <src/umd/dnadiff_cmdline.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static const long SNP_BUFF = 20; // required buffer around "good" snps
+
+// Statistics of the alignments of a coords file
+struct align_stats {
+  long   n       = 0;
+  long   sumLenR = 0, sumLenQ = 0;
+  double sumLen  = 0, sumIdy = 0; // combined length, weighted identity
+};
+
+// Statistics of the reference or query sequences
+struct seq_stats {
+  long nSeqs = 0, nASeqs = 0;     // sequences, aligned sequences
+  long nBases = 0, nABases = 0;   // bases, aligned bases
+  long nBrk = 0;                  // breakpoints
+  long nIns = 0, sumIns = 0;      // insertions
+  long nTIns = 0, sumTIns = 0;    // tandem insertions
+  long nInv = 0, nRel = 0, nTrn = 0; // inversions, relocations, translocations
+};
+
+// Counts of SNPs, by reference then query character
+struct snp_stats {
+  std::map<char, std::map<char, long> > all, good;
+  long nSNPs = 0, nIndels = 0, nGSNPs = 0, nGIndels = 0;
+
+  snp_stats() {
+    static const char* init[] = { ".ACGT", "A.CGT", "C.AGT", "G.ACT", "T.ACG" };
+    for(const char* s : init)
+      for(const char* q = s + 1; *q; ++q)
+        all[*s][*q] = good[*s][*q] = 0;
+  }
+};
+
+// A line of show-coords -rclTH
+struct coords_row {
+  long               sA, eA, sB, eB;
+  float              idy;
+  long               seqLenA, seqLenB;
+  const std::string *idA, *idB;
+};
+
+// Sort by IdA, sA, IdB, sB, as show-coords -r
+struct coords_sort {
+  bool operator()(const coords_row& a, const coords_row& b) const {
+    const int i = a.idA->compare(*b.idA);
+    if(i != 0) return i < 0;
+    if(a.sA != b.sA) return a.sA < b.sA;
+    const int j = a.idB->compare(*b.idB);
+    if(j != 0) return j < 0;
+    return a.sB < b.sB;
+  }
+};
+
+static FILE* open_output(const std::string& path) {
+  FILE* res = fopen(path.c_str(), "w");
+  if(!res)
+    dnadiff_cmdline::error() << "Failed to open output file '" << path << "': " << strerror(errno);
+  return res;
+}
+
+static void close_output(FILE* file, const std::string& path) {
+  if(fclose(file))
+    dnadiff_cmdline::error() << "Failed to write output file '" << path << "': " << strerror(errno);
+}
+
+// Run nucmer --maxmatch, from the directory of this executable if
+// present, from the PATH otherwise.
+static void run_nucmer(const dnadiff_cmdline& args) {
+  std::string nucmer = "nucmer";
+  char        exe[PATH_MAX];
+  const auto  len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  if(len > 0) {
+    exe[len] = '\0';
+    const char* slash = strrchr(exe, '/');
+    if(slash) {
+      const std::string path = std::string(exe, slash + 1 - exe) + "nucmer";
+      if(access(path.c_str(), X_OK) == 0)
+        nucmer = path;
+    }
+  }
+
+  std::vector<std::string> cmd = { nucmer, "--maxmatch", "-p", args.prefix_arg };
+  if(args.threads_given) {
+    cmd.push_back("-t");
+    cmd.push_back(std::to_string(args.threads_arg));
+  }
+  cmd.push_back(args.sequences_arg[0]);
+  cmd.push_back(args.sequences_arg[1]);
+  std::vector<char*> argv;
+  for(auto& s : cmd)
+    argv.push_back(&s[0]);
+  argv.push_back(nullptr);
+
+  const pid_t pid = fork();
+  if(pid == -1)
+    dnadiff_cmdline::error() << "Failed to run nucmer: " << strerror(errno);
+  if(pid == 0) {
+    execvp(argv[0], argv.data());
+    std::cerr << "Failed to run '" << argv[0] << "': " << strerror(errno) << std::endl;
+    _exit(EXIT_FAILURE);
+  }
+  int status;
+  if(waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    dnadiff_cmdline::error() << "Failed to run nucmer, aborting.";
+}
+
+// Lengths of the sequences of a FASTA file
+static std::map<std::string, long> fasta_sizes(const std::string& path) {
+  std::map<std::string, long> res;
+
+  mummer::fasta_index::indexed_fasta fasta;
+  if(fasta.open(path)) {
+    for(const auto& e : fasta.entries())
+      res[e.name] = e.length;
+    return res;
+  }
+
+  // Not a regular file or compressed, read it sequentially
+  mummer::compressed::ifstream file;
+  try {
+    file.open(path);
+  } catch(const std::runtime_error& e) {
+    dnadiff_cmdline::error() << e.what() << " '" << path << '\'';
+  }
+  if(!file.is_open())
+    dnadiff_cmdline::error() << "Failed to open FASTA file '" << path << '\'';
+  long  initsize = INIT_SIZE;
+  char* S        = (char*)Safe_malloc(initsize);
+  char  id[MAX_LINE];
+  while(Read_String(file, S, initsize, id, false))
+    res[id] = strlen(S + 1);
+  free(S);
+  if(file.bad())
+    dnadiff_cmdline::error() << "Failed to read FASTA file '" << path << '\'';
+  return res;
+}
+
+static void write_delta(DeltaGraph_t& graph, const std::vector<DeltaEdgelet_t*>& aligns,
+                        const std::vector<char>& keep, const std::string& path) {
+  for(size_t i = 0; i < aligns.size(); ++i)
+    aligns[i]->isGOOD = keep[i];
+  std::ofstream os(path);
+  if(!os.good())
+    dnadiff_cmdline::error() << "Failed to open output file '" << path << '\'';
+  graph.outputDelta(os);
+  os.close();
+  if(!os.good())
+    dnadiff_cmdline::error() << "Failed to write output file '" << path << '\'';
+}
+
+// Percent identity of an alignment, computed as DeltaAlignment_t::read
+// (the edgelet keeps a rounded fraction). Every '-' of the delta
+// string is the sign of an indel in the query.
+static float identity(const DeltaEdgelet_t& a, bool promer) {
+  float total = labs(a.hiR - a.loR) + 1.0;
+  if(promer)
+    total /= 3.0;
+  total += std::count(a.delta.begin(), a.delta.end(), '-');
+  return (total - (float)a.idyc) / total * 100.0;
+}
+
+// The show-coords -rclTH lines of the kept alignments, in the order
+// of the delta file written by outputDelta.
+static std::vector<coords_row> coords_rows(const std::vector<DeltaEdgelet_t*>& aligns,
+                                           const std::vector<char>& keep, bool promer) {
+  std::vector<coords_row> res;
+  for(size_t i = 0; i < aligns.size(); ++i) {
+    if(!keep[i]) continue;
+    const DeltaEdgelet_t& a = *aligns[i];
+    coords_row r;
+    r.sA = a.loR; r.eA = a.hiR;
+    r.sB = a.loQ; r.eB = a.hiQ;
+    if(a.dirR == REVERSE_DIR) std::swap(r.sA, r.eA);
+    if(a.dirQ == REVERSE_DIR) std::swap(r.sB, r.eB);
+    r.idy = identity(a, promer);
+    if(r.idy > 99.99 && r.idy != 100)
+      r.idy = 99.99;
+    r.seqLenA = a.edge->refnode->len;
+    r.seqLenB = a.edge->qrynode->len;
+    r.idA     = a.edge->refnode->id;
+    r.idB     = a.edge->qrynode->id;
+    res.push_back(r);
+  }
+  std::sort(res.begin(), res.end(), coords_sort());
+  return res;
+}
+
+// Write the coords file and accumulate the alignment statistics. The
+// identities are summed as printed, with 2 decimals.
+static void write_coords(const std::vector<coords_row>& rows, const std::string& path, align_stats& st) {
+  FILE* file = open_output(path);
+  for(const auto& r : rows) {
+    const long len1 = labs(r.eA - r.sA) + 1;
+    const long len2 = labs(r.eB - r.sB) + 1;
+    char       idy[32];
+    snprintf(idy, sizeof(idy), "%.2f", r.idy);
+    fprintf(file, "%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%s\t%ld\t%ld\t%.2f\t%.2f\t%s\t%s\n",
+            r.sA, r.eA, r.sB, r.eB, len1, len2, idy, r.seqLenA, r.seqLenB,
+            (float)len1 / (float)r.seqLenA * 100.0, (float)len2 / (float)r.seqLenB * 100.0,
+            r.idA->c_str(), r.idB->c_str());
+
+    ++st.n;
+    st.sumLenR += len1;
+    st.sumLenQ += len2;
+    st.sumIdy  += atof(idy) / 100.0 * (len1 + len2);
+    st.sumLen  += len1 + len2;
+  }
+  close_output(file, path);
+}
+
+// Aligned sequences, bases and breakpoints from the M-to-M alignments.
+// The lengths of the aligned sequences are negated.
+static void count_aligned(const std::vector<coords_row>& rows,
+                          std::map<std::string, long>& refs, std::map<std::string, long>& qrys,
+                          seq_stats& rst, seq_stats& qst) {
+  for(const auto& r : rows) {
+    auto rit = refs.find(*r.idA);
+    if(rit != refs.end() && rit->second > 0) {
+      ++rst.nASeqs;
+      rst.nABases += rit->second;
+      rit->second = -rit->second;
+    }
+    auto qit = qrys.find(*r.idB);
+    if(qit != qrys.end() && qit->second > 0) {
+      ++qst.nASeqs;
+      qst.nABases += qit->second;
+      qit->second = -qit->second;
+    }
+
+    rst.nBrk += (std::min(r.sA, r.eA) != 1) + (std::max(r.sA, r.eA) != r.seqLenA);
+    qst.nBrk += (std::min(r.sB, r.eB) != 1) + (std::max(r.sB, r.eB) != r.seqLenB);
+  }
+}
+
+// Write the SNPs without conflict, as show-snps -rlTHC, and count them
+static void write_snps(std::vector<const SNP_t*>& snps, const std::string& path, snp_stats& st) {
+  std::sort(snps.begin(), snps.end(), SNP_R_Sort());
+
+  FILE* file = open_output(path);
+  for(const SNP_t* s : snps) {
+    const long lenR  = s->ep->refnode->len;
+    const long lenQ  = s->ep->qrynode->len;
+    const long distR = std::min(s->pR, lenR - s->pR + 1);
+    const long distQ = std::min(s->pQ, lenQ - s->pQ + 1);
+    fprintf(file, "%ld\t%c\t%c\t%ld\t%ld\t%ld\t%ld\t%ld\t%d\t%d\t%s\t%s\n",
+            s->pR, s->cR, s->cQ, s->pQ, s->buff, std::min(distR, distQ),
+            lenR, lenQ, s->lp->frmR, s->lp->frmQ,
+            s->ep->refnode->id->c_str(), s->ep->qrynode->id->c_str());
+
+    const char r     = toupper(s->cR);
+    const char q     = toupper(s->cQ);
+    const bool indel = r == INDEL_CHAR || q == INDEL_CHAR;
+    ++st.all[r][q];
+    st.all[q].insert(std::make_pair(r, 0));
+    ++(indel ? st.nIndels : st.nSNPs);
+    if(s->buff >= SNP_BUFF) {
+      ++st.good[r][q];
+      st.good[q].insert(std::make_pair(r, 0));
+      ++(indel ? st.nGIndels : st.nGSNPs);
+    }
+  }
+  close_output(file, path);
+}
+
+// Write the breakpoints of the reference or query sequences, as
+// show-diff -rH or -qH, and count the features
+static void write_diff(DeltaGraph_t& graph, bool ref, const std::string& path, seq_stats& st) {
+  FILE* file = open_output(path);
+  graph.findDiffs(ref, [&](const DeltaNode_t& node, const DeltaDiff_t& d) {
+      const char* seq = node.id->c_str();
+      const long  len = d.e - d.s + 1;
+      long        gap = len;
+      long        ins = len;
+      switch(d.type) {
+      case DIFF_GAP:
+        fprintf(file, "%s\tGAP\t%ld\t%ld\t%ld\t%ld\t%ld\n", seq, d.s, d.e, d.gap1, d.gap2, d.gap1 - d.gap2);
+        gap = ins = d.gap1;
+        if(d.gap1 - d.gap2 > gap)
+          ins = d.gap1 - d.gap2;
+        if(d.gap1 <= 0 && d.gap2 <= 0 && d.gap1 - d.gap2 > 0) {
+          ++st.nTIns;
+          st.sumTIns += d.gap1 - d.gap2;
+        }
+        break;
+      case DIFF_DUP: fprintf(file, "%s\tDUP\t%ld\t%ld\t%ld\n", seq, d.s, d.e, len); break;
+      case DIFF_BRK: fprintf(file, "%s\tBRK\t%ld\t%ld\t%ld\n", seq, d.s, d.e, len); break;
+      case DIFF_JMP: fprintf(file, "%s\tJMP\t%ld\t%ld\t%ld\n", seq, d.s, d.e, len); ++st.nRel; break;
+      case DIFF_INV: fprintf(file, "%s\tINV\t%ld\t%ld\t%ld\n", seq, d.s, d.e, len); ++st.nInv; break;
+      case DIFF_SEQ:
+        fprintf(file, "%s\tSEQ\t%ld\t%ld\t%ld\t%s\t%s\n", seq, d.s, d.e, len, d.prev->c_str(), d.next->c_str());
+        ++st.nTrn;
+        break;
+      }
+      if(d.type != DIFF_DUP && gap > 0)
+        st.nABases -= gap;
+      if(ins > 0) {
+        ++st.nIns;
+        st.sumIns += ins;
+      }
+    });
+  close_output(file, path);
+}
+
+// Unaligned sequences, i.e. with a non negative length
+static void write_unaligned(const std::map<std::string, long>& sizes, const std::string& path) {
+  FILE* file = open_output(path);
+  for(const auto& s : sizes)
+    if(s.second >= 0)
+      fprintf(file, "%s\tUNI\t1\t%ld\t%ld\n", s.first.c_str(), s.second, s.second);
+  close_output(file, path);
+}
+
+static std::string percent(long n, long total) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%10ld(%.2f%%)", n, total ? (double)n / total * 100.0 : 0.0);
+  return buf;
+}
+
+static void print_pair(FILE* file, const char* name, const std::string& r, const std::string& q) {
+  fprintf(file, "%-15s %20s %20s\n", name, r.c_str(), q.c_str());
+}
+
+static void print_pair(FILE* file, const char* name, long r, long q) {
+  fprintf(file, "%-15s %20ld %20ld\n", name, r, q);
+}
+
+static void print_pair(FILE* file, const char* name, double r, double q) {
+  fprintf(file, "%-15s %20.2f %20.2f\n", name, r, q);
+}
+
+// One line per substitution of counts selected by pred, with the
+// count of the reverse substitution
+template<typename Pred>
+static void print_snps(FILE* file, const std::map<char, std::map<char, long> >& counts, long total, Pred pred) {
+  for(const auto& r : counts) {
+    for(const auto& q : r.second) {
+      if(!pred(r.first, q.first)) continue;
+      const char name[3] = { r.first, q.first, '\0' };
+      print_pair(file, name, percent(q.second, total), percent(counts.at(q.first).at(r.first), total));
+    }
+  }
+}
+
+static void print_alignments(FILE* file, const char* name, const align_stats& st) {
+  print_pair(file, name, st.n, st.n);
+  print_pair(file, "TotalLength", st.sumLenR, st.sumLenQ);
+  print_pair(file, "AvgLength",
+             st.n ? (double)st.sumLenR / st.n : 0.0,
+             st.n ? (double)st.sumLenQ / st.n : 0.0);
+  const double idy = st.sumLen ? st.sumIdy / st.sumLen * 100.0 : 0.0;
+  print_pair(file, "AvgIdentity", idy, idy);
+}
+
+static void write_report(const DeltaGraph_t& graph, const std::string& path,
+                         const seq_stats& r, const seq_stats& q,
+                         const align_stats& one, const align_stats& many, const snp_stats& snps) {
+  FILE* file = open_output(path);
+  fprintf(file, "%s %s\n%s\n\n", graph.refpath.c_str(), graph.qrypath.c_str(),
+          (graph.datatype == NUCMER_DATA ? NUCMER_STRING : PROMER_STRING).c_str());
+  fprintf(file, "%-15s %20s %20s\n", "", "[REF]", "[QRY]");
+
+  fprintf(file, "[Sequences]\n");
+  print_pair(file, "TotalSeqs", r.nSeqs, q.nSeqs);
+  print_pair(file, "AlignedSeqs", percent(r.nASeqs, r.nSeqs), percent(q.nASeqs, q.nSeqs));
+  print_pair(file, "UnalignedSeqs", percent(r.nSeqs - r.nASeqs, r.nSeqs), percent(q.nSeqs - q.nASeqs, q.nSeqs));
+
+  fprintf(file, "\n[Bases]\n");
+  print_pair(file, "TotalBases", r.nBases, q.nBases);
+  print_pair(file, "AlignedBases", percent(r.nABases, r.nBases), percent(q.nABases, q.nBases));
+  print_pair(file, "UnalignedBases", percent(r.nBases - r.nABases, r.nBases), percent(q.nBases - q.nABases, q.nBases));
+
+  fprintf(file, "\n[Alignments]\n");
+  print_alignments(file, "1-to-1", one);
+  fprintf(file, "\n");
+  print_alignments(file, "M-to-M", many);
+
+  fprintf(file, "\n[Feature Estimates]\n");
+  print_pair(file, "Breakpoints", r.nBrk, q.nBrk);
+  print_pair(file, "Relocations", r.nRel, q.nRel);
+  print_pair(file, "Translocations", r.nTrn, q.nTrn);
+  print_pair(file, "Inversions", r.nInv, q.nInv);
+  fprintf(file, "\n");
+  print_pair(file, "Insertions", r.nIns, q.nIns);
+  print_pair(file, "InsertionSum", r.sumIns, q.sumIns);
+  print_pair(file, "InsertionAvg",
+             r.nIns ? (double)r.sumIns / r.nIns : 0.0,
+             q.nIns ? (double)q.sumIns / q.nIns : 0.0);
+  fprintf(file, "\n");
+  print_pair(file, "TandemIns", r.nTIns, q.nTIns);
+  print_pair(file, "TandemInsSum", r.sumTIns, q.sumTIns);
+  print_pair(file, "TandemInsAvg",
+             r.nTIns ? (double)r.sumTIns / r.nTIns : 0.0,
+             q.nTIns ? (double)q.sumTIns / q.nTIns : 0.0);
+
+  auto is_snp      = [](char r, char q) { return r != INDEL_CHAR && q != INDEL_CHAR; };
+  auto is_deletion = [](char r, char q) { return q == INDEL_CHAR; };
+  auto is_insert   = [](char r, char q) { return r == INDEL_CHAR; };
+  fprintf(file, "\n[SNPs]\n");
+  print_pair(file, "TotalSNPs", snps.nSNPs, snps.nSNPs);
+  print_snps(file, snps.all, snps.nSNPs, is_snp);
+  fprintf(file, "\n");
+  print_pair(file, "TotalGSNPs", snps.nGSNPs, snps.nGSNPs);
+  print_snps(file, snps.good, snps.nGSNPs, is_snp);
+  fprintf(file, "\n");
+  print_pair(file, "TotalIndels", snps.nIndels, snps.nIndels);
+  print_snps(file, snps.all, snps.nIndels, is_deletion);
+  print_snps(file, snps.all, snps.nIndels, is_insert);
+  fprintf(file, "\n");
+  print_pair(file, "TotalGIndels", snps.nGIndels, snps.nGIndels);
+  print_snps(file, snps.good, snps.nGIndels, is_deletion);
+  print_snps(file, snps.good, snps.nGIndels, is_insert);
+  close_output(file, path);
+}
+
+int main(int argc, char *argv[]) {
+  dnadiff_cmdline args(argc, argv);
+  if(args.delta_given ? !args.sequences_arg.empty() : args.sequences_arg.size() != 2)
+    dnadiff_cmdline::error() << "Expected either a reference and a query file, or a delta file (--delta)";
+#ifdef _OPENMP
+  if(args.threads_given) omp_set_num_threads(args.threads_arg);
+  const unsigned int nb_threads = args.threads_given ? args.threads_arg : omp_get_num_procs();
+#else
+  const unsigned int nb_threads = 1;
+#endif
+  const std::string& prefix = args.prefix_arg;
+
+  //-- Build the alignments
+  std::string delta_path;
+  if(args.delta_given) {
+    delta_path = args.delta_arg;
+  } else {
+    run_nucmer(args);
+    delta_path = prefix + ".delta";
+  }
+
+  DeltaGraph_t graph;
+  graph.threads = nb_threads;
+  graph.build(delta_path, true);
+
+  //-- 1-to-1 and M-to-M alignments, i.e. intersection and union of
+  //   RLIS and QLIS, in the order written by outputDelta
+  srand(1);
+  graph.flagRLIS(-1, 100.0, false);
+  graph.flagQLIS(-1, 100.0, false);
+  std::vector<DeltaEdgelet_t*> aligns;
+  for(auto& node : graph.qrynodes)
+    for(auto edge : node.second.edges)
+      aligns.insert(aligns.end(), edge->edgelets.begin(), edge->edgelets.end());
+  std::vector<char> one(aligns.size()), many(aligns.size());
+  for(size_t i = 0; i < aligns.size(); ++i) {
+    one[i]  = aligns[i]->isRLIS && aligns[i]->isQLIS;
+    many[i] = aligns[i]->isRLIS || aligns[i]->isQLIS;
+  }
+  write_delta(graph, aligns, many, prefix + ".mdelta");
+  write_delta(graph, aligns, one, prefix + ".1delta");
+  const std::vector<coords_row> coords1 = coords_rows(aligns, one, graph.datatype == PROMER_DATA);
+  const std::vector<coords_row> coordsM = coords_rows(aligns, many, graph.datatype == PROMER_DATA);
+
+  std::map<std::string, long> refs = fasta_sizes(graph.refpath);
+  std::map<std::string, long> qrys = fasta_sizes(graph.qrypath);
+  seq_stats rst, qst;
+  for(const auto& s : refs) { ++rst.nSeqs; rst.nBases += s.second; }
+  for(const auto& s : qrys) { ++qst.nSeqs; qst.nBases += s.second; }
+
+  //-- SNPs of the 1-to-1 alignments (the good edgelets), without conflict
+  graph.findSNPs(true, 0);
+  graph.checkSNPs();
+  std::vector<const SNP_t*> snps;
+  for(auto& node : graph.refnodes)
+    for(auto edge : node.second.edges)
+      for(auto a : edge->edgelets)
+        for(auto s : a->snps)
+          if(s->conR == 0 && s->conQ == 0)
+            snps.push_back(s);
+
+  //-- The outputs are independent
+  align_stats st1, stM;
+  snp_stats   sst;
+  seq_stats   rdiff, qdiff;
+#pragma omp parallel sections
+  {
+#pragma omp section
+    {
+      write_coords(coords1, prefix + ".1coords", st1);
+      write_coords(coordsM, prefix + ".mcoords", stM);
+      count_aligned(coordsM, refs, qrys, rst, qst);
+    }
+#pragma omp section
+    write_snps(snps, prefix + ".snps", sst);
+#pragma omp section
+    {
+      // Breakpoints of the M-to-M alignments, flagged again as
+      // show-diff does on the .mdelta file. The graph is not cleaned,
+      // the SNPs stay valid.
+      for(size_t i = 0; i < aligns.size(); ++i) {
+        aligns[i]->isGOOD = many[i];
+        aligns[i]->isRLIS = aligns[i]->isQLIS = false;
+      }
+      srand(1);
+      graph.flagMtoM();
+      write_diff(graph, true, prefix + ".rdiff", rdiff);
+      write_diff(graph, false, prefix + ".qdiff", qdiff);
+    }
+  }
+
+  //-- Summary
+  for(auto p : { std::make_pair(&rst, &rdiff), std::make_pair(&qst, &qdiff) }) {
+    seq_stats&       st = *p.first;
+    const seq_stats& d  = *p.second;
+    st.nABases += d.nABases;
+    st.nIns     = d.nIns;  st.sumIns  = d.sumIns;
+    st.nTIns    = d.nTIns; st.sumTIns = d.sumTIns;
+    st.nInv     = d.nInv;  st.nRel    = d.nRel;  st.nTrn = d.nTrn;
+  }
+  write_report(graph, prefix + ".report", rst, qst, st1, stM, sst);
+  if(rst.nSeqs != rst.nASeqs)
+    write_unaligned(refs, prefix + ".unref");
+  if(qst.nSeqs != qst.nASeqs)
+    write_unaligned(qrys, prefix + ".unqry");
+
+  return 0;
+}
@@ -0,0 +1,885 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mummer/delta.hh>
+#include <src/umd/dotplot_cmdline.hpp>
+
+enum { FWD, REV, HLT, NB_LAYERS };
+
+// A sequence on an axis of the plot
+struct seq_info {
+  std::string id;
+  long        len;
+  long        off;              // offset on the axis
+  int         dir;              // 1 forward, -1 reverse complemented
+};
+
+// Ordered set of the sequences of an axis
+struct seq_table {
+  std::vector<seq_info>                   seqs;
+  std::unordered_map<std::string, size_t> index;
+  bool                                    all = true; // plot all the sequences of the delta file
+
+  long find(const std::string& id) const {
+    const auto it = index.find(id);
+    return it == index.end() ? -1 : (long)it->second;
+  }
+
+  // Add a sequence, return false if already present
+  bool add(const std::string& id, long len, int dir) {
+    if(!index.insert(std::make_pair(id, seqs.size())).second)
+      return false;
+    seqs.push_back({ id, len, 0, dir });
+    return true;
+  }
+
+  // Index of a sequence of the delta file, -1 if not plotted. The
+  // length in the delta file takes precedence.
+  long get(const std::string& id, long len) {
+    if(all) add(id, len, 1);
+    const long i = find(id);
+    if(i >= 0) seqs[i].len = len;
+    return i;
+  }
+
+  // Offsets of the sequences, laid out in the given order
+  long set_offsets(const std::vector<size_t>& order) {
+    long off = 0;
+    for(size_t i : order) {
+      seqs[i].off  = off;
+      off         += seqs[i].len;
+    }
+    return off;
+  }
+  long set_offsets() {
+    std::vector<size_t> order(seqs.size());
+    for(size_t i = 0; i < order.size(); ++i)
+      order[i] = i;
+    return set_offsets(order);
+  }
+};
+
+// An alignment, in the coordinates of its sequences
+struct align_info {
+  long  sR, eR, sQ, eQ;
+  float sim;
+  long  r, q;                   // indices in the sequence tables
+};
+
+// Parse a FASTA file or a list of 'ID len [+-]' lines, as mummerplot
+static void parse_ids(const char* path, seq_table& table) {
+  std::ifstream is(path);
+  if(!is.good())
+    dotplot_cmdline::error() << "Failed to open '" << path << "': " << strerror(errno);
+  table.all = false;
+
+  std::string line;
+  bool        is_fasta = false;
+  long        current  = -1;
+  while(std::getline(is, line)) {
+    while(!line.empty() && isspace(line.back()))
+      line.pop_back();
+    if(line.find_first_not_of(" \t") == std::string::npos) continue;
+
+    if(line[0] == '>') {
+      is_fasta = true;
+      const std::string id = line.substr(1, line.find_first_of(" \t") - 1);
+      if(table.add(id, 0, 1)) {
+        current = table.seqs.size() - 1;
+      } else {
+        std::cerr << "WARNING: Duplicate sequence '" << id << "' ignored\n";
+        current = -1;
+      }
+      continue;
+    }
+    if(is_fasta) {
+      if(current >= 0) table.seqs[current].len += line.size();
+      continue;
+    }
+
+    std::istringstream ls(line);
+    std::string        id, dir;
+    long               len;
+    if(!(ls >> id >> len) || len < 0 || ((ls >> dir) && dir != "+" && dir != "-"))
+      dotplot_cmdline::error() << "Could not parse '" << path << "':\n" << line;
+    if(!table.add(id, len, dir == "-" ? -1 : 1))
+      std::cerr << "WARNING: Duplicate sequence '" << id << "' ignored\n";
+  }
+}
+
+// Alignments between the plotted sequences, register the sequences
+// in the tables
+static std::vector<align_info> read_aligns(const char* path, seq_table& refs, seq_table& qrys) {
+  std::vector<align_info> res;
+  DeltaReader_t           dr;
+  dr.open(path);
+  while(dr.readNextHeadersOnly()) {
+    const DeltaRecord_t& rec = dr.getRecord();
+    const long           r   = refs.get(rec.idR, rec.lenR);
+    const long           q   = qrys.get(rec.idQ, rec.lenQ);
+    if(r < 0 || q < 0) continue;
+    for(const auto& a : rec.aligns)
+      res.push_back({ a.sR, a.eR, a.sQ, a.eQ, a.sim, r, q });
+  }
+  return res;
+}
+
+// Alignments kept by delta-filter -q -r
+static std::vector<align_info> filter_aligns(const char* path, const seq_table& refs, const seq_table& qrys) {
+  std::vector<align_info> res;
+  DeltaGraph_t            graph;
+  graph.build(path, false);
+  graph.flagQLIS();
+  graph.flagRLIS();
+  for(const auto& node : graph.refnodes) {
+    const long r = refs.find(*node.second.id);
+    if(r < 0) continue;
+    for(const auto edge : node.second.edges) {
+      const long q = qrys.find(*edge->qrynode->id);
+      if(q < 0) continue;
+      for(const auto l : edge->edgelets) {
+        if(!l->isGOOD) continue;
+        res.push_back({ l->dirR == FORWARD_DIR ? l->loR : l->hiR, l->dirR == FORWARD_DIR ? l->hiR : l->loR,
+                        l->dirQ == FORWARD_DIR ? l->loQ : l->hiQ, l->dirQ == FORWARD_DIR ? l->hiQ : l->loQ,
+                        l->sim * 100, r, q });
+      }
+    }
+  }
+  return res;
+}
+
+//-- Layout, as mummerplot --layout
+
+// Largest alignment between a reference and a query sequence. Index 0
+// of lo and hi is the reference side, index 1 the query side.
+struct layout_link {
+  int  slope;
+  long lo[2], hi[2];
+};
+
+// A sequence and its largest alignment to each sequence of the other axis
+struct layout_node {
+  bool                   placed = false;
+  long                   len    = 0;
+  std::map<long, size_t> links; // other sequence -> index in the links
+};
+
+typedef std::map<long, layout_node>       layout_nodes;
+typedef std::vector<std::pair<long, int>> layout_order; // sequence, direction
+
+// Place the sequences spanned by x, on side s, and recursively the
+// sequences they span
+static void span(long x, int s, layout_nodes& xc, layout_order& xl, layout_nodes& yc, layout_order& yl,
+                 std::vector<layout_link>& links) {
+  std::vector<std::pair<long, size_t>> ys(xc[x].links.begin(), xc[x].links.end());
+  std::stable_sort(ys.begin(), ys.end(), [&](const std::pair<long, size_t>& a, const std::pair<long, size_t>& b) {
+      return links[a.second].lo[s] < links[b.second].lo[s];
+    });
+
+  std::vector<long> post;
+  for(const auto& y : ys) {
+    layout_node& ny = yc[y.first];
+    if(ny.placed) continue;
+    ny.placed = true;
+
+    //-- if we need to flip, reverse complement all y links
+    const int slope = links[y.second].slope;
+    if(slope == -1) {
+      for(const auto& xx : ny.links) {
+        layout_link& l  = links[xx.second];
+        const long   lo = l.lo[1 - s];
+        l.slope         = -l.slope;
+        l.lo[1 - s]     = ny.len - l.hi[1 - s] + 1;
+        l.hi[1 - s]     = ny.len - lo + 1;
+      }
+    }
+    yl.push_back(std::make_pair(y.first, slope));
+
+    //-- recurse if y > x, else save for later
+    if(ny.len > xc[x].len)
+      span(y.first, 1 - s, yc, yl, xc, xl, links);
+    else
+      post.push_back(y.first);
+  }
+  for(long y : post)
+    span(y, 1 - s, yc, yl, xc, xl, links);
+}
+
+// Order and orient the sequences so the largest alignments are near the
+// diagonal. Sequences without alignments are placed at the end.
+static void layout(const std::vector<align_info>& aligns, seq_table& refs, seq_table& qrys, bool fat) {
+  layout_nodes             rc, qc;
+  std::vector<layout_link> links;
+
+  for(const auto& a : aligns) {
+    const int  dR = a.sR < a.eR ? 1 : -1, dQ = a.sQ < a.eQ ? 1 : -1;
+    const long loR = std::min(a.sR, a.eR), hiR = std::max(a.sR, a.eR);
+    const long loQ = std::min(a.sQ, a.eQ), hiQ = std::max(a.sQ, a.eQ);
+
+    if(fat) { // keep only the fattest alignment of each query
+      const auto it = qc.find(a.q);
+      if(it != qc.end() && !it->second.links.empty()) {
+        const auto         old = it->second.links.begin();
+        const layout_link& l   = links[old->second];
+        if(l.hi[0] - l.lo[0] > hiR - loR) continue;
+        rc[old->first].links.erase(a.q);
+        qc.erase(it);
+      }
+    }
+
+    layout_node& nr = rc[a.r];
+    layout_node& nq = qc[a.q];
+    nr.len          = refs.seqs[a.r].len;
+    nq.len          = qrys.seqs[a.q].len;
+    const auto it   = nr.links.find(a.q);
+    if(it == nr.links.end() || hiR - loR > links[it->second].hi[0] - links[it->second].lo[0]) {
+      nr.links[a.q] = nq.links[a.r] = links.size();
+      links.push_back({ dR == dQ ? 1 : -1, { loR, loQ }, { hiR, hiQ } });
+    }
+  }
+
+  //-- recursively span sequences to generate the layout
+  std::vector<long> roots;
+  for(const auto& n : rc)
+    roots.push_back(n.first);
+  std::stable_sort(roots.begin(), roots.end(), [&](long a, long b) { return rc[a].len > rc[b].len; });
+  layout_order rl, ql;
+  for(long r : roots)
+    span(r, 0, rc, rl, qc, ql, links);
+
+  //-- offsets according to the new layout, then the sequences left out
+  auto reorder = [](seq_table& table, const layout_order& l) {
+    std::vector<char>   placed(table.seqs.size(), false);
+    std::vector<size_t> order;
+    for(const auto& p : l) {
+      table.seqs[p.first].dir = p.second;
+      placed[p.first]         = true;
+      order.push_back(p.first);
+    }
+    for(size_t i = 0; i < placed.size(); ++i)
+      if(!placed[i]) order.push_back(i);
+    table.set_offsets(order);
+  };
+  reorder(refs, rl);
+  reorder(qrys, ql);
+}
+
+//-- Binning
+
+// Highest similarity of the alignments through each bin of the plot,
+// for the forward, reverse and highlighted alignments.
+struct plot_grid {
+  long               width, height;
+  long               xmax, ymax;
+  std::vector<float> layers[NB_LAYERS]; // -1 if empty
+
+  plot_grid(long w, long h, long xm, long ym) : width(w), height(h), xmax(xm), ymax(ym) {
+    for(auto& l : layers)
+      l.assign(width * height, -1);
+  }
+
+  long xbin(long x) const { return std::min(width - 1, std::max(0l, (x - 1) * width / xmax)); }
+  long ybin(long y) const { return std::min(height - 1, std::max(0l, (y - 1) * height / ymax)); }
+  float at(int layer, long bx, long by) const { return layers[layer][by * width + bx]; }
+
+  // Draw a segment between two points of the plot
+  void segment(int layer, long x0, long y0, long x1, long y1, float sim) {
+    const long bx = xbin(x0), by = ybin(y0);
+    const long dx = xbin(x1) - bx, dy = ybin(y1) - by;
+    const long n  = std::max(std::abs(dx), std::abs(dy));
+    for(long i = 0; i <= n; ++i) {
+      const long x = n ? bx + std::lround((double)dx * i / n) : bx;
+      const long y = n ? by + std::lround((double)dy * i / n) : by;
+      float&     v = layers[layer][y * width + x];
+      v            = std::max(v, sim);
+    }
+  }
+};
+
+// Bin the alignments, as mummerplot plots them
+static void bin_aligns(const std::vector<align_info>& aligns, const seq_table& refs, const seq_table& qrys,
+                       const dotplot_cmdline& args, plot_grid& grid) {
+  const long breaklen = args.breaklen_arg;
+  for(const auto& a : aligns) {
+    const seq_info& r  = refs.seqs[a.r];
+    const seq_info& q  = qrys.seqs[a.q];
+    long            sR = a.sR, eR = a.eR, sQ = a.sQ, eQ = a.eQ;
+
+    //-- get the orientation right
+    if(r.dir == -1) {
+      sR = r.len - sR + 1;
+      eR = r.len - eR + 1;
+    }
+    if(q.dir == -1) {
+      sQ = q.len - sQ + 1;
+      eQ = q.len - eQ + 1;
+    }
+
+    const bool highlight = args.breaklen_given &&
+      ((sR - 1 > breaklen && sQ - 1 > breaklen && r.len - sR > breaklen && q.len - sQ > breaklen) ||
+       (eR - 1 > breaklen && eQ - 1 > breaklen && r.len - eR > breaklen && q.len - eQ > breaklen));
+    const int layer = (sR < eR) == (sQ < eQ) ? FWD : REV;
+
+    sR += r.off; eR += r.off;
+    sQ += q.off; eQ += q.off;
+    for(int l : { layer, highlight ? HLT : -1 }) {
+      if(l < 0) continue;
+      if(args.coverage_flag) {
+        grid.segment(l, sR, 10, eR, 10, a.sim);
+        grid.segment(l, sR, std::lround(a.sim), eR, std::lround(a.sim), a.sim);
+      } else {
+        grid.segment(l, sR, sQ, eR, eQ, a.sim);
+      }
+    }
+  }
+}
+
+//-- Colors
+
+struct rgb { unsigned char r, g, b; };
+
+static const rgb WHITE  = { 0xff, 0xff, 0xff };
+static const rgb BLACK  = { 0x00, 0x00, 0x00 };
+static const rgb GRID   = { 0xdd, 0xdd, 0xdd };
+static const rgb LAYER_COLORS[NB_LAYERS] = { { 0xdd, 0x00, 0x00 }, { 0x00, 0x00, 0xdd }, { 0x00, 0xaa, 0x00 } };
+
+// Color of a percent similarity, with the mummerplot --color palette
+static rgb sim_color(float sim) {
+  static const struct { float sim; rgb color; } palette[] = {
+    {   0, { 0x00, 0x00, 0x00 } }, {  40, { 0xdd, 0x00, 0xdd } }, {  60, { 0x00, 0x00, 0xdd } },
+    {  70, { 0x00, 0xdd, 0xdd } }, {  80, { 0x00, 0xdd, 0x00 } }, {  90, { 0xdd, 0xdd, 0x00 } },
+    { 100, { 0xdd, 0x00, 0x00 } }
+  };
+  size_t i = 1;
+  while(i < sizeof(palette) / sizeof(palette[0]) - 1 && palette[i].sim < sim) ++i;
+  const float t = std::min(1.0f, std::max(0.0f, (sim - palette[i - 1].sim) / (palette[i].sim - palette[i - 1].sim)));
+  auto mix = [&](unsigned char a, unsigned char b) { return (unsigned char)std::lround(a + t * (b - a)); };
+  return { mix(palette[i - 1].color.r, palette[i].color.r), mix(palette[i - 1].color.g, palette[i].color.g),
+      mix(palette[i - 1].color.b, palette[i].color.b) };
+}
+
+// Topmost layer in a bin, -1 if empty
+static int top_layer(const plot_grid& grid, long bx, long by) {
+  for(int l = NB_LAYERS - 1; l >= 0; --l)
+    if(grid.at(l, bx, by) >= 0) return l;
+  return -1;
+}
+
+// Sequences of an axis in the order of the plot, without those
+// starting closer than MIN_GRID bins to the previous one: their
+// boundaries and names would not be readable.
+static const long MIN_GRID = 8;
+static std::vector<const seq_info*> visible_seqs(const seq_table& table, long nb, long max) {
+  std::vector<const seq_info*> seqs, res;
+  for(const auto& s : table.seqs)
+    seqs.push_back(&s);
+  std::sort(seqs.begin(), seqs.end(), [](const seq_info* a, const seq_info* b) { return a->off < b->off; });
+  long prev = -MIN_GRID;
+  for(const auto s : seqs) {
+    const long b = s->off * nb / max;
+    if(b < nb && b - prev >= MIN_GRID) {
+      res.push_back(s);
+      prev = b;
+    }
+  }
+  return res;
+}
+
+// Bins on the boundaries between sequences
+static std::vector<char> boundaries(const seq_table& table, long nb, long max, bool coverage) {
+  std::vector<char> res(nb, false);
+  if(coverage || table.seqs.size() < 2) return res;
+  for(const auto s : visible_seqs(table, nb, max))
+    if(s->off > 0) res[s->off * nb / max] = true;
+  return res;
+}
+
+//-- PNG output
+
+static uint32_t crc32(const std::string& data) {
+  static uint32_t table[256];
+  static bool     init = false;
+  if(!init) {
+    for(uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for(int k = 0; k < 8; ++k)
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      table[n] = c;
+    }
+    init = true;
+  }
+  uint32_t c = 0xffffffff;
+  for(unsigned char x : data)
+    c = table[(c ^ x) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffff;
+}
+
+static void put_uint32(std::string& buf, uint32_t x) {
+  for(int s = 24; s >= 0; s -= 8)
+    buf += (char)((x >> s) & 0xff);
+}
+
+// Deflate bit stream, least significant bit first
+struct bit_writer {
+  std::string& out;
+  uint32_t     acc = 0;
+  int          n   = 0;
+
+  bit_writer(std::string& o) : out(o) { }
+  void put(uint32_t bits, int len) {
+    acc |= bits << n;
+    for(n += len; n >= 8; n -= 8, acc >>= 8)
+      out += (char)(acc & 0xff);
+  }
+  // Huffman codes are packed most significant bit first
+  void code(uint32_t c, int len) {
+    uint32_t r = 0;
+    for(int i = 0; i < len; ++i, c >>= 1)
+      r = (r << 1) | (c & 1);
+    put(r, len);
+  }
+  void flush() {
+    if(n > 0) out += (char)(acc & 0xff);
+    acc = n = 0;
+  }
+};
+
+// Literal/length symbol with the fixed Huffman codes
+static void put_symbol(bit_writer& bw, unsigned v) {
+  if(v < 144)      bw.code(0x30 + v, 8);
+  else if(v < 256) bw.code(0x190 + v - 144, 9);
+  else if(v < 280) bw.code(v - 256, 7);
+  else             bw.code(0xc0 + v - 280, 8);
+}
+
+// Copy of len bytes from dist bytes back, 3 <= len <= 258
+static void put_match(bit_writer& bw, unsigned len, unsigned dist) {
+  static const unsigned len_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                         35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+  static const int len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+  static const unsigned dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                          257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                          8193, 12289, 16385, 24577 };
+  int c = 28;
+  while(len_base[c] > len) --c;
+  put_symbol(bw, 257 + c);
+  if(len_extra[c]) bw.put(len - len_base[c], len_extra[c]);
+  int d = 29;
+  while(dist_base[d] > dist) --d;
+  bw.code(d, 5);
+  if(d >= 4) bw.put(dist - dist_base[d], d / 2 - 1);
+}
+
+// zlib stream of a single fixed Huffman block. The only matches are
+// runs of identical bytes and copies of the previous row of the image
+// (stride bytes back): plots are mostly empty, so that is enough.
+static std::string zlib_compress(const std::string& data, size_t stride) {
+  static const size_t MAX_MATCH = 258, MAX_DIST = 32768;
+  std::string res("\x78\x01", 2);
+  bit_writer  bw(res);
+  bw.put(1, 1);                 // last block
+  bw.put(1, 2);                 // fixed Huffman codes
+  auto match_len = [&](size_t i, size_t dist) {
+    size_t len = 0;
+    if(i >= dist)
+      while(len < MAX_MATCH && i + len < data.size() && data[i + len] == data[i + len - dist]) ++len;
+    return len;
+  };
+  for(size_t i = 0; i < data.size(); ) {
+    const size_t run = match_len(i, 1);
+    const size_t row = stride <= MAX_DIST ? match_len(i, stride) : 0;
+    if(std::max(run, row) < 3) {
+      put_symbol(bw, (unsigned char)data[i++]);
+    } else if(row > run) {
+      put_match(bw, row, stride);
+      i += row;
+    } else {
+      put_match(bw, run, 1);
+      i += run;
+    }
+  }
+  put_symbol(bw, 256);          // end of block
+  bw.flush();
+
+  uint32_t a = 1, b = 0;
+  for(unsigned char x : data) {
+    a = (a + x) % 65521;
+    b = (b + a) % 65521;
+  }
+  put_uint32(res, (b << 16) | a);
+  return res;
+}
+
+static void png_chunk(std::ostream& os, const char* type, const std::string& data) {
+  std::string buf;
+  put_uint32(buf, data.size());
+  buf += type;
+  buf += data;
+  put_uint32(buf, crc32(buf.substr(4)));
+  os.write(buf.data(), buf.size());
+}
+
+// Palette image of the plot with a black frame
+static void write_png(std::ostream& os, const plot_grid& grid, const seq_table& refs, const seq_table& qrys,
+                      bool coverage, bool color) {
+  enum { I_WHITE, I_BLACK, I_GRID, I_LAYERS, I_SIM = I_LAYERS + NB_LAYERS };
+  std::string palette;
+  auto add_color = [&](const rgb& c) { palette += (char)c.r; palette += (char)c.g; palette += (char)c.b; };
+  for(const rgb& c : { WHITE, BLACK, GRID }) add_color(c);
+  for(const rgb& c : LAYER_COLORS) add_color(c);
+  for(int s = 0; s <= 100; ++s) add_color(sim_color(s));
+
+  const long              width = grid.width + 2, height = grid.height + 2;
+  const std::vector<char> xb    = boundaries(refs, grid.width, grid.xmax, false);
+  const std::vector<char> yb    = boundaries(qrys, grid.height, grid.ymax, coverage);
+  std::string             pixels;
+  pixels.reserve((width + 1) * height);
+  for(long y = 0; y < height; ++y) {
+    pixels += '\0';             // no filter
+    const long by = grid.height - y;
+    for(long x = 0; x < width; ++x) {
+      const long bx = x - 1;
+      if(x == 0 || y == 0 || x == width - 1 || y == height - 1) {
+        pixels += (char)I_BLACK;
+        continue;
+      }
+      const int l = top_layer(grid, bx, by);
+      if(l >= 0)
+        pixels += (char)(color ? I_SIM + std::lround(std::max(0.0f, grid.at(l, bx, by))) : I_LAYERS + l);
+      else
+        pixels += (char)(xb[bx] || yb[by] ? I_GRID : I_WHITE);
+    }
+  }
+
+  std::string header;
+  put_uint32(header, width);
+  put_uint32(header, height);
+  header += std::string("\x08\x03\x00\x00\x00", 5); // 8 bits palette, no interlace
+  os.write("\x89PNG\r\n\x1a\n", 8);
+  png_chunk(os, "IHDR", header);
+  png_chunk(os, "PLTE", palette);
+  png_chunk(os, "IDAT", zlib_compress(pixels, width + 1));
+  png_chunk(os, "IEND", "");
+}
+
+//-- SVG output
+
+static std::string xml_escape(const std::string& s) {
+  std::string res;
+  for(char c : s) {
+    switch(c) {
+    case '&': res += "&amp;"; break;
+    case '<': res += "&lt;"; break;
+    case '>': res += "&gt;"; break;
+    case '"': res += "&quot;"; break;
+    default: res += c;
+    }
+  }
+  return res;
+}
+
+static std::string hex_color(const rgb& c) {
+  char buf[8];
+  snprintf(buf, sizeof(buf), "#%02x%02x%02x", c.r, c.g, c.b);
+  return buf;
+}
+
+// Label of an axis: the sequence id if only one, the name of the axis otherwise
+static std::string axis_label(const seq_table& table, const char* name) {
+  return table.seqs.size() == 1 ? table.seqs[0].id : name;
+}
+
+// Plot with a rectangle per run of bins of the same color, and the
+// sequence names on the axes
+static void write_svg(std::ostream& os, const plot_grid& grid, const seq_table& refs, const seq_table& qrys,
+                      bool coverage, bool color) {
+  size_t rlen = 0, qlen = 0;
+  for(const auto& s : refs.seqs) rlen = std::max(rlen, s.id.size() + 1);
+  for(const auto& s : qrys.seqs) qlen = std::max(qlen, s.id.size() + 1);
+  if(coverage) qlen = 3;
+  const long left   = 20 + std::min(200l, (long)(qlen * 5));
+  const long bottom = 20 + std::min(200l, (long)(rlen * 5));
+  const long width  = left + grid.width + 10, height = grid.height + bottom + 10;
+
+  os << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+     << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width << "\" height=\"" << height << "\">\n"
+     << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n"
+     << "<g transform=\"translate(" << left << ",10)\" font-family=\"Courier,monospace\" font-size=\"8\">\n";
+
+  //-- grid
+  const std::vector<char> xb = boundaries(refs, grid.width, grid.xmax, false);
+  const std::vector<char> yb = boundaries(qrys, grid.height, grid.ymax, coverage);
+  const std::string       gc = hex_color(GRID);
+  for(long bx = 0; bx < grid.width; ++bx)
+    if(xb[bx])
+      os << "<line x1=\"" << bx << ".5\" y1=\"0\" x2=\"" << bx << ".5\" y2=\"" << grid.height << "\" stroke=\"" << gc << "\"/>\n";
+  for(long by = 0; by < grid.height; ++by)
+    if(yb[by])
+      os << "<line x1=\"0\" y1=\"" << (grid.height - 1 - by) << ".5\" x2=\"" << grid.width << "\" y2=\""
+         << (grid.height - 1 - by) << ".5\" stroke=\"" << gc << "\"/>\n";
+
+  //-- bins, merged in runs along the rows
+  os << "<g shape-rendering=\"crispEdges\">\n";
+  auto bin_color = [&](long bx, long by) -> std::string {
+    const int l = top_layer(grid, bx, by);
+    if(l < 0) return std::string();
+    return hex_color(color ? sim_color(grid.at(l, bx, by)) : LAYER_COLORS[l]);
+  };
+  for(long by = 0; by < grid.height; ++by) {
+    for(long bx = 0; bx < grid.width; ) {
+      const std::string c   = bin_color(bx, by);
+      long              end = bx + 1;
+      if(c.empty()) {
+        bx = end;
+        continue;
+      }
+      while(end < grid.width && bin_color(end, by) == c) ++end;
+      os << "<rect x=\"" << bx << "\" y=\"" << (grid.height - 1 - by) << "\" width=\"" << (end - bx)
+         << "\" height=\"1\" fill=\"" << c << "\"/>\n";
+      bx = end;
+    }
+  }
+  os << "</g>\n"
+     << "<rect x=\"0\" y=\"0\" width=\"" << grid.width << "\" height=\"" << grid.height
+     << "\" fill=\"none\" stroke=\"black\"/>\n";
+
+  //-- tics
+  if(refs.seqs.size() > 1) {
+    for(const auto s : visible_seqs(refs, grid.width, grid.xmax)) {
+      const long x = s->off * grid.width / grid.xmax;
+      os << "<text transform=\"translate(" << x << ',' << (grid.height + 4) << ") rotate(90)\">"
+         << (s->dir == -1 ? "*" : "") << xml_escape(s->id) << "</text>\n";
+    }
+  }
+  if(coverage) {
+    for(int sim = 0; sim <= 100; sim += 20)
+      os << "<text x=\"-4\" y=\"" << (grid.height - (sim - 1) * grid.height / grid.ymax)
+         << "\" text-anchor=\"end\">" << sim << "</text>\n";
+  } else if(qrys.seqs.size() > 1) {
+    for(const auto s : visible_seqs(qrys, grid.height, grid.ymax)) {
+      const long y = s->off * grid.height / grid.ymax;
+      os << "<text x=\"-4\" y=\"" << (grid.height - y) << "\" text-anchor=\"end\">"
+         << (s->dir == -1 ? "*" : "") << xml_escape(s->id) << "</text>\n";
+    }
+  }
+  os << "</g>\n"
+     << "<text x=\"" << (left + grid.width / 2) << "\" y=\"" << (height - 4)
+     << "\" text-anchor=\"middle\" font-family=\"Courier,monospace\" font-size=\"10\">"
+     << xml_escape(axis_label(refs, "REF")) << "</text>\n"
+     << "<text transform=\"translate(12," << (10 + grid.height / 2)
+     << ") rotate(-90)\" text-anchor=\"middle\" font-family=\"Courier,monospace\" font-size=\"10\">"
+     << xml_escape(coverage ? std::string("%SIM") : axis_label(qrys, "QRY")) << "</text>\n"
+     << "</svg>\n";
+}
+
+//-- gnuplot output
+
+// Binned plot data, in the format of mummerplot: one segment per bin,
+// from corner to corner of the bin in the direction of the alignments.
+static void write_plot_data(std::ostream& os, const plot_grid& grid, int layer, bool coverage) {
+  static const char* names[NB_LAYERS] = { "forward", "reverse", "highlighted" };
+  os << "#-- " << names[layer] << " hits binned on a " << grid.width << 'x' << grid.height
+     << " grid, max %sim\n0 0 0\n0 0 0\n\n\n";
+  for(long by = 0; by < grid.height; ++by) {
+    const long y0 = 1 + by * grid.ymax / grid.height, y1 = (by + 1) * grid.ymax / grid.height;
+    for(long bx = 0; bx < grid.width; ++bx) {
+      const float sim = grid.at(layer, bx, by);
+      if(sim < 0) continue;
+      const long x0 = 1 + bx * grid.xmax / grid.width, x1 = (bx + 1) * grid.xmax / grid.width;
+      char       buf[256];
+      if(coverage)
+        snprintf(buf, sizeof(buf), "%ld %ld %.2f\n%ld %ld %.2f\n\n\n", x0, (y0 + y1) / 2, sim, x1, (y0 + y1) / 2, sim);
+      else if(layer == REV)
+        snprintf(buf, sizeof(buf), "%ld %ld %.2f\n%ld %ld %.2f\n\n\n", x0, y1, sim, x1, y0, sim);
+      else
+        snprintf(buf, sizeof(buf), "%ld %ld %.2f\n%ld %ld %.2f\n\n\n", x0, y0, sim, x1, y1, sim);
+      os << buf;
+    }
+  }
+}
+
+// Tics of the visible sequences of an axis, as mummerplot
+static void write_tics(std::ostream& os, const char* axis, const seq_table& table, long nb, long range) {
+  os << "set " << axis << "tics" << (axis[0] == 'x' ? " rotate" : "") << " ( \\\n";
+  for(const auto s : visible_seqs(table, nb, range))
+    os << " \"" << (s->dir == -1 ? "*" : "") << s->id << "\" " << (s->off + 1) << ".0, \\\n";
+  os << " \"\" " << range << " \\\n)\n";
+}
+
+static void write_gnuplot(std::ostream& os, const plot_grid& grid, const seq_table& refs, const seq_table& qrys,
+                          const dotplot_cmdline& args, const std::string& prefix) {
+  const bool coverage = args.coverage_flag, color = args.color_flag, highlight = args.breaklen_given;
+  os << "set terminal png tiny size " << grid.width << ',' << (coverage ? grid.width : grid.height) << '\n'
+     << "set output \"" << prefix << ".png\"\n";
+
+  int border = 0;
+  if(refs.seqs.size() > 1)
+    write_tics(os, "x", refs, grid.width, grid.xmax);
+  else
+    border |= 10;
+  if(coverage) {
+    border |= 5;
+  } else if(qrys.seqs.size() > 1) {
+    write_tics(os, "y", qrys, grid.height, grid.ymax);
+  } else {
+    border |= 5;
+  }
+
+  os << (coverage ? "set size 1,.375\n" : "set size 1,1\n")
+     << "set grid\n"
+     << "unset key\n"
+     << "set border " << border << '\n'
+     << "set tics scale 0\n"
+     << "set xlabel \"" << axis_label(refs, "REF") << "\"\n"
+     << "set ylabel \"" << (coverage ? std::string("%SIM") : axis_label(qrys, "QRY")) << "\"\n"
+     << "set format \"%.0f\"\n"
+     << "set xrange [1:" << grid.xmax << "]\n"
+     << "set yrange [1:" << grid.ymax << "]\n";
+  if(color)
+    os << "set zrange [0:100]\n"
+       << "set colorbox default\n"
+       << "set cblabel \"%similarity\"\n"
+       << "set cbrange [0:100]\n"
+       << "set cbtics 20\n"
+       << "set pm3d map\n"
+       << "set palette model RGB defined ( \\\n"
+       << "  0 \"#000000\", \\\n"
+       << "  4 \"#DD00DD\", \\\n"
+       << "  6 \"#0000DD\", \\\n"
+       << "  7 \"#00DDDD\", \\\n"
+       << "  8 \"#00DD00\", \\\n"
+       << "  9 \"#DDDD00\", \\\n"
+       << " 10 \"#DD0000\"  \\\n)\n";
+
+  static const int line_types[2][NB_LAYERS] = { { 1, 3, 2 }, { 2, 2, 1 } };
+  for(int l = 0; l < NB_LAYERS; ++l) {
+    os << "set style line " << (l + 1) << ' ';
+    if(color)
+      os << " palette";
+    else
+      os << " lt " << line_types[highlight][l];
+    os << " lw 3\n";
+  }
+
+  os << (color ? "splot \\\n" : "plot \\\n")
+     << " \"" << prefix << ".fplot\" title \"FWD\" w l ls 1, \\\n"
+     << " \"" << prefix << ".rplot\" title \"REV\" w l ls 2";
+  if(highlight)
+    os << ", \\\n \"" << prefix << ".hplot\" title \"HLT\" w l ls 3";
+  os << '\n';
+}
+
+//-- Main
+
+static void open_output(std::ofstream& os, const std::string& path) {
+  os.open(path, std::ios::out | std::ios::binary);
+  if(!os.good())
+    dotplot_cmdline::error() << "Failed to open output file '" << path << "': " << strerror(errno);
+}
+
+static void close_output(std::ofstream& os, const std::string& path) {
+  os.close();
+  if(!os.good())
+    dotplot_cmdline::error() << "Failed to write output file '" << path << '\'';
+}
+
+static long plot_size(const std::string& size) {
+  if(size == "small")  return 800;
+  if(size == "medium") return 1024;
+  if(size == "large")  return 1400;
+  char*      end;
+  const long res = strtol(size.c_str(), &end, 10);
+  if(*end || res <= 0)
+    dotplot_cmdline::error() << "Invalid plot size '" << size << '\'';
+  return res;
+}
+
+int main(int argc, char *argv[]) {
+  std::ios::sync_with_stdio(false);
+  dotplot_cmdline args(argc, argv);
+
+  const std::string& terminal = args.terminal_arg;
+  if(terminal != "png" && terminal != "svg" && terminal != "gnuplot")
+    dotplot_cmdline::error() << "Unknown terminal type '" << terminal << '\'';
+  const long size = plot_size(args.size_arg);
+
+  //-- Parse the reference and query IDs
+  seq_table refs, qrys;
+  if(args.IdR_given) {
+    refs.all = false;
+    refs.add(args.IdR_arg, 0, 1);
+  } else if(args.Rfile_given) {
+    parse_ids(args.Rfile_arg, refs);
+  }
+  if(args.IdQ_given) {
+    qrys.all = false;
+    qrys.add(args.IdQ_arg, 0, 1);
+  } else if(args.Qfile_given) {
+    parse_ids(args.Qfile_arg, qrys);
+  }
+
+  //-- Alignment data, filtered as delta-filter -q -r for --filter and --layout
+  std::vector<align_info> aligns = read_aligns(args.delta_arg, refs, qrys);
+  const bool              do_layout = args.layout_flag || args.fat_flag;
+  if(args.filter_flag || do_layout) {
+    std::vector<align_info> filtered = filter_aligns(args.delta_arg, refs, qrys);
+    if(do_layout)
+      layout(filtered, refs, qrys, args.fat_flag);
+    if(args.filter_flag)
+      aligns.swap(filtered);
+  }
+  if(!do_layout) {
+    refs.set_offsets();
+    qrys.set_offsets();
+  }
+  long xmax = 0, ymax = 0;
+  for(const auto& s : refs.seqs) xmax += s.len;
+  for(const auto& s : qrys.seqs) ymax += s.len;
+  if(args.coverage_flag) ymax = 110;
+  if(aligns.empty() || xmax == 0 || ymax == 0)
+    dotplot_cmdline::error() << "No alignment data to plot";
+
+  //-- Bin and plot
+  plot_grid grid(size, args.coverage_flag ? size * 3 / 8 : size, xmax, ymax);
+  bin_aligns(aligns, refs, qrys, args, grid);
+
+  const std::string& prefix = args.prefix_arg;
+  if(terminal == "png") {
+    std::ofstream os;
+    open_output(os, prefix + ".png");
+    write_png(os, grid, refs, qrys, args.coverage_flag, args.color_flag);
+    close_output(os, prefix + ".png");
+  } else if(terminal == "svg") {
+    std::ofstream os;
+    open_output(os, prefix + ".svg");
+    write_svg(os, grid, refs, qrys, args.coverage_flag, args.color_flag);
+    close_output(os, prefix + ".svg");
+  } else {
+    static const char* suffixes[NB_LAYERS] = { ".fplot", ".rplot", ".hplot" };
+    for(int l = 0; l < NB_LAYERS; ++l) {
+      if(l == HLT && !args.breaklen_given) continue;
+      std::ofstream os;
+      open_output(os, prefix + suffixes[l]);
+      write_plot_data(os, grid, l, args.coverage_flag);
+      close_output(os, prefix + suffixes[l]);
+    }
+    std::ofstream os;
+    open_output(os, prefix + ".gp");
+    write_gnuplot(os, grid, refs, qrys, args, prefix);
+    close_output(os, prefix + ".gp");
+  }
+
+  return 0;
+}
@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//!
+//! \brief Source for the external sort of external_sort.hh
+//!
+//! \see external_sort.hh
+////////////////////////////////////////////////////////////////////////////////
+
+#include <mummer/external_sort.hh>
+#include <algorithm>
+#include <queue>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace mummer {
+namespace external_sort {
+
+// Maximum number of files merged at once
+static const size_t MAX_MERGE_RUNS = 64;
+static const size_t HEADER_LEN     = sizeof(uint64_t) + sizeof(uint32_t);
+
+static uint64_t record_key(const char* p) {
+  uint64_t key;
+  memcpy(&key, p, sizeof(key));
+  return key;
+}
+
+static uint32_t record_len(const char* p) {
+  uint32_t len;
+  memcpy(&len, p + sizeof(uint64_t), sizeof(len));
+  return len;
+}
+
+// Compare the records (key, then payload) starting at a and b
+static int compare_records(uint64_t ka, const char* pa, uint32_t la,
+                           uint64_t kb, const char* pb, uint32_t lb) {
+  if(ka != kb) return ka < kb ? -1 : 1;
+  const int c = memcmp(pa, pb, std::min(la, lb));
+  if(c) return c;
+  return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+static FILE* temporary_file() {
+  const char*       dir  = getenv("TMPDIR");
+  const std::string tdir = dir && *dir ? dir : "/tmp";
+  std::string       path = tdir + "/mummer_sort.XXXXXX";
+  const int         fd   = mkstemp(&path[0]);
+  FILE*             f    = fd < 0 ? nullptr : fdopen(fd, "w+");
+  if(!f)
+    throw std::runtime_error("Failed to create a temporary file in '" + tdir + "': " + strerror(errno));
+  unlink(path.c_str());
+  return f;
+}
+
+static void rewind_run(FILE* f) {
+  if(fflush(f) != 0 || ferror(f) || fseek(f, 0, SEEK_SET) != 0)
+    throw std::runtime_error(std::string("Failed to write a temporary file: ") + strerror(errno));
+}
+
+//
+// buffer
+//
+void buffer::add(uint64_t key, const char* payload, size_t len) {
+  const uint32_t len32 = len;
+  offsets_m.push_back(data_m.size());
+  data_m.append((const char*)&key, sizeof(key));
+  data_m.append((const char*)&len32, sizeof(len32));
+  data_m.append(payload, len);
+  if(data_m.size() + offsets_m.size() * sizeof(size_t) >= sorter_m.buffer_size_m) {
+    sort();
+    sorter_m.spill(data_m);
+    data_m.clear();
+    offsets_m.clear();
+  }
+}
+
+// Reorder data_m by record
+void buffer::sort() {
+  const char* const data = data_m.data();
+  std::sort(offsets_m.begin(), offsets_m.end(), [data](size_t a, size_t b) {
+      return compare_records(record_key(data + a), data + a + HEADER_LEN, record_len(data + a),
+                             record_key(data + b), data + b + HEADER_LEN, record_len(data + b)) < 0;
+    });
+  std::string sorted;
+  sorted.reserve(data_m.size());
+  for(const auto o : offsets_m)
+    sorted.append(data + o, HEADER_LEN + record_len(data + o));
+  data_m.swap(sorted);
+}
+
+void buffer::done() {
+  if(offsets_m.empty()) return;
+  sort();
+  sorter_m.keep(std::move(data_m));
+  data_m.clear();
+  offsets_m.clear();
+}
+
+//
+// sorter
+//
+sorter::sorter(size_t memory, unsigned int nb_buffers)
+  : memory_m(memory)
+  , buffer_size_m(std::max((size_t)1, memory / std::max(1u, nb_buffers)))
+  , memory_used_m(0)
+{ }
+
+sorter::~sorter() {
+  for(auto f : runs_m)
+    fclose(f);
+}
+
+void sorter::spill(const std::string& run) {
+  FILE* f = temporary_file();
+  fwrite(run.data(), 1, run.size(), f);
+  rewind_run(f);
+  std::lock_guard<std::mutex> lock(mutex_m);
+  runs_m.push_back(f);
+}
+
+// Keep the last run of a buffer in memory, unless the runs already kept
+// use up the memory (e.g. buffers of many batches of references)
+void sorter::keep(std::string&& run) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    if(memory_used_m + run.size() <= memory_m) {
+      memory_used_m += run.size();
+      memory_runs_m.push_back(std::move(run));
+      return;
+    }
+  }
+  spill(run);
+}
+
+namespace {
+// Current record of a run, in memory or in a file
+struct run_head {
+  FILE*       f;
+  const char* p;                // next record in memory
+  const char* end;
+  uint64_t    key;
+  const char* payload;
+  uint32_t    len;
+  std::string buf;              // payload read from the file
+
+  bool next() {
+    if(f) {
+      char header[HEADER_LEN];
+      if(fread(header, 1, HEADER_LEN, f) != HEADER_LEN) return false;
+      key = record_key(header);
+      len = record_len(header);
+      buf.resize(len);
+      if(len && fread(&buf[0], 1, len, f) != len)
+        throw std::runtime_error("Truncated temporary file");
+      payload = buf.data();
+      return true;
+    }
+    if(p >= end) return false;
+    key     = record_key(p);
+    len     = record_len(p);
+    payload = p + HEADER_LEN;
+    p      += HEADER_LEN + len;
+    return true;
+  }
+};
+} // namespace
+
+void sorter::merge(FILE* const* first, FILE* const* last, bool with_memory_runs,
+                   const std::function<void(uint64_t, const char*, size_t)>& out) {
+  std::vector<run_head> heads;
+  for( ; first != last; ++first)
+    heads.push_back({ *first, nullptr, nullptr, 0, nullptr, 0, std::string() });
+  if(with_memory_runs) {
+    for(const auto& run : memory_runs_m)
+      heads.push_back({ nullptr, run.data(), run.data() + run.size(), 0, nullptr, 0, std::string() });
+  }
+
+  auto after = [&heads](size_t i, size_t j) {
+    const run_head& a = heads[i];
+    const run_head& b = heads[j];
+    return compare_records(a.key, a.payload, a.len, b.key, b.payload, b.len) > 0;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(after)> queue(after);
+  for(size_t i = 0; i < heads.size(); ++i)
+    if(heads[i].next()) queue.push(i);
+
+  while(!queue.empty()) {
+    const size_t i = queue.top();
+    queue.pop();
+    out(heads[i].key, heads[i].payload, heads[i].len);
+    if(heads[i].next()) queue.push(i);
+  }
+}
+
+void sorter::merge(const std::function<void(uint64_t, const char*, size_t)>& out) {
+  // Merge the oldest files, MAX_MERGE_RUNS at a time, until few are left
+  while(runs_m.size() > MAX_MERGE_RUNS) {
+    FILE* f = temporary_file();
+    merge(runs_m.data(), runs_m.data() + MAX_MERGE_RUNS, false, [f](uint64_t key, const char* payload, size_t len) {
+        const uint32_t len32 = len;
+        fwrite(&key, sizeof(key), 1, f);
+        fwrite(&len32, sizeof(len32), 1, f);
+        fwrite(payload, 1, len, f);
+      });
+    rewind_run(f);
+    for(size_t i = 0; i < MAX_MERGE_RUNS; ++i)
+      fclose(runs_m[i]);
+    runs_m.erase(runs_m.begin() + 1, runs_m.begin() + MAX_MERGE_RUNS);
+    runs_m[0] = f;
+  }
+
+  merge(runs_m.data(), runs_m.data() + runs_m.size(), true, out);
+  for(auto f : runs_m)
+    fclose(f);
+  runs_m.clear();
+  memory_runs_m.clear();
+  memory_used_m = 0;
+}
+
+} // namespace external_sort
+} // namespace mummer
@@ -88,8 +88,13 @@ void SequenceAligner::align(const char* query, size_t query_len, std::vector<pos
                                   const FastaRecordSeq& Bf) { for(auto& al : als) alignments.push_back(std::move(al)); });
 }
 
-std::unique_ptr<std::ifstream> sequence_info::open_path(const char* path) {
-  std::unique_ptr<std::ifstream> data(new std::ifstream(path));
+std::unique_ptr<std::istream> sequence_info::open_path(const char* path) {
+  std::unique_ptr<std::istream> data;
+  try {
+    data.reset(new compressed::ifstream(path));
+  } catch(const std::runtime_error& e) {
+    throw std::runtime_error(std::string("Unable to open '") + path + "': " + e.what());
+  }
   if(!data->good())
     throw std::runtime_error(std::string("Unable to open '") + path + "'");
   return data;
@@ -4,7 +4,13 @@
 #include <cstdlib>
 #include <thread>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <mummer/nucmer.hpp>
+#include <mummer/delta_binary.hh>
+#include <mummer/external_sort.hh>
+#include <mummer/bgzf.hh>
+#include <mummer/compressed_stream.hh>
 #include <src/umd/nucmer_cmdline.hpp>
 #include <thread_pipe.hpp>
 
@@ -21,35 +27,137 @@ struct getrealpath {
 };
 
 typedef std::vector<const char*>::const_iterator         path_iterator;
-typedef jellyfish::stream_manager<path_iterator>         stream_manager;
+typedef jellyfish::stream_manager<path_iterator, mummer::compressed::ifstream> stream_manager;
 typedef jellyfish::whole_sequence_parser<stream_manager> sequence_parser;
 
+typedef std::vector<std::pair<std::string, long>> reference_list;
+
+// Sort key of a SAM record: index of the reference (over all the
+// batches) and position on the reference.
+static uint64_t sam_sort_key(size_t ref_id, long pos) {
+  return ((uint64_t)ref_id << 32) | (uint64_t)pos;
+}
+
+// Uncompressed size of the output compressed at once by a thread
+static const size_t BGZF_CHUNK = 4 * mummer::bgzf::BLOCK_SIZE;
+
+// Compression of the output of the threads (BAM, or with --compress), as
+// independent BGZF blocks
+static void bgzf_filter(const std::string& in, std::string& out) {
+  out.clear();
+  mummer::bgzf::compress(in, out);
+}
+
+static thread_pipe::filtered_iterator::filter_type output_filter(const nucmer_cmdline* args) {
+  if(args->bam_given || args->compress_flag)
+    return bgzf_filter;
+  return thread_pipe::filtered_iterator::filter_type();
+}
+
+static void add_references(const mummer::nucmer::sequence_info& info, reference_list& references) {
+  for(size_t i = 0; i + 1 < info.records.size(); ++i) {
+    const mummer::nucmer::FastaRecordPtr rec(info, i);
+    references.emplace_back(rec.Id(), rec.len());
+  }
+}
+
+// References of all the batches of the file, as loaded by the aligner
+static void scan_references(const char* path, size_t batch_size, unsigned int threads, reference_list& references) {
+  mummer::compressed::ifstream is;
+  try {
+    is.open(path, std::ios::in, threads);
+  } catch(const std::runtime_error& e) {
+    nucmer_cmdline::error() << "Failed to open reference file '" << path << "': " << e.what();
+  }
+  while(is.peek() != EOF)
+    add_references(mummer::nucmer::sequence_info(is, batch_size), references);
+  if(is.bad())
+    nucmer_cmdline::error() << "Failed to read reference file '" << path << "'";
+}
+
+// Report the error reading the queries, if any
+static void check_queries(const sequence_parser& parser) {
+  if(!parser.error()) return;
+  try {
+    std::rethrow_exception(parser.error());
+  } catch(const std::exception& e) {
+    nucmer_cmdline::error() << "Failed to read query file: " << e.what();
+  }
+}
+
+static std::string sam_header(const char* sort_order, const reference_list& references, const std::string& cmdline) {
+  std::ostringstream os;
+  os << "@HD\tVN:1.6\tSO:" << sort_order << '\n';
+  for(const auto& ref : references)
+    os << "@SQ\tSN:" << ref.first << "\tLN:" << ref.second << '\n';
+  os << "@PG\tID:nucmer\tPN:nucmer\tVN:4.0\tCL:" << cmdline << '\n';
+  return os.str();
+}
+
 void query_thread(mummer::nucmer::FileAligner* aligner, sequence_parser* parser,
-                  thread_pipe::ostream_buffered* printer, const nucmer_cmdline* args) {
-  auto output_it = printer->begin();
+                  thread_pipe::ostream_buffered* printer, const nucmer_cmdline* args,
+                  mummer::external_sort::sorter* sorter, size_t ref_offset) {
+  thread_pipe::filtered_iterator output_it(printer->begin(), output_filter(args), BGZF_CHUNK);
   const bool sam = args->sam_short_given || args->sam_long_given;
+  const bool bam = args->bam_given;
+  std::unique_ptr<mummer::external_sort::buffer> sort_buffer;
+  std::ostringstream                             record;
+  std::string                                    bam_records;
+  if(sorter)
+    sort_buffer.reset(new mummer::external_sort::buffer(*sorter));
 
   auto print_function = [&](std::vector<mummer::postnuc::Alignment>&& als,
                             const mummer::nucmer::FastaRecordPtr& Af, const mummer::nucmer::FastaRecordSeq& Bf) {
     assert(Af.Id()[strlen(Af.Id()) - 1] != ' ');
     assert(Bf.Id().back() != ' ');
-    if(!sam)
+    if(args->binary_flag)
+      mummer::postnuc::printBinaryDeltaAlignments(als, Af.Id(), Af.len(), Bf.Id(), Bf.len(), *output_it, args->minalign_arg);
+    else if(args->paf_given)
+      mummer::postnuc::printPAFAlignments(als, Af.Id(), Af.len(), Bf.Id(), Bf.len(), *output_it, args->paf_cigar_flag, args->minalign_arg);
+    else if(bam) {
+      if(sort_buffer) {
+        mummer::postnuc::printBAMAlignments(als, Af, ref_offset + Af.id(), Bf, bam_records, true, args->minalign_arg,
+                                            [&](const mummer::postnuc::Alignment& Al) {
+                                              sort_buffer->add(sam_sort_key(ref_offset + Af.id(), Al.sA), bam_records);
+                                              bam_records.clear();
+                                            });
+        return;
+      }
+      mummer::postnuc::printBAMAlignments(als, Af, ref_offset + Af.id(), Bf, bam_records, true, args->minalign_arg,
+                                          [](const mummer::postnuc::Alignment&) { });
+      output_it->write(bam_records.data(), bam_records.size());
+      bam_records.clear();
+    } else if(!sam)
       mummer::postnuc::printDeltaAlignments(als, Af.Id(), Af.len(), Bf.Id(), Bf.len(), *output_it, args->minalign_arg);
-    else
+    else if(sort_buffer) {
+      mummer::postnuc::printSAMAlignments(als, Af, Bf, record, args->sam_long_given, args->minalign_arg,
+                                          [&](const mummer::postnuc::Alignment& Al) {
+                                            sort_buffer->add(sam_sort_key(ref_offset + Af.id(), Al.sA), record.str());
+                                            record.str("");
+                                          });
+      return;
+    } else
       mummer::postnuc::printSAMAlignments(als, Af, Bf, *output_it, args->sam_long_given, args->minalign_arg);
     if(output_it->tellp() > 1024)
       ++output_it;
   };
   aligner->thread_align_file(*parser, print_function);
+  if(sort_buffer)
+    sort_buffer->done();
   output_it.done();
 }
 
 void query_long(mummer::nucmer::FileAligner* aligner, sequence_parser* parser,
                 thread_pipe::ostream_buffered* printer, const nucmer_cmdline* args) {
-  auto output_it = printer->begin();
+  thread_pipe::filtered_iterator output_it(printer->begin(), output_filter(args), BGZF_CHUNK);
   auto print_function = [&](std::vector<mummer::postnuc::Alignment>&& als,
                             const mummer::nucmer::FastaRecordPtr& Af, const mummer::nucmer::FastaRecordSeq& Bf) {
-    mummer::postnuc::printDeltaAlignments(als, Af.Id(), Af.len(), Bf.Id(), Bf.len(), *output_it, args->minalign_arg);
+    if(args->binary_flag)
+      mummer::postnuc::printBinaryDeltaAlignments(als, Af.Id(), Af.len(), Bf.Id(), Bf.len(), *output_it, args->minalign_arg);
+    else if(args->paf_given)
+      mummer::postnuc::printPAFAlignments(als, Af.Id(), Af.len(), Bf.Id(), Bf.len(), *output_it, args->paf_cigar_flag, args->minalign_arg);
+    else
+      mummer::postnuc::printDeltaAlignments(als, Af.Id(), Af.len(), Bf.Id(), Bf.len(), *output_it, args->minalign_arg);
     if(output_it->tellp() > 1024)
       ++output_it;
   };
@@ -84,6 +192,8 @@ int main(int argc, char *argv[]) {
   if(args.noextend_flag) opts.noextend();
   if(args.nooptimize_flag) opts.nooptimize();
   if(args.nosimplify_flag) opts.nosimplify();
+  if(args.wavefront_flag) opts.wavefront();
+  if(args.bitsearch_flag) opts.bitsearch();
   if(args.forward_flag) opts.forward();
   if(args.reverse_flag) opts.reverse();
   if(args.mum_flag) opts.mum();
@@ -93,49 +203,121 @@ int main(int argc, char *argv[]) {
     args.delta_given ? args.delta_arg
     : (args.sam_short_given ? args.sam_short_arg
        : (args.sam_long_given ? args.sam_long_arg
-          : args.prefix_arg + ".delta"));
+          : (args.bam_given ? args.bam_arg
+             : (args.paf_given ? args.paf_arg
+                : args.prefix_arg + (args.compress_flag ? ".delta.gz" : ".delta")))));
+  const bool sam = args.sam_short_given || args.sam_long_given;
+  const bool bam = args.bam_given;
+  if(args.sort_flag && !sam && !bam)
+    nucmer_cmdline::error() << "Sorting is only supported with the SAM and BAM output formats";
+  if(args.paf_cigar_flag && !args.paf_given)
+    nucmer_cmdline::error() << "The CIGAR tag is only supported with the PAF output format";
+  if((bam || args.compress_flag) && !mummer::bgzf::available())
+    nucmer_cmdline::error() << "Compressed output is not supported: compiled without zlib";
+  const unsigned int nb_threads = args.threads_given ? args.threads_arg : 2;
+  // In genome mode, a single query is aligned at a time: its syntenys
+  // are extended with all the threads.
+  if(args.genome_flag) opts.extendthreads(nb_threads);
   std::ofstream os;
+  // BAM and compressed output, in BGZF blocks. The threads compress their
+  // own output, the rest goes through bgzf_out.
+  std::unique_ptr<mummer::bgzf::writer> bgzf_out;
+  if(bam || args.compress_flag)
+    bgzf_out.reset(new mummer::bgzf::writer(os, nb_threads));
+  auto write_output = [&](const char* data, size_t len) {
+    if(bgzf_out)
+      bgzf_out->write(data, len);
+    else
+      os.write(data, len);
+  };
+  auto write_header = [&](const std::string& header) {
+    write_output(header.data(), header.size());
+    if(bgzf_out)
+      bgzf_out->flush(); // Before the blocks of the threads
+  };
   if(!args.qry_arg.empty()) {
-    if(args.qry_arg.size() != 1 && !(args.sam_short_given || args.sam_long_given))
-      nucmer_cmdline::error() << "Multiple query file is only supported with the SAM output format";
+    if(args.qry_arg.size() != 1 && !sam && !bam && !args.paf_given)
+      nucmer_cmdline::error() << "Multiple query file is only supported with the SAM, BAM and PAF output formats";
     os.open(output_file);
     if(!os.good())
       nucmer_cmdline::error() << "Failed to open output file '" << output_file << '\'';
 
     getrealpath real_ref(args.ref_arg), real_qry(args.qry_arg[0]);
-    if(args.sam_short_given || args.sam_long_given) {
-      os << "@HD VN1.0 SO:unsorted\n"
-         << "@PG ID:nucmer PN:nucmer VN:4.0 CL:\"" << cmdline << "\"\n";
+    std::ostringstream header;
+    if(args.sort_flag || bam || args.paf_given) {
+      // The SAM/BAM header, with the @SQ lines, is written once the
+      // references are known. PAF has no header.
+    } else if(sam) {
+      header << "@HD VN1.0 SO:unsorted\n"
+             << "@PG ID:nucmer PN:nucmer VN:4.0 CL:\"" << cmdline << "\"\n";
+    } else if(args.binary_flag) {
+      mummer::delta_binary::write_header(header, (const char*)real_ref, (const char*)real_qry, "NUCMER");
     } else {
-      os << real_ref << ' ' << real_qry << '\n'
-         << "NUCMER\n";
+      header << real_ref << ' ' << real_qry << '\n'
+             << "NUCMER\n";
     }
+    write_header(header.str());
   }
   thread_pipe::ostream_buffered output(os);
 
   std::unique_ptr<mummer::nucmer::FileAligner> aligner;
-  std::ifstream reference;
+  mummer::compressed::ifstream reference;
 
   if(args.load_given) {
-    mummer::nucmer::sequence_info reference_info(args.ref_arg);
-    mummer::mummer::sparseSA SA(reference_info.sequence, args.load_arg);
-    aligner.reset(new mummer::nucmer::FileAligner(std::move(reference_info), std::move(SA), opts));
+    std::unique_ptr<mummer::nucmer::sequence_info> reference_info;
+    try {
+      reference_info.reset(new mummer::nucmer::sequence_info(args.ref_arg));
+    } catch(const std::runtime_error& e) {
+      nucmer_cmdline::error() << "Failed to load reference file '" << args.ref_arg << "': " << e.what();
+    }
+    mummer::mummer::sparseSA SA(reference_info->sequence, args.load_arg);
+    aligner.reset(new mummer::nucmer::FileAligner(std::move(*reference_info), std::move(SA), opts));
   } else {
-    reference.open(args.ref_arg);
+    // The reference is read while no alignment thread runs, unless by
+    // batch, in parallel with the alignment of the previous batch.
+    try {
+      reference.open(args.ref_arg, std::ios::in, args.batch_given ? 1 : nb_threads);
+    } catch(const std::runtime_error& e) {
+      nucmer_cmdline::error() << "Failed to open reference file '" << args.ref_arg << "': " << e.what();
+    }
     if(!reference.good())
       nucmer_cmdline::error() << "Failed to open reference file '" << args.ref_arg << "'";
   }
 
-  const size_t batch_size = args.batch_given ? args.batch_arg : std::numeric_limits<size_t>::max();
+  const size_t       batch_size = args.batch_given ? args.batch_arg : std::numeric_limits<size_t>::max();
+  // SAM/BAM records sorted by reference coordinate, with the references
+  // (name and length) of all the batches
+  std::unique_ptr<mummer::external_sort::sorter> sorter;
+  reference_list                                 references;
+  if(args.sort_flag)
+    sorter.reset(new mummer::external_sort::sorter(args.sort_memory_arg, nb_threads));
+  // Unsorted BAM records follow the header, which lists all the
+  // references: read them all first when aligning by batch.
+  const bool bam_header_first = bam && !sorter;
+  const bool references_known = bam_header_first && args.batch_given && !args.load_given;
+  if(references_known)
+    scan_references(args.ref_arg, batch_size, nb_threads, references);
+
+  size_t ref_offset = 0;
   do {
-    if(!args.load_given)
+    if(!args.load_given) {
       aligner.reset(new mummer::nucmer::FileAligner(reference, batch_size,  opts));
+      if(reference.bad())
+        nucmer_cmdline::error() << "Failed to read reference file '" << args.ref_arg << "'";
+    }
+
+    if((sorter || bam) && !references_known)
+      add_references(aligner->reference_info(), references);
+    if(bam_header_first && ref_offset == 0 && !args.qry_arg.empty()) {
+      std::string header;
+      mummer::bam::append_header(header, sam_header("unsorted", references, cmdline), references);
+      write_header(header);
+    }
 
     if(args.save_given && !aligner->sa().save(args.save_arg))
       nucmer_cmdline::error() << "Can't save the suffix array to '" << args.save_arg << "'";
 
     stream_manager     streams(args.qry_arg.cbegin(), args.qry_arg.cend());
-    const unsigned int nb_threads = args.threads_given ? args.threads_arg : 2;
 #ifdef _OPENMP
     if(args.threads_given) omp_set_num_threads(nb_threads);
 #endif // _OPENMP
@@ -146,24 +328,45 @@ int main(int argc, char *argv[]) {
 #ifdef _OPENMP
 #pragma omp parallel
       {
-        query_thread(aligner.get(), &parser, &output, &args);
+        query_thread(aligner.get(), &parser, &output, &args, sorter.get(), ref_offset);
       }
 #else // _OPENMP
       std::vector<std::thread> threads;
       for(unsigned int i = 0; i < nb_threads; ++i)
-        threads.push_back(std::thread(query_thread, aligner.get(), &parser, &output, &args));
+        threads.push_back(std::thread(query_thread, aligner.get(), &parser, &output, &args, sorter.get(), ref_offset));
 
       for(auto& th : threads)
         th.join();
 #endif // _OPENMP
+      check_queries(parser);
     } else {
       // Genome flag on
       sequence_parser    parser(4, 1, 1, streams);
       query_long(aligner.get(), &parser, &output, &args);
+      check_queries(parser);
     }
+    ref_offset += aligner->reference_info().records.size() - 1;
   } while(!args.load_given && reference.peek() != EOF);
   output.close();
+
+  if(sorter && !args.qry_arg.empty()) {
+    std::string header = sam_header("coordinate", references, cmdline);
+    if(bam) {
+      std::string bam_header;
+      mummer::bam::append_header(bam_header, header, references);
+      header.swap(bam_header);
+    }
+    write_output(header.data(), header.size());
+    sorter->merge([&write_output](uint64_t, const char* record, size_t len) { write_output(record, len); });
+  }
+  if(bgzf_out && !args.qry_arg.empty())
+    bgzf_out->close();
   os.close();
 
+  // The records are written in parallel: index them once complete. This
+  // fails, harmlessly, if the output is not a regular file.
+  if(args.binary_flag && !args.qry_arg.empty())
+    mummer::delta_binary::append_index(output_file);
+
   return 0;
 }
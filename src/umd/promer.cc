@@ -0,0 +1,162 @@
+#include <fstream>
+#include <stdexcept>
+#include <mummer/promer.hpp>
+#include <mummer/sparseSA.hpp>
+#include <mummer/mgaps.hh>
+#include <mummer/postpro.hh>
+
+
+namespace mummer {
+namespace promer {
+
+std::vector<postpro::FastaRecord> read_records(std::istream& is) {
+  std::vector<postpro::FastaRecord> res;
+  do {
+    res.push_back(postpro::FastaRecord());
+  } while(res.back().read(is));
+  res.pop_back();
+  return res;
+}
+
+std::vector<postpro::FastaRecord> read_records(const char* path) {
+  std::ifstream is(path);
+  if(!is.good())
+    throw std::runtime_error(std::string("Unable to open '") + path + "'");
+  return read_records(is);
+}
+
+std::string translate_references(const std::vector<postpro::FastaRecord>& references, long mask_len) {
+  // The records are translated independently, then concatenated in
+  // order.
+  const long                nb_records = references.size();
+  std::vector<std::string>  frames(6 * nb_records);
+#pragma omp parallel for schedule(dynamic)
+  for(long i = 0; i < nb_records; ++i)
+    postpro::appendMaskedFrames(references[i], REFERENCE_MASK, mask_len, frames.data() + 6 * i);
+
+  std::string res;
+  size_t      len = 0;
+  for(const auto& f : frames)
+    len += f.size();
+  res.reserve(len);
+  for(auto& f : frames) {
+    res += f;
+    std::string().swap(f);
+  }
+  return res;
+}
+
+void ProteinAligner::frameClusters(const postpro::FastaRecord& query, int frameB,
+                                   mgaps::UnionFind& UF, mgaps::clusters_type& clusters) const {
+  std::string P;
+  postpro::appendMaskedFrame(query, frameB, QUERY_MASK, m_options.mask_len, P);
+  frameClusters(P, UF, clusters);
+}
+
+void ProteinAligner::frameClusters(const std::string& P, mgaps::UnionFind& UF,
+                                   mgaps::clusters_type& clusters) const {
+  std::vector<mgaps::Match_t> matches(1);
+  auto append_matches = [&](const mummer::match_t& m) { matches.push_back({ m.ref + 1, m.query + 1, m.len }); };
+  switch(m_options.match) {
+  case MUM: m_sa.findMUM_each(P, m_options.min_len, false, append_matches); break;
+  case MUMREFERENCE: m_sa.findMAM_each(P, m_options.min_len, false, append_matches); break;
+  case MAXMATCH: m_sa.findMEM_each(P, m_options.min_len, false, append_matches); break;
+  }
+  m_clusterer.Process_Matches(matches.data(), UF, matches.size() - 1, clusters);
+}
+
+// Feed the clusters of the six frames of the query to the synteny
+// builder, in the order and coordinates printed by mgaps.
+static void build_syntenys(const std::vector<postpro::FastaRecord>& references,
+                           const postpro::FastaRecord& query, const mgaps::clusters_type* frames,
+                           std::vector<postpro::Synteny>& res) {
+  postpro::synteny_builder builder(references, [&](std::vector<postpro::Synteny>& s) {
+      for(auto& sp : s)
+        res.push_back(std::move(sp));
+    });
+  for(int f = 0; f < 6; ++f) {
+    builder.header(query.Id(), f + 1);
+    for(const auto& cl : frames[f]) {
+      builder.cluster();
+      builder.match(cl[0].Start1, cl[0].Start2, cl[0].Len);
+      for(size_t i = 1; i < cl.size(); ++i) {
+        const long int adj = cl[i].Simple_Adj;
+        builder.match(cl[i].Start1 + adj, cl[i].Start2 + adj, cl[i].Len - adj);
+      }
+    }
+  }
+  builder.finish();
+}
+
+void ProteinAligner::align(const postpro::FastaRecord& query, QueryAlignments& res) const {
+  mgaps::UnionFind     UF;
+  std::string          P[6];
+  mgaps::clusters_type frames[6];
+  postpro::appendMaskedFrames(query, QUERY_MASK, m_options.mask_len, P);
+  for(int f = 0; f < 6; ++f)
+    frameClusters(P[f], UF, frames[f]);
+
+  res.syntenys.clear();
+  build_syntenys(m_references, query, frames, res.syntenys);
+  res.alignments.clear();
+  res.alignments.resize(res.syntenys.size());
+  for(size_t j = 0; j < res.syntenys.size(); ++j) {
+    auto& Sp = res.syntenys[j];
+    if(Sp.clusters.empty()) continue;
+    Sp.lenB = query.len();
+    m_merger.extendClusters(Sp.clusters, *Sp.AfP, query, res.alignments[j]);
+  }
+}
+
+void ProteinAligner::align_batch(const std::vector<postpro::FastaRecord>& queries,
+                                 std::vector<QueryAlignments>& res) const {
+  const long nb_queries = queries.size();
+  res.clear();
+  res.resize(nb_queries);
+
+  // Translate the queries, then find and cluster the matches of
+  // every frame of every query
+  std::vector<std::string>          translations(6 * nb_queries);
+  std::vector<mgaps::clusters_type> frames(6 * nb_queries);
+#pragma omp parallel
+  {
+#pragma omp for schedule(dynamic)
+    for(long i = 0; i < nb_queries; ++i)
+      postpro::appendMaskedFrames(queries[i], QUERY_MASK, m_options.mask_len, translations.data() + 6 * i);
+
+    mgaps::UnionFind UF;
+#pragma omp for schedule(dynamic)
+    for(long i = 0; i < 6 * nb_queries; ++i) {
+      frameClusters(translations[i], UF, frames[i]);
+      std::string().swap(translations[i]);
+    }
+  }
+
+  // Group the clusters in syntenys, and list the syntenys to extend
+  std::vector<std::pair<long, size_t> > to_extend;
+  for(long i = 0; i < nb_queries; ++i) {
+    build_syntenys(m_references, queries[i], frames.data() + 6 * i, res[i].syntenys);
+    for(int f = 0; f < 6; ++f)
+      mgaps::clusters_type().swap(frames[6 * i + f]);
+    res[i].alignments.resize(res[i].syntenys.size());
+    for(size_t j = 0; j < res[i].syntenys.size(); ++j) {
+      auto& Sp = res[i].syntenys[j];
+      if(Sp.clusters.empty()) continue;
+      Sp.lenB = queries[i].len();
+      to_extend.push_back(std::make_pair(i, j));
+    }
+  }
+
+  // Extend the clusters of every synteny
+  const long nb_extend = to_extend.size();
+#pragma omp parallel for schedule(dynamic)
+  for(long k = 0; k < nb_extend; ++k) {
+    const long   i  = to_extend[k].first;
+    const size_t j  = to_extend[k].second;
+    auto&        Sp = res[i].syntenys[j];
+    m_merger.extendClusters(Sp.clusters, *Sp.AfP, queries[i], res[i].alignments[j]);
+  }
+}
+
+} // namespace promer
+} // namespace mummer
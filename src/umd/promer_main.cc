@@ -0,0 +1,66 @@
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <mummer/promer.hpp>
+#include <src/umd/promer_cmdline.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+int main(int argc, char *argv[]) {
+  std::ios::sync_with_stdio(false);
+
+  promer_cmdline args(argc, argv);
+  mummer::promer::Options opts;
+  opts.breaklen(args.breaklen_arg)
+    .mincluster(args.mincluster_arg)
+    .diagfactor(args.diagfactor_arg)
+    .maxgap(args.maxgap_arg)
+    .minmatch(args.minmatch_arg)
+    .masklen(args.masklen_arg);
+  if(args.matrix_arg < 1 || args.matrix_arg > 3)
+    promer_cmdline::error() << "Invalid matrix type " << args.matrix_arg;
+  opts.matrix(args.matrix_arg);
+  if(args.noextend_flag) opts.noextend();
+  if(args.nodelta_flag) opts.nodelta();
+  if(args.nooptimize_flag) opts.nooptimize();
+  if(args.mum_flag) opts.mum();
+  if(args.maxmatch_flag) opts.maxmatch();
+#ifdef _OPENMP
+  if(args.threads_given) omp_set_num_threads(args.threads_arg);
+#endif // _OPENMP
+
+  std::ifstream query(args.qry_arg);
+  if(!query.good())
+    promer_cmdline::error() << "Failed to open query file '" << args.qry_arg << "'";
+  const std::string output_file = args.prefix_arg + (args.nodelta_flag ? ".cluster" : ".delta");
+  std::ofstream os(output_file);
+  if(!os.good())
+    promer_cmdline::error() << "Failed to open output file '" << output_file << '\'';
+  os << args.ref_arg << ' ' << args.qry_arg << "\nPROMER\n";
+
+  std::unique_ptr<mummer::promer::ProteinAligner> aligner;
+  try {
+    aligner.reset(new mummer::promer::ProteinAligner(args.ref_arg, opts));
+  } catch(std::runtime_error& e) {
+    promer_cmdline::error() << e.what();
+  }
+  if(aligner->references().empty())
+    promer_cmdline::error() << "No sequence in reference file '" << args.ref_arg << "'";
+
+  auto print_delta = [&](std::vector<mummer::postpro::Alignment>&& als,
+                         const mummer::postpro::FastaRecord& Af, const mummer::postpro::FastaRecord& Bf) {
+    mummer::postpro::printDeltaAlignments(als, Af, Bf, os);
+  };
+  auto print_syntenys = [&](const std::vector<mummer::postpro::Synteny>& syntenys,
+                            const mummer::postpro::FastaRecord& Bf) {
+    if(args.nodelta_flag)
+      mummer::postpro::printSyntenys(syntenys, os);
+  };
+  aligner->align_file(query, print_delta, print_syntenys);
+  os.close();
+
+  return 0;
+}
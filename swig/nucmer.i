@@ -41,6 +41,10 @@ struct Options {
   mummer::nucmer::Options& breaklen(long l);
   mummer::nucmer::Options& banded();
   mummer::nucmer::Options& nobanded();
+  mummer::nucmer::Options& wavefront();
+  mummer::nucmer::Options& nowavefront();
+  mummer::nucmer::Options& bitsearch();
+  mummer::nucmer::Options& nobitsearch();
   mummer::nucmer::Options& mincluster(long m);
   mummer::nucmer::Options& diagdiff(long d);
   mummer::nucmer::Options& diagfactor(double f);
@@ -74,6 +78,7 @@ struct Options {
   bool do_shadows;
   int  break_len;
   int  banding;
+  int  engine;
 };
 %apply (const char* STRING, size_t LENGTH) { (const char* reference, size_t reference_len) };
 %apply (const char* STRING, size_t LENGTH) { (const char* query, size_t query_len) };
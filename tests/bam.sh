@@ -0,0 +1,26 @@
+# The BAM output decodes to the long SAM output, with the references in
+# the header. The sequences are upper case in BAM.
+nucmer -t 2 --sam-long aln.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 2 --bam aln.bam $D/seed_reads_1.fa $D/seed_reads_0.fa
+bam2sam aln.bam > aln.bam.sam
+test $(grep -c '^@SQ' aln.bam.sam) = $(grep -c '^>' $D/seed_reads_1.fa)
+upper_seq() { grep -v '^@' "$1" | awk -F '\t' '{ $10 = toupper($10); print }' OFS='\t' | sort; }
+cmp <(upper_seq aln.sam) <(upper_seq aln.bam.sam)
+
+# By batch, the references of all the batches are in the header
+nucmer -t 2 --batch 10000 --bam batch.bam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 2 --batch 10000 --sam-long batch.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+bam2sam batch.bam > batch.bam.sam
+cmp <(grep '^@SQ' aln.bam.sam) <(grep '^@SQ' batch.bam.sam)
+cmp <(upper_seq batch.sam) <(upper_seq batch.bam.sam)
+
+# Sorted BAM: same records as the sorted SAM, whatever the number of
+# threads or memory
+nucmer -t 1 --sort --sam-long sorted.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 1 --sort --bam sorted1.bam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 4 --sort --sort-memory 1k --bam sorted4.bam $D/seed_reads_1.fa $D/seed_reads_0.fa
+bam2sam sorted1.bam > sorted1.bam.sam
+bam2sam sorted4.bam > sorted4.bam.sam
+head -n 1 sorted1.bam.sam | grep -q 'SO:coordinate'
+cmp <(grep -v '^@PG' sorted1.bam.sam) <(grep -v '^@PG' sorted4.bam.sam)
+cmp <(grep -v '^@' sorted.sam | awk -F '\t' '{ print $3, $4 }') <(grep -v '^@' sorted1.bam.sam | awk -F '\t' '{ print $3, $4 }')
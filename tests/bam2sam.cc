@@ -0,0 +1,146 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <zlib.h>
+#include "bam2sam_cmdline.hpp"
+
+static const char EOF_BLOCK[28] = {
+  '\x1f', '\x8b', '\x08', '\x04', 0, 0, 0, 0, 0, '\xff', '\x06', 0, 'B', 'C', '\x02', 0,
+  '\x1b', 0, '\x03', 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+uint32_t get_le(const char* p, int bytes) {
+  uint32_t res = 0;
+  for(int i = bytes - 1; i >= 0; --i)
+    res = res << 8 | (uint8_t)p[i];
+  return res;
+}
+
+// Decompress the BGZF blocks, checking their size field and the end of
+// file block. zlib checks the CRC of each block.
+std::string read_bgzf(const char* path) {
+  std::ifstream is(path, std::ios::binary);
+  const std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+  if(data.size() < sizeof(EOF_BLOCK) || memcmp(data.data() + data.size() - sizeof(EOF_BLOCK), EOF_BLOCK, sizeof(EOF_BLOCK)))
+    bam2sam_cmdline::error() << "Missing BGZF end of file block";
+
+  std::string res;
+  size_t      off = 0;
+  while(off < data.size()) {
+    const char* block = data.data() + off;
+    if(data.size() - off < 18 || memcmp(block, "\x1f\x8b\x08\x04", 4) || block[12] != 'B' || block[13] != 'C')
+      bam2sam_cmdline::error() << "Invalid BGZF block header at offset " << off;
+    const size_t block_len = get_le(block + 16, 2) + 1;
+    const size_t isize     = get_le(block + block_len - 4, 4);
+    if(isize > 0x10000)
+      bam2sam_cmdline::error() << "BGZF block too large at offset " << off;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    inflateInit2(&zs, 15 + 16);
+    const size_t start = res.size();
+    res.resize(start + isize + 1);
+    zs.next_in   = (Bytef*)block;
+    zs.avail_in  = block_len;
+    zs.next_out  = (Bytef*)&res[start];
+    zs.avail_out = isize + 1;
+    const int ret = inflate(&zs, Z_FINISH);
+    if(ret != Z_STREAM_END || zs.total_out != isize || zs.avail_in != 0)
+      bam2sam_cmdline::error() << "Invalid BGZF block at offset " << off;
+    inflateEnd(&zs);
+    res.resize(start + isize);
+    off += block_len;
+  }
+  return res;
+}
+
+int reg2bin(int64_t beg, int64_t end) {
+  --end;
+  if(beg >> 14 == end >> 14) return ((1 << 15) - 1) / 7 + (beg >> 14);
+  if(beg >> 17 == end >> 17) return ((1 << 12) - 1) / 7 + (beg >> 17);
+  if(beg >> 20 == end >> 20) return ((1 << 9) - 1) / 7 + (beg >> 20);
+  if(beg >> 23 == end >> 23) return ((1 << 6) - 1) / 7 + (beg >> 23);
+  if(beg >> 26 == end >> 26) return ((1 << 3) - 1) / 7 + (beg >> 26);
+  return 0;
+}
+
+// Print the header and the records in the format of nucmer's SAM
+// output. The sequence is printed in upper case.
+int main(int argc, char *argv[]) {
+  bam2sam_cmdline args(argc, argv);
+  const std::string data = read_bgzf(args.bam_arg);
+  const char*       p    = data.data();
+  const char* const end  = p + data.size();
+
+  if(data.size() < 12 || memcmp(p, "BAM\1", 4))
+    bam2sam_cmdline::error() << "Invalid BAM magic";
+  const uint32_t l_text = get_le(p + 4, 4);
+  std::cout.write(p + 8, l_text);
+  p += 8 + l_text;
+  const uint32_t n_ref = get_le(p, 4);
+  p += 4;
+  std::vector<std::string> names;
+  for(uint32_t i = 0; i < n_ref; ++i) {
+    const uint32_t l_name = get_le(p, 4);
+    names.push_back(std::string(p + 4, l_name - 1));
+    p += 4 + l_name + 4;
+  }
+
+  static const char ops[]   = "MIDNSHP=X";
+  static const char bases[] = "=ACMGRSVTWYHKDBN";
+  while(p < end) {
+    const uint32_t    block_size = get_le(p, 4);
+    const char*       r          = p + 4;
+    const char* const r_end      = r + block_size;
+    if(r_end > end)
+      bam2sam_cmdline::error() << "Truncated BAM record";
+    const int32_t  ref_id   = get_le(r, 4);
+    const int32_t  pos      = get_le(r + 4, 4);
+    const uint8_t  l_name   = r[8];
+    const uint8_t  mapq     = r[9];
+    const uint16_t bin      = get_le(r + 10, 2);
+    const uint16_t n_cigar  = get_le(r + 12, 2);
+    const uint16_t flag     = get_le(r + 14, 2);
+    const uint32_t l_seq    = get_le(r + 16, 4);
+    if(ref_id < 0 || (uint32_t)ref_id >= n_ref)
+      bam2sam_cmdline::error() << "Invalid reference id " << ref_id;
+    r += 32;
+    const std::string qname(r, l_name - 1);
+    r += l_name;
+    std::ostringstream cigar;
+    int64_t            span = 0;
+    for(uint16_t i = 0; i < n_cigar; ++i, r += 4) {
+      const uint32_t op = get_le(r, 4);
+      cigar << (op >> 4) << ops[op & 0xf];
+      if(strchr("MDN=X", ops[op & 0xf])) span += op >> 4;
+    }
+    if(bin != reg2bin(pos, pos + std::max(span, (int64_t)1)))
+      bam2sam_cmdline::error() << "Invalid bin for " << qname;
+    std::string seq;
+    for(uint32_t i = 0; i < l_seq; ++i)
+      seq += bases[i % 2 ? r[i / 2] & 0xf : (uint8_t)r[i / 2] >> 4];
+    r += (l_seq + 1) / 2 + l_seq;
+
+    std::cout << qname << '\t' << flag << '\t' << names[ref_id] << '\t' << (pos + 1)
+              << '\t' << (int)mapq << '\t' << cigar.str() << "\t*\t0\t0\t"
+              << (l_seq ? seq : "*") << "\t*";
+    while(r < r_end) { // Tags
+      const std::string tag(r, 2);
+      const char        type = r[2];
+      r += 3;
+      switch(type) {
+      case 'i': std::cout << '\t' << tag << ":i:" << (int32_t)get_le(r, 4); r += 4; break;
+      case 'Z': std::cout << '\t' << tag << ":Z:" << r; r += strlen(r) + 1; break;
+      default: bam2sam_cmdline::error() << "Unexpected tag type " << type;
+      }
+    }
+    std::cout << '\n';
+    p = r_end;
+  }
+
+  return 0;
+}
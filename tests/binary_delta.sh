@@ -0,0 +1,18 @@
+# The binary delta format holds the same information as the text
+# format: converting in either direction is lossless and the show-*
+# utilities give the same output on both.
+nucmer -t 1 --delta text.delta $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 1 --binary --delta binary.delta $D/seed_reads_1.fa $D/seed_reads_0.fa
+
+delta-convert -o binary.txt.delta binary.delta
+cmp text.delta binary.txt.delta
+delta-convert -o text.bin.delta text.delta
+cmp binary.delta text.bin.delta
+
+cmp <(show-coords -H -T text.delta) <(show-coords -H -T binary.delta)
+cmp <(show-coords -H -T text.delta) <(show-coords -H -T <(cat binary.delta))
+cmp <(delta-filter -1 text.delta | tail -n +3) <(delta-filter -1 binary.delta | tail -n +3)
+
+# Seek to the last pair of sequences with the index
+IDS=$(grep '^>' text.delta | tail -n 1 | sed 's/^>\([^ ]*\) \([^ ]*\).*/\1 \2/')
+cmp <(show-aligns text.delta $IDS) <(show-aligns binary.delta $IDS)
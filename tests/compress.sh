@@ -0,0 +1,65 @@
+# Compressed output decompresses to the plain output, and is read
+# transparently by the delta tools.
+nucmer -t 2 --delta aln.delta $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 2 --compress --delta aln.delta.gz $D/seed_reads_1.fa $D/seed_reads_0.fa
+gzip -t aln.delta.gz
+cmp <(gzip -dc aln.delta.gz | sort) <(sort aln.delta)
+
+# Same order of the alignments as in the compressed file
+gzip -dc aln.delta.gz > aln.delta
+
+show-coords -H aln.delta > coords.txt
+show-coords -H aln.delta.gz > coords_gz.txt
+cmp coords.txt coords_gz.txt
+
+delta-filter -q aln.delta > filter.delta
+delta-filter -q aln.delta.gz > filter_gz.delta
+cmp filter.delta filter_gz.delta
+
+# Plain gzip, with multiple members
+(head -n 100 aln.delta | gzip -c; tail -n +101 aln.delta | gzip -c) > plain.delta.gz
+show-coords -H plain.delta.gz > coords_plain.txt
+cmp coords.txt coords_plain.txt
+
+# Compressed SAM, unsorted and sorted
+nucmer -t 2 --sam-long aln.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 2 --compress --sam-long aln.sam.gz $D/seed_reads_1.fa $D/seed_reads_0.fa
+cmp <(gzip -dc aln.sam.gz | grep -v '^@PG' | sort) <(grep -v '^@PG' aln.sam | sort)
+nucmer -t 2 --sort --sam-long sorted.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 2 --sort --compress --sam-long sorted.sam.gz $D/seed_reads_1.fa $D/seed_reads_0.fa
+cmp <(gzip -dc sorted.sam.gz | grep -v '^@PG') <(grep -v '^@PG' sorted.sam)
+
+# Compressed reference and queries, the queries split in many gzip
+# members: same alignments
+nucmer -t 2 --sort --sam-long sorted_gz.sam <(gzip -c $D/seed_reads_1.fa) \
+       <(head -n 1000 $D/seed_reads_0.fa | gzip -c; tail -n +1001 $D/seed_reads_0.fa | gzip -c)
+cmp <(grep -v '^@PG' sorted_gz.sam) <(grep -v '^@PG' sorted.sam)
+
+# The tools reloading the sequences named in the delta header read the
+# compressed FASTA files
+gzip -c $D/seed_reads_1.fa > ref.fa.gz
+gzip -c $D/seed_reads_0.fa > qry.fa.gz
+nucmer -t 1 -p plain $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 1 -p gz ref.fa.gz qry.fa.gz
+[ ! -e ref.fa.gz.fai ]
+cmp <(show-snps -rlTHC plain.delta) <(show-snps -rlTHC gz.delta)
+read ref qry < <(show-coords -HT plain.delta | head -n 1 | cut -f 8,9)
+cmp <(show-aligns plain.delta $ref $qry | tail -n +3) <(show-aligns gz.delta $ref $qry | tail -n +3)
+
+dnadiff -p ddplain $D/seed_reads_1.fa $D/seed_reads_0.fa
+dnadiff -p ddgz ref.fa.gz qry.fa.gz
+for e in 1coords mcoords snps rdiff qdiff; do
+    cmp ddplain.$e ddgz.$e
+done
+cmp <(tail -n +2 ddplain.report) <(tail -n +2 ddgz.report)
+
+# Truncated compressed inputs are reported
+head -c 5 ref.fa.gz > trunc.fa.gz
+if nucmer -p trunc trunc.fa.gz qry.fa.gz 2> trunc.err; then false; fi
+grep -q "Failed to open reference file 'trunc.fa.gz': Truncated gzip file" trunc.err
+gzip -c gz.delta | head -c 5 > trunc.delta.gz
+if show-coords trunc.delta.gz 2> trunc.err; then false; fi
+grep -q "Truncated gzip file" trunc.err
+gzip -c $D/seed_reads_0.fa | head -c 20000 > trunc_qry.fa.gz
+if nucmer -t 2 -p trunc_qry $D/seed_reads_1.fa trunc_qry.fa.gz 2> trunc.err; then false; fi
+grep -q "Failed to read query file: Truncated gzip file" trunc.err
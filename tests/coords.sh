@@ -0,0 +1,15 @@
+# Sorted coordinates spilled to disk (tiny -M) are the same as sorted in
+# memory, and the output does not depend on the number of threads.
+nucmer -t 1 --delta coords.delta $D/seed_reads_1.fa $D/seed_reads_0.fa
+
+for o in -r -qclT -rdHw -qo; do
+    show-coords $o coords.delta > mem.txt
+    show-coords -M 512 $o coords.delta > disk.txt
+    cmp mem.txt disk.txt
+done
+test $(show-coords -H coords.delta | wc -l) -gt 64
+
+cmp <(show-coords -t 1 -clT coords.delta) <(show-coords -t 4 -clT coords.delta)
+
+IDS=$(grep '^>' coords.delta | head -n 1 | sed 's/^>\([^ ]*\) \([^ ]*\) .*/\1 \2/')
+cmp <(show-aligns -t 1 -r coords.delta $IDS) <(show-aligns -t 4 -r coords.delta $IDS)
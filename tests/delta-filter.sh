@@ -8,3 +8,10 @@ delta-filter -i 95 ori.delta > filter_i95.delta
 cmp <(show-coords -H -T -I 95 ori.delta) <(show-coords -H -T filter_i95.delta)
 delta-filter -l 95 ori.delta > filter_l95.delta
 cmp <(show-coords -H -T -L 95 ori.delta) <(show-coords -H -T filter_l95.delta)
+
+# Same result when the delta file is not mapped in memory
+cmp <(delta-filter -1 ori.delta) <(delta-filter -1 <(cat ori.delta))
+
+# Same result with several threads
+cmp <(delta-filter -1 ori.delta) <(delta-filter -t 4 -1 ori.delta)
+cmp <(delta-filter -m -u 50 ori.delta) <(delta-filter -t 4 -m -u 50 ori.delta)
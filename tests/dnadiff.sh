@@ -0,0 +1,16 @@
+dnadiff -p dd $D/seed_reads_1.fa $D/seed_reads_0.fa
+
+# Same outputs as the individual tools
+cmp <(delta-filter -1 dd.delta) dd.1delta
+cmp <(delta-filter -m dd.delta) dd.mdelta
+cmp <(show-coords -rclTH dd.1delta) dd.1coords
+cmp <(show-coords -rclTH dd.mdelta) dd.mcoords
+cmp <(show-snps -rlTHC dd.1delta) dd.snps
+cmp <(show-diff -rH dd.mdelta) dd.rdiff
+cmp <(show-diff -qH dd.mdelta) dd.qdiff
+
+# Same outputs from the precomputed delta file
+dnadiff -p pre -d dd.delta
+for e in report 1delta mdelta 1coords mcoords snps rdiff qdiff; do
+    cmp dd.$e pre.$e
+done
@@ -0,0 +1,34 @@
+# The dot plot bins the alignments: the plot data depends only on the
+# plotted alignments, and all outputs are written.
+nucmer -t 1 --delta dp.delta $D/seed_reads_1.fa $D/seed_reads_0.fa
+delta-filter -q -r dp.delta > dp.filter.delta
+delta-convert -o dp.bin.delta dp.delta
+
+dotplot -t gnuplot -p all dp.delta
+dotplot -t gnuplot -p bin dp.bin.delta
+
+# Same sequences on the axes, even without alignments after filtering
+grep '^>' dp.delta | awk '!seen[$1]++ { print substr($1, 2), $3 }' > ref.ids
+grep '^>' dp.delta | awk '!seen[$2]++ { print $2, $4 }' > qry.ids
+dotplot -t gnuplot -p filter -R ref.ids -Q qry.ids -f dp.delta
+dotplot -t gnuplot -p filtered -R ref.ids -Q qry.ids dp.filter.delta
+for e in fplot rplot; do
+    cmp all.$e bin.$e
+    cmp filter.$e filtered.$e
+done
+grep -q '^plot' all.gp
+
+# Highlighted hits are a subset of the plotted ones
+dotplot -t gnuplot -p hlt -b 100 dp.delta
+cmp all.fplot hlt.fplot
+test -s hlt.hplot
+
+# One plot per line of -R, with the lengths of the delta file
+IDR=$(grep '^>' dp.delta | head -n 1 | sed 's/^>\([^ ]*\) .*/\1/')
+dotplot -t gnuplot -p one -r $IDR dp.delta
+grep -q "xlabel \"$IDR\"" one.gp
+
+dotplot -t png -p dp --layout dp.delta
+test "$(head -c 8 dp.png | od -An -tx1 | tr -d ' ')" = 89504e470d0a1a0a
+dotplot -t svg -p dp -c --color dp.delta
+grep -q '</svg>' dp.svg
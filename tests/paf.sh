@@ -0,0 +1,24 @@
+# The PAF records have the coordinates and number of errors of the
+# delta alignments. The block length agrees with the CIGAR.
+nucmer -t 2 --delta aln.delta $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 2 --paf aln.paf --paf-cigar $D/seed_reads_1.fa $D/seed_reads_0.fa
+
+awk '/^>/ { r = substr($1, 2); q = $2; next } NF == 7 { print r, q, $1, $2, $3, $4, $5 }' aln.delta | sort > delta.txt
+awk -F '\t' '{ qs = $5 == "+" ? $3 + 1 : $4; qe = $5 == "+" ? $4 : $3 + 1; print $6, $1, $8 + 1, $9, qs, qe, substr($14, 6) }' aln.paf | sort > paf.txt
+cmp delta.txt paf.txt
+
+awk -F '\t' '{ cg = substr($15, 6); t = 0; q = 0; b = 0
+               while(match(cg, /^[0-9]+[MID]/)) {
+                 n = substr(cg, 1, RLENGTH - 1) + 0; op = substr(cg, RLENGTH, 1); cg = substr(cg, RLENGTH + 1)
+                 b += n; if(op != "I") t += n; if(op != "D") q += n
+               }
+               if(cg != "" || b != $11 || t != $9 - $8 || q != $4 - $3 || $10 > $11) { print "Bad record", NR; exit 1 } }' aln.paf
+
+# Without the cg tag, same records
+nucmer -t 2 --paf short.paf $D/seed_reads_1.fa $D/seed_reads_0.fa
+cmp <(cut -f 1-14 aln.paf | sort) <(sort short.paf)
+
+# The CIGAR tag requires the PAF output
+if nucmer -t 2 --paf-cigar -p nopaf $D/seed_reads_1.fa $D/seed_reads_0.fa 2> nopaf.err; then false; fi
+grep -q "only supported with the PAF output" nopaf.err
+test ! -e nopaf.delta
@@ -0,0 +1,13 @@
+# proalign gives the same delta file as the prepro | mummer | mgaps |
+# postpro pipeline. prepro does not support long headers: remove the
+# comments.
+sed 's/^\(>[^ ]*\) .*/\1/' $D/seed_reads_2.fa > ref.fa
+sed 's/^\(>[^ ]*\) .*/\1/' $D/seed_reads_0.fa > qry.fa
+prepro -m 8 -r ref.fa > ref.aa
+prepro -m 8 -q qry.fa > qry.aa
+mummer -mumreference -l 6 ref.aa qry.aa | mgaps -l 20 -s 30 -f .11 > pipeline.mgaps
+postpro -x 2 -b 60 ref.fa qry.fa pipeline < pipeline.mgaps
+proalign -t 1 -p single ref.fa qry.fa
+proalign -t 4 -p multi ref.fa qry.fa
+diff pipeline.delta single.delta
+diff pipeline.delta multi.delta
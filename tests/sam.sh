@@ -1,2 +1,17 @@
 nucmer --maxmatch --sam-long /dev/stdout $D/seed_reads_1.fa $D/seed_reads_0.fa | check_cigar /dev/stdin $D/seed_reads_1.fa $D/seed_reads_0.fa
 nucmer --sam-long /dev/stdout -l 10 <(echo -e ">101\nggtttatgcgctgttatgtctatggacaaaaaggctacgagaaactgtagccccgttcgctcggacccgcgtcattcgtcggcccagctctacccg") <(echo -e ">21\nggtttatgcgctgttttgtctatggaaaaaaggctacgagaaactgtagccccgttcgctcggtacccgcgtcattcgtcggcccatctctacccg") | tail -n +3 | test_md5 f656b26b59de04e7c94c7c0c0f7e3a0c
+
+# Sorted SAM: the records of the unsorted output, in reference order (the
+# order of the @SQ lines) and position, whatever the number of threads or
+# the memory given to the sort.
+nucmer -t 1 --sort --sam-long sorted1.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 4 --sort --sam-long sorted4.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 4 --sort --sort-memory 1k --sam-long sortedm.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+nucmer -t 4 --sam-long unsorted.sam $D/seed_reads_1.fa $D/seed_reads_0.fa
+cmp <(grep -v '^@PG' sorted1.sam) <(grep -v '^@PG' sorted4.sam)
+cmp <(grep -v '^@PG' sorted1.sam) <(grep -v '^@PG' sortedm.sam)
+head -n 1 sorted1.sam | grep -q 'SO:coordinate'
+test $(grep -c '^@SQ' sorted1.sam) = $(grep -c '^>' $D/seed_reads_1.fa)
+cmp <(grep -v '^@' sorted1.sam) \
+    <(awk -F '\t' 'NR == FNR { if(/^@SQ/) rank[substr($2, 4)] = NR; next } { print rank[$3], $0 }' OFS='\t' sorted1.sam <(grep -v '^@' unsorted.sam) | LC_ALL=C sort -t "$(printf '\t')" -k1,1n -k5,5n -k2 | cut -f 2-)
+grep -v '^@' sorted1.sam | check_cigar /dev/stdin $D/seed_reads_1.fa $D/seed_reads_0.fa
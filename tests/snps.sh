@@ -0,0 +1,13 @@
+# SNPs are found per alignment in parallel: the output does not depend
+# on the number of threads, nor on the selection of the alignments.
+nucmer -t 1 --delta snps.delta $D/seed_reads_1.fa $D/seed_reads_0.fa
+
+show-snps -t 1 -ClrTH -x 3 snps.delta > snps1.txt
+show-snps -t 4 -ClrTH -x 3 snps.delta > snps4.txt
+cmp snps1.txt snps4.txt
+cmp <(show-snps -t 1 -qTH snps.delta) <(show-snps -t 4 -qTH snps.delta)
+
+# Selecting all the alignments gives the same SNPs
+show-coords -THrcl snps.delta | awk -F '\t' '{ print $1, $2, $3, $4, $12, $13 }' OFS='\t' > aligns.txt
+show-snps -S -ClrTH -x 3 snps.delta < aligns.txt > snpsS.txt
+cmp snps1.txt snpsS.txt
@@ -0,0 +1,119 @@
+#include <fstream>
+#include <gtest/gtest.h>
+#include <gtest/test.hpp>
+#include <mummer/fasta_index.hh>
+
+namespace {
+using mummer::fasta_index::indexed_fasta;
+
+struct record {
+  std::string name, seq;
+};
+
+// Write the records with lines of width bases. If irregular, the second
+// line of each record is one base shorter.
+void write_fasta(const char* path, const std::vector<record>& records, size_t width,
+                 const char* eol, bool irregular) {
+  std::ofstream os(path);
+  for(const auto& r : records) {
+    os << '>' << r.name << " some comment" << eol;
+    size_t line = 0;
+    for(size_t i = 0; i < r.seq.size(); ++line) {
+      const size_t w = irregular && line == 1 ? width - 1 : width;
+      os << r.seq.substr(i, w) << eol;
+      i += w;
+    }
+  }
+}
+
+std::string lower(std::string s) {
+  for(auto& c : s) c = tolower(c);
+  return s;
+}
+
+void check_fetch(const indexed_fasta& fasta, const std::vector<record>& records) {
+  std::uniform_int_distribution<size_t> rand_pos(0, 300);
+  for(const auto& r : records) {
+    SCOPED_TRACE(::testing::Message() << "name:" << r.name);
+    std::string seq;
+    ASSERT_TRUE(fasta.fetch(r.name, seq));
+    EXPECT_EQ('\0', seq[0]);
+    EXPECT_EQ(lower(r.seq), seq.substr(1));
+
+    const auto* e = fasta.find(r.name);
+    ASSERT_NE(nullptr, e);
+    for(int i = 0; i < 20; ++i) {
+      const size_t start = rand_pos(rand_gen), len = rand_pos(rand_gen);
+      std::string  region(len, 'X');
+      region.resize(fasta.fetch(*e, start, len, &region[0]));
+      EXPECT_EQ(lower(r.seq.substr(std::min(start, r.seq.size()), len)), region);
+    }
+  }
+  std::string seq;
+  EXPECT_FALSE(fasta.fetch("absent", seq));
+}
+
+TEST(FastaIndex, Fetch) {
+  const char* path = "FastaIndex.fa";
+  const std::string fai_path = std::string(path) + ".fai";
+  file_unlink fu(path), fu_fai(fai_path);
+
+  std::uniform_int_distribution<size_t> rand_len(0, 250);
+  std::uniform_int_distribution<size_t> rand_width(2, 80);
+  for(int test = 0; test < 50; ++test) {
+    std::vector<record> records;
+    for(int i = 0; i < 5; ++i)
+      records.push_back({ "seq" + std::to_string(i), sequence(rand_len(rand_gen)) });
+    const size_t width     = rand_width(rand_gen);
+    const bool   crlf      = test % 3 == 0;
+    const bool   irregular = test % 5 == 0;
+    SCOPED_TRACE(::testing::Message() << "width:" << width << " crlf:" << crlf << " irregular:" << irregular);
+    unlink(fai_path.c_str());
+    write_fasta(path, records, width, crlf ? "\r\n" : "\n", irregular);
+
+    {
+      indexed_fasta fasta;
+      ASSERT_TRUE(fasta.open(path));
+      check_fetch(fasta, records);
+    }
+
+    // The index is saved only if all the records have regular lines
+    bool regular = true;
+    for(const auto& r : records)
+      regular = regular && !(irregular && r.seq.size() > 2 * width - 1);
+    std::ifstream fai(fai_path);
+    EXPECT_EQ(regular, fai.good());
+    if(regular) {
+      std::string line;
+      ASSERT_TRUE((bool)std::getline(fai, line));
+      EXPECT_EQ(0, line.compare(0, 5, "seq0\t"));
+
+      indexed_fasta fasta;
+      ASSERT_TRUE(fasta.open(path));
+      check_fetch(fasta, records);
+    }
+  }
+}
+
+TEST(FastaIndex, NotRegularFile) {
+  indexed_fasta fasta;
+  EXPECT_FALSE(fasta.open("/dev/null"));
+  EXPECT_FALSE(fasta.open("does_not_exist.fa"));
+  EXPECT_FALSE(fasta.is_open());
+}
+
+// Compressed or not FASTA: not indexed, and no .fai written
+TEST(FastaIndex, NotFasta) {
+  const char* path = "FastaIndex.fa.gz";
+  file_unlink fu(path);
+  file_unlink fu_fai(std::string(path) + ".fai");
+  {
+    std::ofstream os(path);
+    os << "\x1f\x8b\x08\x00 not really compressed\n>seq\nACGT\n";
+  }
+  indexed_fasta fasta;
+  EXPECT_FALSE(fasta.open(path));
+  EXPECT_FALSE(fasta.is_open());
+  EXPECT_FALSE(std::ifstream(std::string(path) + ".fai").good());
+}
+} // namespace
@@ -100,4 +100,50 @@ TEST(Nucmer, LongSequences) {
 
 } // Nucmer.LongSequences
 
+// The forward extensions computed in parallel give the same alignments
+// as the sequential extension of the clusters.
+TEST(Nucmer, ThreadedExtensions) {
+  std::uniform_int_distribution<int> rand_edit(0, 60);
+  const std::string s1 = sequence(20000);
+  std::string       s2;
+  for(char c : s1) {
+    switch(rand_edit(rand_gen)) {
+    case 0: s2 += c == 'a' ? 'c' : 'a'; break;
+    case 1: break;
+    case 2: s2 += c; s2 += sequence(3); break;
+    default: s2 += c; break;
+    }
+  }
+  std::string rev = s2.substr(5000, 4000);
+  mummer::nucmer::reverse_complement(rev);
+  s2.replace(5000, 4000, rev);
+  mummer::nucmer::Options opts;
+
+#ifdef _OPENMP
+  const int max_threads = omp_get_max_threads();
+#endif
+  mummer::set_num_threads(1);
+  const auto a1 = mummer::nucmer::align_sequences(s1.c_str(), s1.length(),
+                                                  s2.c_str(), s2.length(), opts);
+  mummer::set_num_threads(4);
+  const auto a4 = mummer::nucmer::align_sequences(s1.c_str(), s1.length(),
+                                                  s2.c_str(), s2.length(), opts);
+#ifdef _OPENMP
+  mummer::set_num_threads(max_threads);
+#endif
+
+  EXPECT_LT((size_t)1, a1.size());
+  ASSERT_EQ(a1.size(), a4.size());
+  for(size_t i = 0; i < a1.size(); ++i) {
+    SCOPED_TRACE(::testing::Message() << "i:" << i);
+    EXPECT_EQ(a1[i].sA, a4[i].sA);
+    EXPECT_EQ(a1[i].eA, a4[i].eA);
+    EXPECT_EQ(a1[i].sB, a4[i].sB);
+    EXPECT_EQ(a1[i].eB, a4[i].eB);
+    EXPECT_EQ(a1[i].dirB, a4[i].dirB);
+    EXPECT_EQ(a1[i].Errors, a4[i].Errors);
+    EXPECT_EQ(a1[i].delta, a4[i].delta);
+  }
+} // Nucmer.ThreadedExtensions
+
 } // empty namespace
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+#include <gtest/test.hpp>
+#include <mummer/sw_align.hh>
+
+namespace {
+using namespace mummer::sw_align;
+
+// Give access to the full dynamic programming engine
+struct engine_aligner : public aligner {
+  using aligner::aligner;
+  using aligner::_alignEngine;
+  using aligner::_alignWavefront;
+  using aligner::_searchBitVector;
+};
+
+char mutate(char c) {
+  static const char bases[] = "acgt";
+  std::uniform_int_distribution<int> rand_base(1, 3);
+  return bases[((strchr(bases, c) - bases) + rand_base(rand_gen)) % 4];
+}
+
+// The fast path of alignTarget for equal length sequences must give
+// the same result as the dynamic programming engine.
+TEST(SwAlign, UngappedAlignTarget) {
+  std::uniform_int_distribution<int> rand_len(2, 120);
+  std::uniform_int_distribution<int> rand_mm(0, 4);
+  std::uniform_int_distribution<int> rand_mode(0, 3);
+
+  const engine_aligner al;
+  int ungapped = 0;
+  for(int test = 0; test < 2000; ++test) {
+    const long int len = rand_len(rand_gen);
+    std::string    A   = ' ' + sequence(len);
+    std::string    B   = A;
+    std::uniform_int_distribution<long int> rand_pos(1, len);
+    const int nb_mm = rand_mm(rand_gen);
+    for(int i = 0; i < nb_mm; ++i) {
+      const long int pos = rand_pos(rand_gen);
+      B[pos] = mutate(B[pos]);
+    }
+    switch(rand_mode(rand_gen)) {
+    case 1: B[rand_pos(rand_gen)] = 'n'; break;
+    case 2: B[rand_pos(rand_gen)] = toupper(B[rand_pos(rand_gen)]); break;
+    default: break;
+    }
+    SCOPED_TRACE(::testing::Message() << "A:" << A << " B:" << B);
+
+    for(unsigned int m_o : { FORWARD_ALIGN, FORCED_FORWARD_ALIGN }) {
+      long int              Aend = len, Bend = len;
+      std::vector<long int> Delta;
+      const bool            reached = al.alignTarget(A.c_str(), 1, Aend, B.c_str(), 1, Bend, Delta, m_o);
+
+      long int              eAend = len, eBend = len;
+      std::vector<long int> eDelta;
+      DiagonalMatrix        Diag;
+      const bool            ereached = al._alignEngine(A.c_str(), 1, eAend, B.c_str(), 1, eBend, eDelta, m_o, Diag);
+
+      EXPECT_EQ(ereached, reached);
+      EXPECT_EQ(eAend, Aend);
+      EXPECT_EQ(eBend, Bend);
+      EXPECT_EQ(eDelta, Delta);
+      ungapped += reached && Delta.empty();
+    }
+  }
+  EXPECT_LT(0, ungapped);
+}
+
+// Score of the alignment of A[1..N] and B[1..M] given by Delta, with
+// the NUCLEOTIDE matrix. Returns a very low score if the delta does
+// not cover exactly both sequences.
+long int deltaScore(const std::string& A, long int N, const std::string& B, long int M,
+                    const std::vector<long int>& Delta) {
+  long int score = 0, i = 1, j = 1;
+  auto match = [&]() { score += MATCH_SCORE[NUCLEOTIDE][toupper(A[i++]) - 'A'][toupper(B[j++]) - 'A']; };
+  long int gap = 0; // Sign of the current gap, 0 if none
+  for(long int d : Delta) {
+    for(long int c = std::abs(d); c > 1; --c, gap = 0)
+      match();
+    const long int sign = d > 0 ? 1 : -1;
+    score += gap == sign ? CONT_GAP_SCORE[NUCLEOTIDE] : OPEN_GAP_SCORE[NUCLEOTIDE];
+    gap    = sign;
+    if(d > 0) ++i; else ++j;
+  }
+  while(i <= N && j <= M)
+    match();
+  return i == N + 1 && j == M + 1 ? score : std::numeric_limits<long int>::min();
+}
+
+// The wavefront engine finds the alignments of maximum score, at least
+// as good as the ones of the dynamic programming engine.
+TEST(SwAlign, WavefrontAlignTarget) {
+  std::uniform_int_distribution<int> rand_len(1, 400);
+  std::uniform_int_distribution<int> rand_edit(0, 30);
+
+  const engine_aligner al;
+  for(int test = 0; test < 500; ++test) {
+    const long int len = rand_len(rand_gen);
+    std::string    A   = ' ' + sequence(len);
+    std::string    B   = " ";
+    for(long int i = 1; i <= len; ++i) {
+      switch(rand_edit(rand_gen)) {
+      case 0: B += mutate(A[i]); break;
+      case 1: break;
+      case 2: B += A[i]; B += sequence(1); break;
+      default: B += A[i]; break;
+      }
+    }
+    const long int blen = B.size() - 1;
+    if(blen == 0) continue;
+    SCOPED_TRACE(::testing::Message() << "A:" << A << " B:" << B);
+
+    for(unsigned int m_o : { FORWARD_ALIGN, FORCED_FORWARD_ALIGN }) {
+      long int              Aend = len, Bend = blen;
+      std::vector<long int> Delta;
+      DiagonalMatrix        Diag;
+      const bool            reached = al._alignWavefront(A.c_str(), 1, Aend, B.c_str(), 1, Bend, Delta, m_o, Diag);
+
+      long int              eAend = len, eBend = blen;
+      std::vector<long int> eDelta;
+      const bool            ereached = al._alignEngine(A.c_str(), 1, eAend, B.c_str(), 1, eBend, eDelta, m_o, Diag);
+
+      if(m_o & FORCED_BIT) EXPECT_TRUE(reached);
+      if(!reached || !ereached) continue;
+      EXPECT_EQ(len, Aend);
+      EXPECT_EQ(blen, Bend);
+      EXPECT_GE(deltaScore(A, len, B, blen, Delta), deltaScore(A, len, B, blen, eDelta));
+    }
+  }
+}
+// The bit-vector search reaches the target of similar sequences, like
+// the dynamic programming engine, and not the one of random sequences.
+TEST(SwAlign, BitVectorSearch) {
+  std::uniform_int_distribution<int> rand_len(1, 2000);
+  std::uniform_int_distribution<int> rand_edit(0, 40);
+
+  const engine_aligner al;
+  for(int test = 0; test < 200; ++test) {
+    const long int len = rand_len(rand_gen);
+    std::string    A   = ' ' + sequence(len);
+    std::string    B   = " ";
+    for(long int i = 1; i <= len; ++i) {
+      switch(rand_edit(rand_gen)) {
+      case 0: B += mutate(A[i]); break;
+      case 1: break;
+      case 2: B += A[i]; B += sequence(1); break;
+      default: B += A[i]; break;
+      }
+    }
+    const long int blen = B.size() - 1;
+    if(blen == 0) continue;
+    std::string R = ' ' + sequence(blen);
+    SCOPED_TRACE(::testing::Message() << "A:" << A << " B:" << B);
+
+    for(unsigned int m_o : { FORWARD_SEARCH, BACKWARD_SEARCH, FORCED_FORWARD_SEARCH }) {
+      const bool     forward = m_o & DIRECTION_BIT;
+      DiagonalMatrix Diag;
+      long int       Aend = forward ? len : 1, Bend = forward ? blen : 1;
+      const bool     reached = al._searchBitVector(A.c_str(), forward ? 1 : len, Aend,
+                                                   B.c_str(), forward ? 1 : blen, Bend, m_o, Diag);
+      long int       eAend = forward ? len : 1, eBend = forward ? blen : 1;
+      std::vector<long int> eDelta;
+      const bool     ereached = al._alignEngine(A.c_str(), forward ? 1 : len, eAend,
+                                                B.c_str(), forward ? 1 : blen, eBend, eDelta, m_o, Diag);
+      EXPECT_EQ(ereached, reached);
+      if(reached) {
+        EXPECT_EQ(forward ? len : 1, Aend);
+        EXPECT_EQ(forward ? blen : 1, Bend);
+      }
+
+      if(len < 500 || (m_o & FORCED_BIT)) continue;
+      long int Rend = forward ? blen : 1;
+      Aend = forward ? len : 1;
+      EXPECT_FALSE(al._searchBitVector(A.c_str(), forward ? 1 : len, Aend,
+                                       R.c_str(), forward ? 1 : blen, Rend, m_o, Diag));
+      EXPECT_GT(200, forward ? Aend : len - Aend);
+    }
+  }
+}
+// Past 10k bases, the edits are recomputed from checkpoints during the
+// traceback. A forced alignment is still optimal, as with the forced
+// wavefront engine.
+TEST(SwAlign, CheckpointTraceback) {
+  const long int len = 15000;
+  std::string    A   = ' ' + sequence(len);
+  std::string    B   = " ";
+  std::uniform_int_distribution<int> rand_edit(0, 500);
+  for(long int i = 1; i <= len; ++i) {
+    switch(rand_edit(rand_gen)) {
+    case 0: B += mutate(A[i]); break;
+    case 1: break;
+    case 2: B += A[i]; B += sequence(1); break;
+    default: B += A[i]; break;
+    }
+  }
+  const long int blen = B.size() - 1;
+
+  const engine_aligner al;
+  DiagonalMatrix       Diag;
+  long int              Aend = len, Bend = blen;
+  std::vector<long int> Delta;
+  EXPECT_TRUE(al._alignEngine(A.c_str(), 1, Aend, B.c_str(), 1, Bend, Delta, FORCED_FORWARD_ALIGN, Diag));
+  EXPECT_EQ(len, Aend);
+  EXPECT_EQ(blen, Bend);
+
+  long int              wAend = len, wBend = blen;
+  std::vector<long int> wDelta;
+  EXPECT_TRUE(al._alignWavefront(A.c_str(), 1, wAend, B.c_str(), 1, wBend, wDelta, FORCED_FORWARD_ALIGN, Diag));
+  EXPECT_EQ(deltaScore(A, len, B, blen, wDelta), deltaScore(A, len, B, blen, Delta));
+}
+} // empty namespace
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include <gtest/test.hpp>
+#include <mummer/translate.hh>
+
+namespace {
+// Translation of frame (1-6) of A[1..len], one codon at a time through
+// the universal table.
+std::string reference_translation(const std::string& A, long int len, int frame) {
+  auto symbol = [](char c) { return transdna[(unsigned char)c] < 0 ? DNA_XN : transdna[(unsigned char)c]; };
+  std::string res;
+  if(frame <= 3) {
+    for(long int i = frame; i + 2 <= len; i += 3)
+      res += universal[(symbol(A[i]) << 8) | (symbol(A[i + 1]) << 4) | symbol(A[i + 2])];
+  } else {
+    for(long int i = len - (frame - 3) + 1; i - 2 >= 1; i -= 3)
+      res += universal[(compdna[symbol(A[i])] << 8) | (compdna[symbol(A[i - 1])] << 4) | compdna[symbol(A[i - 2])]];
+  }
+  return res;
+}
+
+// The table driven translations, one frame at a time or all six at
+// once, are the same as a direct use of the universal table.
+TEST(Translate, SixFrames) {
+  static const char bases[] = "acgtACGTuUnNrykmswbdhv";
+  std::uniform_int_distribution<int> rand_len(0, 200);
+  std::uniform_int_distribution<int> rand_base(0, 3);
+  std::uniform_int_distribution<int> rand_ambiguous(0, sizeof(bases) - 2);
+  std::uniform_int_distribution<int> rand_mode(0, 20);
+
+  for(int test = 0; test < 1000; ++test) {
+    const long int len = rand_len(rand_gen);
+    std::string    A(1, '\0');
+    for(long int i = 0; i < len; ++i)
+      A += bases[rand_mode(rand_gen) ? rand_base(rand_gen) : rand_ambiguous(rand_gen)];
+    SCOPED_TRACE(::testing::Message() << "A:" << (A.c_str() + 1));
+
+    std::vector<std::vector<char> > frames(6, std::vector<char>(len / 3 + 2));
+    char*                           tA[6];
+    long int                        tA_len[6];
+    for(int f = 0; f < 6; ++f)
+      tA[f] = frames[f].data();
+    Translate_DNA_Frames(A.c_str(), len, tA, tA_len);
+
+    for(int f = 1; f <= 6; ++f) {
+      const std::string expected = reference_translation(A, len, f);
+      EXPECT_EQ(expected, std::string(tA[f - 1] + 1));
+      EXPECT_EQ((long int)expected.size(), tA_len[f - 1]);
+
+      std::vector<char> single(len / 3 + 2);
+      EXPECT_EQ((long int)expected.size(), Translate_DNA(A.c_str(), len, single.data(), f));
+      EXPECT_EQ(expected, std::string(single.data() + 1));
+    }
+  }
+}
+} // empty namespace
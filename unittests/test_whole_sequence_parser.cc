@@ -169,4 +169,57 @@ TEST(SequenceParser, FastaMany) {
   EXPECT_EQ((size_t)nb_sequences, parser.nb_reads());
 }
 
+// Enough reads to span many blocks read from the file
+TEST(SequenceParser, FastqMany) {
+  const char* file_name = "FastqMany.fq";
+  file_unlink fu(file_name);
+  static const int nb_sequences = 20000;
+
+  std::uniform_int_distribution<int> rand_byte(0, 255);
+  std::uniform_int_distribution<int> rand_6bits(0, 63);
+
+  {
+    std::ofstream sequence(file_name);
+    ASSERT_TRUE(sequence.good());
+    for(int i = 0; i < nb_sequences; ++i) {
+      const int seq_len = rand_byte(rand_gen) + 10;
+      sequence << "@" << i << " " << seq_len << "\n";
+      for(int j = 0; j < seq_len; ++j) {
+        sequence << (char)('A' + j % 26);
+        if(rand_6bits(rand_gen) == 0)
+          sequence << '\n';
+      }
+      sequence << "\n+\n";
+      for(int j = 0; j < seq_len; ++j)
+        sequence << (char)('!' + j % 40);
+      sequence << '\n';
+    }
+  }
+
+  auto sequence = new std::ifstream(file_name);
+  opened_streams<std::ifstream**> streams(&sequence, &sequence + 1);
+  parser_type parser(10, 13, 1, streams);
+  int got_sequences = 0;
+  while(true) {
+    parser_type::job job(parser);
+    if(job.is_empty())
+      break;
+    for(size_t i = 0; i < job->nb_filled; ++i) {
+      EXPECT_EQ(got_sequences, atoi(job->data[i].header.c_str()));
+      ++got_sequences;
+      const size_t len_pos = job->data[i].header.find_first_of(" ");
+      const int seq_len = atoi(job->data[i].header.c_str() + len_pos + 1);
+      ASSERT_EQ((size_t)seq_len, job->data[i].seq.size());
+      ASSERT_EQ((size_t)seq_len, job->data[i].qual.size());
+      for(int j = 0; j < seq_len; ++j) {
+        EXPECT_EQ('A' + (j % 26), job->data[i].seq[j]);
+        EXPECT_EQ('!' + (j % 40), job->data[i].qual[j]);
+      }
+    }
+  }
+  EXPECT_EQ(nb_sequences, got_sequences);
+  EXPECT_EQ((size_t)1, parser.nb_files());
+  EXPECT_EQ((size_t)nb_sequences, parser.nb_reads());
+}
+
 }